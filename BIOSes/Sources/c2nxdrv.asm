@@ -0,0 +1,2607 @@
+;-----------------------------------------------------------------------------
+;
+; Nextor driver for the Carnivore2 IDE, with a sector cache and a RAM disk
+; in the cartridge RAM
+;
+; The kernel banks 0-6 and the header of bank 7 are taken from BIDECMFC.BIN
+; (Nextor 2.1.1), this file replaces the driver in bank 7.
+;
+; Devices 1 and 2 are the IDE master and slave, in LBA mode. Device 3 is
+; the RAM disk, RAMD_BLOCKS blocks of 64K of the cartridge RAM. Device 4 is
+; the ROM disk, a read only disk image in free flash blocks, written by
+; c2man /d as a directory entry of type "D".
+;
+; Sectors read from the IDE are kept in the cartridge RAM: CACHE_SETS sets
+; of 4 sectors, the least recently used sector of a set is replaced.
+; Writes go to the IDE and update the cached copy. The tags (LBA and device
+; of each cached sector) and the LRU order of every set are in the work
+; area, so a hit is a single copy out of the cartridge RAM.
+;
+; The RAM is reached through bank 1 of the cartridge subslot at 6000h-7FFFh,
+; with a routine copied to the work area that saves and restores the bank
+; registers around the copy. The cache is bypassed while the RAM may be
+; used by someone else (Shadow BIOS on, RAM mapper enabled, a bank mapping
+; RAM, registers hidden) and emptied the next time it can be used. It is emptied too on
+; IDE errors, and when DEV_STATUS finds another card: the serial number of
+; the IDENTIFY data is checked there, so a media change does not return
+; stale sectors. A hit costs about as much as a read from a fast card, the
+; cache only saves the command latency of slow cards and is not built by
+; default.
+;
+; The RAM disk is reached through the same window, and is not ready in the
+; same cases. It is formatted (FAT12, no partition table) at initialization
+; when its boot sector is not valid, which is the case after power on.
+; DRV_CONFIG gives a drive to the first IDE device, one to the RAM disk and
+; one to the ROM disk.
+;
+; The hit and miss counters are read with _CDRVR, routine DRV_DIRECT0:
+;   A=0: hits, A=1: misses -> HL:DE = count, BC = cache size in sectors
+; DRV_DIRECT1 empties the cache and resets the counters.
+;
+; Build: sjasm c2nxdrv.asm ../BIDEC2NX.BIN
+;
+;-----------------------------------------------------------------------------
+
+; !COMPILATION OPTIONS!
+CACHE_PAGE	equ	#78	;First 8K page of the cache in the cartridge RAM (F0000h)
+CACHE_SETS	equ	0	;Sets of 4 sectors: 2-64, power of 2, 0 = no cache
+			;The cache takes CACHE_SETS*2K of RAM and CACHE_SETS*17
+			;bytes of work area, it must end within the 1MB:
+			;CACHE_PAGE+CACHE_SETS/4 <= 128
+CACHE_MAXRUN	equ	4	;Reads of more sectors bypass the cache
+RAMD_FIRST	equ	12	;First 64K block of the RAM disk in the cartridge RAM
+RAMD_BLOCKS	equ	3	;Size of the RAM disk in 64K blocks, 0 = no RAM disk
+			;It must end below the cache: RAMD_FIRST+RAMD_BLOCKS <= 16
+			;and RAMD_FIRST+RAMD_BLOCKS <= CACHE_PAGE/8
+			;Blocks 1-3 hold the Shadow BIOS, c2ramldr loads ROMs
+			;from block 4 on: RAMD_FIRST >= 12 keeps the boot
+			;sector in the first block such a load overwrites
+
+DRV_MAJOR	equ	1
+DRV_MINOR	equ	1
+DRV_REV		equ	0
+
+;-----------------------------------------------------------------------------
+;
+; BIOS and kernel
+
+CHPUT	equ	#00A2
+ENASLT	equ	#0024
+
+GSLOT1	equ	#402D	;Get slot of page 1, in bank 0
+CALBNK	equ	#4042	;Call a routine in another bank
+GWORK	equ	#4045	;Get the work area address, in bank 0
+
+; Carnivore2 registers, cartridge subslot
+
+CardMDR	equ	#4F80
+AddrFR	equ	CardMDR+#05
+R1Reg	equ	CardMDR+#08
+R1Mult	equ	CardMDR+#09
+B1MaskR	equ	CardMDR+#0A
+B1AdrD	equ	CardMDR+#0B
+R2Mult	equ	CardMDR+#0F
+R3Mult	equ	CardMDR+#15
+R4Mult	equ	CardMDR+#1B
+CardMod	equ	CardMDR+#1E	;bit 2: RAM mapper enabled
+C2Ver	equ	CardMDR+#2C	;Firmware version, 3 ASCII digits
+
+M_SHADOW	equ	#02	;CardMDR: Shadow BIOS in the RAM
+M_DELAY	equ	#08	;CardMDR: delayed reconfiguration
+M_MAPEN	equ	#04	;CardMod: RAM mapper enabled
+M_RAMOFF	equ	#28	;RxMult: RAM, bank disabled
+M_RAM	equ	#20	;RxMult: RAM
+
+XMULT_RAM	equ	#34	;Window at 6000h: 8K, RAM, writable
+XMULT_ROM	equ	#04	;Window at 6000h: 8K, flash, read only
+XMULT_OFF	equ	#08	;Bank disabled
+
+; IDE registers, IDE subslot
+
+IDE_BANK	equ	#4104	;bit 0: enable (1) or disable (0) IDE registers
+				;bits 5-7: select 16K ROM bank
+IDE_DATA	equ	#7C00	;Data registers, this is a 512 byte area
+IDE_ERROR	equ	#7E01	;Error register
+IDE_SECCNT	equ	#7E02	;Sector count
+IDE_LBALOW	equ	#7E03	;Logical sector low
+IDE_LBAMID	equ	#7E04	;Logical sector mid
+IDE_LBAHIGH	equ	#7E05	;Logical sector high
+IDE_HEAD	equ	#7E06	;bits 0-3: logical sector higher
+IDE_STATUS	equ	#7E07	;Status register
+IDE_CMD		equ	#7E07	;Command register
+IDE_DEVCTRL	equ	#7E0E	;Device control register
+
+ATA_READ	equ	#20	;Read sectors
+ATA_WRITE	equ	#30	;Write sectors
+ATA_IDENTIFY	equ	#EC	;Identify device
+
+; Bits in the error register
+
+WP	equ	6	;Write protected
+IDNF	equ	4	;ID Not Found
+NM	equ	1	;No media
+
+; Head register: LBA mode, bits 7 and 5 set for old devices
+
+M_HEAD	equ	#E0
+M_DEV	equ	#10	;Slave
+
+; Bits in the status register
+
+BSY	equ	7	;Busy
+
+M_BSY	equ	#80
+M_DRDY	equ	#40
+M_DF	equ	#20
+M_DRQ	equ	#08
+M_ERR	equ	#01
+
+M_SRST	equ	#04	;Device control: software reset
+
+; Timeouts for WAIT_RDY, in units of about 3.7ms
+
+T_CMD	equ	8142	;30s
+T_RESET	equ	1357	;5s
+T_SLAVE	equ	136	;0.5s
+
+; RAM disk
+
+RAMD_DEV	equ	3		;Device index
+ROMD_DEV	equ	4		;Device index of the ROM disk
+RD_SECS		equ	RAMD_BLOCKS*128	;Size in sectors
+RD_FATSEC	equ	((RD_SECS+2)*3/2+511)/512	;Sectors per FAT, FAT12
+RD_ROOTSEC	equ	8		;Root directory sectors, 128 entries
+
+; Error codes for DEV_RW
+
+.NCOMP	equ	#0FF
+.WRERR	equ	#0FE
+.DISK	equ	#0FD
+.NRDY	equ	#0FC
+.DATA	equ	#0FA
+.RNF	equ	#0F9
+.WPROT	equ	#0F8
+.UFORM	equ	#0F7
+.SEEK	equ	#0F3
+.IFORM	equ	#0F0
+.IDEVL	equ	#0B5
+.IPARM	equ	#08B
+
+; Work area
+
+W_DEVS	equ	0	;bit 0: master present, bit 1: slave present,
+			;bit 2: RAM disk present, bit 3: ROM disk present,
+			;bit 7: RAM disk changed
+W_HEAD	equ	1	;Head register of the selected device
+W_DTAG	equ	2	;Selected device in bits 7-4, for the cache tags
+W_CACHE	equ	3	;bit 0: cache enabled, bit 1: cache to be emptied
+W_OWNSLT	equ	4	;Slot of the driver
+W_CARSLT	equ	5	;Slot of the cartridge subslot
+W_XBLK	equ	6	;Window of XFER: 64K block,
+W_XPAGE	equ	7	;8K page in the block
+W_XMULT	equ	8	;and bank mode
+W_WAY	equ	9	;Way of the set found or to replace
+W_SMDR	equ	10	;CardMDR saved by XFER
+W_SREGS	equ	11	;AddrFR and the bank registers saved by XFER, 25 bytes
+W_LBA	equ	36	;Sector of the transfer, bits 31-28 = device (cache tag)
+W_HITS	equ	40	;Cache hits, 32 bit
+W_MISS	equ	44	;Cache misses, 32 bit
+W_RBLK	equ	48	;First 64K block of the ROM disk
+W_RSIZE	equ	49	;Size of the ROM disk in sectors
+W_SERIAL	equ	51	;Signature of the serial number of the master and slave,
+			;16 bit each, see ID_SERIAL
+W_XFER	equ	55	;XFER routine, then the LRU order of the sets (W_LRU)
+			;and the tags of the sets (W_TAGS)
+
+LRU_INIT	equ	#E4	;Ways 3,2,1,0 from least to most recently used
+
+
+;-----------------------------------------------------------------------------
+;
+; Kernel banks and bank 7 header
+
+	incbin	"../BIDECMFC.BIN",0,7*#4000+#100
+
+	org	#4100
+
+	db	"NEXTOR_DRIVER",0
+	db	1+4		;Device-based driver, with DRV_CONFIG
+	db	0
+	db	"Carnivore2 IDE                  "
+
+	jp	DRV_TIMI
+	jp	DRV_VERSION
+	jp	DRV_INIT
+	jp	DRV_BASSTAT
+	jp	DRV_BASDEV
+	jp	DRV_EXTBIO
+	jp	DRV_DIRECT0
+	jp	DRV_DIRECT1
+	jp	DRV_DIRECT2
+	jp	DRV_DIRECT3
+	jp	DRV_DIRECT4
+	jp	DRV_CONFIG
+
+	ds	12
+
+	jp	DEV_RW
+	jp	DEV_INFO
+	jp	DEV_STATUS
+	jp	LUN_INFO
+	jp	DEV_FORMAT
+	jp	DEV_CMD
+
+
+;-----------------------------------------------------------------------------
+;
+; Driver routines with nothing to do
+
+DRV_TIMI:
+DRV_EXTBIO:
+DRV_DIRECT2:
+DRV_DIRECT3:
+DRV_DIRECT4:
+	ret
+
+DRV_BASSTAT:
+DRV_BASDEV:
+	scf
+	ret
+
+DRV_VERSION:
+	ld	a,DRV_MAJOR
+	ld	b,DRV_MINOR
+	ld	c,DRV_REV
+	ret
+
+DEV_FORMAT:
+	ld	a,.IFORM
+	ret
+
+DEV_CMD:
+	ld	a,2
+	ret
+
+
+;-----------------------------------------------------------------------------
+;
+; Driver initialization
+;
+; Input:  A = 0: return the size of the work area in HL
+;         A = 1: initialize the driver
+;
+DRV_INIT:
+	ld	hl,W_SIZE
+	or	a
+	ret	z
+
+	call	GETWRK
+	push	ix
+	pop	hl
+	ld	d,h
+	ld	e,l
+	inc	de
+	ld	bc,W_SIZE-1
+	ld	(hl),0
+	ldir
+
+	ld	de,STR_TITLE
+	call	PRINT
+
+	call	IDE_ON
+	ld	a,M_SRST
+	ld	(IDE_DEVCTRL),a
+	ld	b,0
+DRV_INIT_SRST:
+	djnz	DRV_INIT_SRST
+	xor	a
+	ld	(IDE_DEVCTRL),a
+
+	ld	de,STR_MASTER
+	call	PRINT
+	ld	a,1
+	ld	de,T_RESET
+	call	DEV_DETECT
+	ld	de,STR_SLAVE
+	call	PRINT
+	ld	a,2
+	ld	de,T_SLAVE
+	call	DEV_DETECT
+	call	IDE_OFF
+
+	call	XF_INIT
+   if CACHE_SETS
+	push	af
+	call	CA_INIT
+	pop	af
+   endif
+   if RAMD_BLOCKS
+	push	af
+	call	RD_INIT
+	pop	af
+   endif
+	jp	RO_INIT
+
+
+;-----------------------------------------------------------------------------
+; Detect a device and print its model
+;
+; Input:  A = Device (1 or 2)
+;         DE = Timeout for the device to get ready
+;
+DEV_DETECT:
+	push	af
+	call	DEV_HEAD
+	ld	a,(IDE_STATUS)
+	inc	a
+	jr	z,DEV_DET_NONE	;Nothing connected
+	call	IDE_IDENT
+	jr	c,DEV_DET_NONE
+
+	pop	af
+	ld	b,1
+	dec	a
+	jr	z,DEV_DET_SET
+	ld	b,2
+DEV_DET_SET:
+	ld	a,(ix+W_DEVS)
+	or	b
+	ld	(ix+W_DEVS),a
+
+   if CACHE_SETS
+	ld	b,10		;Words 10-19: serial number
+	call	ID_SKIP
+	call	ID_SERIAL
+	push	de
+	ld	b,7		;Words 27-46: model
+   else
+	ld	b,27		;Words 27-46: model
+   endif
+	call	ID_SKIP
+	ld	b,20
+	call	ID_PRINT
+	call	ID_DRAIN
+   if CACHE_SETS
+	pop	de
+	call	SER_ADR
+	ld	(hl),e
+	inc	hl
+	ld	(hl),d
+   endif
+	jr	DEV_DET_END
+
+DEV_DET_NONE:
+	pop	af
+	ld	de,STR_NONE
+	call	PRINT
+DEV_DET_END:
+	ld	de,STR_CRLF
+	jp	PRINT
+
+
+;-----------------------------------------------------------------------------
+; DRV_CONFIG: Get driver configuration
+;
+; Input:  A = 1: Get number of drives at boot time
+;             B = 0 for DOS 2 mode, 1 for DOS 1 mode
+;             C: bit 5 set if the user requests a reduced drive count
+;         A = 2: Get default configuration for drive
+;             B = 0 for DOS 2 mode, 1 for DOS 1 mode
+;             C = Relative drive number at boot time
+; Output: A = 0: OK, 1: Configuration not available
+;         A = 1: B = Number of drives
+;         A = 2: B = Device index, C = LUN index
+;
+; The first IDE device present gets a drive, the RAM disk and the ROM disk
+; one each.
+;
+DRV_CONFIG:
+	call	GETWRK
+	dec	a
+	jr	z,DRV_CFG_COUNT
+	dec	a
+	jr	z,DRV_CFG_DRIVE
+	ld	a,1
+	ret
+
+DRV_CFG_COUNT:
+	call	DRV_CFG_LIST
+	bit	5,c
+	jr	z,DRV_CFG_OK
+	ld	a,b
+	or	a
+	jr	z,DRV_CFG_OK
+	ld	b,1		;Reduced: the first drive only
+DRV_CFG_OK:
+	xor	a
+	ret
+
+DRV_CFG_DRIVE:
+	call	DRV_CFG_LIST
+	ld	a,d
+	or	a
+	ld	a,1
+	ret	z		;No such drive
+	ld	b,d
+	ld	c,1
+	xor	a
+	ret
+
+; Devices of the drives
+; Input:  C = Relative drive number
+; Output: B = Number of drives
+;         D = Device of the drive, 0 if there is no such drive
+; Preserves: C
+
+DRV_CFG_LIST:
+	ld	h,(ix+W_DEVS)
+	bit	0,h
+	jr	z,DRV_CFG_FIRST
+	res	1,h		;Master present: no drive for the slave
+DRV_CFG_FIRST:
+	ld	b,0		;Drives
+	ld	d,b
+	ld	e,1		;Device
+DRV_CFG_DEV:
+	srl	h
+	jr	nc,DRV_CFG_NEXT
+	ld	a,b
+	cp	c
+	jr	nz,DRV_CFG_ADD
+	ld	d,e
+DRV_CFG_ADD:
+	inc	b
+DRV_CFG_NEXT:
+	inc	e
+	ld	a,e
+	cp	ROMD_DEV+1
+	jr	c,DRV_CFG_DEV
+	ret
+
+
+;-----------------------------------------------------------------------------
+;
+; Device routines
+
+;-----------------------------------------------------------------------------
+; DEV_RW: Read or write sectors
+;
+; Input:  Cy = 0 to read, 1 to write
+;         A = Device number, 1 to 7
+;         B = Number of sectors to read or write
+;         C = Logical unit number, 1 to 7
+;         HL = Source or destination memory address for the transfer
+;         DE = Address where the 4 byte sector number is stored
+; Output: A = Error code (the same codes of MSX-DOS are used)
+;         B = Number of sectors actually read/written
+;
+DEV_RW:
+	push	af
+	call	GETWRK
+	ld	a,c
+	dec	a
+	jr	nz,DEV_RW_IDEVL	;Only LUN 1
+	pop	af
+	push	af
+	call	DEV_SEL
+	jr	c,DEV_RW_IDEVL
+
+	ex	de,hl		;Sector number to W_LBA
+	ld	a,(hl)
+	ld	(ix+W_LBA),a
+	inc	hl
+	ld	a,(hl)
+	ld	(ix+W_LBA+1),a
+	inc	hl
+	ld	a,(hl)
+	ld	(ix+W_LBA+2),a
+	inc	hl
+	ld	a,(hl)
+	ex	de,hl
+	cp	#10
+	jr	nc,DEV_RW_RNF	;LBA has 28 bits
+	or	(ix+W_DTAG)
+	ld	(ix+W_LBA+3),a
+
+	ld	a,(ix+W_DTAG)
+	cp	RAMD_DEV*16
+	jr	nc,DEV_RW_MEM	;RAM disk or ROM disk
+	pop	af
+	ld	a,b
+	jr	c,DEV_WR
+	or	a
+	ret	z		;Nothing to read
+
+	cp	CACHE_MAXRUN+1
+	jr	c,DEV_RD_CACHE
+DEV_RD_IDE:
+	or	a
+	call	IDE_RW
+	ret	z
+	jp	CA_INVAL
+
+DEV_RW_IDEVL:
+	pop	af
+	ld	a,.IDEVL
+	ld	b,0
+	ret
+
+DEV_RW_RNF:
+	pop	af
+	ld	a,.RNF
+	ld	b,0
+	ret
+
+DEV_RW_MEM:
+	pop	af
+	jp	MD_RW
+
+	;--- Read through the cache, one sector at a time
+
+DEV_RD_CACHE:
+	ld	c,b		;C = Sectors to read
+	ld	b,0		;B = Sectors read
+DEV_RD_SECT:
+	push	bc
+	push	hl
+	call	CA_FIND
+	pop	hl
+	jr	c,DEV_RD_REST
+	jr	nz,DEV_RD_MISS
+
+	push	hl
+	ex	de,hl
+	call	CA_GET
+	pop	hl
+	jr	c,DEV_RD_REST
+	ld	bc,W_HITS
+	jr	DEV_RD_NEXT
+
+DEV_RD_MISS:
+	push	hl
+	ld	b,1
+	or	a
+	call	IDE_RW
+	pop	hl
+	jr	nz,DEV_RD_FAIL
+	push	hl
+	call	CA_PUT
+	pop	hl
+	ld	bc,W_MISS
+DEV_RD_NEXT:
+	push	hl
+	call	INC32
+	call	CA_TOUCH
+	pop	hl
+	inc	h
+	inc	h
+	call	LBA_INC
+	pop	bc
+	inc	b
+	ld	a,b
+	cp	c
+	jr	nz,DEV_RD_SECT
+	xor	a
+	ret
+
+DEV_RD_REST:			;No cache: the rest from the IDE
+	pop	bc
+	ld	a,c
+	sub	b
+	push	bc
+	ld	b,a
+	or	a
+	call	IDE_RW
+	pop	de
+	push	af
+	ld	a,b
+	add	a,d
+	ld	b,a
+	pop	af
+	ret	z
+	jp	CA_INVAL
+
+DEV_RD_FAIL:
+	pop	bc
+	jp	CA_INVAL
+
+	;--- Write to the IDE, then update the cached sectors
+
+DEV_WR:
+	or	a
+	ret	z		;Nothing to write
+	push	hl
+	push	bc
+	scf
+	call	IDE_RW
+	pop	de
+	pop	hl
+	jp	nz,CA_INVAL
+
+	ld	a,d
+	cp	CACHE_MAXRUN+1
+	ld	c,b		;C = Sectors written
+	ld	b,0
+	ld	e,0
+	rl	e		;E = 1 if short write: sectors not cached are added
+DEV_WR_SECT:
+	push	bc
+	push	de
+	push	hl
+	call	CA_FIND
+	pop	hl
+	pop	de
+	jr	c,DEV_WR_END
+	jr	z,DEV_WR_PUT
+	bit	0,e
+	jr	z,DEV_WR_NEXT
+DEV_WR_PUT:
+	push	de
+	push	hl
+	call	CA_PUT
+	call	CA_TOUCH
+	pop	hl
+	pop	de
+DEV_WR_NEXT:
+	inc	h
+	inc	h
+	call	LBA_INC
+	pop	bc
+	inc	b
+	ld	a,b
+	cp	c
+	jr	nz,DEV_WR_SECT
+	xor	a
+	ret
+
+DEV_WR_END:
+	pop	bc
+	ld	b,c
+	xor	a
+	ret
+
+
+;-----------------------------------------------------------------------------
+; DEV_INFO: Obtain device information
+;
+; Input:  A = Device index, 1 to 7
+;         B = Information to return:
+;             0: Basic information
+;             1: Manufacturer name string
+;             2: Device name string
+;             3: Serial number string
+;         HL = Pointer to a buffer in RAM
+; Output: A = Error code: 0 = OK, 1 = Information not available
+;
+DEV_INFO:
+	call	GETWRK
+	call	DEV_SEL
+	jr	c,DEV_INFO_ERR
+
+	ld	a,b
+	or	a
+	jr	nz,DEV_INFO_STR
+	ld	(hl),1		;One LUN
+	inc	hl
+	ld	(hl),0		;No flags
+	xor	a
+	ret
+
+DEV_INFO_STR:
+	ld	c,a
+	ld	a,(ix+W_DTAG)
+	cp	RAMD_DEV*16
+	ld	a,c
+	jp	nc,MD_INFO
+	ld	c,20		;Model: words 27-46
+	ld	b,27
+	cp	2
+	jr	z,DEV_INFO_ID
+	ld	c,10		;Serial: words 10-19
+	ld	b,10
+	cp	3
+	jr	nz,DEV_INFO_ERR
+DEV_INFO_ID:
+	push	bc
+	push	hl
+	call	IDE_ON
+	ld	de,T_CMD
+	call	IDE_IDENT
+	pop	de
+	pop	bc
+	jr	c,DEV_INFO_FAIL
+	push	de
+	push	bc
+	call	ID_SKIP
+	pop	bc
+	ld	b,c
+	call	ID_STR
+	call	ID_DRAIN
+	call	IDE_OFF
+
+DEV_INFO_SPACES:
+	pop	hl		;Pad with spaces to 64 characters
+	ld	bc,64
+	add	hl,bc
+	or	a
+	sbc	hl,de
+	ld	b,l
+	ld	a," "
+DEV_INFO_PAD:
+	ld	(de),a
+	inc	de
+	djnz	DEV_INFO_PAD
+	xor	a
+	ret
+
+DEV_INFO_FAIL:
+	call	IDE_OFF
+DEV_INFO_ERR:
+	ld	a,1
+	ret
+
+
+;-----------------------------------------------------------------------------
+; DEV_STATUS: Obtain device status
+;
+; Input:  A = Device index, 1 to 7
+;         B = Logical unit number, 1 to 7
+; Output: A = Status:
+;             0: The device or LUN is not available
+;             1: The device or LUN is available and has not changed
+;             2: The device or LUN is available and has changed
+;
+; With the cache, an IDE device has changed when the serial number of the
+; card is not the one seen last time, the cache is emptied then. It is
+; emptied too when the device does not answer, the card may be changed
+; meanwhile. Without the cache the IDE devices are always unchanged.
+;
+DEV_STATUS:
+	call	GETWRK
+	call	DEV_SEL
+	ld	a,0
+	ret	c
+	dec	b
+	ret	nz
+	ld	a,(ix+W_DTAG)
+	cp	RAMD_DEV*16
+	jr	c,DEV_STAT_IDE
+	ld	a,1
+	ret	nz
+	bit	7,(ix+W_DEVS)	;RAM disk overwritten?
+	ret	z
+	res	7,(ix+W_DEVS)
+	inc	a
+	ret
+
+DEV_STAT_IDE:
+   if CACHE_SETS
+	call	IDE_ON
+	ld	a,(IDE_STATUS)
+	inc	a
+	jr	z,DEV_STAT_NONE	;Card removed
+	ld	de,T_SLAVE
+	call	IDE_IDENT
+	jr	c,DEV_STAT_NONE
+	ld	b,10		;Words 10-19: serial number
+	call	ID_SKIP
+	call	ID_SERIAL
+	call	ID_DRAIN
+	call	IDE_OFF
+
+	call	SER_ADR
+	ld	c,(hl)
+	ld	(hl),e
+	inc	hl
+	ld	b,(hl)
+	ld	(hl),d
+	ex	de,hl
+	or	a
+	sbc	hl,bc
+	ld	a,1
+	ret	z
+	call	CA_INVAL
+	inc	a
+	ret
+
+DEV_STAT_NONE:
+	call	IDE_OFF
+	call	CA_INVAL
+	xor	a
+	ret
+   else
+	ld	a,1
+	ret
+   endif
+
+
+;-----------------------------------------------------------------------------
+; LUN_INFO: Obtain information about a logical unit
+;
+; Input:  A = Device index, 1 to 7
+;         B = Logical unit number, 1 to 7
+;         HL = Pointer to buffer in RAM
+; Output: A = 0: OK, buffer filled with information
+;             1: Error, device or logical unit not available
+;
+LUN_INFO:
+	call	GETWRK
+	call	DEV_SEL
+	jr	c,LUN_INFO_ERR
+	dec	b
+	jr	nz,LUN_INFO_ERR
+	ld	a,(ix+W_DTAG)
+	cp	RAMD_DEV*16
+	jp	nc,MD_LUN_INFO
+
+	push	hl
+	call	IDE_ON
+	ld	de,T_CMD
+	call	IDE_IDENT
+	pop	de
+	jr	c,LUN_INFO_FAIL
+
+	xor	a
+	ld	(de),a		;+0: Block device
+	inc	de
+	ld	(de),a		;+1: Sector size, 512
+	inc	de
+	ld	a,2
+	ld	(de),a
+	inc	de
+	push	de		;+3: Sectors, from words 60-61
+	inc	de
+	inc	de
+	inc	de
+	inc	de
+	xor	a
+	ld	(de),a		;+7: Fixed device
+	inc	de
+
+	ld	b,1		;+8: Cylinders, word 1
+	call	ID_SKIP
+	ldi
+	ldi
+	ld	b,1		;+10: Heads, word 3
+	call	ID_SKIP
+	ldi
+	inc	hl
+	ld	b,2		;+11: Sectors per track, word 6
+	call	ID_SKIP
+	ldi
+	inc	hl
+	pop	de
+	ld	b,53
+	call	ID_SKIP
+	ld	bc,4
+	ldir
+	call	ID_DRAIN
+	call	IDE_OFF
+	xor	a
+	ret
+
+LUN_INFO_FAIL:
+	call	IDE_OFF
+LUN_INFO_ERR:
+	ld	a,1
+	ret
+
+
+;-----------------------------------------------------------------------------
+; Select a device
+;
+; Input:  A = Device index
+; Output: Cy=1 if the device does not exist
+;         W_HEAD and W_DTAG set for the device
+; Preserves: BC, DE, HL
+;
+DEV_SEL:
+	push	bc
+	ld	c,a
+	dec	a
+	cp	ROMD_DEV
+	jr	nc,DEV_SEL_NONE	;Devices 1 to 4 only
+	ld	b,c
+	ld	a,1		;Bit of the device in W_DEVS
+	jr	DEV_SEL_NEXT
+DEV_SEL_BIT:
+	add	a,a
+DEV_SEL_NEXT:
+	djnz	DEV_SEL_BIT
+	and	(ix+W_DEVS)
+	jr	z,DEV_SEL_NONE
+	ld	a,c
+	call	DEV_HEAD
+	or	a
+	jr	DEV_SEL_END
+DEV_SEL_NONE:
+	scf
+DEV_SEL_END:
+	pop	bc
+	ret
+
+   if CACHE_SETS
+; Address of the serial number signature of the selected IDE device
+; Output: HL = Address in the work area
+; Preserves: DE
+
+SER_ADR:
+	ld	bc,W_SERIAL
+	bit	4,(ix+W_HEAD)	;M_DEV
+	jp	z,WRKADR
+	ld	bc,W_SERIAL+2
+	jp	WRKADR
+   endif
+
+; Set W_HEAD and W_DTAG for a device
+; Input: A = Device index, 1 to 4
+; Preserves: BC, DE, HL
+
+DEV_HEAD:
+	push	af
+	rrca
+	rrca
+	rrca
+	rrca
+	ld	(ix+W_DTAG),a
+	pop	af
+	dec	a
+	ld	a,M_HEAD
+	jr	z,DEV_HEAD_SET
+	or	M_DEV
+DEV_HEAD_SET:
+	ld	(ix+W_HEAD),a
+	ret
+
+
+;-----------------------------------------------------------------------------
+;
+; IDE access
+
+;-----------------------------------------------------------------------------
+; Read or write sectors of the selected device
+;
+; Input:  Cy = 0 to read, 1 to write
+;         B = Number of sectors, 1 to 255
+;         HL = Memory address
+;         W_LBA = First sector
+; Output: A = Error code, Z if no error
+;         B = Number of sectors actually read/written
+;         HL = Memory address after the sectors transferred
+;
+IDE_RW:
+	push	af
+	call	IDE_ON
+	ld	a,(ix+W_HEAD)	;IDE_HEAD must be written first
+	ld	c,a
+	ld	a,(ix+W_LBA+3)
+	and	#0F
+	or	c
+	ld	(IDE_HEAD),a
+	ld	de,T_CMD
+	call	WAIT_RDY
+	jr	c,IDE_RW_NRDY
+	ld	a,(ix+W_LBA)
+	ld	(IDE_LBALOW),a
+	ld	a,(ix+W_LBA+1)
+	ld	(IDE_LBAMID),a
+	ld	a,(ix+W_LBA+2)
+	ld	(IDE_LBAHIGH),a
+	ld	a,b
+	ld	(IDE_SECCNT),a
+	ld	c,b		;C = Sectors requested, B = sectors left
+
+	pop	af
+	push	af
+	ld	a,ATA_READ
+	jr	nc,IDE_RW_CMD
+	ld	a,ATA_WRITE
+IDE_RW_CMD:
+	ld	(IDE_CMD),a
+
+IDE_RW_SECT:
+	call	IDE_WAITDRQ
+	jr	c,IDE_RW_ERR
+	pop	af
+	push	af
+	push	bc
+	jr	c,IDE_RW_WR
+	ex	de,hl
+	ld	hl,IDE_DATA
+	call	IDE_SECT
+	ex	de,hl
+	jr	IDE_RW_NEXT
+IDE_RW_WR:
+	ld	de,IDE_DATA
+	call	IDE_SECT
+IDE_RW_NEXT:
+	pop	bc
+	djnz	IDE_RW_SECT
+
+	pop	af		;Writes end when the device is no longer busy
+	push	af
+	jr	nc,IDE_RW_DONE
+	call	IDE_WAITBSY
+	jr	c,IDE_RW_ERR
+IDE_RW_DONE:
+	pop	af
+	ld	a,(IDE_STATUS)
+	and	M_DF
+	ld	a,.DISK
+	jr	nz,IDE_RW_END
+	xor	a
+	jr	IDE_RW_END
+
+IDE_RW_NRDY:
+	pop	af
+	ld	a,.NRDY
+	ld	c,b
+	jr	IDE_RW_END
+
+IDE_RW_ERR:
+	pop	af
+	ld	e,.NRDY
+	ld	a,(IDE_STATUS)
+	rlca
+	jr	c,IDE_RW_CODE	;Still busy: timeout
+	ld	a,(IDE_ERROR)
+	bit	NM,a		;Not ready
+	jr	nz,IDE_RW_CODE
+	ld	e,.RNF
+	bit	IDNF,a		;Sector not found
+	jr	nz,IDE_RW_CODE
+	ld	e,.WPROT
+	bit	WP,a		;Write protected
+	jr	nz,IDE_RW_CODE
+	ld	e,.DISK		;Other error
+IDE_RW_CODE:
+	ld	a,e
+IDE_RW_END:
+	push	af
+	call	IDE_OFF
+	ld	a,c		;Sectors done = requested - left
+	sub	b
+	ld	b,a
+	pop	af
+	or	a
+	ret
+
+
+;-----------------------------------------------------------------------------
+; Move one sector between the data register and memory
+;
+; Unrolled LDIs take 18 T-states per byte on MSX (M1 wait included),
+; LDIR takes 23.
+;
+; Input:  HL = Source, DE = Destination
+; Output: HL, DE = after the sector
+; Modifies: AF, BC
+;
+IDE_SECT:
+	ld	bc,512
+IDE_SECT_LOOP:
+	ldi
+	ldi
+	ldi
+	ldi
+	ldi
+	ldi
+	ldi
+	ldi
+	ldi
+	ldi
+	ldi
+	ldi
+	ldi
+	ldi
+	ldi
+	ldi
+	jp	pe,IDE_SECT_LOOP
+	ret
+
+
+;-----------------------------------------------------------------------------
+; IDENTIFY DEVICE on the selected device
+;
+; Input:  DE = Timeout for the device to get ready
+; Output: Cy=1 if the command failed
+;         HL = IDE_DATA, to read the data with ID_SKIP, ID_STR, ID_PRINT
+;              and ID_DRAIN
+; The IDE registers must be switched on.
+;
+IDE_IDENT:
+	ld	a,(ix+W_HEAD)
+	ld	(IDE_HEAD),a
+	push	de
+	call	WAIT_RDY
+	pop	de
+	ret	c
+	ld	a,ATA_IDENTIFY
+	ld	(IDE_CMD),a
+IDE_IDENT_WAIT:
+	ld	b,255
+IDE_IDENT_WAIT2:
+	ld	a,(IDE_STATUS)
+	bit	BSY,a
+	jr	z,IDE_IDENT_END
+	djnz	IDE_IDENT_WAIT2
+	dec	de
+	ld	a,d
+	or	e
+	jr	nz,IDE_IDENT_WAIT
+	scf
+	ret
+IDE_IDENT_END:
+	and	M_DRQ+M_ERR
+	cp	M_DRQ
+	scf
+	ret	nz
+	ld	hl,IDE_DATA
+	or	a
+	ret
+
+; Skip B words of the IDENTIFY data
+
+ID_SKIP:
+	ld	a,(hl)
+	inc	hl
+	ld	a,(hl)
+	inc	hl
+	djnz	ID_SKIP
+	ret
+
+; Copy a string of B words to DE, the bytes of each word are swapped
+
+ID_STR:
+	ld	c,(hl)
+	inc	hl
+	ld	a,(hl)
+	inc	hl
+	ld	(de),a
+	inc	de
+	ld	a,c
+	ld	(de),a
+	inc	de
+	djnz	ID_STR
+	ret
+
+; Print a string of B words without the trailing spaces
+
+ID_PRINT:
+	ld	c,0		;Spaces not printed yet
+ID_PRINT_WORD:
+	ld	e,(hl)
+	inc	hl
+	ld	a,(hl)
+	inc	hl
+	call	ID_PRINT_CHAR
+	ld	a,e
+	call	ID_PRINT_CHAR
+	djnz	ID_PRINT_WORD
+	ret
+
+ID_PRINT_CHAR:
+	cp	" "
+	jr	nz,ID_PRINT_SP
+	inc	c
+	ret
+ID_PRINT_SP:
+	push	af
+ID_PRINT_SP2:
+	ld	a,c
+	or	a
+	jr	z,ID_PRINT_OUT
+	ld	a," "
+	call	CHPUT
+	dec	c
+	jr	ID_PRINT_SP2
+ID_PRINT_OUT:
+	pop	af
+	jp	CHPUT
+
+   if CACHE_SETS
+; Signature of a serial number of 10 words, to tell the cards apart
+; Output: DE = Signature
+
+ID_SERIAL:
+	ld	de,0
+	ld	b,10
+ID_SERIAL_WORD:
+	ex	de,hl		;Rotate left, then mix in the word
+	add	hl,hl
+	jr	nc,ID_SERIAL_ADD
+	inc	hl
+ID_SERIAL_ADD:
+	ex	de,hl
+	ld	a,(hl)
+	inc	hl
+	xor	e
+	ld	e,a
+	ld	a,(hl)
+	inc	hl
+	xor	d
+	ld	d,a
+	djnz	ID_SERIAL_WORD
+	ret
+   endif
+
+; Read the rest of the data, so the device ends the command
+
+ID_DRAIN:
+	ld	a,h
+	cp	(IDE_DATA+512)/256
+	ret	z
+	ld	a,(hl)
+	inc	hl
+	jr	ID_DRAIN
+
+
+;-----------------------------------------------------------------------------
+; Wait the BSY flag to clear and RDY flag to be set
+;
+; Input:  DE = Timeout, in units of about 3.7ms
+; Output: Cy=1 on timeout
+; Preserves: BC
+;
+WAIT_RDY:
+	push	bc
+WAIT_RDY1:
+	ld	b,255
+WAIT_RDY2:
+	ld	a,(IDE_STATUS)
+	and	M_BSY+M_DRDY
+	cp	M_DRDY
+	jr	z,WAIT_RDY_END	;Wait for BSY to clear and DRDY to set
+	djnz	WAIT_RDY2
+	dec	de
+	ld	a,d
+	or	e
+	jr	nz,WAIT_RDY1
+	scf
+WAIT_RDY_END:
+	pop	bc
+	ret
+
+
+;-----------------------------------------------------------------------------
+; Wait for the next sector of a command
+; Output: Cy=1 if the command failed instead, or on timeout
+; Preserves: BC, DE, HL
+;
+IDE_WAITDRQ:
+	call	IDE_WAITNB
+	ret	c
+	and	M_DRQ+M_ERR
+	cp	M_DRQ
+	ret	z
+	scf
+	ret
+
+; Wait for the end of a command
+; Output: Cy=1 if ERR bit in status register set, or on timeout
+;
+IDE_WAITBSY:
+	call	IDE_WAITNB
+	ret	c
+	rrca
+	ret
+
+; Wait for the BSY flag to clear, T_CMD units of about 3.1ms at most
+; Output: A = Status register, Cy=1 on timeout
+; Preserves: BC, DE, HL
+;
+IDE_WAITNB:
+	push	de
+	push	bc
+	ld	de,T_CMD
+IDE_WAITNB1:
+	ld	b,255
+IDE_WAITNB2:
+	ld	a,(IDE_STATUS)
+	or	a		;Cy=0, S=BSY
+	jp	p,IDE_WAITNB_END
+	djnz	IDE_WAITNB2
+	dec	de
+	ld	a,d
+	or	e
+	jr	nz,IDE_WAITNB1
+	scf
+IDE_WAITNB_END:
+	pop	bc
+	pop	de
+	ret
+
+
+;-----------------------------------------------------------------------------
+; Enable or disable the IDE registers
+; Note that bank 7 (the driver code bank) must be kept switched
+;
+IDE_ON:
+	ld	a,1+2+7*32		; bit 1: sector FIFO of the firmware
+	ld	(IDE_BANK),a
+	ret
+
+IDE_OFF:
+	ld	a,7*32
+	ld	(IDE_BANK),a
+	ret
+
+
+;-----------------------------------------------------------------------------
+;
+; RAM disk and ROM disk
+
+;-----------------------------------------------------------------------------
+; Set up the RAM disk at driver initialization
+;
+; Input: Cy=1 if XFER can not be used
+;
+RD_INIT:
+	push	af
+	ld	de,STR_RAMD
+	call	PRINT
+	pop	af
+	jr	c,RD_INIT_NONE
+
+	ld	hl,-64		;Buffer on the stack
+	add	hl,sp
+	ld	sp,hl
+	call	RD_CHECK
+	ld	hl,64
+	add	hl,sp
+	ld	sp,hl
+	inc	a
+	jr	z,RD_INIT_NONE
+
+	set	2,(ix+W_DEVS)
+	push	af
+	ld	hl,RAMD_BLOCKS*64
+	call	PRDEC
+	pop	af
+	ld	de,STR_KB
+	cp	2
+	jr	nz,RD_INIT_KB
+	ld	de,STR_KFMT
+RD_INIT_KB:
+	jp	PRINT
+
+RD_INIT_NONE:
+	ld	de,STR_NONE
+	call	PRINT
+	ld	de,STR_CRLF
+	jp	PRINT
+
+
+;-----------------------------------------------------------------------------
+; Check the boot sector of the RAM disk, format the RAM disk if not valid
+;
+; Input:  HL = Buffer of 64 bytes
+; Output: A = 0 if valid, 1 if formatted, #FF if the RAM can not be used
+;
+RD_CHECK:
+	ld	a,RAMD_FIRST*8
+	call	XF_SEG
+	push	hl
+	ex	de,hl
+	ld	hl,#6000	;Bytes 0-31 of the boot sector
+	ld	a,2
+	call	XF_CALL
+	pop	de
+	jr	c,RD_CHECK_NONE
+	push	de
+	ld	hl,32
+	add	hl,de
+	ex	de,hl
+	ld	hl,#6000+512-32	;Bytes 480-511
+	ld	a,2
+	call	XF_CALL
+	pop	de
+	jr	c,RD_CHECK_NONE
+
+	ld	hl,RD_VALID
+	ld	b,(RD_BOOT-RD_VALID)/2
+RD_CHECK_BYTE:
+	ld	a,(hl)		;Offset in the buffer
+	inc	hl
+	push	hl
+	ld	l,a
+	ld	h,0
+	add	hl,de
+	ld	a,(hl)
+	pop	hl
+	cp	(hl)
+	inc	hl
+	jr	nz,RD_FORMAT
+	djnz	RD_CHECK_BYTE
+	xor	a
+	ret
+
+RD_CHECK_NONE:
+	ld	a,#FF
+	ret
+
+; Format the RAM disk: boot sector, FATs and root directory
+; Input: DE = Buffer of 64 bytes
+
+RD_FORMAT:
+	ld	h,d
+	ld	l,e
+	ld	b,64
+RD_FMT_CLR:
+	ld	(hl),0
+	inc	hl
+	djnz	RD_FMT_CLR
+
+	push	de		;Empty the first 16K
+	ex	de,hl
+	ld	a,RAMD_FIRST*8+1
+	call	RD_FILL
+	jr	c,RD_FMT_FAIL
+	pop	hl
+	push	hl
+	ld	a,RAMD_FIRST*8
+	call	RD_FILL
+	jr	c,RD_FMT_FAIL
+
+	pop	hl		;FAT: media byte and the cluster 1
+	push	hl
+	ld	(hl),#F8
+	inc	hl
+	ld	(hl),#FF
+	inc	hl
+	ld	(hl),#FF
+	pop	hl
+	push	hl
+	ld	de,#6000+512	;First FAT
+	ld	a,1
+	call	XF_CALL
+	jr	c,RD_FMT_FAIL
+	pop	hl
+	push	hl
+	ld	de,#6000+512*(1+RD_FATSEC)	;Second FAT
+	ld	a,1
+	call	XF_CALL
+	jr	c,RD_FMT_FAIL
+
+	pop	hl		;Boot sector: signature at the end,
+	push	hl
+	xor	a
+	ld	(hl),a
+	inc	hl
+	ld	(hl),a
+	inc	hl
+	ld	(hl),a
+	ld	de,14-2
+	add	hl,de
+	ld	(hl),#55
+	inc	hl
+	ld	(hl),#AA
+	pop	hl
+	push	hl
+	ld	de,#6000+512-16
+	ld	a,1
+	call	XF_CALL
+	jr	c,RD_FMT_FAIL
+	pop	de		;and the BPB
+	push	de
+	ld	hl,RD_BOOT
+	ld	bc,RD_BOOT_END-RD_BOOT
+	ldir
+	pop	hl
+	push	hl
+	ld	de,#6000
+	ld	a,(RD_BOOT_END-RD_BOOT)/16
+	call	XF_CALL
+	jr	c,RD_FMT_FAIL
+	pop	de
+	ld	a,1
+	ret
+
+RD_FMT_FAIL:
+	pop	de
+	ld	a,#FF
+	ret
+
+; Fill an 8K page with the first 16 bytes of a buffer
+; Input: A = Page, HL = Buffer
+; Output: Cy=1 if the RAM can not be used
+
+RD_FILL:
+	call	XF_SEG
+	ld	de,#6000
+	ld	a,1
+	call	XF_CALL
+	ret	c
+	ld	hl,#6000	;The overlapping copy fills the rest
+	ld	de,#6000+16
+	xor	a		;4096 bytes
+	call	XF_CALL
+	ret	c
+	ld	hl,#6000
+	ld	de,#7000
+	xor	a
+	jp	XF_CALL
+
+; Bytes of a valid boot sector: offset in the buffer of RD_CHECK, value
+
+RD_VALID:
+	db	#0B,0,#0C,2	;512 bytes per sector
+	db	#13,RD_SECS & #FF,#14,RD_SECS/256	;Size of the RAM disk
+	db	32+30,#55,32+31,#AA	;Signature
+
+; Boot sector, without boot code
+
+RD_BOOT:
+	db	#EB,#FE,#90
+	db	"C2RAMDSK"	;+3: OEM name
+	dw	512		;+11: Bytes per sector
+	db	1		;+13: Sectors per cluster
+	dw	1		;+14: Reserved sectors
+	db	2		;+16: FATs
+	dw	RD_ROOTSEC*16	;+17: Root directory entries
+	dw	RD_SECS		;+19: Sectors
+	db	#F8		;+21: Media
+	dw	RD_FATSEC	;+22: Sectors per FAT
+	dw	1		;+24: Sectors per track
+	dw	1		;+26: Heads
+	dw	0,0		;+28: Hidden sectors
+	dw	0,0		;+32: Sectors, 32 bit
+	db	0,0,#29		;+36: Drive, reserved, extended boot signature
+	db	"C2RD"		;+39: Serial number
+	db	"RAMDISK    "	;+43: Volume label
+	db	"FAT12   "	;+54: File system
+	db	0,0
+RD_BOOT_END:
+
+
+;-----------------------------------------------------------------------------
+; Look for the ROM disk at driver initialization
+;
+; The ROM disk is the first entry of type "D" of the flash directory,
+; written by c2man /d.
+;
+; Input: Cy=1 if XFER can not be used
+;
+RO_INIT:
+	push	af
+	ld	de,STR_ROMD
+	call	PRINT
+	pop	af
+	jr	c,RO_INIT_NONE
+
+	ld	hl,-16		;Buffer on the stack
+	add	hl,sp
+	ld	sp,hl
+	call	RO_FIND
+	ld	hl,16
+	add	hl,sp
+	ld	sp,hl
+	inc	a
+	jr	z,RO_INIT_NONE
+
+	set	3,(ix+W_DEVS)
+	ld	l,(ix+W_RSIZE)	;Sectors / 8 = K
+	ld	h,(ix+W_RSIZE+1)
+	srl	h
+	rr	l
+	call	PRDEC
+	ld	de,STR_KB
+	jp	PRINT
+
+RO_INIT_NONE:
+	ld	de,STR_NONE
+	call	PRINT
+	ld	de,STR_CRLF
+	jp	PRINT
+
+; Find the ROM disk in the directory
+; Input:  HL = Buffer of 16 bytes
+; Output: A = 0 if found, #FF if not
+;         W_RBLK, W_RSIZE = First 64K block and size in sectors
+
+RO_FIND:
+	ld	c,0		;Entry
+RO_FIND_ENTRY:
+	push	bc
+	push	hl
+	ld	(ix+W_XBLK),0	;Directory: flash 4000h-7FFFh, 64 bytes per entry
+	ld	a,c
+	rlca
+	and	1
+	add	a,2
+	ld	(ix+W_XPAGE),a
+	ld	(ix+W_XMULT),XMULT_ROM
+	ld	a,c
+	and	127
+	ld	l,a
+	ld	h,0
+	add	hl,hl
+	add	hl,hl
+	add	hl,hl
+	add	hl,hl
+	add	hl,hl
+	add	hl,hl
+	ld	de,#6000
+	add	hl,de
+	pop	de
+	push	de
+	ld	a,1
+	call	XF_CALL
+	pop	hl
+	pop	bc
+	jr	c,RO_FIND_NONE
+
+	ld	a,(hl)		;+0: Entry number, #FF if free
+	inc	a
+	jr	z,RO_FIND_NEXT
+	push	hl
+	inc	hl
+	ld	a,(hl)		;+1: 0 if deleted
+	inc	hl
+	ld	e,(hl)		;+2: First block
+	inc	hl
+	ld	d,(hl)		;+3: Blocks
+	inc	hl
+	ld	b,(hl)		;+4: Type
+	pop	hl
+	or	a
+	jr	z,RO_FIND_NEXT
+	ld	a,b
+	cp	"D"
+	jr	nz,RO_FIND_NEXT
+	ld	a,d
+	or	a
+	jr	nz,RO_FIND_OK
+RO_FIND_NEXT:
+	inc	c
+	jr	nz,RO_FIND_ENTRY
+RO_FIND_NONE:
+	ld	a,#FF
+	ret
+
+RO_FIND_OK:
+	ld	(ix+W_RBLK),e
+	rrca			;Sectors = blocks * 128
+	and	#80
+	ld	(ix+W_RSIZE),a
+	ld	a,d
+	srl	a
+	ld	(ix+W_RSIZE+1),a
+	xor	a
+	ret
+
+
+;-----------------------------------------------------------------------------
+; Read or write sectors of the RAM disk or the ROM disk
+;
+; Input and output as IDE_RW
+;
+MD_RW:
+	ld	c,b		;C = Sectors requested, B = sectors left
+	push	af
+	ld	e,.WPROT
+	jr	nc,MD_RW_LBA
+	ld	a,(ix+W_DTAG)
+	cp	ROMD_DEV*16
+	jr	z,MD_RW_END	;The ROM disk is read only
+MD_RW_LBA:
+	ld	a,(ix+W_LBA+3)
+	and	#0F
+	or	(ix+W_LBA+2)
+	ld	e,.RNF
+	jr	nz,MD_RW_END
+
+MD_RW_NEXT:
+	ld	e,0
+	ld	a,b
+	or	a
+	jr	z,MD_RW_END	;Done
+	push	bc
+	push	hl
+	call	MD_DISK
+	ex	de,hl		;HL = Size
+	ld	e,(ix+W_LBA)
+	ld	d,(ix+W_LBA+1)
+	scf
+	sbc	hl,de
+	pop	hl
+	pop	bc
+	ld	e,.RNF
+	jr	c,MD_RW_END	;Past the end
+	pop	af
+	push	af
+	push	bc
+	call	MD_XFER
+	ld	a,b
+	pop	bc
+	ld	e,.NRDY
+	jr	c,MD_RW_FAIL
+	neg
+	add	a,b
+	ld	b,a
+	jr	MD_RW_NEXT
+
+MD_RW_FAIL:
+	set	7,(ix+W_DEVS)	;The RAM disk may have been overwritten
+MD_RW_END:
+	pop	af
+	ld	a,c		;Sectors done = requested - left
+	sub	b
+	ld	b,a
+	ld	a,e
+	or	a
+	ret
+
+; Transfer the sectors that are in the same 8K page, 8 at most
+;
+; Input:  Cy = 0 to read, 1 to write
+;         B = Number of sectors
+;         HL = Memory address
+;         W_LBA = First sector
+; Output: Cy=1 if the memory can not be used
+;         B = Number of sectors transferred
+;         HL, W_LBA = After the sectors transferred
+
+MD_XFER:
+	push	af
+	ld	a,(ix+W_LBA)	;Sectors to the end of the page
+	and	15
+	sub	16
+	neg
+	cp	8+1
+	jr	c,MD_XFER_PAGE
+	ld	a,8
+MD_XFER_PAGE:
+	cp	b
+	jr	nc,MD_XFER_SEG
+	ld	b,a
+
+MD_XFER_SEG:
+	push	bc
+	call	MD_DISK
+	ld	(ix+W_XMULT),c
+	ld	c,a
+	ld	a,(ix+W_LBA)	;Block = first block + sector/128
+	rlca
+	ld	a,(ix+W_LBA+1)
+	rla
+	add	a,c
+	ld	(ix+W_XBLK),a
+	ld	a,(ix+W_LBA)	;8K page in the block
+	rrca
+	rrca
+	rrca
+	rrca
+	and	7
+	ld	(ix+W_XPAGE),a
+	pop	bc
+	ld	a,(ix+W_LBA)	;Sector in the window
+	and	15
+	add	a,a
+	add	a,#60
+	ld	d,a
+	ld	e,0
+	ld	a,b		;Bytes / 16, 0 for 8 sectors
+	rrca
+	rrca
+	rrca
+	and	#E0
+	ld	c,a
+
+	pop	af
+	push	hl
+	push	bc
+	jr	c,MD_XFER_GO
+	ex	de,hl
+MD_XFER_GO:
+	ld	a,c
+	call	XF_CALL
+	pop	bc
+	pop	hl
+	ret	c
+
+	ld	a,b
+	add	a,a
+	add	a,h
+	ld	h,a
+	ld	a,(ix+W_LBA)
+	add	a,b
+	ld	(ix+W_LBA),a
+	ret	nc
+	inc	(ix+W_LBA+1)
+	or	a
+	ret
+
+; Memory disk of W_DTAG
+; Output: A = First 64K block, C = XFER mode, DE = Size in sectors
+
+MD_DISK:
+	ld	a,(ix+W_DTAG)
+	cp	ROMD_DEV*16
+	jr	z,MD_DISK_ROM
+	ld	a,RAMD_FIRST
+	ld	c,XMULT_RAM
+	ld	de,RD_SECS
+	ret
+MD_DISK_ROM:
+	ld	a,(ix+W_RBLK)
+	ld	c,XMULT_ROM
+	ld	e,(ix+W_RSIZE)
+	ld	d,(ix+W_RSIZE+1)
+	ret
+
+
+;-----------------------------------------------------------------------------
+; DEV_INFO and LUN_INFO for the RAM disk and the ROM disk
+;
+; Input and output as DEV_INFO and LUN_INFO, the device is checked
+;
+MD_INFO:
+	cp	2
+	jp	nz,DEV_INFO_ERR	;Device name only
+	push	hl
+	ex	de,hl
+	ld	hl,STR_RDNAME
+	ld	a,(ix+W_DTAG)
+	cp	ROMD_DEV*16
+	jr	nz,MD_INFO_NAME
+	ld	hl,STR_RONAME
+MD_INFO_NAME:
+	ld	bc,STR_RDEND-STR_RDNAME
+	ldir
+	jp	DEV_INFO_SPACES
+
+MD_LUN_INFO:
+	push	hl
+	call	MD_DISK
+	pop	hl
+	xor	a
+	ld	(hl),a		;+0: Block device
+	inc	hl
+	ld	(hl),a		;+1: Sector size, 512
+	inc	hl
+	ld	(hl),2
+	inc	hl
+	ld	(hl),e		;+3: Sectors
+	inc	hl
+	ld	(hl),d
+	inc	hl
+	ld	(hl),a
+	inc	hl
+	ld	(hl),a
+	inc	hl
+	ld	a,(ix+W_DTAG)	;+7: Fixed device, read only for the ROM disk
+	cp	ROMD_DEV*16
+	ld	a,0
+	jr	nz,MD_LUN_FLAGS
+	ld	a,2
+MD_LUN_FLAGS:
+	ld	(hl),a
+	inc	hl
+	xor	a
+	ld	b,4		;+8: No geometry
+MD_LUN_ZERO:
+	ld	(hl),a
+	inc	hl
+	djnz	MD_LUN_ZERO
+	ret
+
+
+;-----------------------------------------------------------------------------
+;
+; Sector cache
+
+;-----------------------------------------------------------------------------
+; Set up the cache at driver initialization
+;
+; Input: Cy=1 if XFER can not be used
+;
+CA_INIT:
+	push	af
+	ld	de,STR_CACHE
+	call	PRINT
+	pop	af
+	jr	c,CA_INIT_NONE
+
+	ld	(ix+W_CACHE),3	;Enabled, to be emptied
+	call	CA_CLEAR
+
+	ld	hl,CACHE_SETS*2
+	call	PRDEC
+	ld	de,STR_KB
+	jp	PRINT
+
+CA_INIT_NONE:
+	ld	(ix+W_CACHE),0
+	ld	de,STR_NONE
+	call	PRINT
+	ld	de,STR_CRLF
+	jp	PRINT
+
+
+;-----------------------------------------------------------------------------
+; DRV_DIRECT0: Cache statistics
+;
+; Input:  A = 0 for the hits, 1 for the misses
+; Output: A = 0, or .IPARM if the input is not valid
+;         HL:DE = Count
+;         BC = Size of the cache in sectors, 0 if there is no cache
+;
+DRV_DIRECT0:
+	call	GETWRK
+	ld	bc,W_HITS
+	or	a
+	jr	z,DRV_DIR0_GET
+	ld	bc,W_MISS
+	dec	a
+	ld	a,.IPARM
+	ret	nz
+DRV_DIR0_GET:
+	call	WRKADR
+	ld	e,(hl)
+	inc	hl
+	ld	d,(hl)
+	inc	hl
+	ld	a,(hl)
+	inc	hl
+	ld	h,(hl)
+	ld	l,a
+	ld	bc,0
+	bit	0,(ix+W_CACHE)
+	jr	z,DRV_DIR0_END
+	ld	bc,CACHE_SETS*4
+DRV_DIR0_END:
+	xor	a
+	ret
+
+
+;-----------------------------------------------------------------------------
+; DRV_DIRECT1: Empty the cache and reset the counters
+;
+; Output: A = 0
+;
+DRV_DIRECT1:
+	call	GETWRK
+	call	CA_INVAL
+	ld	bc,W_HITS
+	call	WRKADR
+	ld	b,8
+DRV_DIR1_CLR:
+	ld	(hl),0
+	inc	hl
+	djnz	DRV_DIR1_CLR
+	xor	a
+	ret
+
+
+;-----------------------------------------------------------------------------
+; Look for the sector W_LBA in the cache
+;
+; Output: Cy=1 if the cache can not be used
+;         Z if found, NZ if not
+;         W_WAY = Way of the sector, or the least recently used one
+;
+CA_FIND:
+	call	CA_READY
+	ret	c
+	call	CA_TAGADR
+	ld	b,0		;Way
+CA_FIND_WAY:
+	push	hl
+	ld	a,(ix+W_LBA)
+	cp	(hl)
+	jr	nz,CA_FIND_NEXT
+	inc	hl
+	ld	a,(ix+W_LBA+1)
+	cp	(hl)
+	jr	nz,CA_FIND_NEXT
+	inc	hl
+	ld	a,(ix+W_LBA+2)
+	cp	(hl)
+	jr	nz,CA_FIND_NEXT
+	inc	hl
+	ld	a,(ix+W_LBA+3)
+	cp	(hl)
+CA_FIND_NEXT:
+	pop	hl
+	jr	z,CA_FIND_HIT
+	inc	hl
+	inc	hl
+	inc	hl
+	inc	hl
+	inc	b
+	ld	a,b
+	cp	4
+	jr	nz,CA_FIND_WAY
+
+	call	CA_LRUADR	;Not found: replace the least recently used
+	ld	a,(hl)
+	rlca
+	rlca
+	and	3
+	ld	(ix+W_WAY),a
+	or	1		;NZ, NC
+	ret
+
+CA_FIND_HIT:
+	ld	(ix+W_WAY),b
+	xor	a		;Z, NC
+	ret
+
+
+;-----------------------------------------------------------------------------
+; Copy the sector of W_WAY from the cache
+;
+; Input:  DE = Destination
+; Output: Cy=1 if the cache can not be used
+;
+CA_GET:
+	push	de
+	call	CA_LINEWIN
+	pop	de
+	ld	a,512/16
+	jp	CA_XFER
+
+
+;-----------------------------------------------------------------------------
+; Store a sector in the cache, in the way W_WAY of the set of W_LBA
+;
+; Input:  HL = Sector data
+; Output: Cy=1 if the cache can not be used
+;
+CA_PUT:
+	push	hl
+	call	CA_LINEWIN
+	ex	de,hl
+	pop	hl
+	ld	a,512/16
+	call	CA_XFER
+	ret	c
+
+	call	CA_TAGADR	;Tag of the way
+	ld	a,(ix+W_WAY)
+	add	a,a
+	add	a,a
+	ld	c,a
+	ld	b,0
+	add	hl,bc
+	ld	a,(ix+W_LBA)
+	ld	(hl),a
+	inc	hl
+	ld	a,(ix+W_LBA+1)
+	ld	(hl),a
+	inc	hl
+	ld	a,(ix+W_LBA+2)
+	ld	(hl),a
+	inc	hl
+	ld	a,(ix+W_LBA+3)
+	ld	(hl),a
+	or	a
+	ret
+
+
+;-----------------------------------------------------------------------------
+; Make W_WAY the most recently used way of the set of W_LBA
+;
+; The LRU byte of a set holds the 4 ways in 2 bit fields,
+; from the least (bits 7-6) to the most (bits 1-0) recently used.
+;
+CA_TOUCH:
+	call	CA_LRUADR
+	ld	d,(hl)
+	ld	e,0
+	ld	c,(ix+W_WAY)
+	ld	b,4
+CA_TOUCH_WAY:
+	rlc	d		;Next way, least recently used first
+	rlc	d
+	ld	a,d
+	and	3
+	cp	c
+	jr	z,CA_TOUCH_NEXT
+	sla	e
+	sla	e
+	or	e
+	ld	e,a
+CA_TOUCH_NEXT:
+	djnz	CA_TOUCH_WAY
+	ld	a,e
+	add	a,a
+	add	a,a
+	or	c
+	ld	(hl),a
+	ret
+
+
+;-----------------------------------------------------------------------------
+; Empty the cache on the next access
+;
+; Preserves: AF, BC, DE, HL
+;
+CA_INVAL:
+	bit	0,(ix+W_CACHE)
+	ret	z
+	set	1,(ix+W_CACHE)
+	ret
+
+
+;-----------------------------------------------------------------------------
+; Check if the cache can be used, empty it first if needed
+;
+; Output: Cy=1 if not
+;
+CA_READY:
+	ld	a,(ix+W_CACHE)
+	rrca
+	ccf
+	ret	c		;Disabled
+	rrca
+	ret	nc
+
+; Empty the cache
+; Output: Cy=0
+
+CA_CLEAR:
+	ld	bc,W_LRU
+	call	WRKADR
+	ld	b,CACHE_SETS
+CA_CLEAR_LRU:
+	ld	(hl),LRU_INIT
+	inc	hl
+	djnz	CA_CLEAR_LRU
+	ld	(hl),#FF	;The tags follow, #FF is no sector
+	ld	d,h
+	ld	e,l
+	inc	de
+	ld	bc,CACHE_SETS*16-1
+	ldir
+	res	1,(ix+W_CACHE)
+	or	a
+	ret
+
+
+;-----------------------------------------------------------------------------
+; Addresses of the set of W_LBA
+;
+; CA_TAGADR:  Output: HL = Tags of the set in the work area, 4 bytes per way
+; CA_LINEWIN: Output: HL = Sector of W_WAY in the XFER window
+; CA_LRUADR:  Output: HL = LRU byte of the set in the work area
+;
+CA_TAGADR:
+	ld	a,(ix+W_LBA)
+	and	CACHE_SETS-1
+	ld	l,a
+	ld	h,0
+	add	hl,hl
+	add	hl,hl
+	add	hl,hl
+	add	hl,hl
+	ld	bc,W_TAGS
+	add	hl,bc
+	ld	b,h
+	ld	c,l
+	jp	WRKADR
+
+CA_LINEWIN:
+	ld	a,(ix+W_LBA)	;Sector = set*4 + way, 16 sectors per page
+	and	CACHE_SETS-1
+	add	a,a
+	add	a,a
+	or	(ix+W_WAY)
+	push	af
+	rrca
+	rrca
+	rrca
+	rrca
+	and	#0F
+	add	a,CACHE_PAGE
+	call	XF_SEG
+	pop	af
+	and	15
+	add	a,a
+	add	a,#60
+	ld	h,a
+	ld	l,0
+	ret
+
+CA_LRUADR:
+	ld	a,(ix+W_LBA)
+	and	CACHE_SETS-1
+	ld	c,a
+	ld	b,0
+	call	WRKADR
+	ld	bc,W_LRU
+	add	hl,bc
+	ret
+
+
+;-----------------------------------------------------------------------------
+; Call XFER for the cache
+;
+; Input and output as XFER, the cache is emptied on the next access
+; if the RAM can not be used.
+;
+CA_XFER:
+	call	XF_CALL
+	ret	nc
+	jp	CA_INVAL
+
+
+;-----------------------------------------------------------------------------
+;
+; Access to the cartridge RAM
+
+;-----------------------------------------------------------------------------
+; Copy XFER to the work area at driver initialization
+;
+; The cartridge subslot must be reachable: the driver in an expanded slot
+; and the registers of the cartridge visible at CardMDR.
+;
+; Output: Cy=1 if the driver is not in an expanded slot
+;
+XF_INIT:
+	xor	a
+	ex	af,af'
+	xor	a
+	ld	ix,GSLOT1
+	call	CALBNK
+	call	GETWRK
+	ld	(ix+W_OWNSLT),a
+	and	#F3		;Subslot 0
+	ld	(ix+W_CARSLT),a
+	rlca
+	ccf
+	ret	c		;Not expanded
+
+	push	ix
+	pop	hl
+	ld	bc,W_XFER
+	add	hl,bc
+	ex	de,hl
+	ld	hl,XFER
+	ld	bc,XFER_END-XFER
+	ldir
+	or	a
+	ret
+
+; Call XFER in the work area
+; Input and output as XFER
+
+XF_CALL:
+	push	hl
+	push	ix
+	pop	hl
+	ld	bc,W_XFER
+	add	hl,bc
+	ld	b,h
+	ld	c,l
+	pop	hl
+	push	bc
+	ret
+
+; Set the window of XFER to an 8K page of the RAM
+; Input: A = Page
+
+XF_SEG:
+	push	af
+	rrca
+	rrca
+	rrca
+	and	#1F
+	ld	(ix+W_XBLK),a
+	pop	af
+	and	7
+	ld	(ix+W_XPAGE),a
+	ld	(ix+W_XMULT),XMULT_RAM
+	ret
+
+
+;-----------------------------------------------------------------------------
+; Copy through a window on the cartridge RAM or flash, at 6000h-7FFFh
+;
+; This routine is copied to the work area, it must be relocatable.
+; The bank 1 registers are set for the copy, the other banks are disabled,
+; all of them are restored after.
+;
+; Input:  HL = Source, DE = Destination
+;         A = Number of bytes / 16, 0 for 4096
+;         W_XBLK, W_XPAGE, W_XMULT = Block, page and mode of the window
+; Output: Cy=1 if the registers are not visible, or the window is on the
+;         RAM and the RAM may be in use by someone else
+; Modifies: AF, BC, DE, HL
+;
+XFER:
+	ld	c,a
+	ld	a,i
+	push	af		;P/V = interrupts enabled
+	di
+	push	hl
+	push	de
+	push	bc
+	ld	a,(ix+W_CARSLT)
+	ld	h,#40
+	call	ENASLT
+
+	ld	hl,C2Ver	;Registers visible?
+	ld	b,3
+XFER_VER:
+	ld	a,(hl)
+	sub	"0"
+	cp	10
+	jr	nc,XFER_NONE
+	inc	hl
+	djnz	XFER_VER
+
+	bit	5,(ix+W_XMULT)	;Flash: can be read at any time
+	jr	z,XFER_SET
+	ld	a,(CardMDR)	;Shadow BIOS in the RAM?
+	and	M_SHADOW
+	jr	nz,XFER_NONE
+	ld	a,(CardMod)
+	and	M_MAPEN
+	jr	nz,XFER_NONE
+	ld	hl,R1Mult	;A bank mapping RAM?
+	ld	de,6
+	ld	b,4
+XFER_RAM:
+	ld	a,(hl)
+	and	M_RAMOFF
+	cp	M_RAM
+	jr	z,XFER_NONE
+	add	hl,de
+	djnz	XFER_RAM
+	jr	XFER_SET
+
+XFER_NONE:
+	pop	bc
+	pop	de
+	pop	hl
+	scf
+	jr	XFER_END_SLOT
+
+XFER_SET:
+	ld	hl,CardMDR
+	ld	a,(hl)
+	ld	(ix+W_SMDR),a
+	and	255-M_DELAY	;Changes take effect now
+	ld	(hl),a
+	push	ix
+	pop	de
+	ld	hl,W_SREGS
+	add	hl,de
+	ex	de,hl
+	ld	hl,AddrFR
+	ld	bc,25
+	ldir
+
+	ld	a,(ix+W_XBLK)
+	ld	(AddrFR),a
+	ld	a,7
+	ld	(B1MaskR),a
+	ld	a,#60
+	ld	(B1AdrD),a
+	ld	a,(ix+W_XPAGE)
+	ld	(R1Reg),a
+	ld	a,(ix+W_XMULT)
+	ld	(R1Mult),a
+	ld	a,XMULT_OFF
+	ld	(R2Mult),a
+	ld	(R3Mult),a
+	ld	(R4Mult),a
+
+	pop	bc
+	pop	de
+	pop	hl
+	ld	a,c
+XFER_COPY:
+	ldi
+	ldi
+	ldi
+	ldi
+	ldi
+	ldi
+	ldi
+	ldi
+	ldi
+	ldi
+	ldi
+	ldi
+	ldi
+	ldi
+	ldi
+	ldi
+	dec	a
+	jr	nz,XFER_COPY
+
+	push	ix
+	pop	hl
+	ld	bc,W_SREGS
+	add	hl,bc
+	ld	de,AddrFR
+	ld	bc,25
+	ldir
+	ld	a,(ix+W_SMDR)
+	ld	(CardMDR),a
+	or	a
+XFER_END_SLOT:
+	push	af
+	ld	a,(ix+W_OWNSLT)
+	ld	h,#40
+	call	ENASLT
+	pop	bc
+	pop	hl		;L = flags of LD A,I
+	bit	2,l
+	jr	z,XFER_DI
+	ei
+XFER_DI:
+	push	bc
+	pop	af
+	ret
+XFER_END:
+
+W_LRU	equ	W_XFER+XFER_END-XFER	;LRU order of the sets, see CA_TOUCH
+W_TAGS	equ	W_LRU+CACHE_SETS	;Tags of the sets, see CA_TAGADR
+W_SIZE	equ	W_TAGS+CACHE_SETS*16
+
+
+;-----------------------------------------------------------------------------
+;
+; Helpers
+
+;-----------------------------------------------------------------------------
+; Get the work area address
+; Output: IX = Work area
+; Preserves: AF, BC, DE, HL
+;
+GETWRK:
+	push	af
+	xor	a
+	ex	af,af'
+	xor	a
+	ld	ix,GWORK
+	call	CALBNK
+	pop	af
+	push	de
+	ld	e,(ix+0)
+	ld	d,(ix+1)
+	push	de
+	pop	ix
+	pop	de
+	ret
+
+; Address of a work area field
+; Input: BC = Offset  Output: HL = Address
+
+WRKADR:
+	push	ix
+	pop	hl
+	add	hl,bc
+	ret
+
+; Increment the 32 bit counter at offset BC of the work area
+
+INC32:
+	call	WRKADR
+	ld	b,4
+INC32_BYTE:
+	inc	(hl)
+	ret	nz
+	inc	hl
+	djnz	INC32_BYTE
+	ret
+
+; Next sector: increment W_LBA
+
+LBA_INC:
+	inc	(ix+W_LBA)
+	ret	nz
+	inc	(ix+W_LBA+1)
+	ret	nz
+	inc	(ix+W_LBA+2)
+	ret	nz
+	inc	(ix+W_LBA+3)
+	ret
+
+; Print the zero terminated string at DE
+
+PRINT:
+	ld	a,(de)
+	or	a
+	ret	z
+	call	CHPUT
+	inc	de
+	jr	PRINT
+
+; Print HL in decimal
+
+PRDEC:
+	ld	e,0		;Leading zeros not printed
+	ld	bc,-10000
+	call	PRDEC_DIGIT
+	ld	bc,-1000
+	call	PRDEC_DIGIT
+	ld	bc,-100
+	call	PRDEC_DIGIT
+	ld	bc,-10
+	call	PRDEC_DIGIT
+	ld	e,1
+	ld	bc,-1
+PRDEC_DIGIT:
+	ld	a,"0"-1
+PRDEC_SUB:
+	inc	a
+	add	hl,bc
+	jr	c,PRDEC_SUB
+	sbc	hl,bc
+	cp	"0"
+	jr	nz,PRDEC_OUT
+	bit	0,e
+	ret	z
+PRDEC_OUT:
+	ld	e,1
+	jp	CHPUT
+
+
+;-----------------------------------------------------------------------------
+;
+; Strings
+
+STR_TITLE:
+	db	"Carnivore2 IDE driver v1.1",13,10,0
+STR_MASTER:
+	db	"Master: ",0
+STR_SLAVE:
+	db	"Slave:  ",0
+STR_CACHE:
+	db	"Cache:  ",0
+STR_NONE:
+	db	"none",0
+STR_RAMD:
+	db	"RAM disk: ",0
+STR_ROMD:
+	db	"ROM disk: ",0
+STR_KFMT:
+	db	"K, formatted",13,10,0
+STR_KB:
+	db	"K"
+STR_CRLF:
+	db	13,10,0
+STR_RDNAME:
+	db	"Carnivore2 RAM disk"
+STR_RDEND:
+STR_RONAME:
+	db	"Carnivore2 ROM disk"	;Same length
+
+
+;-----------------------------------------------------------------------------
+;
+; Bank switching routine, called by the kernel at 7FD0h
+;
+; Input: A = Bank number
+; Bank bits are reversed in IDE_BANK (bit 5 is the highest), the IDE
+; registers are switched off.
+
+	ds	#7FD0-$
+
+CHGBNK:
+	push	bc
+	srl	a
+	rl	b
+	srl	a
+	rl	b
+	srl	a
+	rl	b
+	srl	a
+	rl	b
+	srl	a
+	rl	b
+	ld	a,b
+	pop	bc
+	rlca
+	rlca
+	rlca
+	and	#F8
+	ld	(IDE_BANK),a
+	ret
+
+	ds	#8000-$,#FF
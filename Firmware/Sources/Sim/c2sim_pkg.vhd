@@ -0,0 +1,160 @@
+----------------------------------------------------------------
+--  Title     : c2sim_pkg.vhd
+--  Function  : Z80 slot bus model for the mcscc benches (GHDL)
+----------------------------------------------------------------
+-- The bus cycles follow the Z80 timing at 3.58 MHz: the address
+-- changes on the rising edge of T1, MREQ/RD/SLTSL go low on its
+-- falling edge, WR on the falling edge of T2, where WAIT is sampled
+-- (again on every Tw), data is read on the rising edge of T3 and the
+-- strobes end on its falling edge. I/O cycles get the automatic
+-- wait state of the Z80, IORQ goes low on the rising edge of T2.
+----------------------------------------------------------------
+library IEEE;
+use IEEE.std_logic_1164.all;
+use IEEE.numeric_std.all;
+
+package c2sim_pkg is
+
+  constant T_SLTCLK : time := 279.37 ns;  -- 3.579545 MHz
+  constant T_CLK2   : time := 20 ns;      -- 50 MHz (pSltClk2)
+
+  type slot_t is record
+    Adr     : std_logic_vector(15 downto 0);
+    Merq_n  : std_logic;
+    Iorq_n  : std_logic;
+    Rd_n    : std_logic;
+    Wr_n    : std_logic;
+    M1_n    : std_logic;
+    Sltsl_n : std_logic;
+  end record;
+
+  constant SLOT_IDLE : slot_t := (Adr => (others => '0'), others => '1');
+
+  type slot_op_t is (MEM_RD, MEM_WR, IO_RD, IO_WR);
+
+  -- Result of the last bus cycle: clocks (3 for memory, 4 for I/O, plus waits)
+  type slot_res_t is record
+    Dat    : std_logic_vector(7 downto 0);
+    Clocks : natural;
+    Waits  : natural;
+  end record;
+
+  procedure slot_cycle(
+    op         : in slot_op_t;
+    adr        : in std_logic_vector(15 downto 0);
+    wdat       : in std_logic_vector(7 downto 0);
+    res        : out slot_res_t;
+    signal clk : in std_logic;
+    signal slt : out slot_t;
+    signal dat : inout std_logic_vector(7 downto 0);
+    signal wait_n : in std_logic);
+
+  function hex(v : std_logic_vector) return string;
+
+  -- CRC-32 (IEEE 802.3, reflected) of one more byte, start with FFFFFFFFh
+  -- and invert the result
+  function crc32(c : std_logic_vector(31 downto 0); d : natural) return std_logic_vector;
+
+  -- Byte b (0-511) of sector lba of ide_model, as long as it is not written
+  function ide_byte(lba : natural; b : natural) return natural;
+
+end c2sim_pkg;
+
+package body c2sim_pkg is
+
+  procedure slot_cycle(
+    op         : in slot_op_t;
+    adr        : in std_logic_vector(15 downto 0);
+    wdat       : in std_logic_vector(7 downto 0);
+    res        : out slot_res_t;
+    signal clk : in std_logic;
+    signal slt : out slot_t;
+    signal dat : inout std_logic_vector(7 downto 0);
+    signal wait_n : in std_logic) is
+    variable n : natural := 0;
+  begin
+    -- T1
+    wait until rising_edge(clk);
+    slt <= SLOT_IDLE;
+    slt.Adr <= adr;
+    dat <= (others => 'Z');
+    wait until falling_edge(clk);
+    case op is
+      when MEM_RD => slt.Merq_n <= '0'; slt.Sltsl_n <= '0'; slt.Rd_n <= '0';
+      when MEM_WR => slt.Merq_n <= '0'; slt.Sltsl_n <= '0'; dat <= wdat;
+      when IO_WR  => dat <= wdat;
+      when others => null;
+    end case;
+    -- T2
+    wait until rising_edge(clk);
+    case op is
+      when IO_RD  => slt.Iorq_n <= '0'; slt.Rd_n <= '0';
+      when IO_WR  => slt.Iorq_n <= '0'; slt.Wr_n <= '0';
+      when others => null;
+    end case;
+    wait until falling_edge(clk);
+    if (op = MEM_WR) then
+      slt.Wr_n <= '0';
+    end if;
+    if (op = IO_RD or op = IO_WR) then
+      wait until rising_edge(clk);        -- automatic wait state
+      wait until falling_edge(clk);
+    end if;
+    -- Tw
+    while wait_n = '0' loop
+      n := n + 1;
+      wait until rising_edge(clk);
+      wait until falling_edge(clk);
+    end loop;
+    -- T3
+    wait until rising_edge(clk);
+    res.Dat := dat;
+    wait until falling_edge(clk);
+    slt.Merq_n <= '1'; slt.Iorq_n <= '1'; slt.Sltsl_n <= '1';
+    slt.Rd_n <= '1'; slt.Wr_n <= '1';
+    res.Waits := n;
+    if (op = IO_RD or op = IO_WR) then
+      res.Clocks := 4 + n;
+    else
+      res.Clocks := 3 + n;
+    end if;
+  end slot_cycle;
+
+  function hex(v : std_logic_vector) return string is
+    constant digits : string(1 to 16) := "0123456789ABCDEF";
+    variable r : string(1 to (v'length + 3) / 4);
+    variable x : std_logic_vector(r'length * 4 - 1 downto 0) := (others => '0');
+    variable d : std_logic_vector(3 downto 0);
+  begin
+    x(v'length - 1 downto 0) := v;
+    for i in r'range loop
+      d := x(x'left - (i - 1) * 4 downto x'left - (i - 1) * 4 - 3);
+      if (is_x(d)) then
+        r(i) := 'X';
+      else
+        r(i) := digits(to_integer(unsigned(d)) + 1);
+      end if;
+    end loop;
+    return r;
+  end hex;
+
+  function crc32(c : std_logic_vector(31 downto 0); d : natural) return std_logic_vector is
+    variable r : unsigned(31 downto 0) := unsigned(c);
+    variable b : unsigned(7 downto 0) := to_unsigned(d, 8);
+  begin
+    for i in 0 to 7 loop
+      if ((r(0) xor b(i)) = '1') then
+        r := shift_right(r, 1) xor x"EDB88320";
+      else
+        r := shift_right(r, 1);
+      end if;
+    end loop;
+    return std_logic_vector(r);
+  end crc32;
+
+  function ide_byte(lba : natural; b : natural) return natural is
+  begin
+    return (lba * 37 + b * 5 + b / 256) mod 256;
+  end ide_byte;
+
+end c2sim_pkg;
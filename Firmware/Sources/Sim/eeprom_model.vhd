@@ -0,0 +1,136 @@
+----------------------------------------------------------------
+--  Title     : eeprom_model.vhd
+--  Function  : Behavioural model of the 93C46 EEPROM, x8 mode
+----------------------------------------------------------------
+-- The commands are clocked in on the rising edge of SK while CS is
+-- high, after a start bit: READ (10, sequential), WRITE (01), EWEN and
+-- EWDS (00 11xxxxx / 00 00xxxxx). ERAL and WRAL are reported and
+-- ignored. The write cycle starts on the last data bit; while it runs
+-- the chip ignores SK. From the next time CS is high until a start bit,
+-- DO is low while the write runs and high after. Writes without EWEN
+-- are ignored, as in the chip.
+--
+-- Byte n starts as (n * 29 + 7) mod 256. SK high and low are checked
+-- against the 250ns of the 5V part.
+----------------------------------------------------------------
+library IEEE;
+use IEEE.std_logic_1164.all;
+use IEEE.numeric_std.all;
+
+entity eeprom_model is
+  generic(
+    tPD    : time := 250 ns;    -- SK to DO
+    tWR    : time := 5 ms;      -- write cycle
+    tSK    : time := 250 ns     -- SK high and low
+  );
+  port(
+    CS     : IN std_logic;
+    SK     : IN std_logic;
+    DI     : IN std_logic;
+    DO     : OUT std_logic;
+    Writes : OUT natural;
+    Errors : OUT natural        -- timing, writes while busy
+  );
+end eeprom_model;
+
+architecture behave of eeprom_model is
+
+  type mem_t is array (0 to 127) of std_logic_vector(7 downto 0);
+
+  function init return mem_t is
+    variable m : mem_t;
+  begin
+    for i in 0 to 127 loop
+      m(i) := std_logic_vector(to_unsigned((i * 29 + 7) mod 256, 8));
+    end loop;
+    return m;
+  end init;
+
+  signal Busy : std_logic := '0';
+
+begin
+
+  process(CS, SK, Busy)
+    variable mem    : mem_t := init;
+    variable start  : boolean := false;
+    variable n      : natural := 0;
+    variable sh     : std_logic_vector(16 downto 0) := (others => '0');
+    variable ewen   : boolean := false;
+    variable rd     : boolean := false;
+    variable stat   : boolean := false;
+    variable radr   : natural := 0;
+    variable rbit   : natural := 0;
+    variable nwr    : natural := 0;
+    variable nerr   : natural := 0;
+    variable tsk    : time := 0 ns;
+  begin
+    if (SK'event and now > 0 ns) then
+      if (now - tsk < tSK and CS = '1') then
+        nerr := nerr + 1;
+        report "eeprom: SK " & std_logic'image(not SK) & " for " & time'image(now - tsk) severity warning;
+      end if;
+      tsk := now;
+    end if;
+
+    if (CS = '0') then
+      start := false;
+      rd := false;
+      DO <= 'Z';
+    elsif (CS'event or Busy'event) then
+      if (stat) then                                  -- status of the write cycle
+        DO <= not Busy;
+      end if;
+    elsif (SK'event and SK = '1' and Busy = '0') then
+      if (not start) then
+        start := DI = '1';
+        n := 0;
+        if (start) then
+          stat := false;
+          DO <= 'Z';
+        end if;
+      else
+        n := n + 1;
+        sh := sh(15 downto 0) & DI;
+        if (rd) then                                  -- next data bit, then the next byte
+          if (rbit = 0) then
+            radr := (radr + 1) mod 128;
+            rbit := 8;
+          end if;
+          rbit := rbit - 1;
+          DO <= mem(radr)(rbit) after tPD;
+        elsif (n = 9) then
+          case sh(8 downto 7) is
+            when "10" =>                              -- READ, dummy 0 first
+              rd := true;
+              radr := (to_integer(unsigned(sh(6 downto 0))) + 127) mod 128;
+              rbit := 0;
+              DO <= '0' after tPD;
+            when "00" =>
+              case sh(6 downto 5) is
+                when "11" => ewen := true;
+                when "00" => ewen := false;
+                when others =>
+                  report "eeprom: ERAL or WRAL, ignored" severity warning;
+              end case;
+            when others =>
+              null;
+          end case;
+        elsif (n = 17 and sh(16 downto 15) = "01") then
+          if (ewen) then
+            mem(to_integer(unsigned(sh(14 downto 8)))) := sh(7 downto 0);
+            nwr := nwr + 1;
+            Busy <= '1', '0' after tWR;
+            stat := true;
+          end if;
+        end if;
+      end if;
+    elsif (SK'event and SK = '1' and Busy = '1' and DI = '1') then
+      nerr := nerr + 1;
+      report "eeprom: start bit while busy" severity warning;
+    end if;
+
+    Writes <= nwr;
+    Errors <= nerr;
+  end process;
+
+end behave;
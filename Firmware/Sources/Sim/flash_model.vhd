@@ -0,0 +1,177 @@
+----------------------------------------------------------------
+--  Title     : flash_model.vhd
+--  Function  : Behavioural model of the M29W640 flash, byte mode
+----------------------------------------------------------------
+-- Only what the cartridge software uses: the AAA/555 unlock cycles,
+-- program (A0), sector erase (80/30, 64K sectors), chip erase (80/10)
+-- and reset (F0). While the chip is busy RY/BY# is low and reads
+-- return the status (DQ7 inverted, DQ6 toggling). The modelled array
+-- is 2^ABITS bytes, the upper address bits wrap.
+--
+-- Writes while busy are errors. Reads while busy are legal (status
+-- polling) and counted, so that a bench can tell that nothing polled.
+-- A write lasts while CE# and WE# are both low and ends on the first
+-- of them going high, with the last valid data seen. It is checked
+-- against the 70ns part: strobe low and high widths, data setup and
+-- an address stable while the strobe is low.
+----------------------------------------------------------------
+library IEEE;
+use IEEE.std_logic_1164.all;
+use IEEE.numeric_std.all;
+
+entity flash_model is
+  generic(
+    ABITS  : natural := 17;
+    tACC   : time := 70 ns;
+    tPROG  : time := 10 us;
+    tERASE : time := 100 us;    -- sector erase, far shorter than the chip
+    tWP    : time := 35 ns;     -- write strobe low
+    tWPH   : time := 30 ns;     -- write strobe high between writes
+    tDS    : time := 45 ns      -- data setup to the end of the strobe
+  );
+  port(
+    A      : IN std_logic_vector(22 downto 0);
+    DQ     : INOUT std_logic_vector(7 downto 0);
+    CE_n   : IN std_logic;
+    OE_n   : IN std_logic;
+    WE_n   : IN std_logic;
+    RP_n   : IN std_logic;
+    RB_n   : OUT std_logic;
+    Programs  : OUT natural;    -- program operations
+    BusyReads : OUT natural;    -- reads while busy
+    Errors    : OUT natural     -- writes while busy, programs of 0 to 1, timing
+  );
+end flash_model;
+
+architecture behave of flash_model is
+
+  type mem_t is array (0 to 2**ABITS - 1) of std_logic_vector(7 downto 0);
+  signal Busy : std_logic := '0';
+
+begin
+
+  RB_n <= '0' when Busy = '1' else '1';
+
+  process(WE_n, OE_n, CE_n, A, DQ, RP_n, Busy)
+    variable mem    : mem_t := (others => (others => '1'));
+    variable cyc    : natural := 0;
+    variable adr    : natural;
+    variable wadr   : natural := 0;
+    variable alo    : std_logic_vector(11 downto 0);
+    variable d      : std_logic_vector(7 downto 0);
+    variable stat   : std_logic_vector(7 downto 0) := "00000000";
+    variable nprog  : natural := 0;
+    variable nbread : natural := 0;
+    variable nerr   : natural := 0;
+    variable wr     : boolean := false;
+    variable amove  : boolean := false;
+    variable tfall  : time := 0 ns;
+    variable trise  : time := 0 ns;
+    variable tdat   : time := 0 ns;
+  begin
+    if (is_x(A(ABITS - 1 downto 0))) then
+      adr := 0;
+    else
+      adr := to_integer(unsigned(A(ABITS - 1 downto 0)));
+    end if;
+
+    if (CE_n = '0' and WE_n = '0') then
+      if (not wr) then                                -- start of a write
+        wr := true;
+        if (now - trise < tWPH) then
+          nerr := nerr + 1;
+          report "flash: write strobe high for " & time'image(now - trise) severity warning;
+        end if;
+        tfall := now;
+        wadr := adr;
+        alo := A(11 downto 0);
+        amove := false;
+        d := DQ;
+        if (DQ'last_event > now) then tdat := 0 ns; else tdat := now - DQ'last_event; end if;
+      else
+        if (adr /= wadr) then amove := true; end if;
+        if (not is_x(DQ) and DQ /= d) then            -- the data may go first at the end
+          d := DQ;
+          tdat := now;
+        end if;
+      end if;
+    elsif (wr) then                                   -- end of the write
+      wr := false;
+      trise := now;
+      if (now - tfall < tWP or now - tdat < tDS or amove) then
+        nerr := nerr + 1;
+        report "flash: write timing at " & integer'image(wadr) & ", strobe low "
+             & time'image(now - tfall) & ", data setup " & time'image(now - tdat) severity warning;
+      end if;
+      if (RP_n = '0') then
+        cyc := 0;
+      elsif (Busy = '1') then
+        nerr := nerr + 1;
+        report "flash: write " & integer'image(wadr) & " while busy" severity warning;
+      elsif (d = x"F0") then
+        cyc := 0;
+      else
+        case cyc is
+          when 0 | 4 =>
+            if (alo = x"AAA" and d = x"AA") then cyc := cyc + 1; else cyc := 0; end if;
+          when 1 | 5 =>
+            if (alo = x"555" and d = x"55") then cyc := cyc + 1; else cyc := 0; end if;
+          when 2 =>
+            if (alo = x"AAA" and d = x"A0") then
+              cyc := 3;
+            elsif (alo = x"AAA" and d = x"80") then
+              cyc := 4;
+            else
+              cyc := 0;
+            end if;
+          when 3 =>                                   -- program
+            if ((mem(wadr) and d) /= d) then
+              nerr := nerr + 1;
+              report "flash: program of a 0 bit to 1 at " & integer'image(wadr) severity warning;
+            end if;
+            mem(wadr) := mem(wadr) and d;
+            stat := (not d(7)) & "0000000";
+            nprog := nprog + 1;
+            Busy <= '1', '0' after tPROG;
+            cyc := 0;
+          when 6 =>                                   -- erase
+            if (d = x"30") then
+              for i in 0 to 65535 loop
+                mem(((wadr / 65536) * 65536 + i) mod (2**ABITS)) := x"FF";
+              end loop;
+              stat := "00000000";
+              Busy <= '1', '0' after tERASE;
+            elsif (d = x"10") then
+              mem := (others => (others => '1'));
+              stat := "00000000";
+              Busy <= '1', '0' after tERASE * 8;
+            end if;
+            cyc := 0;
+          when others =>
+            cyc := 0;
+        end case;
+      end if;
+    elsif (RP_n = '0') then
+      cyc := 0;
+    end if;
+
+    if (CE_n = '0' and OE_n = '0' and WE_n = '1') then
+      if (Busy = '1') then
+        if (OE_n'event) then
+          stat(6) := not stat(6);
+          nbread := nbread + 1;
+        end if;
+        DQ <= stat after tACC;
+      else
+        DQ <= mem(adr) after tACC;
+      end if;
+    else
+      DQ <= (others => 'Z');
+    end if;
+
+    Programs <= nprog;
+    BusyReads <= nbread;
+    Errors <= nerr;
+  end process;
+
+end behave;
@@ -0,0 +1,266 @@
+----------------------------------------------------------------
+--  Title     : ide_model.vhd
+--  Function  : Behavioural model of a CF card in PIO mode
+----------------------------------------------------------------
+-- Task file on CS1 (command block) and CS3 (device control and
+-- alternate status at A=6), 16 bit data register. Commands: READ
+-- SECTORS (20h/21h), READ MULTIPLE (C4h), WRITE SECTORS (30h/31h),
+-- WRITE MULTIPLE (C5h), SET MULTIPLE (C6h), IDENTIFY (ECh); the others
+-- abort. LBA addressing only, SECTORS sectors, beyond them IDNF.
+-- Sector lba starts as ide_byte(lba, 0..511) of c2sim_pkg.
+--
+-- BSY is set for tCMD after a command, tSEC between the DRQ blocks of
+-- a read and tWR after each written block. The strobes are checked
+-- against PIO mode 0: 165ns low, address and CS set 70ns before.
+-- Data accesses without DRQ are errors too.
+----------------------------------------------------------------
+library IEEE;
+use IEEE.std_logic_1164.all;
+use IEEE.numeric_std.all;
+use work.c2sim_pkg.all;
+
+entity ide_model is
+  generic(
+    SECTORS : natural := 64;
+    tCMD    : time := 20 us;
+    tSEC    : time := 5 us;
+    tWR     : time := 50 us;
+    tRD     : time := 100 ns;   -- RD to data
+    tSTB    : time := 165 ns;   -- RD and WR low
+    tAS     : time := 70 ns     -- address and CS to RD or WR
+  );
+  port(
+    A      : IN std_logic_vector(2 downto 0);
+    D      : INOUT std_logic_vector(15 downto 0);
+    CS1_n  : IN std_logic;
+    CS3_n  : IN std_logic;
+    RD_n   : IN std_logic;
+    WR_n   : IN std_logic;
+    RST_n  : IN std_logic;
+    Words  : OUT natural;       -- data words moved
+    Errors : OUT natural        -- timing, data accesses without DRQ
+  );
+end ide_model;
+
+architecture behave of ide_model is
+
+  type sector_t is array (0 to 255) of std_logic_vector(15 downto 0);
+  type disk_t is array (0 to SECTORS - 1) of sector_t;
+
+  function init return disk_t is
+    variable dk : disk_t;
+  begin
+    for l in 0 to SECTORS - 1 loop
+      for i in 0 to 255 loop
+        dk(l)(i) := std_logic_vector(to_unsigned(ide_byte(l, 2 * i + 1), 8))
+                  & std_logic_vector(to_unsigned(ide_byte(l, 2 * i), 8));
+      end loop;
+    end loop;
+    return dk;
+  end init;
+
+  -- what to do at the end of BSY
+  constant P_NONE  : natural := 0;
+  constant P_READ  : natural := 1;   -- DRQ with the next sector
+  constant P_WRITE : natural := 2;   -- DRQ for the next sector
+  constant P_DATA  : natural := 3;   -- DRQ with buf (IDENTIFY)
+  constant P_IDNF  : natural := 4;
+
+  signal Bsy : std_logic := '0';
+
+begin
+
+  process(A, CS1_n, CS3_n, RD_n, WR_n, RST_n, Bsy)
+    variable disk   : disk_t := init;
+    variable buf    : sector_t;
+    variable feat   : std_logic_vector(7 downto 0) := x"00";
+    variable cnt    : std_logic_vector(7 downto 0) := x"01";
+    variable lba    : std_logic_vector(23 downto 0) := (others => '0');
+    variable head   : std_logic_vector(7 downto 0) := x"00";
+    variable err    : std_logic_vector(7 downto 0) := x"00";
+    variable drq    : boolean := false;
+    variable rd     : boolean := false;
+    variable pend   : natural := P_NONE;
+    variable cur    : natural := 0;
+    variable nsec   : natural := 0;
+    variable mult   : natural := 1;
+    variable blk    : natural := 1;
+    variable multi  : boolean := false;
+    variable widx   : natural := 0;
+    variable nwd    : natural := 0;
+    variable nerr   : natural := 0;
+    variable tstb   : time := 0 ns;
+    variable sel    : boolean;
+    variable stat   : std_logic_vector(7 downto 0);
+    variable d8     : std_logic_vector(7 downto 0);
+
+    procedure busy(t : time; p : natural) is
+    begin
+      drq := false;
+      pend := p;
+      Bsy <= '1', '0' after t;
+    end busy;
+
+    -- next sector of a read, at once inside a DRQ block
+    procedure next_read is
+    begin
+      if (cur >= SECTORS) then
+        err := x"10";
+        drq := false;
+      else
+        buf := disk(cur);
+        widx := 0;
+        drq := true;
+      end if;
+    end next_read;
+
+  begin
+    sel := CS1_n = '0' or (CS3_n = '0' and A = "110");
+
+    if (RST_n = '0') then
+      drq := false;
+      err := x"00";
+      pend := P_NONE;
+      D <= (others => 'Z');
+    elsif (Bsy'event and Bsy = '0') then
+      case pend is
+        when P_READ  => next_read;
+        when P_WRITE => widx := 0; drq := true;
+        when P_DATA  => widx := 0; drq := true;
+        when P_IDNF  => err := x"10";
+        when others  => null;
+      end case;
+      pend := P_NONE;
+      if (multi) then blk := mult; else blk := 1; end if;
+    end if;
+
+    if (Bsy = '1') then
+      stat := x"80";
+    else
+      stat := x"50";
+      if (drq) then stat(3) := '1'; end if;
+      if (err /= x"00") then stat(0) := '1'; end if;
+    end if;
+
+    -- start of a strobe
+    if ((RD_n'event and RD_n = '0') or (WR_n'event and WR_n = '0')) and sel then
+      tstb := now;
+      if (A'last_event < tAS or (CS1_n = '0' and CS1_n'last_event < tAS)
+          or (CS3_n = '0' and CS3_n'last_event < tAS)) then
+        nerr := nerr + 1;
+        report "ide: address set " & time'image(A'last_event) & " before the strobe" severity warning;
+      end if;
+      if (RD_n = '0') then
+        if (CS1_n = '0' and A = "000") then
+          if (drq and rd and Bsy = '0') then
+            D <= buf(widx) after tRD;
+          else
+            nerr := nerr + 1;
+            report "ide: data read without DRQ" severity warning;
+          end if;
+        else
+          case A is
+            when "001"  => d8 := err;
+            when "010"  => d8 := cnt;
+            when "011"  => d8 := lba(7 downto 0);
+            when "100"  => d8 := lba(15 downto 8);
+            when "101"  => d8 := lba(23 downto 16);
+            when "110"  => if (CS1_n = '0') then d8 := head; else d8 := stat; end if;
+            when others => d8 := stat;
+          end case;
+          D <= "ZZZZZZZZ" & d8 after tRD;
+        end if;
+      end if;
+    end if;
+
+    -- end of a strobe
+    if ((RD_n'event and RD_n = '1') or (WR_n'event and WR_n = '1')) and sel then
+      if (now - tstb < tSTB) then
+        nerr := nerr + 1;
+        report "ide: strobe low for " & time'image(now - tstb) severity warning;
+      end if;
+      if (RD_n'event) then
+        D <= (others => 'Z');
+      end if;
+      if (CS1_n = '0' and A = "000") then             -- data
+        if (drq and Bsy = '0') then
+          if (not rd) then buf(widx) := D; end if;
+          nwd := nwd + 1;
+          widx := widx + 1;
+          if (widx = 256) then                        -- end of a sector
+            if (not rd) then
+              disk(cur) := buf;
+            end if;
+            cur := cur + 1;
+            nsec := nsec - 1;
+            blk := blk - 1;
+            if (nsec = 0) then
+              if (rd) then drq := false; else busy(tWR, P_NONE); end if;
+            elsif (blk > 0) then
+              if (rd) then next_read; else widx := 0; end if;
+            elsif (rd) then
+              busy(tSEC, P_READ);
+            else
+              busy(tWR, P_WRITE);
+            end if;
+          end if;
+        elsif (WR_n'event) then
+          nerr := nerr + 1;
+          report "ide: data write without DRQ" severity warning;
+        end if;
+      elsif (WR_n'event and CS3_n = '0') then         -- device control
+        if (D(2) = '1') then
+          drq := false;
+          err := x"00";
+          busy(1 us, P_NONE);
+        end if;
+      elsif (WR_n'event) then
+        case A is
+          when "001"  => feat := D(7 downto 0);
+          when "010"  => cnt := D(7 downto 0);
+          when "011"  => lba(7 downto 0) := D(7 downto 0);
+          when "100"  => lba(15 downto 8) := D(7 downto 0);
+          when "101"  => lba(23 downto 16) := D(7 downto 0);
+          when "110"  => head := D(7 downto 0);
+          when others =>                              -- command
+            err := x"00";
+            cur := to_integer(unsigned(head(3 downto 0) & lba));
+            nsec := to_integer(unsigned(cnt));
+            if (nsec = 0) then nsec := 256; end if;
+            multi := false;
+            case D(7 downto 0) is
+              when x"20" | x"21" | x"C4" =>
+                rd := true;
+                multi := D(7 downto 0) = x"C4";
+                busy(tCMD, P_READ);
+              when x"30" | x"31" | x"C5" =>
+                rd := false;
+                multi := D(7 downto 0) = x"C5";
+                if (cur + nsec > SECTORS) then
+                  busy(tCMD, P_IDNF);
+                else
+                  busy(1 us, P_WRITE);
+                end if;
+              when x"C6" =>
+                mult := to_integer(unsigned(cnt));
+                busy(1 us, P_NONE);
+              when x"EC" =>
+                rd := true;
+                nsec := 1;
+                for i in 0 to 255 loop
+                  buf(i) := std_logic_vector(to_unsigned(16#EC00# + i, 16));
+                end loop;
+                buf(0) := x"848A";
+                busy(tCMD, P_DATA);
+              when others =>
+                err := x"04";
+            end case;
+          end case;
+      end if;
+    end if;
+
+    Words <= nwd;
+    Errors <= nerr;
+  end process;
+
+end behave;
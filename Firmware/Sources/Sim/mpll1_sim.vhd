@@ -0,0 +1,43 @@
+----------------------------------------------------------------
+--  Title     : mpll1_sim.vhd
+--  Function  : Simulation stand-in for the MPLL1 megafunction
+----------------------------------------------------------------
+-- 50 MHz * 3528 / 15625 = 11.2896 MHz, made by a phase accumulator on
+-- inclk0, so the output has the right mean frequency with a 20 ns
+-- jitter and stops when the bench stops its clocks.
+----------------------------------------------------------------
+library IEEE;
+use IEEE.std_logic_1164.all;
+
+entity MPLL1 is
+  port(
+    areset : IN std_logic := '0';
+    inclk0 : IN std_logic := '0';
+    c0     : OUT std_logic;
+    locked : OUT std_logic
+  );
+end MPLL1;
+
+architecture sim of MPLL1 is
+  signal clk : std_logic := '0';
+begin
+
+  process(areset, inclk0)
+    variable acc : natural := 0;
+  begin
+    if (areset = '1') then
+      acc := 0;
+      clk <= '0';
+    elsif (inclk0'event and inclk0 = '1') then
+      acc := acc + 2 * 3528;
+      if (acc >= 15625) then
+        acc := acc - 15625;
+        clk <= not clk;
+      end if;
+    end if;
+  end process;
+
+  c0 <= clk;
+  locked <= not areset;
+
+end sim;
@@ -0,0 +1,93 @@
+----------------------------------------------------------------
+--  Title     : sram_model.vhd
+--  Function  : Behavioural model of the cartridge SRAM
+----------------------------------------------------------------
+-- The RAM shares the address, data, OE# and WE# lines of the flash
+-- and has its own chip select. Writes are taken like in flash_model:
+-- while CE# and WE# are both low, ending on the first of them going
+-- high, checked for the strobe width, data setup and a stable address.
+-- The modelled array is 2^ABITS bytes and starts undefined.
+----------------------------------------------------------------
+library IEEE;
+use IEEE.std_logic_1164.all;
+use IEEE.numeric_std.all;
+
+entity sram_model is
+  generic(
+    ABITS  : natural := 17;
+    tAA    : time := 55 ns;
+    tWP    : time := 40 ns;     -- write strobe low
+    tDS    : time := 25 ns      -- data setup to the end of the strobe
+  );
+  port(
+    A      : IN std_logic_vector(22 downto 0);
+    DQ     : INOUT std_logic_vector(7 downto 0);
+    CE_n   : IN std_logic;
+    OE_n   : IN std_logic;
+    WE_n   : IN std_logic;
+    Writes : OUT natural;
+    Errors : OUT natural        -- timing
+  );
+end sram_model;
+
+architecture behave of sram_model is
+
+  type mem_t is array (0 to 2**ABITS - 1) of std_logic_vector(7 downto 0);
+
+begin
+
+  process(WE_n, OE_n, CE_n, A, DQ)
+    variable mem    : mem_t := (others => (others => 'X'));
+    variable adr    : natural;
+    variable wadr   : natural := 0;
+    variable d      : std_logic_vector(7 downto 0);
+    variable nwr    : natural := 0;
+    variable nerr   : natural := 0;
+    variable wr     : boolean := false;
+    variable amove  : boolean := false;
+    variable tfall  : time := 0 ns;
+    variable tdat   : time := 0 ns;
+  begin
+    if (is_x(A(ABITS - 1 downto 0))) then
+      adr := 0;
+    else
+      adr := to_integer(unsigned(A(ABITS - 1 downto 0)));
+    end if;
+
+    if (CE_n = '0' and WE_n = '0') then
+      if (not wr) then                                -- start of a write
+        wr := true;
+        tfall := now;
+        wadr := adr;
+        amove := false;
+        d := DQ;
+        if (DQ'last_event > now) then tdat := 0 ns; else tdat := now - DQ'last_event; end if;
+      else
+        if (adr /= wadr) then amove := true; end if;
+        if (not is_x(DQ) and DQ /= d) then
+          d := DQ;
+          tdat := now;
+        end if;
+      end if;
+    elsif (wr) then                                   -- end of the write
+      wr := false;
+      if (now - tfall < tWP or now - tdat < tDS or amove) then
+        nerr := nerr + 1;
+        report "sram: write timing at " & integer'image(wadr) & ", strobe low "
+             & time'image(now - tfall) & ", data setup " & time'image(now - tdat) severity warning;
+      end if;
+      mem(wadr) := d;
+      nwr := nwr + 1;
+    end if;
+
+    if (CE_n = '0' and OE_n = '0' and WE_n = '1') then
+      DQ <= mem(adr) after tAA;
+    else
+      DQ <= (others => 'Z');
+    end if;
+
+    Writes <= nwr;
+    Errors <= nerr;
+  end process;
+
+end behave;
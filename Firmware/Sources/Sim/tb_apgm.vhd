@@ -0,0 +1,200 @@
+----------------------------------------------------------------
+--  Title     : tb_apgm.vhd
+--  Function  : Bench of the flash auto-program mode
+----------------------------------------------------------------
+-- Bank 1 maps the first 16K of the flash at 4000h with writes enabled.
+--  1. auto-program: a single write, ConfFl bit 7 shows the sequence
+--     and the program, the byte reads back;
+--  2. auto-program: 64 bytes copied with plain writes (an ldir),
+--     no polling, every byte reads back;
+--  3. auto-program through DatM0;
+--  4. the same 64 bytes programmed with the unlock cycles and
+--     auto-wait, to compare the clocks per byte.
+-- The flash model also checks the WE# timing of the sequencer.
+----------------------------------------------------------------
+library IEEE;
+use IEEE.std_logic_1164.all;
+use IEEE.numeric_std.all;
+use work.c2sim_pkg.all;
+
+entity tb_apgm is
+end tb_apgm;
+
+architecture sim of tb_apgm is
+
+  constant REGS    : natural := 16#4F80#;
+  constant R1MULT  : natural := REGS + 16#09#;
+  constant ADDRM0  : natural := REGS + 16#01#;
+  constant ADDRM1  : natural := REGS + 16#02#;
+  constant ADDRM2  : natural := REGS + 16#03#;
+  constant DATM0   : natural := REGS + 16#04#;
+  constant CONFFL  : natural := REGS + 16#20#;
+
+  signal Done      : boolean := false;
+  signal SltClk    : std_logic := '0';
+  signal SltClk2   : std_logic := '0';
+  signal SltRst_n  : std_logic := '0';
+  signal Slt       : slot_t := SLOT_IDLE;
+  signal SltDat    : std_logic_vector(7 downto 0);
+  signal SltWait_n : std_logic;
+
+  signal FlAdr     : std_logic_vector(22 downto 0);
+  signal FlDat     : std_logic_vector(7 downto 0);
+  signal FlCS_n    : std_logic;
+  signal FlOE_n    : std_logic;
+  signal FlW_n     : std_logic;
+  signal FlRP_n    : std_logic;
+  signal FlRB_b    : std_logic;
+  signal IDEDat    : std_logic_vector(15 downto 0);
+  signal Programs  : natural;
+  signal BusyReads : natural;
+  signal Errors    : natural;
+
+begin
+
+  SltClk  <= not SltClk after T_SLTCLK / 2 when not Done;
+  SltClk2 <= not SltClk2 after T_CLK2 / 2 when not Done;
+
+  SltWait_n <= 'H';
+  SltDat <= (others => 'H');
+
+  dut : entity work.mcscc
+    port map(
+      pSltClk => SltClk, pSltRst1_n => SltRst_n, pSltSltsls_n => Slt.Sltsl_n,
+      pSltIorq_n => Slt.Iorq_n, pSltRd_n => Slt.Rd_n, pSltWr_n => Slt.Wr_n,
+      pSltAdr => Slt.Adr, pSltDat => SltDat, pSltBdir_n => open,
+      pSltCs1 => '1', pSltCs2 => '1', pSltCs12 => '1', pSltRfsh_n => '1',
+      pSltWait_n => SltWait_n, pSltInt_n => '1', pSltM1_n => Slt.M1_n,
+      pSltMerq_n => Slt.Merq_n, pSltClk2 => SltClk2, pSltRsv5 => '1', pSltRsv16 => '1',
+      pFlAdr => FlAdr, pFlDat => FlDat, pFlCS_n => FlCS_n, pFlOE_n => FlOE_n,
+      pFlW_n => FlW_n, pFlRP_n => FlRP_n, pFlRB_b => FlRB_b, pFlVpp => open,
+      pRAMCS_n => open,
+      pIDEAdr => open, pIDEDat => IDEDat, pIDECS1_n => open, pIDECS3_n => open,
+      pIDERD_n => open, pIDEWR_n => open, pPIN180 => open, pIDE_Rst_n => open,
+      dac_xsmt => open, dac_lrck => open, dac_din => open, dac_bck => open,
+      dac_sck => open, dac_flt => open, dac_demp => open,
+      adc_md => open, adc_scki => open, adc_bck => open, adc_lrck => open, adc_dout => '0',
+      EECS => open, EECK => open, EEDI => open, EEDO => '0'
+    );
+
+  flash : entity work.flash_model
+    port map(
+      A => FlAdr, DQ => FlDat, CE_n => FlCS_n, OE_n => FlOE_n, WE_n => FlW_n,
+      RP_n => FlRP_n, RB_n => FlRB_b,
+      Programs => Programs, BusyReads => BusyReads, Errors => Errors
+    );
+
+  process
+    variable res : slot_res_t;
+    variable clocks : natural;
+    variable polls : natural;
+    variable br : natural;
+    variable np : natural;
+    variable apclk : natural;
+
+    procedure wr(adr : natural; dat : natural) is
+    begin
+      slot_cycle(MEM_WR, std_logic_vector(to_unsigned(adr, 16)),
+                 std_logic_vector(to_unsigned(dat, 8)), res, SltClk, Slt, SltDat, SltWait_n);
+      clocks := clocks + res.Clocks;
+    end wr;
+
+    procedure rd(adr : natural) is
+    begin
+      slot_cycle(MEM_RD, std_logic_vector(to_unsigned(adr, 16)),
+                 "00000000", res, SltClk, Slt, SltDat, SltWait_n);
+      clocks := clocks + res.Clocks;
+    end rd;
+
+    procedure idle(n : natural) is         -- clocks with no slot access
+    begin
+      for i in 1 to n loop
+        wait until rising_edge(SltClk);
+      end loop;
+      clocks := clocks + n;
+    end idle;
+
+    procedure program(adr : natural; dat : natural) is
+    begin
+      wr(16#4AAA#, 16#AA#);
+      wr(16#4555#, 16#55#);
+      wr(16#4AAA#, 16#A0#);
+      wr(adr, dat);
+    end program;
+
+  begin
+    clocks := 0;
+    wait for 1 us;
+    SltRst_n <= '1';
+    rd(16#0000#);                          -- the first slot access ends the reset
+    wr(R1MULT, 16#15#);                    -- bank 1: 16K, flash, writes enabled
+    wr(CONFFL, 16#12#);                    -- RP# high, auto-program
+
+    -- 1. a single byte
+    np := Programs;
+    wr(16#4100#, 16#5A#);
+    rd(CONFFL);
+    assert res.Dat(7) = '0' report "ConfFl: not busy after a write" severity error;
+    polls := 0;
+    loop
+      rd(CONFFL);
+      polls := polls + 1;
+      exit when res.Dat(7) = '1';
+      assert polls < 1000 report "program never ends" severity failure;
+    end loop;
+    rd(16#4100#);
+    assert res.Dat = x"5A" report "single: read " & hex(res.Dat) & " instead of 5A" severity error;
+    assert Programs = np + 1 report "single: no program" severity error;
+    report "single byte: busy for " & integer'image(polls) & " status reads";
+
+    -- 2. a block with plain writes
+    br := BusyReads;
+    np := Programs;
+    clocks := 0;
+    for i in 0 to 63 loop
+      wr(16#4200# + i, (i * 37 + 1) mod 256);
+      idle(18);                             -- the rest of the ldir
+    end loop;
+    apclk := clocks;
+    report "64 bytes auto-programmed: " & integer'image(clocks) & " clocks, "
+         & integer'image(clocks / 64) & " per byte";
+    for i in 0 to 63 loop
+      rd(16#4200# + i);
+      assert to_integer(unsigned(res.Dat)) = (i * 37 + 1) mod 256
+        report "block: " & hex(res.Dat) & " at offset " & integer'image(i) severity error;
+    end loop;
+    assert Programs = np + 64 report "block: " & integer'image(Programs - np) & " programs" severity error;
+    assert BusyReads = br report "block: the busy flash was read" severity error;
+
+    -- 3. DatM0
+    wr(ADDRM0, 16#00#);
+    wr(ADDRM1, 16#05#);
+    wr(ADDRM2, 16#00#);
+    wr(DATM0, 16#3C#);
+    rd(DATM0);
+    assert res.Dat = x"3C" report "DatM0: read " & hex(res.Dat) & " instead of 3C" severity error;
+    assert res.Waits > 0 report "DatM0: no wait states" severity error;
+
+    -- 4. the same block with the unlock cycles
+    wr(CONFFL, 16#0A#);                    -- RP# high, auto-wait
+    clocks := 0;
+    for i in 0 to 63 loop
+      program(16#4300# + i, (i * 37 + 1) mod 256);
+      idle(4 * 18);                         -- the code around the writes
+    end loop;
+    report "64 bytes with unlock cycles: " & integer'image(clocks) & " clocks, "
+         & integer'image(clocks / 64) & " per byte";
+    assert apclk < clocks report "auto-program is not faster" severity error;
+    for i in 0 to 63 loop
+      rd(16#4300# + i);
+      assert to_integer(unsigned(res.Dat)) = (i * 37 + 1) mod 256
+        report "unlock block: " & hex(res.Dat) & " at offset " & integer'image(i) severity error;
+    end loop;
+
+    assert Errors = 0 report "flash errors: " & integer'image(Errors) severity error;
+    report "tb_apgm: " & integer'image(Programs) & " programs, done";
+    Done <= true;
+    wait;
+  end process;
+
+end sim;
@@ -0,0 +1,249 @@
+----------------------------------------------------------------
+--  Title     : tb_bank.vhd
+--  Function  : Bench of the bank presets
+----------------------------------------------------------------
+-- Bank 2 is an 8K RAM page, its register at 7000h. Pages 1 and 2
+-- are filled first.
+--  0. the version at 4FACh-4FAEh is "260" or later, as software
+--     checks it before it uses the presets;
+--  1. preset 1: page 1 at 8000h, preset 2: page 2 at A000h, saved
+--     with 4FA5h; the time of a save is reported;
+--  2. delayed configuration (CardMDR 3b): a load of preset 1 and a
+--     commit in one write, the next read of 8000h waits for it and
+--     gets page 1; the same with preset 2 at A000h; the wait states
+--     are reported;
+--  3. a load without commit changes the registers read at 4F8Ch-
+--     4F91h only, a commit alone then switches the bank;
+--  4. immediate configuration: a load alone switches the bank;
+--  5. block bases: bank 3 at A000h with base 1 (10000h) and bank 2
+--     at 8000h with base 0 map page 1 of the two blocks at once.
+----------------------------------------------------------------
+library IEEE;
+use IEEE.std_logic_1164.all;
+use IEEE.numeric_std.all;
+use work.c2sim_pkg.all;
+
+entity tb_bank is
+end tb_bank;
+
+architecture sim of tb_bank is
+
+  constant REGS    : natural := 16#4F80#;
+  constant CARDMDR : natural := REGS + 16#00#;
+  constant R2MASK  : natural := REGS + 16#0C#;
+  constant R2ADDR  : natural := REGS + 16#0D#;
+  constant R2REG   : natural := REGS + 16#0E#;
+  constant R2MULT  : natural := REGS + 16#0F#;
+  constant B2MASKR : natural := REGS + 16#10#;
+  constant B2ADRD  : natural := REGS + 16#11#;
+  constant R3MASK  : natural := REGS + 16#12#;
+  constant R3ADDR  : natural := REGS + 16#13#;
+  constant R3REG   : natural := REGS + 16#14#;
+  constant R3MULT  : natural := REGS + 16#15#;
+  constant B3MASKR : natural := REGS + 16#16#;
+  constant B3ADRD  : natural := REGS + 16#17#;
+  constant BNKCTL  : natural := REGS + 16#25#;
+  constant VERSION : natural := REGS + 16#2C#;
+  constant B3BASE  : natural := REGS + 16#39#;
+
+  signal Done      : boolean := false;
+  signal SltClk    : std_logic := '0';
+  signal SltClk2   : std_logic := '0';
+  signal SltRst_n  : std_logic := '0';
+  signal Slt       : slot_t := SLOT_IDLE;
+  signal SltDat    : std_logic_vector(7 downto 0);
+  signal SltWait_n : std_logic;
+
+  signal FlAdr     : std_logic_vector(22 downto 0);
+  signal FlDat     : std_logic_vector(7 downto 0);
+  signal FlCS_n    : std_logic;
+  signal FlOE_n    : std_logic;
+  signal FlW_n     : std_logic;
+  signal FlRP_n    : std_logic;
+  signal FlRB_b    : std_logic;
+  signal RAMCS_n   : std_logic;
+  signal IDEDat    : std_logic_vector(15 downto 0);
+  signal Programs  : natural;
+  signal BusyReads : natural;
+  signal Errors    : natural;
+  signal RAMWrites : natural;
+  signal RAMErrors : natural;
+
+begin
+
+  SltClk  <= not SltClk after T_SLTCLK / 2 when not Done;
+  SltClk2 <= not SltClk2 after T_CLK2 / 2 when not Done;
+
+  SltWait_n <= 'H';
+  SltDat <= (others => 'H');
+
+  dut : entity work.mcscc
+    port map(
+      pSltClk => SltClk, pSltRst1_n => SltRst_n, pSltSltsls_n => Slt.Sltsl_n,
+      pSltIorq_n => Slt.Iorq_n, pSltRd_n => Slt.Rd_n, pSltWr_n => Slt.Wr_n,
+      pSltAdr => Slt.Adr, pSltDat => SltDat, pSltBdir_n => open,
+      pSltCs1 => '1', pSltCs2 => '1', pSltCs12 => '1', pSltRfsh_n => '1',
+      pSltWait_n => SltWait_n, pSltInt_n => '1', pSltM1_n => Slt.M1_n,
+      pSltMerq_n => Slt.Merq_n, pSltClk2 => SltClk2, pSltRsv5 => '1', pSltRsv16 => '1',
+      pFlAdr => FlAdr, pFlDat => FlDat, pFlCS_n => FlCS_n, pFlOE_n => FlOE_n,
+      pFlW_n => FlW_n, pFlRP_n => FlRP_n, pFlRB_b => FlRB_b, pFlVpp => open,
+      pRAMCS_n => RAMCS_n,
+      pIDEAdr => open, pIDEDat => IDEDat, pIDECS1_n => open, pIDECS3_n => open,
+      pIDERD_n => open, pIDEWR_n => open, pPIN180 => open, pIDE_Rst_n => open,
+      dac_xsmt => open, dac_lrck => open, dac_din => open, dac_bck => open,
+      dac_sck => open, dac_flt => open, dac_demp => open,
+      adc_md => open, adc_scki => open, adc_bck => open, adc_lrck => open, adc_dout => '0',
+      EECS => open, EECK => open, EEDI => open, EEDO => '0'
+    );
+
+  flash : entity work.flash_model
+    port map(
+      A => FlAdr, DQ => FlDat, CE_n => FlCS_n, OE_n => FlOE_n, WE_n => FlW_n,
+      RP_n => FlRP_n, RB_n => FlRB_b,
+      Programs => Programs, BusyReads => BusyReads, Errors => Errors
+    );
+
+  sram : entity work.sram_model
+    port map(
+      A => FlAdr, DQ => FlDat, CE_n => RAMCS_n, OE_n => FlOE_n, WE_n => FlW_n,
+      Writes => RAMWrites, Errors => RAMErrors
+    );
+
+  process
+    variable res : slot_res_t;
+    variable t0 : time;
+    variable n : natural;
+
+    procedure wr(adr : natural; dat : natural) is
+    begin
+      slot_cycle(MEM_WR, std_logic_vector(to_unsigned(adr, 16)),
+                 std_logic_vector(to_unsigned(dat, 8)), res, SltClk, Slt, SltDat, SltWait_n);
+    end wr;
+
+    procedure rd(adr : natural) is
+    begin
+      slot_cycle(MEM_RD, std_logic_vector(to_unsigned(adr, 16)),
+                 "00000000", res, SltClk, Slt, SltDat, SltWait_n);
+    end rd;
+
+    procedure check(adr : natural; dat : natural; what : string) is
+    begin
+      rd(adr);
+      assert to_integer(unsigned(res.Dat)) = dat
+        report what & ": " & hex(res.Dat) & " at " & hex(std_logic_vector(to_unsigned(adr, 16)))
+             & ", not " & hex(std_logic_vector(to_unsigned(dat, 8))) severity error;
+    end check;
+
+    procedure wait_ready is
+    begin
+      n := 0;
+      loop
+        rd(BNKCTL);
+        n := n + 1;
+        exit when res.Dat(7) = '0';
+        assert n < 1000 report "presets busy for ever" severity failure;
+      end loop;
+    end wait_ready;
+
+    procedure bank2(adr : natural; page : natural) is
+    begin
+      wr(R2MASK, 16#F8#);                  -- 7000h-77FFh
+      wr(R2ADDR, 16#70#);
+      wr(R2REG,  page);
+      wr(B2MASKR, 16#07#);
+      wr(B2ADRD, adr / 256);
+      wr(R2MULT, 16#B4#);                  -- RAM, writes enabled, 8K
+    end bank2;
+
+    function pat(p : natural; i : natural) return natural is
+    begin
+      return (p * 64 + i * 5) mod 256;
+    end pat;
+
+  begin
+    wait for 1 us;
+    SltRst_n <= '1';
+    rd(16#0000#);                          -- the first slot access ends the reset
+
+    bank2(16#8000#, 0);
+    for p in 1 to 2 loop
+      wr(16#7000#, p);
+      for i in 0 to 15 loop
+        wr(16#8000# + i * 256, pat(p, i));
+      end loop;
+    end loop;
+
+    -- 0. version
+    check(VERSION, 16#32#, "version");
+    check(VERSION + 1, 16#36#, "version");
+
+    -- 1. save
+    bank2(16#8000#, 1);
+    t0 := now;
+    wr(BNKCTL, 16#41#);
+    wait_ready;
+    report "save of a preset: " & time'image(now - t0);
+    assert res.Dat = x"01" report "4FA5 after the save: " & hex(res.Dat) severity error;
+    bank2(16#A000#, 2);
+    wr(BNKCTL, 16#42#);
+    wait_ready;
+    check(16#A000#, pat(2, 0), "preset 2 before the save");
+
+    -- 2. load and commit, delayed configuration
+    wr(CARDMDR, 16#38#);
+    wr(BNKCTL, 16#A1#);
+    rd(16#8000#);
+    report "load and commit, the next read: " & integer'image(res.Waits) & " wait states";
+    assert res.Waits > 0 report "no wait during the load" severity error;
+    assert to_integer(unsigned(res.Dat)) = pat(1, 0)
+      report "preset 1: " & hex(res.Dat) severity error;
+    for i in 1 to 15 loop
+      check(16#8000# + i * 256, pat(1, i), "preset 1");
+    end loop;
+    wr(BNKCTL, 16#A2#);
+    for i in 0 to 15 loop
+      check(16#A000# + i * 256, pat(2, i), "preset 2");
+    end loop;
+
+    -- 3. load alone, then commit
+    wr(BNKCTL, 16#21#);
+    wait_ready;
+    check(B2ADRD, 16#80#, "B2AdrD after the load");
+    check(R2REG, 16#01#, "R2Reg after the load");
+    check(16#A000#, pat(2, 0), "bank before the commit");
+    wr(BNKCTL, 16#80#);
+    check(16#8000#, pat(1, 0), "bank after the commit");
+
+    -- 4. immediate configuration
+    wr(CARDMDR, 16#30#);
+    wr(BNKCTL, 16#22#);
+    check(16#A000#, pat(2, 0), "immediate load");
+    check(16#A100#, pat(2, 1), "immediate load");
+
+    -- 5. block bases
+    bank2(16#8000#, 1);
+    wr(R3MASK, 16#F8#);                    -- 7800h-7FFFh
+    wr(R3ADDR, 16#78#);
+    wr(R3REG,  1);
+    wr(B3MASKR, 16#07#);
+    wr(B3ADRD, 16#A0#);
+    wr(B3BASE, 1);
+    wr(R3MULT, 16#B4#);
+    check(B3BASE, 1, "B3Base");
+    for i in 0 to 15 loop
+      wr(16#A000# + i * 256, pat(3, i));
+    end loop;
+    for i in 0 to 15 loop
+      check(16#8000# + i * 256, pat(1, i), "bank 2, block 0");
+      check(16#A000# + i * 256, pat(3, i), "bank 3, block 1");
+    end loop;
+    wr(B3BASE, 0);
+    check(16#A000#, pat(1, 0), "bank 3, block 0");
+
+    assert RAMErrors = 0 report "RAM errors: " & integer'image(RAMErrors) severity error;
+    report "tb_bank: done";
+    Done <= true;
+    wait;
+  end process;
+
+end sim;
@@ -0,0 +1,230 @@
+----------------------------------------------------------------
+--  Title     : tb_copy.vhd
+--  Function  : Bench of the copy engine
+----------------------------------------------------------------
+-- Bank 1 maps the first 16K of the flash at 4000h, bank 2 the RAM
+-- from 10000h at 8000h.
+--  1. 256 bytes are auto-programmed at 0100h in the flash;
+--  2. they are copied to 10000h in the RAM, XCtl polled, the time
+--     per byte is reported and the RAM is read back through bank 2;
+--  3. a RAM to RAM copy (10000h to 10400h) runs while the Z80 reads
+--     the flash in bank 1: both are right, the wait states of the
+--     Z80 are reported;
+--  4. a copy of length 0 ends at once.
+----------------------------------------------------------------
+library IEEE;
+use IEEE.std_logic_1164.all;
+use IEEE.numeric_std.all;
+use work.c2sim_pkg.all;
+
+entity tb_copy is
+end tb_copy;
+
+architecture sim of tb_copy is
+
+  constant REGS    : natural := 16#4F80#;
+  constant R1MULT  : natural := REGS + 16#09#;
+  constant R2MASK  : natural := REGS + 16#0C#;
+  constant R2ADDR  : natural := REGS + 16#0D#;
+  constant R2REG   : natural := REGS + 16#0E#;
+  constant R2MULT  : natural := REGS + 16#0F#;
+  constant B2MASKR : natural := REGS + 16#10#;
+  constant B2ADRD  : natural := REGS + 16#11#;
+  constant CONFFL  : natural := REGS + 16#20#;
+  constant XCTL    : natural := REGS + 16#36#;
+  constant XIDX    : natural := REGS + 16#3E#;
+  constant XDAT    : natural := REGS + 16#3F#;
+
+  signal Done      : boolean := false;
+  signal SltClk    : std_logic := '0';
+  signal SltClk2   : std_logic := '0';
+  signal SltRst_n  : std_logic := '0';
+  signal Slt       : slot_t := SLOT_IDLE;
+  signal SltDat    : std_logic_vector(7 downto 0);
+  signal SltWait_n : std_logic;
+
+  signal FlAdr     : std_logic_vector(22 downto 0);
+  signal FlDat     : std_logic_vector(7 downto 0);
+  signal FlCS_n    : std_logic;
+  signal FlOE_n    : std_logic;
+  signal FlW_n     : std_logic;
+  signal FlRP_n    : std_logic;
+  signal FlRB_b    : std_logic;
+  signal RAMCS_n   : std_logic;
+  signal IDEDat    : std_logic_vector(15 downto 0);
+  signal Programs  : natural;
+  signal BusyReads : natural;
+  signal Errors    : natural;
+  signal RAMWrites : natural;
+  signal RAMErrors : natural;
+
+begin
+
+  SltClk  <= not SltClk after T_SLTCLK / 2 when not Done;
+  SltClk2 <= not SltClk2 after T_CLK2 / 2 when not Done;
+
+  SltWait_n <= 'H';
+  SltDat <= (others => 'H');
+
+  dut : entity work.mcscc
+    port map(
+      pSltClk => SltClk, pSltRst1_n => SltRst_n, pSltSltsls_n => Slt.Sltsl_n,
+      pSltIorq_n => Slt.Iorq_n, pSltRd_n => Slt.Rd_n, pSltWr_n => Slt.Wr_n,
+      pSltAdr => Slt.Adr, pSltDat => SltDat, pSltBdir_n => open,
+      pSltCs1 => '1', pSltCs2 => '1', pSltCs12 => '1', pSltRfsh_n => '1',
+      pSltWait_n => SltWait_n, pSltInt_n => '1', pSltM1_n => Slt.M1_n,
+      pSltMerq_n => Slt.Merq_n, pSltClk2 => SltClk2, pSltRsv5 => '1', pSltRsv16 => '1',
+      pFlAdr => FlAdr, pFlDat => FlDat, pFlCS_n => FlCS_n, pFlOE_n => FlOE_n,
+      pFlW_n => FlW_n, pFlRP_n => FlRP_n, pFlRB_b => FlRB_b, pFlVpp => open,
+      pRAMCS_n => RAMCS_n,
+      pIDEAdr => open, pIDEDat => IDEDat, pIDECS1_n => open, pIDECS3_n => open,
+      pIDERD_n => open, pIDEWR_n => open, pPIN180 => open, pIDE_Rst_n => open,
+      dac_xsmt => open, dac_lrck => open, dac_din => open, dac_bck => open,
+      dac_sck => open, dac_flt => open, dac_demp => open,
+      adc_md => open, adc_scki => open, adc_bck => open, adc_lrck => open, adc_dout => '0',
+      EECS => open, EECK => open, EEDI => open, EEDO => '0'
+    );
+
+  flash : entity work.flash_model
+    port map(
+      A => FlAdr, DQ => FlDat, CE_n => FlCS_n, OE_n => FlOE_n, WE_n => FlW_n,
+      RP_n => FlRP_n, RB_n => FlRB_b,
+      Programs => Programs, BusyReads => BusyReads, Errors => Errors
+    );
+
+  sram : entity work.sram_model
+    port map(
+      A => FlAdr, DQ => FlDat, CE_n => RAMCS_n, OE_n => FlOE_n, WE_n => FlW_n,
+      Writes => RAMWrites, Errors => RAMErrors
+    );
+
+  process
+    variable res : slot_res_t;
+    variable clocks : natural;
+    variable t0 : time;
+    variable n : natural;
+    variable waits : natural;
+    variable maxw : natural;
+
+    procedure wr(adr : natural; dat : natural) is
+    begin
+      slot_cycle(MEM_WR, std_logic_vector(to_unsigned(adr, 16)),
+                 std_logic_vector(to_unsigned(dat, 8)), res, SltClk, Slt, SltDat, SltWait_n);
+      clocks := clocks + res.Clocks;
+    end wr;
+
+    procedure rd(adr : natural) is
+    begin
+      slot_cycle(MEM_RD, std_logic_vector(to_unsigned(adr, 16)),
+                 "00000000", res, SltClk, Slt, SltDat, SltWait_n);
+      clocks := clocks + res.Clocks;
+    end rd;
+
+    procedure idle(n : natural) is         -- clocks with no slot access
+    begin
+      for i in 1 to n loop
+        wait until rising_edge(SltClk);
+      end loop;
+      clocks := clocks + n;
+    end idle;
+
+    procedure copy(src : natural; dst : natural; len : natural) is
+    begin
+      wr(XIDX, 0);
+      wr(XDAT, src mod 256);
+      wr(XDAT, (src / 256) mod 256);
+      wr(XDAT, src / 65536);
+      wr(XDAT, dst mod 256);
+      wr(XDAT, (dst / 256) mod 256);
+      wr(XDAT, dst / 65536);
+      wr(XDAT, len mod 256);
+      wr(XDAT, (len / 256) mod 256);
+      wr(XDAT, len / 65536);
+      wr(XCTL, 1);
+    end copy;
+
+    function pat(i : natural) return natural is
+    begin
+      return (i * 37 + 1) mod 256;
+    end pat;
+
+  begin
+    clocks := 0;
+    wait for 1 us;
+    SltRst_n <= '1';
+    rd(16#0000#);                          -- the first slot access ends the reset
+    wr(R1MULT, 16#15#);                    -- bank 1: 16K, flash, writes enabled
+    wr(R2MASK, 16#F8#);                    -- bank 2: 16K, RAM from 10000h at 8000h
+    wr(R2ADDR, 16#70#);
+    wr(R2REG,  16#04#);
+    wr(B2MASKR, 16#07#);
+    wr(B2ADRD, 16#80#);
+    wr(R2MULT, 16#B5#);
+
+    -- 1. the source in the flash
+    wr(CONFFL, 16#12#);                    -- RP# high, auto-program
+    for i in 0 to 255 loop
+      wr(16#4100# + i, pat(i));
+      idle(18);
+    end loop;
+    rd(16#4100#);                          -- waits for the last program
+    wr(CONFFL, 16#02#);
+
+    -- 2. flash to RAM
+    copy(16#000100#, 16#010000#, 256);
+    rd(XIDX);
+    assert res.Dat = x"09" report "XIdx: " & hex(res.Dat) & " after 9 XDat writes" severity error;
+    t0 := now;
+    n := 0;
+    loop
+      rd(XCTL);
+      n := n + 1;
+      exit when res.Dat(0) = '0';
+      assert n < 10000 report "copy never ends" severity failure;
+    end loop;
+    report "flash to RAM, 256 bytes: " & time'image(now - t0) & ", "
+         & time'image((now - t0) / 256) & " per byte";
+    for i in 0 to 255 loop
+      rd(16#8000# + i);
+      assert to_integer(unsigned(res.Dat)) = pat(i)
+        report "flash to RAM: " & hex(res.Dat) & " at offset " & integer'image(i) severity error;
+    end loop;
+
+    -- 3. RAM to RAM while the Z80 reads the flash
+    copy(16#810000#, 16#010400#, 256);
+    n := 0;
+    waits := 0;
+    maxw := 0;
+    loop
+      rd(16#4100# + n mod 256);
+      assert to_integer(unsigned(res.Dat)) = pat(n mod 256)
+        report "Z80 read during the copy: " & hex(res.Dat) & " at offset " & integer'image(n mod 256) severity error;
+      waits := waits + res.Waits;
+      if (res.Waits > maxw) then maxw := res.Waits; end if;
+      n := n + 1;
+      rd(XCTL);
+      exit when res.Dat(0) = '0';
+      assert n < 10000 report "copy never ends" severity failure;
+    end loop;
+    report "RAM to RAM with Z80 reads: " & integer'image(n) & " reads, "
+         & integer'image(waits) & " wait states, at most " & integer'image(maxw);
+    for i in 0 to 255 loop
+      rd(16#8400# + i);
+      assert to_integer(unsigned(res.Dat)) = pat(i)
+        report "RAM to RAM: " & hex(res.Dat) & " at offset " & integer'image(i) severity error;
+    end loop;
+
+    -- 4. length 0
+    copy(16#000100#, 16#010800#, 0);
+    rd(XCTL);
+    rd(XCTL);
+    assert res.Dat(0) = '0' report "length 0: still busy" severity error;
+
+    assert Errors = 0 report "flash errors: " & integer'image(Errors) severity error;
+    assert RAMErrors = 0 report "RAM errors: " & integer'image(RAMErrors) severity error;
+    report "tb_copy: " & integer'image(RAMWrites) & " RAM writes, done";
+    Done <= true;
+    wait;
+  end process;
+
+end sim;
@@ -0,0 +1,240 @@
+----------------------------------------------------------------
+--  Title     : tb_crc.vhd
+--  Function  : Bench of the CRC-32 unit
+----------------------------------------------------------------
+-- Bank 2 maps the RAM from 10000h at 8000h.
+--  1. CRC scan of "123456789": the CRC-32 check value CBF43926h;
+--  2. CRC scan of 256 bytes, the time per byte is reported;
+--  3. the same bytes read by the Z80 with the snoop on page 2;
+--  4. the CRC of a copy and the CRC scan of the copied bytes;
+--  5. CRC scan of the erased flash.
+----------------------------------------------------------------
+library IEEE;
+use IEEE.std_logic_1164.all;
+use IEEE.numeric_std.all;
+use work.c2sim_pkg.all;
+
+entity tb_crc is
+end tb_crc;
+
+architecture sim of tb_crc is
+
+  constant REGS    : natural := 16#4F80#;
+  constant R2MASK  : natural := REGS + 16#0C#;
+  constant R2ADDR  : natural := REGS + 16#0D#;
+  constant R2REG   : natural := REGS + 16#0E#;
+  constant R2MULT  : natural := REGS + 16#0F#;
+  constant B2MASKR : natural := REGS + 16#10#;
+  constant B2ADRD  : natural := REGS + 16#11#;
+  constant XCTL    : natural := REGS + 16#36#;
+  constant XIDX    : natural := REGS + 16#3E#;
+  constant XDAT    : natural := REGS + 16#3F#;
+
+  signal Done      : boolean := false;
+  signal SltClk    : std_logic := '0';
+  signal SltClk2   : std_logic := '0';
+  signal SltRst_n  : std_logic := '0';
+  signal Slt       : slot_t := SLOT_IDLE;
+  signal SltDat    : std_logic_vector(7 downto 0);
+  signal SltWait_n : std_logic;
+
+  signal FlAdr     : std_logic_vector(22 downto 0);
+  signal FlDat     : std_logic_vector(7 downto 0);
+  signal FlCS_n    : std_logic;
+  signal FlOE_n    : std_logic;
+  signal FlW_n     : std_logic;
+  signal FlRP_n    : std_logic;
+  signal FlRB_b    : std_logic;
+  signal RAMCS_n   : std_logic;
+  signal IDEDat    : std_logic_vector(15 downto 0);
+  signal Programs  : natural;
+  signal BusyReads : natural;
+  signal Errors    : natural;
+  signal RAMWrites : natural;
+  signal RAMErrors : natural;
+
+begin
+
+  SltClk  <= not SltClk after T_SLTCLK / 2 when not Done;
+  SltClk2 <= not SltClk2 after T_CLK2 / 2 when not Done;
+
+  SltWait_n <= 'H';
+  SltDat <= (others => 'H');
+
+  dut : entity work.mcscc
+    port map(
+      pSltClk => SltClk, pSltRst1_n => SltRst_n, pSltSltsls_n => Slt.Sltsl_n,
+      pSltIorq_n => Slt.Iorq_n, pSltRd_n => Slt.Rd_n, pSltWr_n => Slt.Wr_n,
+      pSltAdr => Slt.Adr, pSltDat => SltDat, pSltBdir_n => open,
+      pSltCs1 => '1', pSltCs2 => '1', pSltCs12 => '1', pSltRfsh_n => '1',
+      pSltWait_n => SltWait_n, pSltInt_n => '1', pSltM1_n => Slt.M1_n,
+      pSltMerq_n => Slt.Merq_n, pSltClk2 => SltClk2, pSltRsv5 => '1', pSltRsv16 => '1',
+      pFlAdr => FlAdr, pFlDat => FlDat, pFlCS_n => FlCS_n, pFlOE_n => FlOE_n,
+      pFlW_n => FlW_n, pFlRP_n => FlRP_n, pFlRB_b => FlRB_b, pFlVpp => open,
+      pRAMCS_n => RAMCS_n,
+      pIDEAdr => open, pIDEDat => IDEDat, pIDECS1_n => open, pIDECS3_n => open,
+      pIDERD_n => open, pIDEWR_n => open, pPIN180 => open, pIDE_Rst_n => open,
+      dac_xsmt => open, dac_lrck => open, dac_din => open, dac_bck => open,
+      dac_sck => open, dac_flt => open, dac_demp => open,
+      adc_md => open, adc_scki => open, adc_bck => open, adc_lrck => open, adc_dout => '0',
+      EECS => open, EECK => open, EEDI => open, EEDO => '0'
+    );
+
+  flash : entity work.flash_model
+    port map(
+      A => FlAdr, DQ => FlDat, CE_n => FlCS_n, OE_n => FlOE_n, WE_n => FlW_n,
+      RP_n => FlRP_n, RB_n => FlRB_b,
+      Programs => Programs, BusyReads => BusyReads, Errors => Errors
+    );
+
+  sram : entity work.sram_model
+    port map(
+      A => FlAdr, DQ => FlDat, CE_n => RAMCS_n, OE_n => FlOE_n, WE_n => FlW_n,
+      Writes => RAMWrites, Errors => RAMErrors
+    );
+
+  process
+    variable res : slot_res_t;
+    variable clocks : natural;
+    variable t0 : time;
+    variable n : natural;
+    variable exp : std_logic_vector(31 downto 0);
+    variable got : std_logic_vector(31 downto 0);
+
+    procedure wr(adr : natural; dat : natural) is
+    begin
+      slot_cycle(MEM_WR, std_logic_vector(to_unsigned(adr, 16)),
+                 std_logic_vector(to_unsigned(dat, 8)), res, SltClk, Slt, SltDat, SltWait_n);
+      clocks := clocks + res.Clocks;
+    end wr;
+
+    procedure rd(adr : natural) is
+    begin
+      slot_cycle(MEM_RD, std_logic_vector(to_unsigned(adr, 16)),
+                 "00000000", res, SltClk, Slt, SltDat, SltWait_n);
+      clocks := clocks + res.Clocks;
+    end rd;
+
+    -- source, destination and length, then XCtl
+    procedure start(src : natural; dst : natural; len : natural; ctl : natural) is
+    begin
+      wr(XIDX, 0);
+      wr(XDAT, src mod 256);
+      wr(XDAT, (src / 256) mod 256);
+      wr(XDAT, src / 65536);
+      wr(XDAT, dst mod 256);
+      wr(XDAT, (dst / 256) mod 256);
+      wr(XDAT, dst / 65536);
+      wr(XDAT, len mod 256);
+      wr(XDAT, (len / 256) mod 256);
+      wr(XDAT, len / 65536);
+      wr(XCTL, ctl);
+    end start;
+
+    procedure wait_done is
+    begin
+      n := 0;
+      loop
+        rd(XCTL);
+        n := n + 1;
+        exit when res.Dat(0) = '0';
+        assert n < 10000 report "the engine never ends" severity failure;
+      end loop;
+    end wait_done;
+
+    procedure read_crc is
+    begin
+      wr(XIDX, 16#09#);
+      for i in 0 to 3 loop
+        rd(XDAT);
+        got(i * 8 + 7 downto i * 8) := res.Dat;
+      end loop;
+    end read_crc;
+
+    function pat(i : natural) return natural is
+    begin
+      return (i * 37 + 1) mod 256;
+    end pat;
+
+    constant CHECK : string(1 to 9) := "123456789";
+
+  begin
+    clocks := 0;
+    wait for 1 us;
+    SltRst_n <= '1';
+    rd(16#0000#);                          -- the first slot access ends the reset
+    wr(R2MASK, 16#F8#);                    -- bank 2: 16K, RAM from 10000h at 8000h
+    wr(R2ADDR, 16#70#);
+    wr(R2REG,  16#04#);
+    wr(B2MASKR, 16#07#);
+    wr(B2ADRD, 16#80#);
+    wr(R2MULT, 16#B5#);
+
+    -- 1. check value
+    for i in CHECK'range loop
+      wr(16#8000# + i - 1, character'pos(CHECK(i)));
+    end loop;
+    start(16#810000#, 0, 9, 16#06#);       -- clear and scan
+    wait_done;
+    read_crc;
+    assert got = x"CBF43926" report "check value: " & hex(got) severity error;
+
+    -- 2. scan
+    exp := (others => '1');
+    for i in 0 to 255 loop
+      wr(16#8100# + i, pat(i));
+      exp := crc32(exp, pat(i));
+    end loop;
+    exp := not exp;
+    start(16#810100#, 0, 256, 16#06#);
+    t0 := now;
+    wait_done;
+    report "CRC scan, 256 bytes: " & time'image(now - t0) & ", "
+         & time'image((now - t0) / 256) & " per byte";
+    read_crc;
+    assert got = exp report "scan: " & hex(got) & " instead of " & hex(exp) severity error;
+
+    -- 3. snoop
+    wr(XIDX, 16#0D#);
+    wr(XDAT, 16#82#);                      -- Z80 reads from page 2
+    wr(XCTL, 16#04#);
+    for i in 0 to 255 loop
+      rd(16#8100# + i);
+      if (i mod 64 = 0) then
+        rd(XCTL);                          -- the registers are not counted
+      end if;
+    end loop;
+    wr(XIDX, 16#0D#);
+    wr(XDAT, 16#00#);
+    read_crc;
+    assert got = exp report "snoop: " & hex(got) & " instead of " & hex(exp) severity error;
+
+    -- 4. copy, then scan the copy
+    start(16#810100#, 16#010400#, 256, 16#05#);
+    wait_done;
+    read_crc;
+    assert got = exp report "copy: " & hex(got) & " instead of " & hex(exp) severity error;
+    start(16#810400#, 0, 256, 16#06#);
+    wait_done;
+    read_crc;
+    assert got = exp report "copied bytes: " & hex(got) & " instead of " & hex(exp) severity error;
+
+    -- 5. erased flash
+    exp := (others => '1');
+    for i in 0 to 15 loop
+      exp := crc32(exp, 16#FF#);
+    end loop;
+    exp := not exp;
+    start(16#002000#, 0, 16, 16#06#);
+    wait_done;
+    read_crc;
+    assert got = exp report "flash: " & hex(got) & " instead of " & hex(exp) severity error;
+
+    assert Errors = 0 report "flash errors: " & integer'image(Errors) severity error;
+    assert RAMErrors = 0 report "RAM errors: " & integer'image(RAMErrors) severity error;
+    report "tb_crc: done";
+    Done <= true;
+    wait;
+  end process;
+
+end sim;
@@ -0,0 +1,286 @@
+----------------------------------------------------------------
+--  Title     : tb_eeprom.vhd
+--  Function  : Bench of the EEPROM shadow
+----------------------------------------------------------------
+--  1. after the reset XCtl shows the EEPROM busy until the 128
+--     bytes are loaded, the time is reported; XDat 80h-FFh read
+--     them back;
+--  2. a write of XDat 85h writes the EEPROM, the time until XCtl
+--     is clear is reported; the byte is in the shadow and in the
+--     EEPROM (read back with the EERD routine of the Boot Menu);
+--     a second write while busy is ignored;
+--  3. EEWEN and EEWR of the Boot Menu on 4FA3 write the EEPROM and
+--     the shadow follows;
+--  4. the bus cycles of a byte read by EERD and from the shadow are
+--     reported;
+--  5. EERD of the Boot Menu right after a reset, as the tools older
+--     than 2.60 do: the load pauses, EERD reads the EEPROM and the
+--     load ends with the whole shadow right.
+----------------------------------------------------------------
+library IEEE;
+use IEEE.std_logic_1164.all;
+use IEEE.numeric_std.all;
+use work.c2sim_pkg.all;
+
+entity tb_eeprom is
+end tb_eeprom;
+
+architecture sim of tb_eeprom is
+
+  constant REGS    : natural := 16#4F80#;
+  constant EEREG   : natural := REGS + 16#23#;
+  constant XCTL    : natural := REGS + 16#36#;
+  constant XIDX    : natural := REGS + 16#3E#;
+  constant XDAT    : natural := REGS + 16#3F#;
+
+  signal Done      : boolean := false;
+  signal SltClk    : std_logic := '0';
+  signal SltClk2   : std_logic := '0';
+  signal SltRst_n  : std_logic := '0';
+  signal Slt       : slot_t := SLOT_IDLE;
+  signal SltDat    : std_logic_vector(7 downto 0);
+  signal SltWait_n : std_logic;
+
+  signal FlAdr     : std_logic_vector(22 downto 0);
+  signal FlDat     : std_logic_vector(7 downto 0);
+  signal FlCS_n    : std_logic;
+  signal FlOE_n    : std_logic;
+  signal FlW_n     : std_logic;
+  signal FlRP_n    : std_logic;
+  signal FlRB_b    : std_logic;
+  signal RAMCS_n   : std_logic;
+  signal IDEDat    : std_logic_vector(15 downto 0);
+  signal EeCS      : std_logic;
+  signal EeCK      : std_logic;
+  signal EeDI      : std_logic;
+  signal EeDO      : std_logic;
+  signal Programs  : natural;
+  signal BusyReads : natural;
+  signal Errors    : natural;
+  signal EeWrites  : natural;
+  signal EeErrors  : natural;
+
+begin
+
+  SltClk  <= not SltClk after T_SLTCLK / 2 when not Done;
+  SltClk2 <= not SltClk2 after T_CLK2 / 2 when not Done;
+
+  SltWait_n <= 'H';
+  SltDat <= (others => 'H');
+
+  dut : entity work.mcscc
+    port map(
+      pSltClk => SltClk, pSltRst1_n => SltRst_n, pSltSltsls_n => Slt.Sltsl_n,
+      pSltIorq_n => Slt.Iorq_n, pSltRd_n => Slt.Rd_n, pSltWr_n => Slt.Wr_n,
+      pSltAdr => Slt.Adr, pSltDat => SltDat, pSltBdir_n => open,
+      pSltCs1 => '1', pSltCs2 => '1', pSltCs12 => '1', pSltRfsh_n => '1',
+      pSltWait_n => SltWait_n, pSltInt_n => '1', pSltM1_n => Slt.M1_n,
+      pSltMerq_n => Slt.Merq_n, pSltClk2 => SltClk2, pSltRsv5 => '1', pSltRsv16 => '1',
+      pFlAdr => FlAdr, pFlDat => FlDat, pFlCS_n => FlCS_n, pFlOE_n => FlOE_n,
+      pFlW_n => FlW_n, pFlRP_n => FlRP_n, pFlRB_b => FlRB_b, pFlVpp => open,
+      pRAMCS_n => RAMCS_n,
+      pIDEAdr => open, pIDEDat => IDEDat, pIDECS1_n => open, pIDECS3_n => open,
+      pIDERD_n => open, pIDEWR_n => open, pPIN180 => open, pIDE_Rst_n => open,
+      dac_xsmt => open, dac_lrck => open, dac_din => open, dac_bck => open,
+      dac_sck => open, dac_flt => open, dac_demp => open,
+      adc_md => open, adc_scki => open, adc_bck => open, adc_lrck => open, adc_dout => '0',
+      EECS => EeCS, EECK => EeCK, EEDI => EeDI, EEDO => EeDO
+    );
+
+  flash : entity work.flash_model
+    port map(
+      A => FlAdr, DQ => FlDat, CE_n => FlCS_n, OE_n => FlOE_n, WE_n => FlW_n,
+      RP_n => FlRP_n, RB_n => FlRB_b,
+      Programs => Programs, BusyReads => BusyReads, Errors => Errors
+    );
+
+  eeprom : entity work.eeprom_model
+    generic map(tWR => 200 us)
+    port map(
+      CS => EeCS, SK => EeCK, DI => EeDI, DO => EeDO,
+      Writes => EeWrites, Errors => EeErrors
+    );
+
+  process
+    variable res : slot_res_t;
+    variable clocks : natural;
+    variable t0 : time;
+    variable n : natural;
+    variable c : natural;
+    variable d : std_logic_vector(7 downto 0);
+
+    procedure wr(adr : natural; dat : natural) is
+    begin
+      slot_cycle(MEM_WR, std_logic_vector(to_unsigned(adr, 16)),
+                 std_logic_vector(to_unsigned(dat, 8)), res, SltClk, Slt, SltDat, SltWait_n);
+      clocks := clocks + res.Clocks;
+    end wr;
+
+    procedure rd(adr : natural) is
+    begin
+      slot_cycle(MEM_RD, std_logic_vector(to_unsigned(adr, 16)),
+                 "00000000", res, SltClk, Slt, SltDat, SltWait_n);
+      clocks := clocks + res.Clocks;
+    end rd;
+
+    procedure wait_ready is
+    begin
+      n := 0;
+      loop
+        rd(XCTL);
+        n := n + 1;
+        exit when res.Dat(1) = '0';
+        assert n < 100000 report "EEPROM busy for ever" severity failure;
+      end loop;
+    end wait_ready;
+
+    -- The routines of the Boot Menu, one slot write per "ld (hl),a"
+    procedure ee_cmd(op : natural; adr : natural) is
+    begin
+      wr(EEREG, 2#0100#);                  -- one CK pulse
+      wr(EEREG, 2#0000#);
+      wr(EEREG, 2#0010#);                  -- start bit
+      wr(EEREG, 2#1010#);
+      wr(EEREG, 2#1110#);
+      for i in 1 downto 0 loop             -- opcode
+        wr(EEREG, 2#1000# + ((op / 2**i) mod 2) * 2);
+        wr(EEREG, 2#1100# + ((op / 2**i) mod 2) * 2);
+      end loop;
+      for i in 6 downto 0 loop             -- address A6-A0
+        wr(EEREG, 2#1000# + ((adr / 2**i) mod 2) * 2);
+        wr(EEREG, 2#1100# + ((adr / 2**i) mod 2) * 2);
+      end loop;
+    end ee_cmd;
+
+    procedure eerd(adr : natural) is
+    begin
+      ee_cmd(2, adr);
+      wr(EEREG, 2#1000#);
+      wr(EEREG, 2#1100#);
+      for i in 7 downto 0 loop
+        rd(EEREG);
+        d(i) := res.Dat(0);
+        wr(EEREG, 2#1000#);
+        wr(EEREG, 2#1100#);
+      end loop;
+      wr(EEREG, 2#1000#);
+      wr(EEREG, 2#0000#);
+    end eerd;
+
+    procedure eewr(adr : natural; dat : natural) is
+    begin
+      ee_cmd(1, adr);
+      for i in 7 downto 0 loop
+        wr(EEREG, 2#1000# + ((dat / 2**i) mod 2) * 2);
+        wr(EEREG, 2#1100# + ((dat / 2**i) mod 2) * 2);
+      end loop;
+      wr(EEREG, 2#1000#);
+      wr(EEREG, 2#0000#);
+      loop                                 -- write cycle
+        wr(EEREG, 2#1000#);
+        wr(EEREG, 2#1100#);
+        rd(EEREG);
+        exit when res.Dat(0) = '1';
+      end loop;
+      wr(EEREG, 2#1000#);
+      wr(EEREG, 2#0000#);
+    end eewr;
+
+    function init(i : natural) return natural is
+    begin
+      return (i * 29 + 7) mod 256;
+    end init;
+
+  begin
+    clocks := 0;
+    wait for 1 us;
+    SltRst_n <= '1';
+    rd(16#0000#);                          -- the first slot access ends the reset
+
+    -- 1. load after the reset
+    t0 := now;
+    rd(XCTL);
+    assert res.Dat(1) = '1' report "EEPROM not busy after the reset" severity error;
+    wait_ready;
+    report "load of the 128 bytes: " & time'image(now - t0);
+    wr(XIDX, 16#80#);
+    for i in 0 to 127 loop
+      rd(XDAT);
+      assert to_integer(unsigned(res.Dat)) = init(i)
+        report "shadow: " & hex(res.Dat) & " at " & integer'image(i) severity error;
+    end loop;
+
+    -- 2. write through the serializer
+    wr(XIDX, 16#85#);
+    wr(XDAT, 16#3C#);
+    t0 := now;
+    wr(XIDX, 16#86#);
+    wr(XDAT, 16#C3#);                      -- busy: ignored
+    rd(XCTL);
+    assert res.Dat(1) = '1' report "EEPROM not busy after a write" severity error;
+    wait_ready;
+    report "write of a byte: " & time'image(now - t0);
+    wr(XIDX, 16#85#);
+    rd(XDAT);
+    assert res.Dat = x"3C" report "shadow after the write: " & hex(res.Dat) severity error;
+    rd(XDAT);
+    assert to_integer(unsigned(res.Dat)) = init(6)
+      report "byte written while busy: " & hex(res.Dat) severity error;
+    eerd(16#05#);
+    assert d = x"3C" report "EEPROM after the write: " & hex(d) severity error;
+    assert EeWrites = 1 report "EEPROM writes: " & integer'image(EeWrites) severity error;
+
+    -- 3. write by the software
+    ee_cmd(0, 16#60#);                     -- EEWEN
+    wr(EEREG, 2#1000#);
+    wr(EEREG, 2#0000#);
+    eewr(16#10#, 16#99#);
+    wr(XIDX, 16#90#);
+    rd(XDAT);
+    assert res.Dat = x"99" report "shadow after EEWR: " & hex(res.Dat) severity error;
+    eerd(16#10#);
+    assert d = x"99" report "EEPROM after EEWR: " & hex(d) severity error;
+
+    -- 4. cost of a byte
+    c := clocks;
+    eerd(16#20#);
+    report "EERD: " & integer'image(clocks - c) & " clocks";
+    assert to_integer(unsigned(d)) = init(16#20#) report "EERD: " & hex(d) severity error;
+    c := clocks;
+    wr(XIDX, 16#A0#);
+    rd(XDAT);
+    report "shadow: " & integer'image(clocks - c) & " clocks";
+    assert res.Dat = d report "shadow and EERD differ" severity error;
+
+    -- 5. bit-bang during the load
+    SltRst_n <= '0';
+    wait for 1 us;
+    SltRst_n <= '1';
+    rd(16#0000#);
+    t0 := now;
+    eerd(16#20#);
+    assert to_integer(unsigned(d)) = init(16#20#) report "EERD during the load: " & hex(d) severity error;
+    eerd(16#05#);
+    assert d = x"3C" report "EERD during the load: " & hex(d) severity error;
+    wait_ready;
+    report "load with EERD: " & time'image(now - t0);
+    wr(XIDX, 16#80#);
+    for i in 0 to 127 loop
+      rd(XDAT);
+      if i = 16#05# then
+        assert res.Dat = x"3C" report "shadow after EERD: " & hex(res.Dat) severity error;
+      elsif i = 16#10# then
+        assert res.Dat = x"99" report "shadow after EERD: " & hex(res.Dat) severity error;
+      else
+        assert to_integer(unsigned(res.Dat)) = init(i)
+          report "shadow after EERD: " & hex(res.Dat) & " at " & integer'image(i) severity error;
+      end if;
+    end loop;
+
+    assert EeErrors = 0 report "EEPROM errors: " & integer'image(EeErrors) severity error;
+    report "tb_eeprom: " & integer'image(EeWrites) & " EEPROM writes, done";
+    Done <= true;
+    wait;
+  end process;
+
+end sim;
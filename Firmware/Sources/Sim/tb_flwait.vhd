@@ -0,0 +1,188 @@
+----------------------------------------------------------------
+--  Title     : tb_flwait.vhd
+--  Function  : Bench of the flash ready/busy status and auto-wait
+----------------------------------------------------------------
+-- Bank 1 maps the first 16K of the flash at 4000h with writes enabled.
+--  1. auto-wait off: a byte is programmed and polled like CHECK does,
+--     ConfFl bit 7 shows the busy time;
+--  2. auto-wait on: the read following the program waits for the
+--     flash and returns the programmed byte, nothing polls the chip;
+--  3. auto-wait on: 16 bytes are programmed with no polling at all;
+--  4. an erase is never waited for: the next read gets the status;
+--  5. a data byte of A0h without the unlock cycles is not a command.
+----------------------------------------------------------------
+library IEEE;
+use IEEE.std_logic_1164.all;
+use IEEE.numeric_std.all;
+use work.c2sim_pkg.all;
+
+entity tb_flwait is
+end tb_flwait;
+
+architecture sim of tb_flwait is
+
+  constant REGS    : natural := 16#4F80#;
+  constant R1MULT  : natural := REGS + 16#09#;
+  constant CONFFL  : natural := REGS + 16#20#;
+
+  signal Done      : boolean := false;
+  signal SltClk    : std_logic := '0';
+  signal SltClk2   : std_logic := '0';
+  signal SltRst_n  : std_logic := '0';
+  signal Slt       : slot_t := SLOT_IDLE;
+  signal SltDat    : std_logic_vector(7 downto 0);
+  signal SltWait_n : std_logic;
+
+  signal FlAdr     : std_logic_vector(22 downto 0);
+  signal FlDat     : std_logic_vector(7 downto 0);
+  signal FlCS_n    : std_logic;
+  signal FlOE_n    : std_logic;
+  signal FlW_n     : std_logic;
+  signal FlRP_n    : std_logic;
+  signal FlRB_b    : std_logic;
+  signal IDEDat    : std_logic_vector(15 downto 0);
+  signal Programs  : natural;
+  signal BusyReads : natural;
+  signal Errors    : natural;
+
+begin
+
+  SltClk  <= not SltClk after T_SLTCLK / 2 when not Done;
+  SltClk2 <= not SltClk2 after T_CLK2 / 2 when not Done;
+
+  SltWait_n <= 'H';
+  SltDat <= (others => 'H');
+
+  dut : entity work.mcscc
+    port map(
+      pSltClk => SltClk, pSltRst1_n => SltRst_n, pSltSltsls_n => Slt.Sltsl_n,
+      pSltIorq_n => Slt.Iorq_n, pSltRd_n => Slt.Rd_n, pSltWr_n => Slt.Wr_n,
+      pSltAdr => Slt.Adr, pSltDat => SltDat, pSltBdir_n => open,
+      pSltCs1 => '1', pSltCs2 => '1', pSltCs12 => '1', pSltRfsh_n => '1',
+      pSltWait_n => SltWait_n, pSltInt_n => '1', pSltM1_n => Slt.M1_n,
+      pSltMerq_n => Slt.Merq_n, pSltClk2 => SltClk2, pSltRsv5 => '1', pSltRsv16 => '1',
+      pFlAdr => FlAdr, pFlDat => FlDat, pFlCS_n => FlCS_n, pFlOE_n => FlOE_n,
+      pFlW_n => FlW_n, pFlRP_n => FlRP_n, pFlRB_b => FlRB_b, pFlVpp => open,
+      pRAMCS_n => open,
+      pIDEAdr => open, pIDEDat => IDEDat, pIDECS1_n => open, pIDECS3_n => open,
+      pIDERD_n => open, pIDEWR_n => open, pPIN180 => open, pIDE_Rst_n => open,
+      dac_xsmt => open, dac_lrck => open, dac_din => open, dac_bck => open,
+      dac_sck => open, dac_flt => open, dac_demp => open,
+      adc_md => open, adc_scki => open, adc_bck => open, adc_lrck => open, adc_dout => '0',
+      EECS => open, EECK => open, EEDI => open, EEDO => '0'
+    );
+
+  flash : entity work.flash_model
+    port map(
+      A => FlAdr, DQ => FlDat, CE_n => FlCS_n, OE_n => FlOE_n, WE_n => FlW_n,
+      RP_n => FlRP_n, RB_n => FlRB_b,
+      Programs => Programs, BusyReads => BusyReads, Errors => Errors
+    );
+
+  process
+    variable res : slot_res_t;
+    variable clocks : natural;
+    variable polls : natural;
+    variable br : natural;
+
+    procedure wr(adr : natural; dat : natural) is
+    begin
+      slot_cycle(MEM_WR, std_logic_vector(to_unsigned(adr, 16)),
+                 std_logic_vector(to_unsigned(dat, 8)), res, SltClk, Slt, SltDat, SltWait_n);
+      clocks := clocks + res.Clocks;
+    end wr;
+
+    procedure rd(adr : natural) is
+    begin
+      slot_cycle(MEM_RD, std_logic_vector(to_unsigned(adr, 16)),
+                 "00000000", res, SltClk, Slt, SltDat, SltWait_n);
+      clocks := clocks + res.Clocks;
+    end rd;
+
+    procedure program(adr : natural; dat : natural) is
+    begin
+      wr(16#4AAA#, 16#AA#);
+      wr(16#4555#, 16#55#);
+      wr(16#4AAA#, 16#A0#);
+      wr(adr, dat);
+    end program;
+
+  begin
+    clocks := 0;
+    wait for 1 us;
+    SltRst_n <= '1';
+    rd(16#0000#);                          -- the first slot access ends the reset
+    wr(R1MULT, 16#15#);                    -- bank 1: 16K, flash, writes enabled
+
+    -- 1. auto-wait off, polling
+    program(16#4100#, 16#5A#);
+    rd(CONFFL);
+    assert res.Dat(7) = '0' report "ConfFl: not busy after a program" severity error;
+    polls := 0;
+    clocks := 0;
+    loop
+      rd(16#4100#);
+      polls := polls + 1;
+      exit when res.Dat = x"5A";
+      assert polls < 1000 report "program never ends" severity failure;
+    end loop;
+    report "polled program: " & integer'image(polls) & " reads, " & integer'image(clocks) & " clocks";
+    rd(CONFFL);
+    assert res.Dat(7) = '1' report "ConfFl: busy after the program" severity error;
+
+    -- 2. auto-wait on
+    wr(CONFFL, 16#0A#);                    -- RP# high, auto-wait
+    br := BusyReads;
+    program(16#4101#, 16#A5#);
+    rd(16#4101#);
+    assert res.Dat = x"A5" report "auto-wait: read " & hex(res.Dat) & " instead of A5" severity error;
+    assert res.Waits > 0 report "auto-wait: no wait states" severity error;
+    assert BusyReads = br report "auto-wait: the busy flash was read" severity error;
+    report "auto-wait read: " & integer'image(res.Waits) & " wait states";
+
+    -- 3. auto-wait on, a block with no polling
+    clocks := 0;
+    for i in 0 to 15 loop
+      program(16#4200# + i, (i * 37) mod 256);
+    end loop;
+    report "16 bytes with auto-wait: " & integer'image(clocks) & " clocks";
+    for i in 0 to 15 loop
+      rd(16#4200# + i);
+      assert to_integer(unsigned(res.Dat)) = (i * 37) mod 256
+        report "block: " & hex(res.Dat) & " at offset " & integer'image(i) severity error;
+    end loop;
+    assert BusyReads = br report "block: the busy flash was read" severity error;
+
+    -- 4. sector erase, not waited for
+    wr(16#4AAA#, 16#AA#);
+    wr(16#4555#, 16#55#);
+    wr(16#4AAA#, 16#80#);
+    wr(16#4AAA#, 16#AA#);
+    wr(16#4555#, 16#55#);
+    wr(16#4000#, 16#30#);
+    rd(16#4100#);
+    assert res.Waits = 0 report "erase: wait states" severity error;
+    assert res.Dat(7) = '0' report "erase: no status read" severity error;
+    polls := 0;
+    loop
+      rd(CONFFL);
+      polls := polls + 1;
+      exit when res.Dat(7) = '1';
+      assert polls < 10000 report "erase never ends" severity failure;
+    end loop;
+    rd(16#4100#);
+    assert res.Dat = x"FF" report "erase: " & hex(res.Dat) & " left" severity error;
+
+    -- 5. A0h written as data does not arm a program
+    wr(16#4300#, 16#A0#);
+    wr(16#4301#, 16#12#);
+    rd(CONFFL);
+    assert res.Dat(7) = '1' report "stray A0h: busy as after a program" severity error;
+
+    assert Errors = 0 report "flash errors: " & integer'image(Errors) severity error;
+    report "tb_flwait: " & integer'image(Programs) & " programs, done";
+    Done <= true;
+    wait;
+  end process;
+
+end sim;
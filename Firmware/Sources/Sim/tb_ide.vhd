@@ -0,0 +1,252 @@
+----------------------------------------------------------------
+--  Title     : tb_ide.vhd
+--  Function  : Bench of the IDE sector FIFO
+----------------------------------------------------------------
+-- The IDE is in subslot 1 (FFFFh = 04h), cReg at 4104h.
+--  1. without the FIFO (cReg = 01h) two sectors from LBA 5 are read
+--     with READ SECTORS as the driver does, the clocks are reported;
+--  2. the same with the FIFO (cReg = 03h), the first sector at
+--     7C00h-7DFFh, the second at 7C00h only; the clocks and the wait
+--     states are reported;
+--  3. LBA 9 is written through the FIFO and read back without it;
+--  4. IDENTIFY through the FIFO, the task file is read during it;
+--  5. a read beyond the card ends with ERR and IDNF.
+----------------------------------------------------------------
+library IEEE;
+use IEEE.std_logic_1164.all;
+use IEEE.numeric_std.all;
+use work.c2sim_pkg.all;
+
+entity tb_ide is
+end tb_ide;
+
+architecture sim of tb_ide is
+
+  constant CREG    : natural := 16#4104#;
+  constant IDEDAT  : natural := 16#7C00#;
+  constant IDEERR  : natural := 16#7E01#;
+  constant IDECMD  : natural := 16#7E07#;
+
+  signal Done      : boolean := false;
+  signal SltClk    : std_logic := '0';
+  signal SltClk2   : std_logic := '0';
+  signal SltRst_n  : std_logic := '0';
+  signal Slt       : slot_t := SLOT_IDLE;
+  signal SltDat    : std_logic_vector(7 downto 0);
+  signal SltWait_n : std_logic;
+
+  signal FlAdr     : std_logic_vector(22 downto 0);
+  signal FlDat     : std_logic_vector(7 downto 0);
+  signal FlCS_n    : std_logic;
+  signal FlOE_n    : std_logic;
+  signal FlW_n     : std_logic;
+  signal FlRP_n    : std_logic;
+  signal FlRB_b    : std_logic;
+  signal RAMCS_n   : std_logic;
+  signal IDEAdr    : std_logic_vector(2 downto 0);
+  signal IDEDat    : std_logic_vector(15 downto 0);
+  signal IDECS1_n  : std_logic;
+  signal IDECS3_n  : std_logic;
+  signal IDERD_n   : std_logic;
+  signal IDEWR_n   : std_logic;
+  signal IDERst_n  : std_logic;
+  signal Programs  : natural;
+  signal BusyReads : natural;
+  signal Errors    : natural;
+  signal Words     : natural;
+  signal IdeErrors : natural;
+
+begin
+
+  SltClk  <= not SltClk after T_SLTCLK / 2 when not Done;
+  SltClk2 <= not SltClk2 after T_CLK2 / 2 when not Done;
+
+  SltWait_n <= 'H';
+  SltDat <= (others => 'H');
+
+  dut : entity work.mcscc
+    port map(
+      pSltClk => SltClk, pSltRst1_n => SltRst_n, pSltSltsls_n => Slt.Sltsl_n,
+      pSltIorq_n => Slt.Iorq_n, pSltRd_n => Slt.Rd_n, pSltWr_n => Slt.Wr_n,
+      pSltAdr => Slt.Adr, pSltDat => SltDat, pSltBdir_n => open,
+      pSltCs1 => '1', pSltCs2 => '1', pSltCs12 => '1', pSltRfsh_n => '1',
+      pSltWait_n => SltWait_n, pSltInt_n => '1', pSltM1_n => Slt.M1_n,
+      pSltMerq_n => Slt.Merq_n, pSltClk2 => SltClk2, pSltRsv5 => '1', pSltRsv16 => '1',
+      pFlAdr => FlAdr, pFlDat => FlDat, pFlCS_n => FlCS_n, pFlOE_n => FlOE_n,
+      pFlW_n => FlW_n, pFlRP_n => FlRP_n, pFlRB_b => FlRB_b, pFlVpp => open,
+      pRAMCS_n => RAMCS_n,
+      pIDEAdr => IDEAdr, pIDEDat => IDEDat, pIDECS1_n => IDECS1_n, pIDECS3_n => IDECS3_n,
+      pIDERD_n => IDERD_n, pIDEWR_n => IDEWR_n, pPIN180 => open, pIDE_Rst_n => IDERst_n,
+      dac_xsmt => open, dac_lrck => open, dac_din => open, dac_bck => open,
+      dac_sck => open, dac_flt => open, dac_demp => open,
+      adc_md => open, adc_scki => open, adc_bck => open, adc_lrck => open, adc_dout => '0',
+      EECS => open, EECK => open, EEDI => open, EEDO => '1'
+    );
+
+  flash : entity work.flash_model
+    port map(
+      A => FlAdr, DQ => FlDat, CE_n => FlCS_n, OE_n => FlOE_n, WE_n => FlW_n,
+      RP_n => FlRP_n, RB_n => FlRB_b,
+      Programs => Programs, BusyReads => BusyReads, Errors => Errors
+    );
+
+  ide : entity work.ide_model
+    generic map(tCMD => 5 us, tSEC => 2 us, tWR => 10 us)
+    port map(
+      A => IDEAdr, D => IDEDat, CS1_n => IDECS1_n, CS3_n => IDECS3_n,
+      RD_n => IDERD_n, WR_n => IDEWR_n, RST_n => IDERst_n,
+      Words => Words, Errors => IdeErrors
+    );
+
+  process
+    variable res : slot_res_t;
+    variable clocks : natural;
+    variable waits : natural;
+    variable maxw : natural;
+    variable c : natural;
+    variable n : natural;
+
+    procedure wr(adr : natural; dat : natural) is
+    begin
+      slot_cycle(MEM_WR, std_logic_vector(to_unsigned(adr, 16)),
+                 std_logic_vector(to_unsigned(dat, 8)), res, SltClk, Slt, SltDat, SltWait_n);
+      clocks := clocks + res.Clocks;
+      waits := waits + res.Waits;
+      if (res.Waits > maxw) then maxw := res.Waits; end if;
+    end wr;
+
+    procedure rd(adr : natural) is
+    begin
+      slot_cycle(MEM_RD, std_logic_vector(to_unsigned(adr, 16)),
+                 "00000000", res, SltClk, Slt, SltDat, SltWait_n);
+      clocks := clocks + res.Clocks;
+      waits := waits + res.Waits;
+      if (res.Waits > maxw) then maxw := res.Waits; end if;
+    end rd;
+
+    -- IDE_WAITBSY and IDE_WAITDRQ of the driver, the status is left in res
+    procedure wait_bsy is
+    begin
+      n := 0;
+      loop
+        rd(IDECMD);
+        n := n + 1;
+        exit when res.Dat(7) = '0';
+        assert n < 100000 report "IDE busy for ever" severity failure;
+      end loop;
+    end wait_bsy;
+
+    procedure wait_drq is
+    begin
+      wait_bsy;
+      assert res.Dat(3) = '1' and res.Dat(0) = '0'
+        report "no DRQ, status " & hex(res.Dat) severity error;
+    end wait_drq;
+
+    procedure command(cmd : natural; lba : natural; cnt : natural) is
+    begin
+      wait_bsy;
+      wr(16#7E02#, cnt);
+      wr(16#7E03#, lba mod 256);
+      wr(16#7E04#, (lba / 256) mod 256);
+      wr(16#7E05#, (lba / 65536) mod 256);
+      wr(16#7E06#, 16#E0#);
+      wr(IDECMD, cmd);
+    end command;
+
+    -- a sector, at 7C00h-7DFFh (step 1) or at 7C00h only (step 0)
+    procedure read_sector(lba : natural; step : natural) is
+    begin
+      wait_drq;
+      for i in 0 to 511 loop
+        rd(IDEDAT + i * step);
+        assert to_integer(unsigned(res.Dat)) = ide_byte(lba, i)
+          report "LBA " & integer'image(lba) & " byte " & integer'image(i)
+               & ": " & hex(res.Dat) severity error;
+      end loop;
+    end read_sector;
+
+    procedure read_two(name : string; step2 : natural) is
+    begin
+      c := clocks;
+      waits := 0;
+      maxw := 0;
+      command(16#20#, 5, 2);
+      read_sector(5, 1);
+      read_sector(6, step2);
+      wait_bsy;
+      assert res.Dat = x"50" report name & ": status " & hex(res.Dat) severity error;
+      report name & ": 2 sectors in " & integer'image(clocks - c) & " clocks, "
+           & integer'image(waits) & " wait states, at most " & integer'image(maxw);
+    end read_two;
+
+  begin
+    clocks := 0;
+    waits := 0;
+    maxw := 0;
+    wait for 1 us;
+    SltRst_n <= '1';
+    rd(16#0000#);                          -- the first slot access ends the reset
+    wr(16#FFFF#, 16#04#);                  -- subslot 1 at 4000h-7FFFh
+
+    -- 1. without the FIFO
+    wr(CREG, 16#01#);
+    read_two("without the FIFO", 1);
+
+    -- 2. with the FIFO
+    wr(CREG, 16#03#);
+    read_two("with the FIFO", 0);
+
+    -- 3. write through the FIFO, read back without
+    command(16#30#, 9, 1);
+    wait_drq;
+    for i in 0 to 511 loop
+      wr(IDEDAT + i, (i * 3 + 1) mod 256);
+    end loop;
+    wait_bsy;
+    assert res.Dat = x"50" report "write: status " & hex(res.Dat) severity error;
+    wr(CREG, 16#01#);
+    command(16#20#, 9, 1);
+    wait_drq;
+    for i in 0 to 511 loop
+      rd(IDEDAT + i);
+      assert to_integer(unsigned(res.Dat)) = (i * 3 + 1) mod 256
+        report "LBA 9 byte " & integer'image(i) & ": " & hex(res.Dat) severity error;
+    end loop;
+    wait_bsy;
+
+    -- 4. IDENTIFY, the error register goes to the card
+    wr(CREG, 16#03#);
+    command(16#EC#, 0, 1);
+    wait_drq;
+    rd(IDEERR);
+    assert res.Dat = x"00" report "IDENTIFY: error " & hex(res.Dat) severity error;
+    rd(IDEDAT);
+    assert res.Dat = x"8A" report "IDENTIFY: word 0 " & hex(res.Dat) severity error;
+    rd(IDEDAT + 1);
+    assert res.Dat = x"84" report "IDENTIFY: word 0 " & hex(res.Dat) severity error;
+    for i in 1 to 255 loop
+      rd(IDEDAT + 2 * i);
+      assert to_integer(unsigned(res.Dat)) = i report "IDENTIFY: word " & integer'image(i) severity error;
+      rd(IDEDAT + 2 * i + 1);
+      assert res.Dat = x"EC" report "IDENTIFY: word " & integer'image(i) severity error;
+    end loop;
+    wait_bsy;
+    assert res.Dat = x"50" report "IDENTIFY: status " & hex(res.Dat) severity error;
+
+    -- 5. beyond the card
+    command(16#20#, 70, 1);
+    wait_bsy;
+    assert res.Dat(0) = '1' and res.Dat(3) = '0'
+      report "read beyond the card: status " & hex(res.Dat) severity error;
+    rd(IDEERR);
+    assert res.Dat = x"10" report "read beyond the card: error " & hex(res.Dat) severity error;
+
+    assert Errors = 0 report "flash errors: " & integer'image(Errors) severity error;
+    assert IdeErrors = 0 report "IDE errors: " & integer'image(IdeErrors) severity error;
+    report "tb_ide: " & integer'image(Words) & " words, done";
+    Done <= true;
+    wait;
+  end process;
+
+end sim;
@@ -0,0 +1,211 @@
+----------------------------------------------------------------
+--  Title     : tb_opll.vhd
+--  Function  : Bench of the OPLL write FIFO
+----------------------------------------------------------------
+-- The writes go to ports 7Ch/7Dh (Mconf 5b is set at reset) without
+-- any delay, XCtl at 4FB6h is polled until bit 3 is clear:
+--  1. XCtl bit 2 is set, bit 3 clear;
+--  2. the 27 channel registers 10h-18h, 20h-28h, 30h-38h: no wait
+--     state, the time until the last one is taken is reported, 76
+--     clocks a write at least (a slot cycle of the core is 72);
+--  3. the extra registers: F0h = 80h, then 40h-4Fh and C0h-C7h,
+--     156 clocks a write at least (38 slots of the core are 152);
+--  4. 300 writes in a row: the FIFO is full after 255, the Z80
+--     waits, the wait states are reported;
+--  5. 7FF4h/7FF5h in the FM Pack subslot (3) with 7FF6h = 01h go
+--     through the FIFO too.
+----------------------------------------------------------------
+library IEEE;
+use IEEE.std_logic_1164.all;
+use IEEE.numeric_std.all;
+use work.c2sim_pkg.all;
+
+entity tb_opll is
+end tb_opll;
+
+architecture sim of tb_opll is
+
+  constant XCTL    : natural := 16#4F80# + 16#36#;
+
+  signal Done      : boolean := false;
+  signal SltClk    : std_logic := '0';
+  signal SltClk2   : std_logic := '0';
+  signal SltRst_n  : std_logic := '0';
+  signal Slt       : slot_t := SLOT_IDLE;
+  signal SltDat    : std_logic_vector(7 downto 0);
+  signal SltWait_n : std_logic;
+
+  signal FlAdr     : std_logic_vector(22 downto 0);
+  signal FlDat     : std_logic_vector(7 downto 0);
+  signal FlCS_n    : std_logic;
+  signal FlOE_n    : std_logic;
+  signal FlW_n     : std_logic;
+  signal FlRP_n    : std_logic;
+  signal FlRB_b    : std_logic;
+  signal IDEDat    : std_logic_vector(15 downto 0);
+  signal Programs  : natural;
+  signal BusyReads : natural;
+  signal Errors    : natural;
+
+begin
+
+  SltClk  <= not SltClk after T_SLTCLK / 2 when not Done;
+  SltClk2 <= not SltClk2 after T_CLK2 / 2 when not Done;
+
+  SltWait_n <= 'H';
+  SltDat <= (others => 'H');
+
+  dut : entity work.mcscc
+    port map(
+      pSltClk => SltClk, pSltRst1_n => SltRst_n, pSltSltsls_n => Slt.Sltsl_n,
+      pSltIorq_n => Slt.Iorq_n, pSltRd_n => Slt.Rd_n, pSltWr_n => Slt.Wr_n,
+      pSltAdr => Slt.Adr, pSltDat => SltDat, pSltBdir_n => open,
+      pSltCs1 => '1', pSltCs2 => '1', pSltCs12 => '1', pSltRfsh_n => '1',
+      pSltWait_n => SltWait_n, pSltInt_n => '1', pSltM1_n => Slt.M1_n,
+      pSltMerq_n => Slt.Merq_n, pSltClk2 => SltClk2, pSltRsv5 => '1', pSltRsv16 => '1',
+      pFlAdr => FlAdr, pFlDat => FlDat, pFlCS_n => FlCS_n, pFlOE_n => FlOE_n,
+      pFlW_n => FlW_n, pFlRP_n => FlRP_n, pFlRB_b => FlRB_b, pFlVpp => open,
+      pRAMCS_n => open,
+      pIDEAdr => open, pIDEDat => IDEDat, pIDECS1_n => open, pIDECS3_n => open,
+      pIDERD_n => open, pIDEWR_n => open, pPIN180 => open, pIDE_Rst_n => open,
+      dac_xsmt => open, dac_lrck => open, dac_din => open, dac_bck => open,
+      dac_sck => open, dac_flt => open, dac_demp => open,
+      adc_md => open, adc_scki => open, adc_bck => open, adc_lrck => open, adc_dout => '0',
+      EECS => open, EECK => open, EEDI => open, EEDO => '0'
+    );
+
+  flash : entity work.flash_model
+    port map(
+      A => FlAdr, DQ => FlDat, CE_n => FlCS_n, OE_n => FlOE_n, WE_n => FlW_n,
+      RP_n => FlRP_n, RB_n => FlRB_b,
+      Programs => Programs, BusyReads => BusyReads, Errors => Errors
+    );
+
+  process
+    variable res : slot_res_t;
+    variable clocks : natural;
+    variable waits : natural;
+    variable c : natural;
+    variable n : natural;
+
+    procedure wr(adr : natural; dat : natural) is
+    begin
+      slot_cycle(MEM_WR, std_logic_vector(to_unsigned(adr, 16)),
+                 std_logic_vector(to_unsigned(dat, 8)), res, SltClk, Slt, SltDat, SltWait_n);
+      clocks := clocks + res.Clocks;
+      waits := waits + res.Waits;
+    end wr;
+
+    procedure rd(adr : natural) is
+    begin
+      slot_cycle(MEM_RD, std_logic_vector(to_unsigned(adr, 16)),
+                 "00000000", res, SltClk, Slt, SltDat, SltWait_n);
+      clocks := clocks + res.Clocks;
+      waits := waits + res.Waits;
+    end rd;
+
+    procedure out_port(port_n : natural; dat : natural) is
+    begin
+      slot_cycle(IO_WR, std_logic_vector(to_unsigned(port_n, 16)),
+                 std_logic_vector(to_unsigned(dat, 8)), res, SltClk, Slt, SltDat, SltWait_n);
+      clocks := clocks + res.Clocks;
+      waits := waits + res.Waits;
+    end out_port;
+
+    -- a register of the OPLL, no delay
+    procedure opll(reg : natural; dat : natural) is
+    begin
+      out_port(16#7C#, reg);
+      out_port(16#7D#, dat);
+    end opll;
+
+    procedure wait_fifo is
+    begin
+      n := 0;
+      loop
+        rd(XCTL);
+        n := n + 1;
+        exit when res.Dat(3) = '0';
+        assert n < 100000 report "OPLL writes pending for ever" severity failure;
+      end loop;
+    end wait_fifo;
+
+  begin
+    clocks := 0;
+    waits := 0;
+    wait for 1 us;
+    SltRst_n <= '1';
+    rd(16#0000#);                          -- the first slot access ends the reset
+
+    -- 1. status
+    rd(XCTL);
+    assert res.Dat(3 downto 2) = "01" report "XCtl at rest: " & hex(res.Dat) severity error;
+
+    -- 2. channel registers
+    c := clocks;
+    waits := 0;
+    for r in 1 to 3 loop
+      for ch in 0 to 8 loop
+        opll(r * 16 + ch, ch * 16 + r);
+      end loop;
+    end loop;
+    report "27 writes: " & integer'image(clocks - c) & " clocks, "
+         & integer'image(waits) & " wait states";
+    assert waits = 0 report "wait states on the channel registers" severity error;
+    rd(XCTL);
+    assert res.Dat(3) = '1' report "no writes pending after the channel registers" severity error;
+    wait_fifo;
+    report "taken by the core after " & integer'image(clocks - c) & " clocks";
+    assert clocks - c >= 27 * 76 report "channel registers taken too fast" severity error;
+
+    -- 3. extra registers
+    opll(16#F0#, 16#80#);
+    wait_fifo;
+    c := clocks;
+    for r in 16#40# to 16#4F# loop
+      opll(r, r);
+    end loop;
+    for r in 16#C0# to 16#C7# loop
+      opll(r, r);
+    end loop;
+    wait_fifo;
+    report "24 extra registers taken after " & integer'image(clocks - c) & " clocks";
+    assert clocks - c >= 24 * 156 report "extra registers taken too fast" severity error;
+    opll(16#F0#, 16#00#);
+    wait_fifo;
+
+    -- 4. a full FIFO
+    c := clocks;
+    waits := 0;
+    out_port(16#7C#, 16#20#);
+    for i in 0 to 299 loop
+      out_port(16#7D#, i mod 256);
+    end loop;
+    report "300 writes: " & integer'image(clocks - c) & " clocks, "
+         & integer'image(waits) & " wait states";
+    assert waits > 0 report "no wait with the FIFO full" severity error;
+    wait_fifo;
+    report "taken by the core after " & integer'image(clocks - c) & " clocks";
+    assert clocks - c >= 300 * 76 report "writes lost with the FIFO full" severity error;
+
+    -- 5. FM Pack registers
+    wr(16#FFFF#, 16#0C#);                  -- subslot 3 at 4000h-7FFFh
+    wr(16#7FF6#, 16#01#);
+    c := clocks;
+    waits := 0;
+    for ch in 0 to 8 loop
+      wr(16#7FF4#, 16#30# + ch);
+      wr(16#7FF5#, 16#F0#);
+    end loop;
+    assert waits = 0 report "wait states at 7FF5h" severity error;
+    wr(16#FFFF#, 16#00#);
+    wait_fifo;
+    report "9 writes at 7FF5h taken after " & integer'image(clocks - c) & " clocks";
+    assert clocks - c >= 9 * 76 report "writes at 7FF5h lost" severity error;
+
+    report "tb_opll: done";
+    Done <= true;
+    wait;
+  end process;
+
+end sim;
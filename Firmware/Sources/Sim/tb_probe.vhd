@@ -0,0 +1,179 @@
+----------------------------------------------------------------
+--  Title     : tb_probe.vhd
+--  Function  : Bench of the mapper probe
+----------------------------------------------------------------
+--  1. the writes of a Konami SCC style ROM (5000h, 7000h, 9000h,
+--     B000h) and of a few other addresses give the bitmap 0149h
+--     and the counts of each range;
+--  2. nothing is recorded once the probe is off;
+--  3. a reset stops the probe and keeps the data;
+--  4. a clear empties it.
+----------------------------------------------------------------
+library IEEE;
+use IEEE.std_logic_1164.all;
+use IEEE.numeric_std.all;
+use work.c2sim_pkg.all;
+
+entity tb_probe is
+end tb_probe;
+
+architecture sim of tb_probe is
+
+  constant REGS    : natural := 16#4F80#;
+  constant XIDX    : natural := REGS + 16#3E#;
+  constant XDAT    : natural := REGS + 16#3F#;
+
+  signal Done      : boolean := false;
+  signal SltClk    : std_logic := '0';
+  signal SltClk2   : std_logic := '0';
+  signal SltRst_n  : std_logic := '0';
+  signal Slt       : slot_t := SLOT_IDLE;
+  signal SltDat    : std_logic_vector(7 downto 0);
+  signal SltWait_n : std_logic;
+
+  signal FlAdr     : std_logic_vector(22 downto 0);
+  signal FlDat     : std_logic_vector(7 downto 0);
+  signal FlCS_n    : std_logic;
+  signal FlOE_n    : std_logic;
+  signal FlW_n     : std_logic;
+  signal FlRP_n    : std_logic;
+  signal FlRB_b    : std_logic;
+  signal RAMCS_n   : std_logic;
+  signal IDEDat    : std_logic_vector(15 downto 0);
+  signal Programs  : natural;
+  signal BusyReads : natural;
+  signal Errors    : natural;
+  signal RAMWrites : natural;
+  signal RAMErrors : natural;
+
+begin
+
+  SltClk  <= not SltClk after T_SLTCLK / 2 when not Done;
+  SltClk2 <= not SltClk2 after T_CLK2 / 2 when not Done;
+
+  SltWait_n <= 'H';
+  SltDat <= (others => 'H');
+
+  dut : entity work.mcscc
+    port map(
+      pSltClk => SltClk, pSltRst1_n => SltRst_n, pSltSltsls_n => Slt.Sltsl_n,
+      pSltIorq_n => Slt.Iorq_n, pSltRd_n => Slt.Rd_n, pSltWr_n => Slt.Wr_n,
+      pSltAdr => Slt.Adr, pSltDat => SltDat, pSltBdir_n => open,
+      pSltCs1 => '1', pSltCs2 => '1', pSltCs12 => '1', pSltRfsh_n => '1',
+      pSltWait_n => SltWait_n, pSltInt_n => '1', pSltM1_n => Slt.M1_n,
+      pSltMerq_n => Slt.Merq_n, pSltClk2 => SltClk2, pSltRsv5 => '1', pSltRsv16 => '1',
+      pFlAdr => FlAdr, pFlDat => FlDat, pFlCS_n => FlCS_n, pFlOE_n => FlOE_n,
+      pFlW_n => FlW_n, pFlRP_n => FlRP_n, pFlRB_b => FlRB_b, pFlVpp => open,
+      pRAMCS_n => RAMCS_n,
+      pIDEAdr => open, pIDEDat => IDEDat, pIDECS1_n => open, pIDECS3_n => open,
+      pIDERD_n => open, pIDEWR_n => open, pPIN180 => open, pIDE_Rst_n => open,
+      dac_xsmt => open, dac_lrck => open, dac_din => open, dac_bck => open,
+      dac_sck => open, dac_flt => open, dac_demp => open,
+      adc_md => open, adc_scki => open, adc_bck => open, adc_lrck => open, adc_dout => '0',
+      EECS => open, EECK => open, EEDI => open, EEDO => '0'
+    );
+
+  flash : entity work.flash_model
+    port map(
+      A => FlAdr, DQ => FlDat, CE_n => FlCS_n, OE_n => FlOE_n, WE_n => FlW_n,
+      RP_n => FlRP_n, RB_n => FlRB_b,
+      Programs => Programs, BusyReads => BusyReads, Errors => Errors
+    );
+
+  sram : entity work.sram_model
+    port map(
+      A => FlAdr, DQ => FlDat, CE_n => RAMCS_n, OE_n => FlOE_n, WE_n => FlW_n,
+      Writes => RAMWrites, Errors => RAMErrors
+    );
+
+  process
+    variable res : slot_res_t;
+    variable clocks : natural;
+
+    procedure wr(adr : natural; dat : natural) is
+    begin
+      slot_cycle(MEM_WR, std_logic_vector(to_unsigned(adr, 16)),
+                 std_logic_vector(to_unsigned(dat, 8)), res, SltClk, Slt, SltDat, SltWait_n);
+      clocks := clocks + res.Clocks;
+    end wr;
+
+    procedure rd(adr : natural) is
+    begin
+      slot_cycle(MEM_RD, std_logic_vector(to_unsigned(adr, 16)),
+                 "00000000", res, SltClk, Slt, SltDat, SltWait_n);
+      clocks := clocks + res.Clocks;
+    end rd;
+
+    procedure probe(ctl : natural) is
+    begin
+      wr(XIDX, 16#0E#);
+      wr(XDAT, ctl);
+    end probe;
+
+    -- bitmap and counters: expected bitmap, counts for 5000h .. B000h
+    type counts_t is array (0 to 8) of natural;
+    procedure check(map_e : natural; cnt : counts_t; what : string) is
+    begin
+      wr(XIDX, 16#0F#);
+      rd(XDAT);
+      assert to_integer(unsigned(res.Dat)) = map_e mod 256
+        report what & ": bitmap low " & hex(res.Dat) severity error;
+      rd(XDAT);
+      assert to_integer(unsigned(res.Dat)) = map_e / 256
+        report what & ": bitmap high " & hex(res.Dat) severity error;
+      for i in 0 to 8 loop
+        rd(XDAT);
+        assert to_integer(unsigned(res.Dat)) = cnt(i)
+          report what & ": counter " & integer'image(i) & " " & hex(res.Dat) severity error;
+      end loop;
+    end check;
+
+  begin
+    clocks := 0;
+    wait for 1 us;
+    SltRst_n <= '1';
+    rd(16#0000#);                          -- the first slot access ends the reset
+
+    -- 1. Konami SCC
+    probe(16#C0#);                         -- clear and enable
+    wr(16#5000#, 1);
+    wr(16#7000#, 2);
+    wr(16#7000#, 3);
+    wr(16#9000#, 16#3F#);                  -- SCC on
+    wr(16#9800#, 16#00#);                  -- SCC register, not a bank
+    for i in 1 to 300 loop
+      wr(16#B000#, i mod 256);
+    end loop;
+    wr(16#4000#, 0);                       -- not a bank address
+    wr(16#C000#, 0);
+    rd(16#6000#);                          -- reads do not count
+    check(16#0149#, (1, 0, 0, 2, 0, 0, 1, 0, 255), "Konami SCC");
+
+    -- 2. off
+    probe(16#00#);
+    wr(16#6000#, 1);
+    check(16#0149#, (1, 0, 0, 2, 0, 0, 1, 0, 255), "probe off");
+
+    -- 3. reset
+    probe(16#80#);
+    wr(16#6800#, 1);
+    SltRst_n <= '0';
+    wait for 1 us;
+    SltRst_n <= '1';
+    rd(16#0000#);
+    wr(16#6800#, 1);                       -- after the reset: not recorded
+    wr(XIDX, 16#0E#);
+    rd(XDAT);
+    assert res.Dat(7) = '0' report "reset: probe still on" severity error;
+    check(16#014D#, (1, 0, 1, 2, 0, 0, 1, 0, 255), "reset");
+
+    -- 4. clear
+    probe(16#40#);
+    check(0, (0, 0, 0, 0, 0, 0, 0, 0, 0), "clear");
+
+    report "tb_probe: done";
+    Done <= true;
+    wait;
+  end process;
+
+end sim;
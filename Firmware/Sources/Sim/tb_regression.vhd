@@ -0,0 +1,324 @@
+----------------------------------------------------------------
+--  Title     : tb_regression.vhd
+--  Function  : Regression bench of the cartridge as a whole
+----------------------------------------------------------------
+-- All the models on the pins: flash, RAM, EEPROM and CF card. Each
+-- scenario reports the slot cycles, clocks and wait states of its
+-- operations, so that a change of the firmware shows up as a change
+-- of the numbers:
+--  1. register setup: the EEPROM shadow is loaded, the version at
+--     4FACh-4FAEh, the bank 2 registers are written and read back;
+--  2. mapper switching: bank 2 is an 8K RAM page at 8000h with its
+--     register at 7000h, 8 pages are filled and read back;
+--  3. SCC: bank 3Fh at 9000h, the 4 wave memories, frequency,
+--     volume and enable registers, the wave read back;
+--  4. IDE: a sector is read without and with the sector FIFO.
+----------------------------------------------------------------
+library IEEE;
+use IEEE.std_logic_1164.all;
+use IEEE.numeric_std.all;
+use work.c2sim_pkg.all;
+
+entity tb_regression is
+end tb_regression;
+
+architecture sim of tb_regression is
+
+  constant REGS    : natural := 16#4F80#;
+  constant R2MASK  : natural := REGS + 16#0C#;
+  constant R2ADDR  : natural := REGS + 16#0D#;
+  constant R2REG   : natural := REGS + 16#0E#;
+  constant R2MULT  : natural := REGS + 16#0F#;
+  constant B2MASKR : natural := REGS + 16#10#;
+  constant B2ADRD  : natural := REGS + 16#11#;
+  constant VERSION : natural := REGS + 16#2C#;
+  constant XCTL    : natural := REGS + 16#36#;
+  constant XIDX    : natural := REGS + 16#3E#;
+  constant XDAT    : natural := REGS + 16#3F#;
+  constant CREG    : natural := 16#4104#;
+  constant IDEDAT  : natural := 16#7C00#;
+  constant IDECMD  : natural := 16#7E07#;
+
+  signal Done      : boolean := false;
+  signal SltClk    : std_logic := '0';
+  signal SltClk2   : std_logic := '0';
+  signal SltRst_n  : std_logic := '0';
+  signal Slt       : slot_t := SLOT_IDLE;
+  signal SltDat    : std_logic_vector(7 downto 0);
+  signal SltWait_n : std_logic;
+
+  signal FlAdr     : std_logic_vector(22 downto 0);
+  signal FlDat     : std_logic_vector(7 downto 0);
+  signal FlCS_n    : std_logic;
+  signal FlOE_n    : std_logic;
+  signal FlW_n     : std_logic;
+  signal FlRP_n    : std_logic;
+  signal FlRB_b    : std_logic;
+  signal RAMCS_n   : std_logic;
+  signal IDEAdr    : std_logic_vector(2 downto 0);
+  signal IDEDat    : std_logic_vector(15 downto 0);
+  signal IDECS1_n  : std_logic;
+  signal IDECS3_n  : std_logic;
+  signal IDERD_n   : std_logic;
+  signal IDEWR_n   : std_logic;
+  signal IDERst_n  : std_logic;
+  signal EeCS      : std_logic;
+  signal EeCK      : std_logic;
+  signal EeDI      : std_logic;
+  signal EeDO      : std_logic;
+  signal Programs  : natural;
+  signal BusyReads : natural;
+  signal Errors    : natural;
+  signal RAMWrites : natural;
+  signal RAMErrors : natural;
+  signal EeWrites  : natural;
+  signal EeErrors  : natural;
+  signal Words     : natural;
+  signal IdeErrors : natural;
+
+begin
+
+  SltClk  <= not SltClk after T_SLTCLK / 2 when not Done;
+  SltClk2 <= not SltClk2 after T_CLK2 / 2 when not Done;
+
+  SltWait_n <= 'H';
+  SltDat <= (others => 'H');
+
+  dut : entity work.mcscc
+    port map(
+      pSltClk => SltClk, pSltRst1_n => SltRst_n, pSltSltsls_n => Slt.Sltsl_n,
+      pSltIorq_n => Slt.Iorq_n, pSltRd_n => Slt.Rd_n, pSltWr_n => Slt.Wr_n,
+      pSltAdr => Slt.Adr, pSltDat => SltDat, pSltBdir_n => open,
+      pSltCs1 => '1', pSltCs2 => '1', pSltCs12 => '1', pSltRfsh_n => '1',
+      pSltWait_n => SltWait_n, pSltInt_n => '1', pSltM1_n => Slt.M1_n,
+      pSltMerq_n => Slt.Merq_n, pSltClk2 => SltClk2, pSltRsv5 => '1', pSltRsv16 => '1',
+      pFlAdr => FlAdr, pFlDat => FlDat, pFlCS_n => FlCS_n, pFlOE_n => FlOE_n,
+      pFlW_n => FlW_n, pFlRP_n => FlRP_n, pFlRB_b => FlRB_b, pFlVpp => open,
+      pRAMCS_n => RAMCS_n,
+      pIDEAdr => IDEAdr, pIDEDat => IDEDat, pIDECS1_n => IDECS1_n, pIDECS3_n => IDECS3_n,
+      pIDERD_n => IDERD_n, pIDEWR_n => IDEWR_n, pPIN180 => open, pIDE_Rst_n => IDERst_n,
+      dac_xsmt => open, dac_lrck => open, dac_din => open, dac_bck => open,
+      dac_sck => open, dac_flt => open, dac_demp => open,
+      adc_md => open, adc_scki => open, adc_bck => open, adc_lrck => open, adc_dout => '0',
+      EECS => EeCS, EECK => EeCK, EEDI => EeDI, EEDO => EeDO
+    );
+
+  flash : entity work.flash_model
+    port map(
+      A => FlAdr, DQ => FlDat, CE_n => FlCS_n, OE_n => FlOE_n, WE_n => FlW_n,
+      RP_n => FlRP_n, RB_n => FlRB_b,
+      Programs => Programs, BusyReads => BusyReads, Errors => Errors
+    );
+
+  sram : entity work.sram_model
+    port map(
+      A => FlAdr, DQ => FlDat, CE_n => RAMCS_n, OE_n => FlOE_n, WE_n => FlW_n,
+      Writes => RAMWrites, Errors => RAMErrors
+    );
+
+  eeprom : entity work.eeprom_model
+    port map(
+      CS => EeCS, SK => EeCK, DI => EeDI, DO => EeDO,
+      Writes => EeWrites, Errors => EeErrors
+    );
+
+  ide : entity work.ide_model
+    generic map(tCMD => 5 us)
+    port map(
+      A => IDEAdr, D => IDEDat, CS1_n => IDECS1_n, CS3_n => IDECS3_n,
+      RD_n => IDERD_n, WR_n => IDEWR_n, RST_n => IDERst_n,
+      Words => Words, Errors => IdeErrors
+    );
+
+  process
+    variable res : slot_res_t;
+    variable cycles : natural;
+    variable clocks : natural;
+    variable waits : natural;
+    variable maxw : natural;
+    variable n : natural;
+
+    procedure wr(adr : natural; dat : natural) is
+    begin
+      slot_cycle(MEM_WR, std_logic_vector(to_unsigned(adr, 16)),
+                 std_logic_vector(to_unsigned(dat, 8)), res, SltClk, Slt, SltDat, SltWait_n);
+      cycles := cycles + 1;
+      clocks := clocks + res.Clocks;
+      waits := waits + res.Waits;
+      if (res.Waits > maxw) then maxw := res.Waits; end if;
+    end wr;
+
+    procedure rd(adr : natural) is
+    begin
+      slot_cycle(MEM_RD, std_logic_vector(to_unsigned(adr, 16)),
+                 "00000000", res, SltClk, Slt, SltDat, SltWait_n);
+      cycles := cycles + 1;
+      clocks := clocks + res.Clocks;
+      waits := waits + res.Waits;
+      if (res.Waits > maxw) then maxw := res.Waits; end if;
+    end rd;
+
+    procedure check(adr : natural; dat : natural; what : string) is
+    begin
+      rd(adr);
+      assert to_integer(unsigned(res.Dat)) = dat
+        report what & ": " & hex(res.Dat) & " at " & hex(std_logic_vector(to_unsigned(adr, 16)))
+             & ", not " & hex(std_logic_vector(to_unsigned(dat, 8))) severity error;
+    end check;
+
+    -- start and end of an operation
+    procedure start is
+    begin
+      cycles := 0;
+      clocks := 0;
+      waits := 0;
+      maxw := 0;
+    end start;
+
+    procedure op(name : string) is
+    begin
+      report name & ": " & integer'image(cycles) & " cycles, " & integer'image(clocks)
+           & " clocks, " & integer'image(waits) & " wait states, at most " & integer'image(maxw);
+    end op;
+
+    procedure wait_bsy is
+    begin
+      n := 0;
+      loop
+        rd(IDECMD);
+        n := n + 1;
+        exit when res.Dat(7) = '0';
+        assert n < 100000 report "IDE busy for ever" severity failure;
+      end loop;
+    end wait_bsy;
+
+    procedure read_sector(lba : natural) is
+    begin
+      wr(16#7E02#, 1);
+      wr(16#7E03#, lba);
+      wr(16#7E04#, 0);
+      wr(16#7E05#, 0);
+      wr(16#7E06#, 16#E0#);
+      wr(IDECMD, 16#20#);
+      wait_bsy;
+      assert res.Dat(3) = '1' report "no DRQ, status " & hex(res.Dat) severity error;
+      for i in 0 to 511 loop
+        check(IDEDAT + i, ide_byte(lba, i), "IDE");
+      end loop;
+      wait_bsy;
+    end read_sector;
+
+  begin
+    wait for 1 us;
+    SltRst_n <= '1';
+    start;
+    rd(16#0000#);                          -- the first slot access ends the reset
+
+    -- 1. register setup
+    start;
+    n := 0;
+    loop
+      rd(XCTL);
+      n := n + 1;
+      exit when res.Dat(1) = '0';
+      assert n < 100000 report "EEPROM busy for ever" severity failure;
+    end loop;
+    op("EEPROM load, XCtl polled");
+    start;
+    wr(XIDX, 16#80#);
+    for i in 0 to 7 loop
+      check(XDAT, (i * 29 + 7) mod 256, "EEPROM shadow");
+    end loop;
+    op("8 bytes of the EEPROM shadow");
+    start;
+    check(VERSION, 16#32#, "version");
+    check(VERSION + 1, 16#36#, "version");
+    check(VERSION + 2, 16#30#, "version");
+    op("version");
+    start;
+    wr(R2MASK, 16#F8#);                    -- 7000h-77FFh
+    wr(R2ADDR, 16#70#);
+    wr(R2REG,  16#00#);
+    wr(B2MASKR, 16#07#);
+    wr(B2ADRD, 16#80#);
+    wr(R2MULT, 16#B4#);                    -- RAM, writes enabled, 8K
+    op("bank 2 set up");
+    start;
+    check(R2MASK, 16#F8#, "R2Mask");
+    check(R2ADDR, 16#70#, "R2Addr");
+    check(R2MULT, 16#B4#, "R2Mult");
+    check(B2MASKR, 16#07#, "B2MaskR");
+    check(B2ADRD, 16#80#, "B2AdrD");
+    op("bank 2 read back");
+
+    -- 2. mapper switching
+    start;
+    for p in 0 to 7 loop
+      wr(16#7000#, p);
+      for i in 0 to 15 loop
+        wr(16#8000# + i * 256, p * 16 + i);
+      end loop;
+    end loop;
+    op("8 pages written");
+    start;
+    for p in 7 downto 0 loop
+      wr(16#7000#, p);
+    end loop;
+    op("8 page switches");
+    start;
+    for p in 0 to 7 loop
+      wr(16#7000#, p);
+      for i in 0 to 15 loop
+        check(16#8000# + i * 256, p * 16 + i, "page " & integer'image(p));
+      end loop;
+    end loop;
+    op("8 pages read back");
+    wr(R2MULT, 16#00#);
+
+    -- 3. SCC
+    start;
+    wr(16#9000#, 16#3F#);
+    op("SCC on");
+    start;
+    for i in 0 to 127 loop
+      wr(16#9800# + i, (i * 7 + 3) mod 256);
+    end loop;
+    op("SCC wave, 4 x 32 bytes");
+    start;
+    for c in 0 to 4 loop
+      wr(16#9880# + c * 2, 16#FE#);        -- frequency
+      wr(16#9881# + c * 2, 16#01#);
+      wr(16#988A# + c, 16#0F#);            -- volume
+    end loop;
+    wr(16#988F#, 16#1F#);                  -- channels on
+    op("SCC registers");
+    start;
+    for i in 0 to 127 loop
+      check(16#9800# + i, (i * 7 + 3) mod 256, "SCC wave");
+    end loop;
+    op("SCC wave read back");
+
+    -- 4. IDE
+    wr(16#FFFF#, 16#04#);                  -- subslot 1 at 4000h-7FFFh
+    wr(CREG, 16#01#);
+    start;
+    read_sector(3);
+    op("IDE sector without the FIFO");
+    wr(CREG, 16#03#);
+    start;
+    read_sector(4);
+    op("IDE sector with the FIFO");
+    wr(CREG, 16#00#);
+    wr(16#FFFF#, 16#00#);
+
+    assert Errors = 0 report "flash errors: " & integer'image(Errors) severity error;
+    assert RAMErrors = 0 report "RAM errors: " & integer'image(RAMErrors) severity error;
+    assert EeErrors = 0 report "EEPROM errors: " & integer'image(EeErrors) severity error;
+    assert IdeErrors = 0 report "IDE errors: " & integer'image(IdeErrors) severity error;
+    report "tb_regression: " & integer'image(RAMWrites) & " RAM writes, "
+         & integer'image(Words) & " IDE words, done";
+    Done <= true;
+    wait;
+  end process;
+
+end sim;
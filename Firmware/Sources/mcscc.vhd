@@ -1,6 +1,6 @@
 
 ----------------------------------------------------------------
--- v2.50.0003
+-- v2.60.0001
 ----------------------------------------------------------------
 library IEEE;
 use IEEE.std_logic_1164.all;
@@ -173,6 +173,16 @@ architecture RTL of mcscc is
       PsgRegWe  : IN std_logic
     );
   end component;
+
+  component ram
+    port(
+      address  : IN  std_logic_vector(7 downto 0);
+      inclock  : IN  std_logic;
+      we       : IN  std_logic;
+      data     : IN  std_logic_vector(7 downto 0);
+      q        : OUT std_logic_vector(7 downto 0)
+    );
+  end component;
   
   
   signal pSltClk_n   : std_logic;
@@ -264,9 +274,125 @@ architecture RTL of mcscc is
   signal aR4Mult      : std_logic_vector(7 downto 0);
   signal aB4MaskR     : std_logic_vector(7 downto 0);
   signal aB4AdrD      : std_logic_vector(7 downto 0);
+-- Block base of each bank, added to AddrFR
+  signal B1Base      : std_logic_vector(6 downto 0);
+  signal B2Base      : std_logic_vector(6 downto 0);
+  signal B3Base      : std_logic_vector(6 downto 0);
+  signal B4Base      : std_logic_vector(6 downto 0);
+  signal aB1Base     : std_logic_vector(6 downto 0);
+  signal aB2Base     : std_logic_vector(6 downto 0);
+  signal aB3Base     : std_logic_vector(6 downto 0);
+  signal aB4Base     : std_logic_vector(6 downto 0);
+  signal MBase       : std_logic_vector(6 downto 0);
+-- Bank presets
+  signal BkW		 : std_logic;
+  signal BkD		 : std_logic_vector(7 downto 0);
+  signal BkOp		 : std_logic_vector(1 downto 0);
+  signal BkCm		 : std_logic;
+  signal BkCmt		 : std_logic;
+  signal BkN		 : std_logic_vector(2 downto 0);
+  signal BkI		 : std_logic_vector(4 downto 0);
+  signal BkBsy		 : std_logic;
+  signal BkWait_n	 : std_logic;
+  signal BkRA		 : std_logic_vector(7 downto 0);
+  signal BkWe		 : std_logic;
+  signal BkWD		 : std_logic_vector(7 downto 0);
+  signal BkQ		 : std_logic_vector(7 downto 0);
 
  
-  signal ConfFl		 : std_logic_vector(2 downto 0);
+  signal ConfFl		 : std_logic_vector(4 downto 0);
+-- Flash ready/busy
+  signal FlRBs		 : std_logic_vector(1 downto 0);
+  signal FlRdy		 : std_logic;
+  signal FlWe		 : std_logic;
+  signal FlWrA		 : std_logic;
+  signal FlWrD		 : std_logic_vector(7 downto 0);
+  signal FlPrg		 : std_logic;
+  signal FlSeq		 : std_logic_vector(1 downto 0);
+  signal FlBusy		 : std_logic;
+  signal FlBusyC	 : std_logic_vector(10 downto 0);
+  signal FlWait_n	 : std_logic;
+-- Flash auto-program
+  signal FlAdrC		 : std_logic_vector(22 downto 0);
+  signal FlWrAd		 : std_logic_vector(22 downto 0);
+  signal ApBusy		 : std_logic;
+  signal ApReq		 : std_logic;
+  signal ApReqS		 : std_logic_vector(1 downto 0);
+  signal ApAck		 : std_logic;
+  signal ApAckS		 : std_logic_vector(1 downto 0);
+  signal ApRun		 : std_logic;
+  signal ApCnt		 : std_logic_vector(3 downto 0);
+  signal ApWe_n		 : std_logic;
+  signal ApAdr		 : std_logic_vector(22 downto 0);
+  signal ApDat		 : std_logic_vector(7 downto 0);
+-- Extended registers (index 4FBE, data 4FBF)
+  signal XIdx		 : std_logic_vector(7 downto 0);
+  signal XAcc		 : std_logic;
+  signal XRd		 : std_logic_vector(7 downto 0);
+-- Copy engine
+  signal CeSrc		 : std_logic_vector(23 downto 0);
+  signal CeDst		 : std_logic_vector(23 downto 0);
+  signal CeLen		 : std_logic_vector(23 downto 0);
+  signal CeReq		 : std_logic;
+  signal CeReqS		 : std_logic_vector(1 downto 0);
+  signal CeAck		 : std_logic;
+  signal CeAckS		 : std_logic_vector(1 downto 0);
+  signal CeBusy		 : std_logic;
+  signal CeRun		 : std_logic;
+  signal CeOwn		 : std_logic;
+  signal CeCnt		 : std_logic_vector(3 downto 0);
+  signal CeSa		 : std_logic_vector(23 downto 0);
+  signal CeDa		 : std_logic_vector(22 downto 0);
+  signal CeLn		 : std_logic_vector(23 downto 0);
+  signal CeDat		 : std_logic_vector(7 downto 0);
+  signal CeAdr		 : std_logic_vector(22 downto 0);
+  signal CeFlCS_n	 : std_logic;
+  signal CeRAMCS_n	 : std_logic;
+  signal CeOE_n		 : std_logic;
+  signal CeWe_n		 : std_logic;
+  signal CeDrv		 : std_logic;
+  signal ZReq		 : std_logic;
+  signal ZReqS		 : std_logic_vector(1 downto 0);
+  signal XCtlW		 : std_logic;
+  signal XCtlD		 : std_logic_vector(2 downto 0);
+  signal CeScan		 : std_logic;
+  signal CeSc		 : std_logic;
+  signal CeCrc		 : std_logic;
+-- CRC32
+  signal Crc		 : std_logic_vector(31 downto 0);
+  signal CrcCtl		 : std_logic_vector(7 downto 0);
+  signal CrcClr		 : std_logic;
+  signal CrcClrS	 : std_logic_vector(1 downto 0);
+  signal CrcClrA	 : std_logic;
+  signal CrcSnR		 : std_logic;
+  signal CrcSnD		 : std_logic_vector(7 downto 0);
+  signal CrcSn		 : std_logic;
+  signal CrcSnS		 : std_logic_vector(1 downto 0);
+  signal CrcSnA		 : std_logic;
+-- Mapper probe
+  type prb_cnt_t is array (0 to 8) of std_logic_vector(7 downto 0);
+  signal PrbEn		 : std_logic;
+  signal PrbW		 : std_logic;
+  signal PrbAdr		 : std_logic_vector(4 downto 0);
+  signal PrbN		 : integer range 0 to 15;
+  signal PrbMap		 : std_logic_vector(8 downto 0) := "000000000";
+  signal PrbCnt		 : prb_cnt_t := (others => "00000000");
+
+  -- CRC-32 (IEEE 802.3, reflected) of one more byte
+  function crc32(c : std_logic_vector(31 downto 0); d : std_logic_vector(7 downto 0))
+           return std_logic_vector is
+    variable r : std_logic_vector(31 downto 0);
+  begin
+    r := c;
+    for i in 0 to 7 loop
+      if ((r(0) xor d(i)) = '1') then
+        r := ('0' & r(31 downto 1)) xor "11101101101110001000001100100000";
+      else
+        r := '0' & r(31 downto 1);
+      end if;
+    end loop;
+    return r;
+  end crc32;
   
   signal DecMDR      : std_logic;
   signal DirFlW      : std_logic; 
@@ -277,6 +403,7 @@ architecture RTL of mcscc is
   signal MR4A		 : std_logic_vector(3 downto 0);
   signal pFlOE_nt    : std_logic;
   signal pFlCS_nt	 : std_logic;
+  signal CartWe		 : std_logic;
   signal pRAMCS_nt	 : std_logic;
   signal RloadEn     : std_logic;
 -- Expend Slot signals  
@@ -322,6 +449,50 @@ architecture RTL of mcscc is
   signal IDEROMADDR    : std_logic_vector(16 downto 0);
   signal Rdh_n		: std_logic;
   signal Wrh_n		: std_logic;
+-- IDE sector FIFO
+  signal IdMd		: std_logic_vector(1 downto 0);
+  signal IdSt		: std_logic_vector(2 downto 0);
+  signal IdT		: std_logic_vector(4 downto 0);
+  signal IdWc		: std_logic_vector(8 downto 0);
+  signal IdWp		: std_logic_vector(9 downto 0);
+  signal IdRp		: std_logic_vector(9 downto 0);
+  signal IdN		: std_logic_vector(9 downto 0);
+  signal IdQ		: std_logic_vector(7 downto 0);
+  signal IdQv		: std_logic;
+  signal IdPl		: std_logic_vector(1 downto 0);
+  signal IdFe		: std_logic_vector(1 downto 0);
+  signal IdEs		: std_logic;
+  signal IdDv		: std_logic;
+  signal IdDi		: std_logic_vector(15 downto 0);
+  signal IdDo		: std_logic_vector(15 downto 0);
+  signal IdSta		: std_logic_vector(7 downto 0);
+  signal IdBsy		: std_logic;
+  signal IdOwn		: std_logic;
+  signal IdGate		: std_logic;
+  signal IdAS		: std_logic;
+  signal IdDrv		: std_logic;
+  signal IdRd_n		: std_logic;
+  signal IdWr_n		: std_logic;
+  signal IdSR		: std_logic;
+  signal IdVirt		: std_logic;
+  signal IdZr		: std_logic;
+  signal IdZw		: std_logic;
+  signal IdZc		: std_logic;
+  signal IdZo		: std_logic;
+  signal IdZrS		: std_logic_vector(2 downto 0);
+  signal IdZwS		: std_logic_vector(1 downto 0);
+  signal IdZwT		: std_logic;
+  signal IdZcS		: std_logic_vector(2 downto 0);
+  signal IdZoS		: std_logic_vector(1 downto 0);
+  signal IdDat		: std_logic_vector(7 downto 0);
+  signal IdWait_n	: std_logic;
+  signal IdRA		: std_logic_vector(7 downto 0);
+  signal IdLWe		: std_logic;
+  signal IdHWe		: std_logic;
+  signal IdLD		: std_logic_vector(7 downto 0);
+  signal IdHD		: std_logic_vector(7 downto 0);
+  signal IdLQ		: std_logic_vector(7 downto 0);
+  signal IdHQ		: std_logic_vector(7 downto 0);
   
 -- MAPPER RAM
 
@@ -345,6 +516,7 @@ architecture RTL of mcscc is
   signal pYM2413_Cs_n     : std_logic;
   signal pYM2413_We_n     : std_logic;
   signal pYM2413_A		: std_logic;
+  signal pYM2413_D		: std_logic_vector(7 downto 0);
 --  signal mo     : std_logic_vector(9 downto 0);
 --  signal ro     : std_logic_vector(9 downto 0);
   signal mix	: std_logic_vector(10 downto 0);
@@ -355,6 +527,25 @@ architecture RTL of mcscc is
   signal R7FF7	:std_logic_vector(1 downto 0);
   signal R5FFE	:std_logic_vector(7 downto 0);
   signal R5FFF	:std_logic_vector(7 downto 0);  
+-- OPLL write FIFO
+  signal OfSel		: std_logic;
+  signal OfZw		: std_logic;
+  signal OfZa		: std_logic;
+  signal OfZd		: std_logic_vector(7 downto 0);
+  signal OfPtr		: std_logic_vector(7 downto 0);
+  signal OfWp		: std_logic_vector(7 downto 0);
+  signal OfRp		: std_logic_vector(7 downto 0);
+  signal OfRA		: std_logic_vector(7 downto 0);
+  signal OfWe		: std_logic;
+  signal OfPQ		: std_logic_vector(7 downto 0);
+  signal OfDQ		: std_logic_vector(7 downto 0);
+  signal OfP		: std_logic_vector(7 downto 0);
+  signal OfD		: std_logic_vector(7 downto 0);
+  signal OfSt		: std_logic_vector(2 downto 0);
+  signal OfT		: std_logic_vector(7 downto 0);
+  signal OfFull		: std_logic;
+  signal OfBsy		: std_logic;
+  signal OfWait_n	: std_logic;
   
   
 --  PLL
@@ -425,6 +616,41 @@ architecture RTL of mcscc is
   signal EECS1 : std_logic;
   signal EECK1 : std_logic;
   signal EEDI1 : std_logic;
+  signal EeCSo : std_logic;
+  signal EeCKo : std_logic;
+  signal EeDIo : std_logic;
+-- EEPROM serializer
+  signal EeLd  : std_logic;
+  signal EePs  : std_logic;
+  signal EeWr  : std_logic;
+  signal EeWq  : std_logic;
+  signal EeBusy : std_logic;
+  signal EeA   : std_logic_vector(6 downto 0);
+  signal EeWA  : std_logic_vector(6 downto 0);
+  signal EeWD  : std_logic_vector(7 downto 0);
+  signal EeStp : std_logic_vector(1 downto 0);
+  signal EePh  : std_logic_vector(2 downto 0);
+  signal EeBit : std_logic_vector(4 downto 0);
+  signal EeLen : std_logic_vector(4 downto 0);
+  signal EeSh  : std_logic_vector(17 downto 0);
+  signal EeTo  : std_logic_vector(12 downto 0);
+  signal EeCS  : std_logic;
+  signal EeCK  : std_logic;
+  signal EeDI  : std_logic;
+-- EEPROM shadow
+  signal EeCKp : std_logic;
+  signal EeDOl : std_logic;
+  signal EeDs  : std_logic;
+  signal EeDe  : std_logic;
+  signal EeDn  : std_logic_vector(4 downto 0);
+  signal EeDr  : std_logic_vector(17 downto 0);
+  signal EeDq  : std_logic_vector(7 downto 0);
+  signal EeWen : std_logic := '0';
+  signal EeRWe : std_logic;
+  signal EeRWA : std_logic_vector(6 downto 0);
+  signal EeRDat : std_logic_vector(7 downto 0);
+  signal EeRAdr : std_logic_vector(7 downto 0);
+  signal EeRQ  : std_logic_vector(7 downto 0);
 -- PSG
   signal PsgRegPtr   : std_logic_vector(3 downto 0);
   signal PsgRegWe    : std_logic;
@@ -594,6 +820,7 @@ begin
   -- Second Cartrige Data
   				    else pFlDat   when DecSCARD = '1' and pSltRd_n = '0'
   -- IDE Register 
+					else IdDat when IdVirt = '1' and pSltRd_n = '0'
  					else IDEsIN      		 when IDEReg = '1' and pSltAdr(9) = '0' and pSltAdr(0) = '1'
 											      and pSltRd_n = '0'
 					else pIDEDat(7 downto 0) when IDEReg = '1' and (pSltAdr(0) = '0' or pSltAdr(9) = '1') 
@@ -669,7 +896,7 @@ begin
 			
 			else aMconf when DecMDR = '1' and CardMDR(0) = '0' and pSltAdr(5 downto 0) = "011110"
 			else CardMDR when DecMDR = '1' and CardMDR(0) = '0' and pSltAdr(5 downto 0) = "011111"
-			else "00000"&ConfFl when DecMDR = '1' and CardMDR(0) = '0' and pSltAdr(5 downto 0) = "100000"
+			else FlRdy&"00"&ConfFl when DecMDR = '1' and CardMDR(0) = '0' and pSltAdr(5 downto 0) = "100000"
 			else aNSReg  when DecMDR = '1' and CardMDR(0) = '0' and pSltAdr(5 downto 0) = "100001"
 			else LVL  when DecMDR = '1' and CardMDR(0) = '0' and pSltAdr(5 downto 0) = "100010"
 			else "0000" & EECS1 & EECK1 & EEDI1 & EEDO 
@@ -684,7 +911,7 @@ begin
 			else aSCART_StBl when DecMDR = '1' and CardMDR(0) = '0' and pSltAdr(5 downto 0) = "101011"
 
 			else "00110010" when DecMDR = '1' and CardMDR(0) = '0' and pSltAdr(5 downto 0) = "101100" -- 2C - 32
-			else "00110101" when DecMDR = '1' and CardMDR(0) = '0' and pSltAdr(5 downto 0) = "101101" -- 2D - 35
+			else "00110110" when DecMDR = '1' and CardMDR(0) = '0' and pSltAdr(5 downto 0) = "101101" -- 2D - 36
 			else "00110000" when DecMDR = '1' and CardMDR(0) = '0' and pSltAdr(5 downto 0) = "101110" -- 2E	- 30
 			else "00000"&SCRT_mRr when DecMDR = '1' and CardMDR(0) = '0' and pSltAdr(5 downto 0) = "101111"
 					
@@ -699,6 +926,14 @@ begin
 			else SLT_3_save when DecMDR = '1' and CardMDR(0) = '0' and pSltAdr(5 downto 0) = "110011"	
 			else A8_save    when DecMDR = '1' and CardMDR(0) = '0' and pSltAdr(5 downto 0) = "110100"
 			else "111100"&PFXN when	DecMDR = '1' and CardMDR(0) = '0' and pSltAdr(5 downto 0) = "110101"	
+			else BkBsy&"0000"&BkN when DecMDR = '1' and CardMDR(0) = '0' and pSltAdr(5 downto 0) = "100101"
+			else "0"&aB1Base when DecMDR = '1' and CardMDR(0) = '0' and pSltAdr(5 downto 0) = "110111"
+			else "0"&aB2Base when DecMDR = '1' and CardMDR(0) = '0' and pSltAdr(5 downto 0) = "111000"
+			else "0"&aB3Base when DecMDR = '1' and CardMDR(0) = '0' and pSltAdr(5 downto 0) = "111001"
+			else "0"&aB4Base when DecMDR = '1' and CardMDR(0) = '0' and pSltAdr(5 downto 0) = "111010"
+			else "0000"&OfBsy&'1'&EeBusy&CeBusy when DecMDR = '1' and CardMDR(0) = '0' and pSltAdr(5 downto 0) = "110110"
+			else XIdx when DecMDR = '1' and CardMDR(0) = '0' and pSltAdr(5 downto 0) = "111110"
+			else XRd  when DecMDR = '1' and CardMDR(0) = '0' and pSltAdr(5 downto 0) = "111111"
 --	        
 --CIV            else V_RA(7 downto 0) when V_active = "10"
 --CIV            else V_RA(15 downto 8) when V_active = "01"  				   					
@@ -815,10 +1050,15 @@ begin
                                -- 2b - select activate bank configurations 0=of start/jmp0/rst0 1= read(400Xh)
                                -- 1b - Shadow BIOS ( to RAM )
                                -- 0b - Disable read direct card vector port and card configuration register (4F80..)  
-         ConfFl    <= "010";    
+         ConfFl    <= "00010";  -- 7b - (read) flash ready: RY/BY# high and no program in progress
+                               -- 4b - auto-program: a flash write is a program (implies 3b)
+                               -- 3b - wait for the flash to be ready on the next cartridge access
+                               -- 1b - flash RP#, 0b - flash Vpp
          AddrM0	<= "00000000";
          AddrM1 <= "00000000";
          AddrM2 <= "0000000";
+         B1Base <= "0000000"; B2Base <= "0000000"; B3Base <= "0000000"; B4Base <= "0000000";
+         aB1Base <= "0000000"; aB2Base <= "0000000"; aB3Base <= "0000000"; aB4Base <= "0000000";
          AddrFR    <= "0000000";  -- shift  addr Flash Rom x 64
          aAddrFR    <= "0000000";
          R1Mult    <= "10000101"; -- 7b - enable page register bank 1
@@ -880,6 +1120,8 @@ begin
          SCART_StBl <= "00000000"; aSCART_StBl <= "00000000";--"00001101"; -- "00000000";
 --- port #F0
          PF0_RV <= "00";
+         BkW <= '0'; BkD <= "00000000"; BkOp <= "00"; BkCm <= '0'; BkCmt <= '0';
+         BkN <= "000"; BkI <= "00000";
        
     elsif (pSltClk_n'event and pSltClk_n = '1') then
           -- Port #F0 decription
@@ -935,7 +1177,7 @@ begin
         if (pSltAdr(5 downto 0) = "011110" and (pSltDat(7) = '1' or pSltDat(3 downto 0) /= "1111" )) then aMconf    <= pSltDat ; end if;
         if (pSltAdr(5 downto 0) = "011111") then CardMDR <= pSltDat ; end if;
  ---------------------------------------------------------------------------------------       
-        if (pSltAdr(5 downto 0) = "100000") then ConfFl  <= pSltDat(2 downto 0); end if;
+        if (pSltAdr(5 downto 0) = "100000") then ConfFl  <= pSltDat(4 downto 0); end if;
         if (pSltAdr(5 downto 0) = "100001") then aNSReg  <= pSltDat(7 downto 0); end if;
         if (pSltAdr(5 downto 0) = "100010") then LVL     <= pSltDat(7 downto 0); end if;
         if (pSltAdr(5 downto 0) = "100011") then EECS1 <= pSltDat(3);
@@ -952,15 +1194,84 @@ begin
         if (pSltAdr(5 downto 0) = "101111") then SCRT_mRr <=pSltDat(2 downto 0); end if;
         if (pSltAdr(5 downto 0) = "110000") then PsgAlt <= pSltDat (1 downto 0); end if;            
         if (pSltAdr(5 downto 0) = "110101") then PFXN <= pSltDat (1 downto 0); end if; 
+        if (pSltAdr(5 downto 0) = "110111") then aB1Base <= pSltDat(6 downto 0); end if;
+        if (pSltAdr(5 downto 0) = "111000") then aB2Base <= pSltDat(6 downto 0); end if;
+        if (pSltAdr(5 downto 0) = "111001") then aB3Base <= pSltDat(6 downto 0); end if;
+        if (pSltAdr(5 downto 0) = "111010") then aB4Base <= pSltDat(6 downto 0); end if;
       end if;
  -- V_hunt off
 --CIV      if V_active = "11" then
 --CIV        aV_hunt <= '0'; V_hunt <='0';
 --CIV      end if;
- -- delayed reconfiguration
-     if RloadEn = '1' then
+ -- bank presets (4FA5)
+      BkCmt <= '0';
+      if (DecMDR = '1' and pSltAdr(5 downto 0) = "100101" and pSltWr_n = '0') then
+        BkW <= '1';
+        BkD <= pSltDat;
+      elsif (BkW = '1') then                   -- end of the write
+        BkW <= '0';
+        if (BkOp = "00") then
+          BkN <= BkD(2 downto 0);
+          BkI <= "00000";
+          if (BkD(6) = '1') then
+            BkOp <= "01";
+          elsif (BkD(5) = '1') then
+            BkOp <= "10";
+            BkCm <= BkD(7);
+          else
+            BkCmt <= BkD(7);
+          end if;
+        end if;
+      elsif (BkOp /= "00") then
+        BkI <= BkI + "00001";
+        if (BkOp = "10") then                  -- the RAM gives byte BkI-1
+          case BkI is
+            when "00001" => aAddrFR  <= BkQ(6 downto 0);
+            when "00010" => aR1Mask  <= BkQ;
+            when "00011" => aR1Addr  <= BkQ;
+            when "00100" => aR1Reg   <= BkQ;
+            when "00101" => aR1Mult  <= BkQ;
+            when "00110" => aB1MaskR <= BkQ;
+            when "00111" => aB1AdrD  <= BkQ;
+            when "01000" => aR2Mask  <= BkQ;
+            when "01001" => aR2Addr  <= BkQ;
+            when "01010" => aR2Reg   <= BkQ;
+            when "01011" => aR2Mult  <= BkQ;
+            when "01100" => aB2MaskR <= BkQ;
+            when "01101" => aB2AdrD  <= BkQ;
+            when "01110" => aR3Mask  <= BkQ;
+            when "01111" => aR3Addr  <= BkQ;
+            when "10000" => aR3Reg   <= BkQ;
+            when "10001" => aR3Mult  <= BkQ;
+            when "10010" => aB3MaskR <= BkQ;
+            when "10011" => aB3AdrD  <= BkQ;
+            when "10100" => aR4Mask  <= BkQ;
+            when "10101" => aR4Addr  <= BkQ;
+            when "10110" => aR4Reg   <= BkQ;
+            when "10111" => aR4Mult  <= BkQ;
+            when "11000" => aB4MaskR <= BkQ;
+            when "11001" => aB4AdrD  <= BkQ;
+            when "11010" => aB1Base  <= BkQ(6 downto 0);
+            when "11011" => aB2Base  <= BkQ(6 downto 0);
+            when "11100" => aB3Base  <= BkQ(6 downto 0);
+            when "11101" => aB4Base  <= BkQ(6 downto 0);
+            when others  => null;
+          end case;
+        end if;
+        if ((BkOp = "01" and BkI = "11100") or BkI = "11101") then
+          BkOp  <= "00";
+          BkCmt <= BkCm or (BkOp(1) and not CardMDR(3));
+          BkCm  <= '0';
+        end if;
+      end if;
+ -- delayed reconfiguration (not while a preset is loaded) or commit
+     if (RloadEn = '1' and BkOp /= "10") or BkCmt = '1' then
 
       AddrFR  <= aAddrFR;
+      B1Base  <= aB1Base;
+      B2Base  <= aB2Base;
+      B3Base  <= aB3Base;
+      B4Base  <= aB4Base;
       R1Mask  <= aR1Mask;
       R1Addr  <= aR1Addr;
       R1Reg   <= aR1Reg;
@@ -1067,6 +1378,57 @@ begin
     end if;
 
   end process;
+  ----------------------------------------------------------------
+  -- Bank presets
+  ----------------------------------------------------------------
+  -- 4FA5 write: 7b - commit: the delayed registers go to the active ones now, as on
+  --                  RloadEn (after the load with 5b)
+  --             6b - save the registers 05h-1Dh (AddrFR and the 4 banks) and 37h-3Ah (the
+  --                  block bases) in preset 2-0b
+  --             5b - load them from preset 2-0b, with 7b in one write a new memory layout
+  --      read:  7b - busy, 2-0b - the last preset
+  -- The 8 presets are 32 bytes each in a RAM. A save or a load takes 29 slot clocks
+  -- (8us), the registers must not be written meanwhile. During a load the
+  -- cartridge accesses wait and the active registers do not follow the delayed ones
+  -- (CardMDR 3b = 0): the new layout goes in all at once at the end.
+  -- From version "260" on: 4FA5 is not decoded by the older firmware.
+  BkBsy    <= '1' when BkOp /= "00" or BkW = '1' else '0';
+  BkWait_n <= '0' when (BkOp = "10" or BkCmt = '1') and Sltsl_C_n = '0' and DecMDR = '0' and (pSltRd_n = '0' or pSltWr_n = '0')
+         else '1';
+  BkRA <= BkN & BkI;
+  BkWe <= '1' when BkOp = "01" else '0';
+  BkWD <= "0" & aAddrFR when BkI = "00000"
+     else aR1Mask  when BkI = "00001"
+     else aR1Addr  when BkI = "00010"
+     else aR1Reg   when BkI = "00011"
+     else aR1Mult  when BkI = "00100"
+     else aB1MaskR when BkI = "00101"
+     else aB1AdrD  when BkI = "00110"
+     else aR2Mask  when BkI = "00111"
+     else aR2Addr  when BkI = "01000"
+     else aR2Reg   when BkI = "01001"
+     else aR2Mult  when BkI = "01010"
+     else aB2MaskR when BkI = "01011"
+     else aB2AdrD  when BkI = "01100"
+     else aR3Mask  when BkI = "01101"
+     else aR3Addr  when BkI = "01110"
+     else aR3Reg   when BkI = "01111"
+     else aR3Mult  when BkI = "10000"
+     else aB3MaskR when BkI = "10001"
+     else aB3AdrD  when BkI = "10010"
+     else aR4Mask  when BkI = "10011"
+     else aR4Addr  when BkI = "10100"
+     else aR4Reg   when BkI = "10101"
+     else aR4Mult  when BkI = "10110"
+     else aB4MaskR when BkI = "10111"
+     else aB4AdrD  when BkI = "11000"
+     else "0" & aB1Base when BkI = "11001"
+     else "0" & aB2Base when BkI = "11010"
+     else "0" & aB3Base when BkI = "11011"
+     else "0" & aB4Base;
+
+  BkRam : ram port map(BkRA, pSltClk_n, BkWe, BkWD, BkQ);
+
   ----------------------------------------------------------------
   -- Not standart configurations 
   ----------------------------------------------------------------  
@@ -1078,13 +1440,19 @@ begin
   -- Flash ROM/RAM interface 
   ---------------------------------------------------------------- 
   -- Flash/RAM DataWrite
-  pFlDat <= pSltDat when (Sltsl_C_n = '0' or SltSl_M_n = '0' or Sltsl_F_n = '0')
+  pFlDat <= CeDat when CeOwn = '1' and CeDrv = '1'                      -- copy engine
+       else (others => 'Z') when CeOwn = '1'
+       else "10101010" when ApBusy = '1' and ApCnt(3 downto 2) = "00"    -- auto-program sequence
+       else "01010101" when ApBusy = '1' and ApCnt(3 downto 2) = "01"
+       else "10100000" when ApBusy = '1' and ApCnt(3 downto 2) = "10"
+       else ApDat when ApBusy = '1'
+       else pSltDat when (Sltsl_C_n = '0' or SltSl_M_n = '0' or Sltsl_F_n = '0')
   --                     and pSltRd_n = '1' and RDh1 = '0'
                          and pSltRd_n = '1' and Rd_n = '1'
       else (others => 'Z');
 
   -- Flash -ChipSelect
-  pFlCS_n <= pFlCS_nt;
+  pFlCS_n <= CeFlCS_n when CeOwn = '1' else '0' when ApBusy = '1' else pFlCS_nt;
   pFlCS_nt <= '0' when DecSCARD = '1' and (pSltAdr(15 downto 14) = "01" or pSltAdr(15 downto 14) = "10") -- Second Cartrige
 		 else '0' when Sltsl_C_n = '0' and ((DecMDR = '1' and pSltAdr(5 downto 0) = "000100")   	-- DatM0  
 					 		             or (MR1A(3) = '0' and R1Mult(5) = '0')
@@ -1098,7 +1466,7 @@ begin
 		 else '1';
 
   -- RAM -ChipSelect
-  pRAMCS_n <= pRAMCS_nt;
+  pRAMCS_n <= CeRAMCS_n when CeOwn = '1' else '1' when ApBusy = '1' else pRAMCS_nt;
   pRAMCS_nt <= '0' when SltSl_M_n = '0' and DEC_P3C = '0' and DEC_PFC = '0' and DEC_PFD = '0'
 					   and DEC_PFE = '0' and DEC_PFF = '0'
 	     else '0' when pFlCS_nt = '1' and Sltsl_C_n = '0' and 
@@ -1115,7 +1483,7 @@ begin
              
   -- Flash -OutputEnable (-Gate)
 --pFlOE_n <= not RDh1 when pSltRd_n = '0'  --pFlOE_nt;
-  pFlOE_n <= Rd_n;-- when pSltRd_n = '0'  --pFlOE_nt;
+  pFlOE_n <= CeOE_n when CeOwn = '1' else Rd_n when FlWait_n = '1' and ApBusy = '0' else '1';-- when pSltRd_n = '0'  --pFlOE_nt;
 --         else '1';
 --pFlOE_nt <= not RDh1 when (pRAMCS_nt = '0' or pFlCS_nt = '0') and pSltRd_n = '0'
   pFlOE_nt <= Rd_n when (pRAMCS_nt = '0' or pFlCS_nt = '0') -- and pSltRd_n = '0'
@@ -1131,10 +1499,8 @@ begin
 --             '1'; 
 
 
-  -- Flash/ROM Write
---pFlW_n  <= not WRh1 when Sltsl_C_n = '0' and ((DecMDR = '1' and pSltAdr(5 downto 0) = "000100")  	-- DatM0
-  pFlW_n  <= '1' when DecSCARD = '1'
-     else   Wr_n     when Sltsl_C_n = '0' and ((DecMDR = '1' and pSltAdr(5 downto 0) = "000100")  	-- DatM0					 		                   
+  -- Cartridge (flash or RAM) write enable
+  CartWe  <= '1' when Sltsl_C_n = '0' and ((DecMDR = '1' and pSltAdr(5 downto 0) = "000100")  	-- DatM0					 		                   
 					 		               or (MR1A(3) = '0' and R1Mult(4) = '1' and DecMDR = '0'
 					 		                   and (NSC_SCCP = '0' or -- scc+
 											   SccModeB(4) = '1' or SccModeA(4) = '1' or SccModeB(0) = '1')) 			-- Bank1
@@ -1147,8 +1513,16 @@ begin
 					 		                   SccModeB(4) = '1' or (SccModeB(2) = '1' and SccModeB(5) = '1') )) 							-- Bank3
 					 		               or (MR4A(3) = '0' and R4Mult(4) = '1' and DecMDR = '0'
 					 		                   and (NSC_SCCP = '0' or -- scc+
-					 		                   (SccModeB(4) = '1' and Dec1FFE /= '1'))) )		-- Bank4 
-					 		                   
+					 		                   (SccModeB(4) = '1' and Dec1FFE /= '1'))) )		-- Bank4
+	 else    '0';
+
+  -- Flash/ROM Write
+--pFlW_n  <= not WRh1 when Sltsl_C_n = '0' and ((DecMDR = '1' and pSltAdr(5 downto 0) = "000100")  	-- DatM0
+  pFlW_n  <= CeWe_n when CeOwn = '1'
+     else   ApWe_n when ApBusy = '1'
+     else   '1' when DecSCARD = '1'
+     else   Wr_n     when CartWe = '1' and FlWait_n = '1' and (ConfFl(4) = '0' or pFlCS_nt = '1')
+     else   '1'      when CartWe = '1'
 --	 else	 not WRh1 when SltSl_M_n = '0' and ( (Port3C(0) = '0' and pSltAdr(15 downto 14) = "00") -- MAP RAM write
 	 else	 Wr_n     when SltSl_M_n = '0' and ( (Port3C(0) = '0' and pSltAdr(15 downto 14) = "00") -- MAP RAM write
 											    or (Port3C(1) = '0' and pSltAdr(15 downto 14) = "01")
@@ -1160,8 +1534,419 @@ begin
 	 else    '1';
 	 
   
+  ----------------------------------------------------------------
+  -- Flash ready/busy
+  ----------------------------------------------------------------
+  -- RY/BY# is latched twice on the slot clock. A write following the
+  -- AAA/AA, 555/55, AAA/A0 command is a program: FlBusy is set when it ends
+  -- and cleared when RY/BY# is seen high again, or after 2048 clocks
+  -- (~570us) in any case. FlSeq counts the unlock cycles like the chip,
+  -- on the low 12 bits of the flash address; any other write restarts it.
+  -- Erase commands are only reported by RY/BY#, they are too long to wait.
+  FlWe <= '1' when CartWe = '1' and pFlCS_nt = '0' and DecSCARD = '0' and pSltWr_n = '0'
+     else '0';
+
+  process(pSltClk_n, pSltRst_n)
+  begin
+    if (pSltRst_n = '0') then
+      FlRBs   <= "11";
+      FlWrA   <= '0';
+      FlWrD   <= "00000000";
+      FlPrg   <= '0';
+      FlSeq   <= "00";
+      FlBusy  <= '0';
+      FlBusyC <= (others => '0');
+      FlWrAd  <= (others => '0');
+      ApBusy  <= '0';
+      ApReq   <= '0';
+      ApAckS  <= "00";
+      ApAdr   <= (others => '0');
+      ApDat   <= "00000000";
+    elsif (pSltClk_n'event and pSltClk_n = '1') then
+      FlRBs <= FlRBs(0) & pFlRB_b;
+      ApAckS <= ApAckS(0) & ApAck;
+      if (FlBusy = '1') then
+        FlBusyC <= FlBusyC + "00000000001";
+        if ((FlBusyC(10 downto 1) /= "0000000000" and FlRBs(1) = '1') or FlBusyC = "11111111111") then
+          FlBusy <= '0';
+        end if;
+      end if;
+      if (ApBusy = '1' and ApAckS(1) = ApReq) then  -- program sequence issued
+        ApBusy  <= '0';
+        FlBusy  <= '1';
+        FlBusyC <= (others => '0');
+      end if;
+      if (FlWe = '1') then                     -- flash write cycle
+        FlWrA <= '1';
+        FlWrD <= pSltDat;
+        FlWrAd <= FlAdrC;
+      elsif (FlWrA = '1') then                 -- end of the flash write cycle
+        FlWrA <= '0';
+        if (ConfFl(4) = '1') then              -- auto-program: hand the byte to the sequencer
+          ApAdr  <= FlWrAd;
+          ApDat  <= FlWrD;
+          ApReq  <= not ApReq;
+          ApBusy <= '1';
+          FlPrg  <= '0';
+          FlSeq  <= "00";
+        else
+          FlPrg <= '0';
+          FlSeq <= "00";
+          if (FlPrg = '1') then
+            FlBusy  <= '1';
+            FlBusyC <= (others => '0');
+          elsif (FlSeq = "00") then
+            if (FlWrAd(11 downto 0) = x"AAA" and FlWrD = x"AA") then FlSeq <= "01"; end if;
+          elsif (FlSeq = "01") then
+            if (FlWrAd(11 downto 0) = x"555" and FlWrD = x"55") then FlSeq <= "10"; end if;
+          else
+            if (FlWrAd(11 downto 0) = x"AAA" and FlWrD = x"A0") then FlPrg <= '1'; end if;
+          end if;
+        end if;
+      end if;
+    end if;
+  end process;
+
+  FlRdy <= '1' when FlBusy = '0' and ApBusy = '0' and FlRBs(1) = '1'
+      else '0';
+
+  -- Auto-wait: any access to the cartridge slot but the registers (DatM0 included) waits for the
+  -- end of a program, the flash OE#/WE# are held until then.
+  -- While the sequencer or the copy engine owns the flash bus every flash or RAM access waits.
+  FlWait_n <= '0' when CeOwn = '1' and ZReq = '1'
+         else '0' when ApBusy = '1' and (pFlCS_nt = '0' or pRAMCS_nt = '0')
+         else '0' when (ConfFl(3) = '1' or ConfFl(4) = '1') and FlBusy = '1' and Sltsl_C_n = '0'
+                       and (DecMDR = '0' or pSltAdr(5 downto 0) = "000100")
+         else '1';
+
+  -- Flash auto-program sequencer
+  -- A flash write in auto-program mode does not reach the chip, its address and data are
+  -- passed to this sequencer which issues AAA/AA, 555/55, AAA/A0 and the byte itself.
+  -- It runs on the 50MHz clock, 4 states per flash write: address and data set up,
+  -- WE# low for 2 states (40ns), hold. The unlock addresses keep the upper bits of the
+  -- target so that they fall in the same bank.
+  process(pSltClk2, pSltRst_n)
+  begin
+    if (pSltRst_n = '0') then
+      ApReqS <= "00";
+      ApAck  <= '0';
+      ApRun  <= '0';
+      ApCnt  <= "0000";
+      ApWe_n <= '1';
+    elsif (pSltClk2'event and pSltClk2 = '1') then
+      ApReqS <= ApReqS(0) & ApReq;
+      if (ApRun = '0') then
+        ApWe_n <= '1';
+        if (ApReqS(1) /= ApAck and CeOwn = '0') then
+          ApRun <= '1';
+          ApCnt <= "0000";
+        end if;
+      else
+        ApCnt <= ApCnt + "0001";
+        if (ApCnt(1) = '0') then ApWe_n <= '0'; else ApWe_n <= '1'; end if;
+        if (ApCnt = "1111") then
+          ApRun <= '0';
+          ApAck <= ApReqS(1);
+        end if;
+      end if;
+    end if;
+  end process;
+
+  pFlAdr <= CeAdr when CeOwn = '1'
+       else ApAdr when ApBusy = '1' and ApCnt(3 downto 2) = "11"
+       else ApAdr(22 downto 12) & "101010101010" when ApBusy = '1' and ApCnt(2) = '0'
+       else ApAdr(22 downto 12) & "010101010101" when ApBusy = '1'
+       else FlAdrC;
+
+  ----------------------------------------------------------------
+  -- Extended registers
+  ----------------------------------------------------------------
+  -- From version "260" (2C-2E) on, as ConfFl 7b/4b/3b, the bank presets (4FA5), the block
+  -- bases (4FB7-4FBA), the IDE sector FIFO and the OPLL write FIFO: software checks the
+  -- version first, the older firmware does not decode these addresses.
+  -- 4FB6 (XCtl)  write: 0b - start a copy, 1b - start a CRC scan (no write), 2b - clear the CRC
+  --              read:  0b - copy engine busy, 1b - EEPROM busy (loading after a reset or writing),
+  --                     2b - 1: OPLL write FIFO, the writes of 7C/7D and 7FF4/7FF5 need no delay,
+  --                     3b - OPLL writes pending
+  -- 4FBE (XIdx)  index of the extended register
+  -- 4FBF (XDat)  extended register XIdx, the index is incremented after each access
+  --   00-02  copy source: address 7-0, 15-8, 22-16 (7b - RAM)
+  --   03-05  copy destination in RAM: address 7-0, 15-8, 22-16
+  --   06-08  copy length: 7-0, 15-8, 23-16
+  --   09-0C  (read) CRC-32, 7-0 .. 31-24
+  --   0D     CRC control: 7b - add the Z80 flash/RAM reads, 1-0b - from page 0-3
+  --   0E     mapper probe: 7b - enable, 6b - (write) clear
+  --   0F-10  (read) mapper probe bitmap, the BMAP bits of the software:
+  --          0F: 5000h 6000h 6800h 7000h 7800h 8000h 9000h A000h (0b-7b), 10: B000h (0b)
+  --   11-19  (read) mapper probe write counters, same order, saturated at FFh
+  --   80-FF  EEPROM 00-7F: read from the shadow loaded after a reset, a write starts the
+  --          write of the byte to the EEPROM (ignored while busy)
+  process(pSltClk_n, pSltRst_n)
+  begin
+    if (pSltRst_n = '0') then
+      XIdx   <= "00000000";
+      XAcc   <= '0';
+      CeSrc  <= (others => '0');
+      CeDst  <= (others => '0');
+      CeLen  <= (others => '0');
+      CeReq  <= '0';
+      CeAckS <= "00";
+      CeScan <= '0';
+      XCtlW  <= '0';
+      XCtlD  <= "000";
+      CrcCtl <= "00000000";
+      CrcClr <= '0';
+      CrcSnR <= '0';
+      CrcSnD <= "00000000";
+      CrcSn  <= '0';
+    elsif (pSltClk_n'event and pSltClk_n = '1') then
+      CeAckS <= CeAckS(0) & CeAck;
+      if (DecMDR = '1' and pSltAdr(5 downto 0) = "110110" and pSltWr_n = '0') then
+        XCtlW <= '1';
+        XCtlD <= pSltDat(2 downto 0);
+      elsif (XCtlW = '1') then                 -- end of the XCtl write
+        XCtlW <= '0';
+        if (XCtlD(1 downto 0) /= "00" and CeBusy = '0') then
+          CeReq  <= not CeReq;
+          CeScan <= XCtlD(1);
+        end if;
+        if (XCtlD(2) = '1') then CrcClr <= not CrcClr; end if;
+      end if;
+      -- CRC of the Z80 reads: the data is taken until the end of the read
+      if (CrcCtl(7) = '1' and ZReq = '1' and pSltRd_n = '0' and pSltAdr(15 downto 14) = CrcCtl(1 downto 0)) then
+        CrcSnR <= '1';
+        CrcSnD <= pFlDat;
+      elsif (CrcSnR = '1') then
+        CrcSnR <= '0';
+        CrcSn  <= not CrcSn;
+      end if;
+      if (DecMDR = '1' and pSltAdr(5 downto 0) = "111111" and (pSltWr_n = '0' or (pSltRd_n = '0' and CardMDR(0) = '0'))) then
+        XAcc <= '1';
+      elsif (XAcc = '1') then                  -- end of the XDat access
+        XAcc <= '0';
+        XIdx <= XIdx + "00000001";
+      end if;
+      if (DecMDR = '1' and pSltWr_n = '0') then
+        if (pSltAdr(5 downto 0) = "111110") then XIdx <= pSltDat; end if;
+        if (pSltAdr(5 downto 0) = "111111") then
+          case XIdx is
+            when "00000000" => CeSrc(7 downto 0)   <= pSltDat;
+            when "00000001" => CeSrc(15 downto 8)  <= pSltDat;
+            when "00000010" => CeSrc(23 downto 16) <= pSltDat;
+            when "00000011" => CeDst(7 downto 0)   <= pSltDat;
+            when "00000100" => CeDst(15 downto 8)  <= pSltDat;
+            when "00000101" => CeDst(23 downto 16) <= pSltDat;
+            when "00000110" => CeLen(7 downto 0)   <= pSltDat;
+            when "00000111" => CeLen(15 downto 8)  <= pSltDat;
+            when "00001000" => CeLen(23 downto 16) <= pSltDat;
+            when "00001101" => CrcCtl <= pSltDat;
+            when others     => null;
+          end case;
+        end if;
+      end if;
+    end if;
+  end process;
+
+  XRd <= CeSrc(7 downto 0)   when XIdx = "00000000"
+    else CeSrc(15 downto 8)  when XIdx = "00000001"
+    else CeSrc(23 downto 16) when XIdx = "00000010"
+    else CeDst(7 downto 0)   when XIdx = "00000011"
+    else CeDst(15 downto 8)  when XIdx = "00000100"
+    else CeDst(23 downto 16) when XIdx = "00000101"
+    else CeLen(7 downto 0)   when XIdx = "00000110"
+    else CeLen(15 downto 8)  when XIdx = "00000111"
+    else CeLen(23 downto 16) when XIdx = "00001000"
+    else not Crc(7 downto 0)   when XIdx = "00001001"
+    else not Crc(15 downto 8)  when XIdx = "00001010"
+    else not Crc(23 downto 16) when XIdx = "00001011"
+    else not Crc(31 downto 24) when XIdx = "00001100"
+    else CrcCtl when XIdx = "00001101"
+    else PrbEn & "0000000"   when XIdx = "00001110"
+    else PrbMap(7 downto 0)  when XIdx = "00001111"
+    else "0000000" & PrbMap(8) when XIdx = "00010000"
+    else PrbCnt(0) when XIdx = "00010001"
+    else PrbCnt(1) when XIdx = "00010010"
+    else PrbCnt(2) when XIdx = "00010011"
+    else PrbCnt(3) when XIdx = "00010100"
+    else PrbCnt(4) when XIdx = "00010101"
+    else PrbCnt(5) when XIdx = "00010110"
+    else PrbCnt(6) when XIdx = "00010111"
+    else PrbCnt(7) when XIdx = "00011000"
+    else PrbCnt(8) when XIdx = "00011001"
+    else EeRQ when XIdx(7) = '1'
+    else "00000000";
+
+  ----------------------------------------------------------------
+  -- Copy engine
+  ----------------------------------------------------------------
+  -- Copies CeLen bytes from the flash or the RAM to the RAM on the 50MHz clock, 240ns
+  -- a byte: 120ns read, 60ns WE#. The slot has priority: no byte is started while the
+  -- Z80 accesses the flash or the RAM (ZReq) and the access waits for the current byte
+  -- only, so the Z80 can run from the cartridge or poll XCtl while the copy goes on.
+  -- The registers keep the programmed values, a new copy needs the busy bit clear.
+  -- A CRC scan only reads the source, 140ns a byte. All the bytes read go to the CRC.
+  CeBusy <= '1' when CeReq /= CeAckS(1) else '0';
+
+  ZReq <= '1' when (pFlCS_nt = '0' or pRAMCS_nt = '0') and (DecMDR = '0' or pSltAdr(5 downto 0) = "000100")
+     else '0';
+
+  process(pSltClk2, pSltRst_n)
+  begin
+    if (pSltRst_n = '0') then
+      CeReqS    <= "00";
+      ZReqS     <= "00";
+      CeAck     <= '0';
+      CeRun     <= '0';
+      CeOwn     <= '0';
+      CeCnt     <= "0000";
+      CeSa      <= (others => '0');
+      CeDa      <= (others => '0');
+      CeLn      <= (others => '0');
+      CeDat     <= "00000000";
+      CeAdr     <= (others => '0');
+      CeFlCS_n  <= '1';
+      CeRAMCS_n <= '1';
+      CeOE_n    <= '1';
+      CeWe_n    <= '1';
+      CeDrv     <= '0';
+      CeSc      <= '0';
+      CeCrc     <= '0';
+    elsif (pSltClk2'event and pSltClk2 = '1') then
+      CeReqS <= CeReqS(0) & CeReq;
+      ZReqS  <= ZReqS(0) & ZReq;
+      CeCrc  <= '0';
+      if (CeRun = '0') then
+        if (CeReqS(1) /= CeAck) then
+          CeRun <= '1';
+          CeSc  <= CeScan;
+          CeSa  <= CeSrc;
+          CeDa  <= CeDst(22 downto 0);
+          CeLn  <= CeLen;
+        end if;
+      elsif (CeOwn = '0') then                 -- between two bytes
+        if (CeLn = 0) then
+          CeRun <= '0';
+          CeAck <= CeReqS(1);
+        elsif (ZReqS(1) = '0' and ApRun = '0' and ApReqS(1) = ApAck) then
+          CeOwn     <= '1';
+          CeCnt     <= "0000";
+          CeAdr     <= CeSa(22 downto 0);
+          CeFlCS_n  <= CeSa(23);
+          CeRAMCS_n <= not CeSa(23);
+          CeOE_n    <= '0';
+        end if;
+      else
+        CeCnt <= CeCnt + "0001";
+        case CeCnt is
+          when "0101" =>                       -- data in, source released
+            CeDat     <= pFlDat;
+            CeCrc     <= '1';
+            CeFlCS_n  <= '1';
+            CeRAMCS_n <= '1';
+            CeOE_n    <= '1';
+            CeAdr     <= CeDa;
+            if (CeSc = '1') then               -- CRC scan: end of the byte
+              CeOwn <= '0';
+              CeSa(22 downto 0) <= CeSa(22 downto 0) + 1;
+              CeLn  <= CeLn - 1;
+            end if;
+          when "0110" =>                       -- RAM write
+            CeRAMCS_n <= '0';
+            CeDrv     <= '1';
+            CeWe_n    <= '0';
+          when "1001" =>
+            CeWe_n    <= '1';
+          when "1010" =>                       -- end of the byte
+            CeOwn     <= '0';
+            CeRAMCS_n <= '1';
+            CeDrv     <= '0';
+            CeSa(22 downto 0) <= CeSa(22 downto 0) + 1;
+            CeDa      <= CeDa + 1;
+            CeLn      <= CeLn - 1;
+          when others =>
+            null;
+        end case;
+      end if;
+    end if;
+  end process;
+
+  ----------------------------------------------------------------
+  -- Mapper probe
+  ----------------------------------------------------------------
+  -- Records the writes of a running ROM to the main cartridge in the 2K ranges from
+  -- the bank select addresses of the usual mappers, whatever the banks do with them.
+  -- A reset stops the probe but keeps what it found, so that a tool started after
+  -- the ROM can read it; only a clear (or the power up) empties it.
+  PrbN <= 0 when PrbAdr = "01010"     -- 5000h
+     else 1 when PrbAdr = "01100"     -- 6000h
+     else 2 when PrbAdr = "01101"     -- 6800h
+     else 3 when PrbAdr = "01110"     -- 7000h
+     else 4 when PrbAdr = "01111"     -- 7800h
+     else 5 when PrbAdr = "10000"     -- 8000h
+     else 6 when PrbAdr = "10010"     -- 9000h
+     else 7 when PrbAdr = "10100"     -- A000h
+     else 8 when PrbAdr = "10110"     -- B000h
+     else 15;
+
+  process(pSltClk_n, pSltRst_n)
+  begin
+    if (pSltRst_n = '0') then
+      PrbEn  <= '0';
+      PrbW   <= '0';
+      PrbAdr <= "00000";
+    elsif (pSltClk_n'event and pSltClk_n = '1') then
+      if (DecMDR = '1' and pSltWr_n = '0' and pSltAdr(5 downto 0) = "111111" and XIdx = "00001110") then
+        PrbEn <= pSltDat(7);
+        if (pSltDat(6) = '1') then
+          PrbMap <= "000000000";
+          PrbCnt <= (others => "00000000");
+        end if;
+      end if;
+      if (Sltsl_C_n = '0' and DecMDR = '0' and pSltWr_n = '0') then
+        PrbW   <= '1';
+        PrbAdr <= pSltAdr(15 downto 11);
+      elsif (PrbW = '1') then                  -- end of the write
+        PrbW <= '0';
+        if (PrbEn = '1' and PrbN /= 15) then
+          PrbMap(PrbN) <= '1';
+          if (PrbCnt(PrbN) /= "11111111") then
+            PrbCnt(PrbN) <= PrbCnt(PrbN) + "00000001";
+          end if;
+        end if;
+      end if;
+    end if;
+  end process;
+
+  ----------------------------------------------------------------
+  -- CRC-32
+  ----------------------------------------------------------------
+  -- Fed by the bytes of the copy engine and by the snooped Z80 reads, on the 50MHz
+  -- clock. Cleared to FFFFFFFFh, read inverted: the usual CRC-32 of the bytes.
+  process(pSltClk2, pSltRst_n)
+  begin
+    if (pSltRst_n = '0') then
+      Crc     <= (others => '1');
+      CrcClrS <= "00";
+      CrcClrA <= '0';
+      CrcSnS  <= "00";
+      CrcSnA  <= '0';
+    elsif (pSltClk2'event and pSltClk2 = '1') then
+      CrcClrS <= CrcClrS(0) & CrcClr;
+      CrcSnS  <= CrcSnS(0) & CrcSn;
+      if (CrcClrS(1) /= CrcClrA) then
+        CrcClrA <= CrcClrS(1);
+        Crc     <= (others => '1');
+      elsif (CeCrc = '1') then
+        Crc     <= crc32(Crc, CeDat);
+      elsif (CrcSnS(1) /= CrcSnA) then
+        CrcSnA  <= CrcSnS(1);
+        Crc     <= crc32(Crc, CrcSnD);
+      end if;
+    end if;
+  end process;
+
   -- Adress Flash/ROM mapping          
-  pFlAdr(22 downto 0) <= (SCART_StBl(6 downto 0) + Maddrs(22 downto 16)) & Maddrs(15 downto 0) when DecSCARD = '1' -- Second Cartrige ROM mapper
+  FlAdrC(22 downto 0) <= (SCART_StBl(6 downto 0) + Maddrs(22 downto 16)) & Maddrs(15 downto 0) when DecSCARD = '1' -- Second Cartrige ROM mapper
             else   ("000000" & IDEROMADDR(16) + "0000001") & IDEROMADDR(15 downto 0) when Sltsl_D_n = '0' -- IDE ROM Addr 10000h-2FFFFh
 			else   "0000011" & R7FF7 & pSltAdr(13 downto 0) when SltSl_F_n = '0' and CsRAM8k = '0'-- FM Pack ROM 30000h-3FFFFh
 			else   "0001111" & "111" & pSltAdr(12 downto 0) when SltSl_F_n = '0' and CsRAM8k = '1'-- FM Pack RAM8Kb 
@@ -1171,7 +1956,15 @@ begin
                          when (DecMDR = '1' and CardMDR(0) = '0' and pSltAdr(5 downto 0) = "000100") -- Direct card vector port
 --CIV            else   "000000000"&(V_AR + pSltAdr(13 downto 0) - V_RA(13 downto 0)) -- inject vector address
 --CIV                        when V_active /= "00"          
-			else  (AddrFR(6 downto 0) + Maddr(22 downto 16)) & Maddr(15 downto 0); -- Cartridge 
+			else  (AddrFR(6 downto 0) + MBase + Maddr(22 downto 16)) & Maddr(15 downto 0); -- Cartridge 
+
+  -- 4FB7-4FBA: block base of the banks 1-4 (x 64KB, added to AddrFR), delayed as AddrFR,
+  -- from version "260" on.
+  -- Two banks can map distant blocks of the flash or the RAM at the same time.
+  MBase <= B1Base when MR1A(3) = '0'
+      else B2Base when MR2A(3) = '0'
+      else B3Base when MR3A(3) = '0'
+      else B4Base;
   
   AddrMAP	<=	MAP_FC when  pSltAdr(15 downto 14) = "00" else	-- Mapper Page
 				MAP_FD when  pSltAdr(15 downto 14) = "01" else	
@@ -1641,34 +2434,258 @@ begin
 ---							else IDEsOUT when IDEReg = '1' and pSltAdr(9) = '0' and pSltAdr(0) = '1' 
 ---							                  and RD_hT1 = '0' 
 ---							else (others => 'Z');  
-  pIDEDat(15 downto 8) 	<= 	pSltDat when IDEReg = '1' and pSltAdr(9) = '1' and Rd_n = '1' and Rd_n1 = '1' and pSltRd_n = '1'
+  pIDEDat(15 downto 8) 	<= 	IdDo(15 downto 8) when IdOwn = '1' and IdDrv = '1'
+                       else (others => 'Z') when IdOwn = '1'
+                       else pSltDat when IDEReg = '1' and pSltAdr(9) = '1' and Rd_n = '1' and Rd_n1 = '1' and pSltRd_n = '1'
                        else pSltDat when IDEReg = '1' and Rd_n = '1' and Rd_n1 = '1' and pSltRd_n = '1'
 					   else (others => 'Z');
-  pIDEDat(7 downto 0) 	<= 	pSltDat when IDEReg = '1' and pSltAdr(9) = '1' and Rd_n = '1' and Rd_n1 = '1' and pSltRd_n = '1'
+  pIDEDat(7 downto 0) 	<= 	IdDo(7 downto 0) when IdOwn = '1' and IdDrv = '1'
+                       else (others => 'Z') when IdOwn = '1'
+                       else pSltDat when IDEReg = '1' and pSltAdr(9) = '1' and Rd_n = '1' and Rd_n1 = '1' and pSltRd_n = '1'
 					   else IDEsOUT when IDEReg = '1' and pSltAdr(9) = '0' and pSltAdr(0) = '1' 
 							             and Rd_n = '1' and Rd_n1 = '1' and pSltRd_n = '1'
 					   else (others => 'Z');
 
 
-  pIDEAdr		<= pSltAdr(2 downto 0) when pSltAdr(9) = '1'
+  pIDEAdr		<= IdAS & IdAS & IdAS when IdOwn = '1'
+                   else pSltAdr(2 downto 0) when pSltAdr(9) = '1'
                    else "000";
 ---  pIDECS1_n		<= pSltAdr(3) when pSltAdr(9) = '1' and IDEReg = '1'
 ---				   else '0' when IDEReg = '1'
 ---				   else '1';
 ---  pIDECS3_n		<= not pSltAdr(3) when pSltAdr(9) = '1' and IDEReg = '1'
 ---				   else '1';
-  pIDECS1_n             <= pSltAdr(3) when pSltAdr(9) = '1' 
+  pIDECS1_n             <= '0' when IdOwn = '1'
+                                   else pSltAdr(3) when pSltAdr(9) = '1' 
                                    else '0';
-  pIDECS3_n             <= not pSltAdr(3) when pSltAdr(9) = '1'
+  pIDECS3_n             <= '1' when IdOwn = '1'
+                                   else not pSltAdr(3) when pSltAdr(9) = '1'
                                    else '1';
 ---  pIDERD_n		<= not RD_hT1;
 ---  pIDEWR_n		<= not WR_hT1;
-  pIDERD_n 		<= Rdh_n;
-  pIDEWR_n		<= Wrh_n;
+  pIDERD_n 		<= IdRd_n when IdOwn = '1' else Rdh_n;
+  pIDEWR_n		<= IdWr_n when IdOwn = '1' else Wrh_n;
   pPIN180		<= '1';
   pIDE_Rst_n	<= pSltRst_n;
-  Rdh_n			<= '0' when Rd_n = '0' and IDEReg = '1' and (pSltAdr(9) = '1' or pSltAdr(0) = '0') else '1';
-  Wrh_n			<= '0' when Wr_n = '0' and IDEReg = '1' and (pSltAdr(9) = '1' or pSltAdr(0) = '1') else '1';
+  Rdh_n			<= '0' when Rd_n = '0' and IDEReg = '1' and (pSltAdr(9) = '1' or pSltAdr(0) = '0')
+                                and IdVirt = '0' and IdGate = '0' else '1';
+  Wrh_n			<= '0' when Wr_n = '0' and IDEReg = '1' and (pSltAdr(9) = '1' or pSltAdr(0) = '1')
+                                and IdVirt = '0' and IdGate = '0' else '1';
+
+----------------------------------------------------------------
+-- IDE sector FIFO
+----------------------------------------------------------------
+-- With cReg bit 1 set (ignored by the Sunrise drivers) the data of the READ (20h 21h 24h
+-- 29h C4h ECh) and WRITE (30h 31h 34h 39h C5h) commands goes through a 512 byte FIFO, two
+-- 256x8 RAMs for the low and high bytes of the words, on the 50MHz clock.
+-- Read: the FPGA polls the status and reads the words of each DRQ block into the FIFO as
+-- long as there is room. The Z80 reads them one after the other at any address of
+-- 7C00h-7DFFh, it waits only when it gets ahead of the card in a DRQ block.
+-- Write: the Z80 writes the FIFO at any address of 7C00h-7DFFh, the FPGA writes the words
+-- to the card when it asks for them.
+-- Until the command is over and the FIFO is empty the status at 7E07h/7E0Eh is made by the
+-- FPGA: BSY while it polls the card (for a read: and the FIFO is empty), else DRQ. The other
+-- registers go to the card, the Z80 waits for the end of a card cycle of the FPGA. A write
+-- of the device control register or of cReg bit 1 to 0 stops the FIFO.
+-- The card cycles follow PIO mode 0: 80ns address setup, 200ns strobe, 600ns a cycle.
+  IdN    <= IdWp - IdRp;
+  IdSR   <= '1' when pSltAdr(9) = '1' and ((pSltAdr(3 downto 0) = "0111") or (pSltAdr(3 downto 0) = "1110"))
+       else '0';                                           -- status/command, alt status/device control
+  IdVirt <= '1' when IdMd /= "00" and IDEReg = '1' and (pSltAdr(9) = '0' or (pSltRd_n = '0' and IdSR = '1'))
+       else '0';
+  IdZr   <= '1' when IdVirt = '1' and pSltAdr(9) = '0' and pSltRd_n = '0' and IdMd(0) = '1' else '0';
+  IdZw   <= '1' when IdVirt = '1' and pSltAdr(9) = '0' and pSltWr_n = '0' and IdMd(1) = '1' else '0';
+  IdZc   <= '1' when cReg(1) = '1' and IDEReg = '1' and pSltWr_n = '0' and IdSR = '1' else '0';
+  IdZo   <= '1' when IdVirt = '0' and IDEReg = '1' and (pSltRd_n = '0' or pSltWr_n = '0') else '0';
+  IdBsy  <= '1' when IdSt(2 downto 1) = "00" and (IdMd(1) = '1' or IdN = "0000000000") else '0';
+  IdDat  <= IdBsy & IdSta(6 downto 4) & not IdBsy & IdSta(2 downto 1) & '0' when pSltAdr(9) = '1'
+       else IdQ when IdQv = '1'
+       else "11111111";
+  IdWait_n <= '0' when IdZr = '1' and IdQv = '0' and (IdN /= "0000000000" or IdSt(2 downto 1) = "01")
+         else '0' when IdZw = '1' and IdZwT = '0' and IdN(9) = '1'
+         else '0' when IdZo = '1' and IdGate = '1'
+         else '1';
+
+  process(pSltClk2, pSltRst_n)
+  begin
+    if (pSltRst_n = '0') then
+      IdMd   <= "00";
+      IdSt   <= "000";
+      IdT    <= "00000";
+      IdWc   <= (others => '0');
+      IdWp   <= (others => '0');
+      IdRp   <= (others => '0');
+      IdQ    <= "11111111";
+      IdQv   <= '0';
+      IdPl   <= "00";
+      IdFe   <= "00";
+      IdEs   <= '0';
+      IdDv   <= '0';
+      IdDi   <= (others => '0');
+      IdDo   <= (others => '0');
+      IdSta  <= "00000000";
+      IdOwn  <= '0';
+      IdGate <= '0';
+      IdAS   <= '0';
+      IdDrv  <= '0';
+      IdRd_n <= '1';
+      IdWr_n <= '1';
+      IdZrS  <= "000";
+      IdZwS  <= "00";
+      IdZwT  <= '0';
+      IdZcS  <= "000";
+      IdZoS  <= "00";
+      IdRA   <= "00000000";
+      IdLD   <= "00000000";
+      IdHD   <= "00000000";
+      IdLWe  <= '0';
+      IdHWe  <= '0';
+    elsif (pSltClk2'event and pSltClk2 = '1') then
+      IdZrS <= IdZrS(1 downto 0) & IdZr;
+      IdZwS <= IdZwS(0) & IdZw;
+      IdZcS <= IdZcS(1 downto 0) & IdZc;
+      IdZoS <= IdZoS(0) & IdZo;
+      IdLWe <= '0';
+      IdHWe <= '0';
+      IdPl  <= IdPl(0) & '0';
+      IdFe  <= IdFe(0) & '0';
+
+      -- the RAM gives the data two clocks after the address
+      if (IdPl(1) = '1') then
+        if (IdRp(0) = '0') then IdQ <= IdLQ; else IdQ <= IdHQ; end if;
+        IdQv <= '1';
+      end if;
+      if (IdFe(1) = '1') then
+        IdDo <= IdHQ & IdLQ;
+        IdDv <= '1';
+        IdRp <= IdRp + "0000000010";
+      end if;
+      -- a byte in IdQ is taken at the end of the read of the Z80
+      if (IdZrS(2) = '1' and IdZrS(1) = '0' and IdQv = '1') then
+        IdQv <= '0';
+        IdRp <= IdRp + "0000000001";
+      end if;
+
+      -- RAM: writes of the Z80, words of the card, words for the card, bytes for the Z80
+      if (IdZwS(1) = '0') then
+        IdZwT <= '0';
+      end if;
+      if (IdZwS(1) = '1' and IdZwT = '0' and IdN(9) = '0') then
+        IdRA  <= IdWp(8 downto 1);
+        IdLD  <= pSltDat;
+        IdHD  <= pSltDat;
+        IdLWe <= not IdWp(0);
+        IdHWe <= IdWp(0);
+        IdWp  <= IdWp + "0000000001";
+        IdZwT <= '1';
+      elsif (IdEs = '1') then
+        IdRA  <= IdWp(8 downto 1);
+        IdLD  <= IdDi(7 downto 0);
+        IdHD  <= IdDi(15 downto 8);
+        IdLWe <= '1';
+        IdHWe <= '1';
+        IdWp  <= IdWp + "0000000010";
+        IdEs  <= '0';
+      elsif (IdMd(1) = '1' and IdDv = '0' and IdFe = "00" and IdN(9 downto 1) /= "000000000") then
+        IdRA  <= IdRp(8 downto 1);
+        IdFe(0) <= '1';
+      elsif (IdMd(0) = '1' and IdQv = '0' and IdPl = "00" and IdN /= "0000000000") then
+        IdRA  <= IdRp(8 downto 1);
+        IdPl(0) <= '1';
+      end if;
+
+      -- the card
+      if ((IdZcS(2) = '0' and IdZcS(1) = '1') or cReg(1) = '0') then
+        IdMd   <= "00";
+        IdSt   <= "000";
+        IdT    <= "00000";
+        IdWp   <= (others => '0');
+        IdRp   <= (others => '0');
+        IdQv   <= '0';
+        IdDv   <= '0';
+        IdEs   <= '0';
+        IdSta  <= "10000000";
+        IdOwn  <= '0';
+        IdGate <= '0';
+        IdDrv  <= '0';
+        IdRd_n <= '1';
+        IdWr_n <= '1';
+        if (cReg(1) = '1' and pSltAdr(3) = '0') then     -- command
+          case pSltDat is
+            when "00100000" | "00100001" | "00100100" | "00101001" | "11000100" | "11101100" =>
+              IdMd <= "01";
+            when "00110000" | "00110001" | "00110100" | "00111001" | "11000101" =>
+              IdMd <= "10";
+            when others =>
+              null;
+          end case;
+        end if;
+      elsif (IdMd /= "00") then
+        IdT <= IdT + "00001";
+        case IdSt is
+          when "000" =>                                   -- 500ns before the status is read
+            if (IdT(4 downto 3) = "11" and IdZoS(1) = '0') then
+              IdSt   <= "001";
+              IdT    <= "00000";
+              IdOwn  <= '1';
+              IdGate <= '1';
+              IdAS   <= '1';
+            end if;
+          when "010" =>                                   -- DRQ block
+            if (IdWc = "000000000") then
+              IdSt <= "000";
+              IdT  <= "00000";
+            elsif (IdZoS(1) = '0' and IdEs = '0'
+                   and ((IdMd(0) = '1' and IdN <= "0111111110") or (IdMd(1) = '1' and IdDv = '1'))) then
+              IdSt   <= "011";
+              IdT    <= "00000";
+              IdOwn  <= '1';
+              IdGate <= '1';
+              IdAS   <= '0';
+              IdDrv  <= IdMd(1);
+            end if;
+          when "001" | "011" =>                           -- card cycle: status or data
+            if (IdT = "00100") then
+              if (IdDrv = '1') then IdWr_n <= '0'; else IdRd_n <= '0'; end if;
+            elsif (IdT = "01110") then
+              IdRd_n <= '1';
+              IdWr_n <= '1';
+              if (IdSt = "001") then
+                IdSta <= pIDEDat(7 downto 0);
+              elsif (IdMd(0) = '1') then
+                IdDi <= pIDEDat;
+                IdEs <= '1';
+              else
+                IdDv <= '0';
+              end if;
+            elsif (IdT = "10000") then
+              IdDrv <= '0';
+            elsif (IdT = "11001") then
+              IdOwn <= '0';
+            elsif (IdT = "11101") then
+              IdGate <= '0';
+              IdT    <= "00000";
+              if (IdSt = "011") then
+                IdSt <= "010";
+                IdWc <= IdWc - "000000001";
+              elsif (IdSta(7) = '1') then                 -- BSY
+                IdSt <= "000";
+              elsif (IdSta(3) = '1') then                 -- DRQ
+                IdSt <= "010";
+                IdWc <= "100000000";
+              else
+                IdSt <= "100";
+              end if;
+            end if;
+          when others =>                                  -- the card is done
+            if (IdMd(1) = '1' or IdN = "0000000000") then IdMd <= "00"; end if;
+        end case;
+      end if;
+    end if;
+  end process;
+
+  IdLo : ram port map(IdRA, pSltClk2, IdLWe, IdLD, IdLQ);
+  IdHi : ram port map(IdRA, pSltClk2, IdHWe, IdHD, IdHQ);
 --- **************************************************************************************************
 --- RAM Mapper slot
 ---
@@ -1797,19 +2814,102 @@ begin
 -- FM Pack Register
 ----------------------------------------------------------------
 
-  U1 : opll port map (pSltClk_n, open, xena, pSltDat, pYM2413_A, pYM2413_Cs_n, pYM2413_We_n, 
+  U1 : opll port map (pSltClk_n, open, xena, pYM2413_D, pYM2413_A, pYM2413_Cs_n, pYM2413_We_n, 
                       pSltRst_n, BCMO, BCRO, SDO);
 --  clk21m <= pSltClk;
-  pYM2413_A <= pSltAdr(0);
   xena <=  '1';
---pYM2413_We_n <= not WRh1;-- pSltWr_n;
-  pYM2413_We_n <= Wr_n;-- pSltWr_n;
-  pYM2413_Cs_n <= '0' when pSltAdr(7 downto 1) = "0111110" and pSltIorq_n = '0' 
+  OfSel <= '1' when pSltAdr(7 downto 1) = "0111110" and pSltIorq_n = '0' 
                            and ( R7FF6b0 = '1' or Mconf(5) = '1')  -- processor port address (7C,7D)
-  			 else '0' when CsOPLL = '1' -- and R7FF6b0 = '1'
+  			 else '1' when CsOPLL = '1' -- and R7FF6b0 = '1'
 --pYM2413_Cs_n <= '0' when pSltAdr(7 downto 1) = "0111110" and pSltIorq_n = '0' and R7FF6b4 = '1' and Mconf(5) = '1'  -- processor port address (7C,7D)
 --			 else '0' when CsOPLL = '1' and R7FF6b0 = '1'
-             else '1';
+             else '0';
+
+----------------------------------------------------------------
+-- OPLL write FIFO
+----------------------------------------------------------------
+-- The core keeps a data write (opllwr) until the next register write, and the Controller
+-- takes it at stage 2 of the slot of the register. The core runs on pSltClk_n with xena
+-- = '1', and SlotCounter goes through the 18 slots in 72 clocks: a channel register is
+-- taken 72 clocks after its data write at most. The voice of an extra register
+-- (40h-D7h) comes by every 38 slots, 152 clocks. The 84 cycles of the YM2413 are the
+-- time of the chip, not of the core. So the Z80 writes do not go to the core: a
+-- register write (7C, 7FF4) is only kept in OfPtr, a data write (7D, 7FF5) puts OfPtr
+-- and the data in a FIFO of 256 entries, two 256x8 RAMs. The FIFO writes them to the
+-- core one after the other, the next register write 76 clocks (156 for 40h and up)
+-- after a data write. The Z80 needs no delay, it waits only when the FIFO is full.
+-- XCtl bit 2 tells the software, bit 3 is set until the last write is taken.
+  OfFull   <= '1' when OfWp + "00000001" = OfRp else '0';
+  OfBsy    <= '1' when OfWp /= OfRp or OfSt /= "000" or OfT /= "00000000" else '0';
+  OfWait_n <= '0' when OfSel = '1' and pSltWr_n = '0' and pSltAdr(0) = '1' and OfFull = '1' else '1';
+
+  -- "110": register, "111": data
+  pYM2413_Cs_n <= not OfSt(2);
+  pYM2413_We_n <= not OfSt(2);
+  pYM2413_A    <= OfSt(0);
+  pYM2413_D    <= OfD when OfSt(0) = '1' else OfP;
+
+  process(pSltClk_n, pSltRst_n)
+  begin
+    if (pSltRst_n = '0') then
+      OfZw  <= '0';
+      OfPtr <= "00000000";
+      OfWp  <= "00000000";
+      OfRp  <= "00000000";
+      OfWe  <= '0';
+      OfSt  <= "000";
+      OfT   <= "00000000";
+    elsif (pSltClk_n'event and pSltClk_n = '1') then
+      OfWe <= '0';
+      -- the Z80: the data is taken until the end of the write
+      if (OfSel = '1' and Wr_n = '0' and OfWait_n = '1') then
+        OfZw <= '1';
+        OfZa <= pSltAdr(0);
+        OfZd <= pSltDat;
+      elsif (OfZw = '1') then                  -- end of the write
+        OfZw <= '0';
+        if (OfZa = '0') then
+          OfPtr <= OfZd;
+        else
+          OfRA <= OfWp;
+          OfWe <= '1';
+          OfWp <= OfWp + "00000001";
+        end if;
+      end if;
+
+      -- the core
+      if (OfT /= "00000000") then
+        OfT <= OfT - "00000001";
+      else
+        case OfSt is
+          when "000" =>                          -- OfRA is free when no write ends
+            if (OfWp /= OfRp and OfZw = '0') then
+              OfRA <= OfRp;
+              OfSt <= "001";
+            end if;
+          when "001" =>
+            OfSt <= "010";
+          when "010" =>
+            OfP  <= OfPQ;
+            OfD  <= OfDQ;
+            OfRp <= OfRp + "00000001";
+            OfSt <= "110";
+          when "110" =>
+            OfSt <= "111";
+          when others =>
+            OfSt <= "000";
+            if (OfP(7 downto 6) /= "00") then
+              OfT <= "10011000";                 -- 152
+            else
+              OfT <= "01001000";                 -- 72
+            end if;
+        end case;
+      end if;
+    end if;
+  end process;
+
+  OfPR : ram port map(OfRA, pSltClk_n, OfWe, OfPtr, OfPQ);
+  OfDR : ram port map(OfRA, pSltClk_n, OfWe, OfZd, OfDQ);
 
 --       mix := ('0'&MO) + ('0'&RO) - "010 0000 0000";
 --		mix <= ('0'&MO) + ('0'&RO) - "01000000000"; --(10)
@@ -2005,9 +3105,180 @@ begin
 ----------------------------------------------------------------
 -- EEPROM Output
 ----------------------------------------------------------------
-  EECS <= '1' when EECS1 = '1' else '0';
-  EECK <= '1' when EECK1 = '1' else '0';
-  EEDI <= '1' when EEDI1 = '1' else '0';
+-- After a reset the serializer reads the 128 bytes of the 93C46 (x8 mode) into the shadow,
+-- one READ command each like the software does, then it gives the pins back to 4FA3.
+-- A write of XDat in 80-FF sends EWEN, WRITE, waits for the end of the write (DO high,
+-- 18ms at most) and sends EWDS. A bit takes 8 slot clocks, CK is about 450kHz.
+-- The load takes about 5.7ms. Tools older than 2.60 bit-bang 4FA3 without looking at
+-- XCtl, so a write of 4FA3 during the load pauses it and gives the pins back; the READ
+-- that was cut is sent again once 4FA3 has not been written for 8191 clocks (2.3ms).
+-- A bit-bang during a write of XDat is not taken care of: software for 2.60 and later
+-- must write through XDat, or wait for XCtl bit 1 to be 0 before it bit-bangs.
+  EeBusy <= EeLd or EeWr or EeWq;
+
+  process(pSltClk_n, pSltRst_n)
+  begin
+    if (pSltRst_n = '0') then
+      EeLd  <= '1';
+      EePs  <= '0';
+      EeWr  <= '0';
+      EeWq  <= '0';
+      EeA   <= "0000000";
+      EeWA  <= "0000000";
+      EeWD  <= "00000000";
+      EeStp <= "00";
+      EePh  <= "000";
+      EeBit <= "00000";
+      EeLen <= "10011";                          -- READ of byte 00
+      EeSh  <= "110" & "0000000" & "00000000";
+      EeTo  <= (others => '0');
+      EeCS  <= '0';
+      EeCK  <= '0';
+      EeDI  <= '0';
+    elsif (pSltClk_n'event and pSltClk_n = '1') then
+      -- the write starts at the end of the XDat write, none is taken while busy
+      if (DecMDR = '1' and pSltWr_n = '0' and pSltAdr(5 downto 0) = "111111" and XIdx(7) = '1') then
+        if (EeLd = '0' and EeWr = '0') then
+          EeWq <= '1';
+          EeWA <= XIdx(6 downto 0);
+          EeWD <= pSltDat;
+        end if;
+      elsif (EeWq = '1') then
+        EeWq  <= '0';
+        EeWr  <= '1';
+        EeStp <= "00";
+        EePh  <= "000";
+        EeBit <= "00000";
+        EeLen <= "01010";                        -- EWEN
+        EeSh  <= "100" & "1100000" & "00000000";
+      end if;
+
+      if (EeLd = '1' and DecMDR = '1' and pSltWr_n = '0' and pSltAdr(5 downto 0) = "100011") then
+        EePs <= '1';                             -- bit-bang of 4FA3 during the load
+        EeTo <= (others => '0');
+        EeCS <= '0';
+        EeCK <= '0';
+      elsif (EePs = '1') then
+        EeTo <= EeTo + "0000000000001";
+        if (EeTo = "1111111111111") then         -- idle: send the READ again
+          EePs  <= '0';
+          EePh  <= "000";
+          EeBit <= "00000";
+          EeSh  <= "110" & EeA & "00000000";
+        end if;
+      elsif (EeLd = '1' or EeWr = '1') then
+        EePh <= EePh + "001";
+        if (EeWr = '1' and EeStp = "10") then     -- CS high until DO is high
+          if (EePh = "000") then EeCS <= '1'; EeDI <= '0'; end if;
+          if (EePh = "100") then EeCK <= '1'; end if;
+          if (EePh = "111") then
+            EeCK <= '0';
+            EeTo <= EeTo + "0000000000001";
+            if (EEDO = '1' or EeTo = "1111111111111") then
+              EeStp <= "11";
+              EeBit <= "00000";
+              EeLen <= "01010";                  -- EWDS
+              EeSh  <= "100" & "0000000" & "00000000";
+            end if;
+          end if;
+        else
+          -- bit 0: CS low and one CK pulse, 1..EeLen: CS high, EeLen+1: CS low
+          if (EePh = "000") then
+            if (EeBit = "00000" or EeBit > EeLen) then EeCS <= '0'; else EeCS <= '1'; end if;
+            if (EeBit = "00000") then EeDI <= '0'; else EeDI <= EeSh(17); end if;
+          end if;
+          if (EePh = "100" and EeBit <= EeLen) then EeCK <= '1'; end if;
+          if (EePh = "111") then
+            EeCK <= '0';
+            if (EeBit /= "00000") then EeSh <= EeSh(16 downto 0) & '0'; end if;
+            if (EeBit <= EeLen) then
+              EeBit <= EeBit + "00001";
+            elsif (EeLd = '1') then               -- end of a READ
+              EeBit <= "00000";
+              EeA   <= EeA + "0000001";
+              EeSh  <= "110" & (EeA + "0000001") & "00000000";
+              if (EeA = "1111111") then EeLd <= '0'; end if;
+            elsif (EeStp = "00") then             -- end of EWEN
+              EeStp <= "01";
+              EeBit <= "00000";
+              EeLen <= "10010";                  -- WRITE
+              EeSh  <= "101" & EeWA & EeWD;
+            elsif (EeStp = "01") then             -- end of WRITE
+              EeStp <= "10";
+              EeTo  <= (others => '0');
+            else                                  -- end of EWDS
+              EeWr  <= '0';
+            end if;
+          end if;
+        end if;
+      end if;
+    end if;
+  end process;
+
+  EeCSo <= EeCS when (EeLd = '1' and EePs = '0') or EeWr = '1' else EECS1;
+  EeCKo <= EeCK when (EeLd = '1' and EePs = '0') or EeWr = '1' else EECK1;
+  EeDIo <= EeDI when (EeLd = '1' and EePs = '0') or EeWr = '1' else EEDI1;
+
+  EECS <= '1' when EeCSo = '1' else '0';
+  EECK <= '1' when EeCKo = '1' else '0';
+  EEDI <= '1' when EeDIo = '1' else '0';
+
+-- The shadow follows the pins, whoever drives them: the byte of a READ is stored when
+-- its last bit is clocked out, the byte of a WRITE when EWEN is on. DO is taken as it
+-- was before the rising edge of CK. ERAL and WRAL are not followed.
+  process(pSltClk_n, pSltRst_n)
+  begin
+    if (pSltRst_n = '0') then
+      EeCKp  <= '0';
+      EeDOl  <= '0';
+      EeDs   <= '0';
+      EeDe   <= '0';
+      EeDn   <= "00000";
+      EeDr   <= (others => '0');
+      EeDq   <= "00000000";
+      EeRWe  <= '0';
+      EeRWA  <= "0000000";
+      EeRDat <= "00000000";
+    elsif (pSltClk_n'event and pSltClk_n = '1') then
+      EeCKp <= EeCKo;
+      if (EeCKo = '0') then EeDOl <= EEDO; end if;
+      EeDe  <= '0';
+      EeRWe <= '0';
+      if (EeCSo = '0') then
+        EeDs <= '0';
+      elsif (EeCKo = '1' and EeCKp = '0') then
+        if (EeDs = '0') then                      -- zeros before the start bit
+          EeDs <= EeDIo;
+          EeDn <= "00000";
+        else
+          EeDe <= '1';
+          EeDr <= EeDr(16 downto 0) & EeDIo;
+          EeDq <= EeDq(6 downto 0) & EeDOl;
+          if (EeDn /= "11111") then EeDn <= EeDn + "00001"; end if;
+        end if;
+      end if;
+      -- one clock after the edge: EeDn bits after the start bit are in EeDr
+      if (EeDe = '1') then
+        if (EeDn = "01001" and EeDr(8 downto 7) = "00") then
+          if (EeDr(6 downto 5) = "11") then EeWen <= '1'; end if;   -- EWEN
+          if (EeDr(6 downto 5) = "00") then EeWen <= '0'; end if;   -- EWDS
+        end if;
+        if (EeDn = "10001" and EeDr(16 downto 15) = "01" and EeWen = '1') then
+          EeRWe  <= '1';                          -- WRITE
+          EeRWA  <= EeDr(14 downto 8);
+          EeRDat <= EeDr(7 downto 0);
+        end if;
+        if (EeDn = "10010" and EeDr(17 downto 16) = "10") then
+          EeRWe  <= '1';                          -- READ, after the dummy bit and 8 bits
+          EeRWA  <= EeDr(15 downto 9);
+          EeRDat <= EeDq;
+        end if;
+      end if;
+    end if;
+  end process;
+
+  EeRAdr <= '0' & EeRWA when EeRWe = '1' else '0' & XIdx(6 downto 0);
+  EeRam : ram port map(EeRAdr, pSltClk_n, EeRWe, EeRDat, EeRQ);
 
 ----------------------------------------------------------------
 -- PSG  (SSG + PPI Sound)
@@ -2096,7 +3367,7 @@ begin
   elsif pSltSltsls_n = '0' then RstEN <= '1';
   end if;
 end process;
-    pSltWait_n <= 'Z';
+    pSltWait_n <= '0' when FlWait_n = '0' or IdWait_n = '0' or BkWait_n = '0' or OfWait_n = '0' else 'Z';
 --  pSltWait_n <= '1';
 --
 -- problem detector (test) :)
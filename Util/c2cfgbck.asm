@@ -984,13 +984,43 @@ Reset1:
 	dw	0			; address
 
 
+; Check for the CFG EEPROM shadow of firmware 2.60 and later, it is
+; read and written at XDat #80-#FF
+; output CY - older firmware, bit-bang
+EESHD:
+	ld	hl,CardMDR+#2C
+	ld	a,(hl)
+	cp	"2"
+	ret	nz
+	inc	hl
+	ld	a,(hl)
+	cp	"6"
+	ret
+
+
 ; Read 1 byte from CFG EEPROM
 ; input A - address
 ; outut A - data
 EERD:
 	push	hl
-	ld	hl,CardMDR+#23
 	ld	c,a
+	call	EESHD
+	jr	c,EERDbb
+	ld	hl,CardMDR+#3E
+	ld	a,c
+	or	#80
+	ld	(hl),a
+	ld	l,#B6
+EERDsw:
+	bit	1,(hl)
+	jr	nz,EERDsw
+	ld	l,#BF
+	ld	a,(hl)
+	pop	hl
+	ret
+; bit-bang on older firmware
+EERDbb:
+	ld	hl,CardMDR+#23
 ; one CLK pulse
 	ld	a,%00000100
 	ld	(hl),a
@@ -1063,8 +1093,29 @@ EERDd1:
 ; A - address
 EEWR:
 	push	hl
-	ld	hl,CardMDR+#23
 	ld	c,a
+	call	EESHD
+	jr	c,EEWRbb
+; the firmware sends EWEN, WRITE and EWDS, none is taken while busy
+	ld	hl,CardMDR+#36
+EEWRs1:
+	bit	1,(hl)
+	jr	nz,EEWRs1
+	ld	l,#BE
+	ld	a,c
+	or	#80
+	ld	(hl),a
+	inc	l
+	ld	(hl),e
+	ld	l,#B6
+EEWRs2:
+	bit	1,(hl)
+	jr	nz,EEWRs2
+	pop	hl
+	ret
+; bit-bang on older firmware
+EEWRbb:
+	ld	hl,CardMDR+#23
 ; one CLK pulse
 	ld	a,%00000100
 	ld	(hl),a
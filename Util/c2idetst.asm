@@ -1,7 +1,7 @@
 ;
 ; Tester for Carnivore2 IDE/FDD controller
 ; Copyright (c) 2019-2023 RBSC
-; Version 1.10
+; Version 1.20
 ;
 
 ; !COMPILATION OPTIONS!
@@ -23,8 +23,12 @@ SPC	equ	0		; 1 = for Arabic and Korean computers
 ;--- System calls and variables
 
 DOS		equ	#0005	; DOS function calls entry point
+RDSLT		equ	#000C	; Read a byte from a slot
 CURSF		equ	#FCA9
 DRVINV		equ	#FB21	; number of drives in a system
+JIFFY		equ	#FC9E	; incremented by every VDP interrupt
+EXPTBL		equ	#FCC1	; Main-ROM slot
+IDBYT1		equ	#002B	; Main-ROM ID byte, bit 7: 1 = 50Hz
 
 ;--- DOS function calls
 
@@ -42,12 +46,19 @@ _FSEARCHF	equ	#11	; File Search First
 _FSEARCHN	equ	#12	; File Search Next
 _FDELETE	equ	#13	; Delete file
 _FCREATE	equ	#16	; File Create
+_CURDRV:	equ	#19	; Get current drive
 _SDMA:		equ	#1A	; Set DMA address
+_ALLOC:		equ	#1B	; Get allocation information
 _RBWRITE	equ	#26	; Random block write
 _RBREAD:	equ	#27	; Random block read
 _TERM:		equ	#62	; Terminate with error code
 _DEFAB:		equ	#63	; Define abort exit routine
 _DOSVER:	equ	#6F	; Get DOS version
+_RDDRV:		equ	#73	; Read absolute sectors from drive (Nextor)
+
+;--- Benchmark
+
+BTOTAL		equ	128	; KB moved by each sequential test
 
 
 ;************************
@@ -100,6 +111,15 @@ CheckNum:
 	ld	a,(hl)
 	cp	'?'			; print help?
 	jr	z,HelpPr
+	or	#20			; to lowercase
+	sub	"a"
+	cp	2+1			; 'b' = benchmark, 'c' = CSV output
+	jr	nc,CheckIter
+	or	a
+	jr	z,HelpPr
+	ld	(BENCHM),a
+	jr	CHECK1
+CheckIter:
 	call	EXTNUM			; extract number from string
 	or	a
 	jr	nz,CHECK1
@@ -129,6 +149,10 @@ CHECK1:
 	ld	(FCBCLN),a		; patch FCBs
 
 TSTSTART:
+	ld	a,(BENCHM)
+	or	a
+	jp	nz,BENCH
+
 	print	STTEST			; print test info
 	ld	de,BUFFER
 	ld	a,(USERIT)
@@ -385,6 +409,439 @@ Exit:
 	jp	DOS
 
 
+;------------------------
+;---  Benchmark mode  ---
+;------------------------
+
+BENCH:
+	call	GETHZ
+	call	GETDRV
+	ld	(BDRIVE),a
+	add	a,"A"
+	ld	(BTITLE1),a		; drive letter
+
+	ld	a,(BENCHM)
+	cp	2
+	jr	z,BENCH1
+	print	BTITLE
+	ld	a,(HZ)
+	ld	e,a
+	ld	d,0
+	ld	b,0
+	call	PRNUM
+	print	BTITLE2
+	jr	BENCH2
+BENCH1:
+	print	BCSVH
+BENCH2:
+	ld	hl,#4000
+	ld	bc,#8000
+BPAT:
+	ld	(hl),l			; create pattern
+	inc	hl
+	dec	bc
+	ld	a,b
+	or	c
+	jr	nz,BPAT
+
+	ld	hl,512			; 512 bytes up to 32KB per call
+	ld	(BBLOCK),hl
+	ld	hl,BTOTAL*2
+	ld	(BCOUNT),hl
+BSEQ:
+	call	BROW
+	ld	c,_FCREATE
+	call	BSEQRUN
+	jp	c,BFAIL
+	ld	de,BCSVW
+	call	BRESULT
+	ld	c,_FOPEN
+	call	BSEQRUN
+	jp	c,BFAIL
+	ld	de,BCSVR
+	call	BRESULT
+	call	BROWEND
+
+	ld	hl,(BCOUNT)
+	srl	h
+	rr	l
+	ld	(BCOUNT),hl
+	ld	hl,(BBLOCK)
+	add	hl,hl
+	ld	(BBLOCK),hl
+	jr	nc,BSEQ
+
+	call	BRAND
+	jr	nc,BEXIT
+
+BFAIL:
+	print	BFAILS
+BEXIT:
+	ld	de,FCB
+	ld	c,_FCLOSE		; close data file
+	call	DOS
+
+	ld	de,FCB
+	ld	c,_FDELETE		; delete data file
+	call	DOS
+
+	call	KEYON
+	ld	c,_TERM0
+	jp	DOS
+
+
+;--- Time one sequential pass of BTOTAL KB in calls of (BBLOCK) bytes
+; Input:  C = _FCREATE (write) or _FOPEN (read)
+; Output: HL = jiffies elapsed
+;         Cy = 1 if the file could not be written or read
+;
+BSEQRUN:
+	push	bc
+	ld	hl,FCBCLN
+	ld	de,FCB
+	ld	bc,FCBCLN-FCB
+	ldir				; clear fcb
+	pop	bc
+	ld	a,c
+	cp	_FCREATE
+	ld	a,_RBWRITE
+	jr	z,BSEQR1
+	ld	a,_RBREAD
+BSEQR1:
+	ld	(BFUNC),a
+	ld	de,FCB
+	call	DOS			; create or open file
+	or	a
+	scf
+	ret	nz
+	ld	hl,(BBLOCK)
+	ld	(FCB+14),hl		; record size = block size
+
+	ld	c,_SDMA
+	ld	de,#4000
+	call	DOS			; set DMA
+
+	ld	hl,(JIFFY)
+	ld	(BSTART),hl
+	ld	bc,(BCOUNT)
+BSEQR2:
+	push	bc
+	ld	hl,1
+	ld	de,FCB
+	ld	a,(BFUNC)
+	ld	c,a
+	call	DOS			; one block
+	pop	bc
+	or	a
+	jr	nz,BSEQR3
+	dec	bc
+	ld	a,b
+	or	c
+	jr	nz,BSEQR2
+BSEQR3:
+	push	af
+	ld	hl,(JIFFY)
+	ld	de,(BSTART)
+	or	a
+	sbc	hl,de
+	push	hl
+	ld	de,FCB
+	ld	c,_FCLOSE
+	call	DOS			; close data file
+	pop	hl
+	pop	af
+	or	a
+	ret	z
+	scf
+	ret
+
+
+;--- Random 512 byte sector reads through Nextor _RDDRV
+; Output: Cy = 1 if a read failed
+;
+BRAND:
+	ld	b,#5A
+	ld	hl,#1234
+	ld	de,#ABCD
+	ld	ix,0
+	ld	c,_DOSVER
+	call	DOS			; IXh=1 on Nextor
+	or	a
+	jr	nz,BRAND0
+	ld	a,ixh
+	or	a
+	jr	nz,BRAND1
+BRAND0:
+	ld	a,(BENCHM)
+	cp	2
+	ret	z
+	print	BNONXT
+	or	a
+	ret
+
+BRAND1:
+	ld	a,(FCB)
+	ld	e,a
+	ld	c,_ALLOC
+	call	DOS			; A = sectors per cluster, DE = clusters
+	ex	de,hl
+BRAND2:
+	srl	a			; HL = sectors, at most #FFFF
+	jr	z,BRAND3
+	add	hl,hl
+	jr	nc,BRAND2
+	ld	hl,#FFFF
+BRAND3:
+	ld	de,0			; DE = largest 2^n-1 below it
+BRAND4:
+	srl	h
+	rr	l
+	ld	a,h
+	or	l
+	jr	z,BRAND5
+	scf
+	rl	e
+	rl	d
+	jr	BRAND4
+BRAND5:
+	ld	(BMASK),de
+
+	ld	c,_SDMA
+	ld	de,#4000
+	call	DOS			; set DMA
+
+	ld	hl,(JIFFY)
+	ld	(BSTART),hl
+	ld	b,0			; 256 reads
+BRAND6:
+	push	bc
+	call	RND16
+	ld	a,(BMASK)
+	and	l
+	ld	e,a
+	ld	a,(BMASK+1)
+	and	h
+	ld	d,a
+	ld	hl,0			; HL:DE = sector number
+	ld	b,1
+	ld	a,(BDRIVE)
+	ld	c,_RDDRV
+	call	DOS			; read one sector
+	pop	bc
+	or	a
+	scf
+	ret	nz
+	djnz	BRAND6
+	ld	hl,(JIFFY)
+	ld	de,(BSTART)
+	or	a
+	sbc	hl,de
+	push	hl
+
+	ld	hl,512
+	ld	(BBLOCK),hl
+	ld	hl,256
+	ld	(BCOUNT),hl
+	ld	a,(BENCHM)
+	cp	2
+	jr	z,BRAND7
+	print	BRNDT
+	call	BROW
+	print	BNOWR
+BRAND7:
+	pop	hl
+	ld	de,BCSVRR
+	call	BRESULT
+	call	BROWEND
+	or	a
+	ret
+
+
+;--- Start and end of a table row
+BROW:
+	ld	a,(BENCHM)
+	cp	2
+	ret	z
+	ld	de,(BBLOCK)
+	ld	b,6
+	jp	PRNUM
+
+BROWEND:
+	ld	a,(BENCHM)
+	cp	2
+	ret	z
+	print	CRLF
+	ret
+
+
+;--- Print KB/s and IOPS of a test
+; Input: HL = jiffies elapsed, DE = test name for the CSV output
+;        (BBLOCK) = bytes per call, (BCOUNT) = calls made
+;
+BRESULT:
+	ld	a,h
+	or	l
+	jr	nz,BRES1
+	inc	hl			; less than one jiffy
+BRES1:
+	ld	(BTIME),hl
+	ld	a,(BENCHM)
+	cp	2
+	jr	nz,BRES2
+	push	de
+	ld	a,(BTITLE1)
+	ld	e,a
+	ld	c,_CONOUT
+	call	DOS			; drive letter
+	pop	de
+	ld	c,_STROUT
+	call	DOS			; ",test,"
+	ld	de,(BBLOCK)
+	ld	b,0
+	call	PRNUM
+	ld	e,","
+	ld	c,_CONOUT
+	call	DOS
+BRES2:
+	ld	de,(BCOUNT)		; KB = calls * (block / 256) / 4
+	ld	a,(BBLOCK+1)
+	call	MUL8
+	srl	h
+	rr	l
+	srl	h
+	rr	l
+	ex	de,hl
+	ld	a,(HZ)
+	call	MUL8			; KB * Hz / jiffies
+	ld	a,h
+	ld	c,l
+	ld	de,(BTIME)
+	call	DIV16
+	ld	d,a
+	ld	e,c
+	call	BRESNUM
+
+	ld	de,(BCOUNT)		; calls * Hz / jiffies
+	ld	a,(HZ)
+	call	MUL8
+	ld	a,h
+	ld	c,l
+	ld	de,(BTIME)
+	call	DIV16
+	ld	d,a
+	ld	e,c
+	ld	a,(BENCHM)
+	cp	2
+	ld	b,6
+	jr	nz,PRNUM
+	ld	b,0
+	call	PRNUM
+	print	CRLF
+	ret
+
+BRESNUM:
+	ld	a,(BENCHM)
+	cp	2
+	ld	b,7
+	jr	nz,PRNUM
+	ld	b,0
+	call	PRNUM
+	ld	e,","
+	ld	c,_CONOUT
+	jp	DOS
+
+
+;--- Print a decimal number
+; Input: DE = number, B = field width (0 = no padding)
+;
+PRNUM:
+	ld	hl,BUFFER
+	ld	c," "
+	ld	a,%00001000
+	call	NUMTOASC
+	print	BUFFER
+	ret
+
+
+;--- HL = DE * A
+MUL8:
+	ld	hl,0
+	ld	b,8
+MUL8L:
+	add	hl,hl
+	rla
+	jr	nc,MUL8N
+	add	hl,de
+MUL8N:
+	djnz	MUL8L
+	ret
+
+
+;--- AC = AC / DE, HL = remainder
+DIV16:
+	ld	hl,0
+	ld	b,16
+DIV16L:
+	sla	c
+	rla
+	adc	hl,hl
+	sbc	hl,de
+	jr	nc,DIV16S
+	add	hl,de
+	djnz	DIV16L
+	ret
+DIV16S:
+	inc	c
+	djnz	DIV16L
+	ret
+
+
+;--- 16 bit xorshift, HL = next number
+RND16:
+	ld	hl,(BSEED)
+	ld	a,h
+	rra
+	ld	a,l
+	rra
+	xor	h
+	ld	h,a
+	ld	a,l
+	rra
+	ld	a,h
+	rra
+	xor	l
+	ld	l,a
+	xor	h
+	ld	h,a
+	ld	(BSEED),hl
+	ret
+
+
+;--- Timer frequency: 50 or 60 jiffies per second
+GETHZ:
+	ld	a,(EXPTBL)
+	ld	hl,IDBYT1
+	call	RDSLT
+	ei
+	ld	b,60
+	rla
+	jr	nc,GETHZ1
+	ld	b,50
+GETHZ1:
+	ld	a,b
+	ld	(HZ),a
+	ret
+
+
+;--- Drive under test, A = 0 for A:
+GETDRV:
+	ld	a,(FCB)
+	dec	a
+	ret	p
+	ld	c,_CURDRV
+	jp	DOS
+
+
 
 ;---- Out to conlose HEX byte
 ; A - byte
@@ -1044,6 +1501,17 @@ USERIT:	db	0
 SHEX:	db	0
 SDEC:	db	0
 
+BENCHM:	db	0		; 0 = test, 1 = benchmark table, 2 = CSV
+BDRIVE:	db	0
+HZ:	db	0
+BFUNC:	db	0
+BBLOCK:	dw	0
+BCOUNT:	dw	0
+BSTART:	dw	0
+BTIME:	dw	0
+BMASK:	dw	0
+BSEED:	dw	#ACE1
+
 ITERM:
 	db	"Iteration: $"
 
@@ -1074,18 +1542,46 @@ STTEST3:
 CRLF:
 	db	13,10,"$"
 
+BTITLE:
+	db	"Benchmark on drive "
+BTITLE1:
+	db	"A:, 128KB per test, timer $"
+BTITLE2:
+	db	"Hz",13,10,13,10
+	db	"          Write        Read",13,10
+	db	" Block   KB/s   IOPS   KB/s   IOPS",13,10,"$"
+BNOWR:
+	db	"      -      -$"
+BRNDT:
+	db	"Random sector reads:",13,10,"$"
+BNONXT:
+	db	"Random sector reads need Nextor.",13,10,"$"
+BFAILS:
+	db	13,10,"Benchmark failed!",13,10,"$"
+
+BCSVH:
+	db	"drive,test,block,kbps,iops",13,10,"$"
+BCSVW:
+	db	",seqwrite,$"
+BCSVR:
+	db	",seqread,$"
+BCSVRR:
+	db	",randread,$"
+
 PRESENT_S:
-	db	"Carnivore2 IDE Tester v1.10",13,10
+	db	"Carnivore2 IDE Tester v1.20",13,10
 	db	"Copyright (c) 2019-2023 by RBSC",13,10,13,10,"$"
 
 FLAGS:
 	db	"Usage:",13,10
-	db	" C2IDETST [/?] [/N] [Drive]",13,10
+	db	" C2IDETST [/?] [/N] [/B] [/C] [Drive]",13,10
 	db	"  where 'N' = number of iterations: 2-99",13,10
+	db	"  'B' = benchmark, 'C' = benchmark as CSV",13,10
 	db	"  and 'Drive' = drive letter A-Z",13,10
 	db	"  or '?' = show help",13,10,13,10
 	db	" Examples:",13,10
 	db	"  C2IDETST /25 A",13,10
+	db	"  C2IDETST /B A",13,10
 	db	"  C2IDETST /?",13,10,13,10,"$"
 
 BUFFER:	ds	256
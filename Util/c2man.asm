@@ -774,6 +774,9 @@ Fpo:
 	print	ONE_NL_S
 
 vrb00:
+	ld	a,(F_D)
+	or	a
+	jp	nz,DSKIMG		; disk image for the ROM disk
 
 ; File size <= 32  ?
 ;	ld	a,(Size+3)
@@ -4536,6 +4539,8 @@ rdt20:
 	ld	a,(ix+#04)		; mapper symbol
 	cp	"C"
 	jp	z,rdt10			; no editing for CFG entries	
+	cp	"D"
+	jp	z,rdt10			; no editing for ROM disk entries
 
 ; preset type cartridge
 	call	CLRSCR
@@ -7651,12 +7656,13 @@ EMBC_S:	db	"EMB Customer Lockable",13,10,"$"
 
 H_PAR_S:
 	db	"Usage:",13,10,13,10
-	db	" c2man [filename.rom] [/h] [/v] [/a] [/r]",13,10,13,10
+	db	" c2man [filename.rom] [/h] [/v] [/a] [/r] [/d]",13,10,13,10
 	db	"Command line options:",13,10
 	db	" /h  - this help screen",13,10
 	db	" /v  - verbose mode (detailed information)",13,10
 	db	" /a  - autodetect and flash ROM image (no user interaction)",13,10
 	db	" /r  - automatically restart MSX after flashing ROM image",10,13
+	db	" /d  - flash a FAT disk image as ROM disk for the Nextor driver",10,13
 	db	" /su - enable Super User mode",13,10
 	db	"       (editing all registers + IDE BIOS writing without shadow copy)",10,13,"$"
 
@@ -7713,6 +7719,7 @@ H_PAR_S:
 	db	" /v  - verbose mode (detailed info)",13,10
 	db	" /a  - autodetect and flash ROM image",13,10
 	db	" /r  - restart MSX after flashing ROM image",10,13
+	db	" /d  - flash a disk image as ROM disk",10,13
 	db	" /su - enable Super User mode",13,10
 	db	"      (editing all registers + IDE BIOS",10,13
 	db	"       writing without shadow copy)",10,13,"$"
@@ -7896,6 +7903,19 @@ fkey05:
 	ld	(F_R),a			; reset flag
 	ret
 fkey06:
+	ld	hl,BUFFER+1
+	ld	a,(hl)
+	and	%11011111
+	cp	"D"
+	jr	nz,fkey07
+	inc	hl
+	ld	a,(hl)
+	or	a
+	jr	nz,fkey07
+	ld	a,6
+	ld	(F_D),a			; disk image flag
+	ret
+fkey07:
 	xor	a
 	dec	a			; S - Illegal flag
 	ret
@@ -8013,6 +8033,8 @@ RCPFound:
 	db	10,13,"Use loaded RCP data for this ROM? (y/n) $"
 UsingRCP:
 	db	"Autodetection ignored, using data from RCP file...",10,13,"$"
+DskImg_S:
+	db	"Disk image, it will be the ROM disk of the Nextor driver",10,13,"$"
 
 FileOver_S:
 	db	"File is too big or there's no free space on the FlashROM chip!",13,10,"$"
@@ -8122,6 +8144,8 @@ RCPFound:
 	db	10,13,"Use RCP data for this ROM? (y/n) $"
 UsingRCP:
 	db	"Autodetection ignored.",10,13,"Using data from RCP file...",10,13,"$"
+DskImg_S:
+	db	"Disk image, it will be the ROM disk",10,13,"of the Nextor driver",10,13,"$"
 
 FileOver_S:
 	db	"File is too big or there's no free space",10,13,"on the FlashROM chip!",13,10,"$"
@@ -8266,6 +8290,40 @@ HMRTB	db	"Mini and Multi ROM control register",13,10
 HSOB	db	"ROM's starting options register",13,10
 	db	"Press [SPACE] to edit the bitmask$"
 
+;------------------------------------------------------------------------------
+; ROM disk image (c2man /d), kept here as there is no room left below #4000
+;
+; The file is flashed as it is, without mapper detection. The directory entry
+; gets type "D" and all banks disabled: it is not a ROM to start, the Nextor
+; driver of BIOSes/Sources looks for it at boot.
+;
+DSKIMG:
+	ld	de,FCB
+	ld	c,_FCLOSE
+	call	DOS			; close file
+
+	xor	a
+	ld	(RCPData),a		; RCP data not used
+	ld	(SRSize),a
+	ld	a,"D"
+	ld	(Record+04),a		; ROM disk image
+	ld	hl,DSKTAB
+	ld	de,Record+#23		; Record register map
+	ld	bc,29
+	ldir
+
+	print	DskImg_S
+	jp	SFM80
+
+DSKTAB:
+	db	#F8,#50,#00,#8C,#3F,#40
+	db	#F8,#70,#01,#8C,#3F,#60
+	db      #F8,#90,#02,#8C,#3F,#80
+	db	#F8,#B0,#03,#8C,#3F,#A0
+	db	#FF,#AC,#00,#02,#FF
+
+F_D	db	0			; disk image flag
+
 EXIT_S:	db	10,13,"Thanks for using RBSC's products!",13,10,"$"
 
 	db	0
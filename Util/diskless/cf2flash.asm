@@ -72,85 +72,7 @@ ADESCR:	equ	#4010
 
 L_STR:	equ	16	 	; number of entries on the screen
 MAPPN:	equ	5		; max number of currently supported mappers
-
-;-----------------------------------------------------------------------------
-;
-; IDE registers and bit definitions
-
-IDE_BANK	equ	#4104	;bit 0: enable (1) or disable (0) IDE registers
-				;bits 5-7: select 16K ROM bank
-IDE_DATA	equ	#7C00	;Data registers, this is a 512 byte area
-IDE_ERROR	equ	#7E01	;Error register
-IDE_FEAT	equ	#7E01	;Feature register
-IDE_SECCNT	equ	#7E02	;Sector count
-IDE_SECNUM	equ	#7E03	;Sector number (CHS mode)
-IDE_LBALOW	equ	#7E03	;Logical sector low (LBA mode)
-IDE_CYLOW	equ	#7E04	;Cylinder low (CHS mode)
-IDE_LBAMID	equ	#7E04	;Logical sector mid (LBA mode)
-IDE_CYHIGH	equ	#7E05	;Cylinder high (CHS mode)
-IDE_LBAHIGH	equ	#7E05	;Logical sector high (LBA mode)
-IDE_HEAD	equ	#7E06	;bits 0-3: Head (CHS mode), logical sector higher (LBA mode)
-IDE_STATUS	equ	#7E07	;Status register
-IDE_CMD		equ	#7E07	;Command register
-IDE_DEVCTRL	equ	#7E0E	;Device control register
-
-; Bits in the error register
-
-UNC	equ	6	;Uncorrectable Data Error
-WP	equ	6	;Write protected
-MC	equ	5	;Media Changed
-IDNF	equ	4	;ID Not Found
-MCR	equ	3	;Media Change Requested
-ABRT	equ	2	;Aborted Command
-NM	equ	1	;No media
-
-M_ABRT	equ	1<<ABRT
-
-; Bits in the head register
-
-DEV	equ	4	;Device select: 0=master, 1=slave
-LBA	equ	6	;0=use CHS mode, 1=use LBA mode
-
-M_DEV	equ	1<<DEV
-M_LBA	equ	1<<LBA
-
-; Bits in the status register
-
-BSY	equ	7	;Busy
-DRDY	equ	6	;Device ready
-DF	equ	5	;Device fault
-DRQ	equ	3	;Data request
-ERR	equ	0	;Error
-
-M_BSY	equ	1<<BSY
-M_DRDY	equ	1<<DRDY
-M_DF	equ	1<<DF
-M_DRQ	equ	1<<DRQ
-M_ERR	equ	1<<ERR
-
-; Bits in the device control register register
-
-SRST	equ	2	;Software reset
-
-M_SRST	equ	1<<SRST
-;-----------------------------------------------------------------------------
-;
-; Error codes for DEV_RW and DEV_FORMAT
-;
-
-.NCOMP	equ	#0FF
-.WRERR	equ	#0FE
-.DISK	equ	#0FD
-.NRDY	equ	#0FC
-.DATA	equ	#0FA
-.RNF	equ	#0F9
-.WPROT	equ	#0F8
-.UFORM	equ	#0F7
-.SEEK	equ	#0F3
-.IFORM	equ	#0F0
-.IDEVL	equ	#0B5
-.IPARM	equ	#08B
-
+CF_CHUNK:	equ	4		; sectors read from CF at once (2kB at BUFTOP)
 
 ;-----------------------------------------------------------------------------
 
@@ -620,14 +542,19 @@ FBProgCF:
 	di
 Loop1Block:
 	exx
-	ld	c,1
+	ld	c,CF_CHUNK
 	ld	de,(CurrentBlock)
 	ld	hl,BUFTOP
 	call	ReadBlocks
 	exx
 	jp	nz,Ld_Fail
 	ld	hl,(CurrentBlock)
-	inc	hl
+	ld	a,CF_CHUNK
+	add	a,l
+	ld	l,a
+	adc	a,h
+	sub	l
+	ld	h,a
 	ld	(CurrentBlock),hl
 	ld	hl,BUFTOP
 	ld	c,0
@@ -650,7 +577,7 @@ Loop1CF:
 	jr	nz,Loop1CF
 	dec	b
 	ld	a,b
-	and	1
+	and	CF_CHUNK*2-1
 	jr	nz,Loop1CF
 	or	b
 	jr	nz,Loop1Block
@@ -674,14 +601,19 @@ FBProg2:
 
 Loop2Block:
 	exx
-	ld	c,1
+	ld	c,CF_CHUNK
 	ld	de,(CurrentBlock)
 	ld	hl,BUFTOP
 	call	ReadBlocks
 	exx
 	jp	nz,Ld_Fail
 	ld	hl,(CurrentBlock)
-	inc	hl
+	ld	a,CF_CHUNK
+	add	a,l
+	ld	l,a
+	adc	a,h
+	sub	l
+	ld	h,a
 	ld	(CurrentBlock),hl
 	ld	hl,BUFTOP
 	ld	c,0
@@ -704,7 +636,10 @@ Loop2:
 	ld	a,b
 	sub	a,2
 	ld	b,a
-	jr	nz,Loop2Block
+	jr	z,PrEr
+	and	CF_CHUNK*2-1
+	jr	nz,Loop2
+	jr	Loop2Block
 PrEr:
 ;    	save flag CF - fail
 	ei
@@ -981,51 +916,7 @@ ReadBlocks:
 	pop	hl
 	pop	de
 	pop	bc
-	xor	a
-	ld	b,a
-	ld	a,c
-	or	a
-	jr	nz,DEV_RW_NO0SEC
-	xor	a
-	ld	b,0
-	jr	ReadBlocksDone
-DEV_RW_NO0SEC:
-	call	IDE_ON
-	xor	a
-	or	M_LBA
-	ld	(IDE_HEAD),a	;IDE_HEAD must be written first,
-	ld	a,e		;or the other IDE_LBAxxx and IDE_SECCNT
-	ld	(IDE_LBALOW),a	;registers will not get a correct value
-	ld	a,d		;(blueMSX issue?)
-	ld	(IDE_LBAMID),a
-	xor	a
-	ld	(IDE_LBAHIGH),a
-	ld	a,c
-	ld	(IDE_SECCNT),a
-	call	WAIT_CMD_RDY
-	jr	c,ReadBlocksRwErr
-	ld	a,#20
-	push	bc	;Save sector count
-	call	DO_IDE
-	pop	bc
-	jr	c,ReadBlocksRwErr
-
-	call	DEV_RW_FAULT
-	jr	nz,ReadBlocksDone
-
-	ld	b,c	;Retrieve sector count
-	ex	de,hl
-DEV_R_GDATA:
-	push	bc
-	ld	hl,IDE_DATA
-	ld	bc,512
-	ldir
-	pop	bc
-	djnz	DEV_R_GDATA
-
-	call	IDE_OFF
-	xor	a
-ReadBlocksDone:
+	call	IDE_READ
 	push	af
 	push	bc
 	ld	a,(FlashSlotId)
@@ -1034,123 +925,9 @@ ReadBlocksDone:
 	pop	bc
 	pop	af
 	ret
-ReadBlocksRwErr:
-	call	DEV_RW_ERR
-	jr	ReadBlocksDone
 
 
-;-----------------------------------------------------------------------------
-; Enable or disable the IDE registers
-; Note that bank 7 (the driver code bank) must be kept switched
-;
-IDE_ON:
-	ld	a,1+7*32
-	ld	(IDE_BANK),a
-	ret
-
-IDE_OFF:
-	ld	a,7*32
-	ld	(IDE_BANK),a
-	ret
-	
-DEV_RW_ERR:
-	ld	a,(IDE_ERROR)
-	ld	b,a
-	call	IDE_OFF
-	ld	a,b	
-
-	bit	NM,a	;Not ready
-	jr	nz,DEV_R_ERR1
-	ld	a,.NRDY
-	ld	b,0
-	ret
-DEV_R_ERR1:
-
-	bit	IDNF,a	;Sector not found
-	jr	nz,DEV_R_ERR2
-	ld	a,.RNF
-	ld	b,0
-	ret
-DEV_R_ERR2:
-
-	bit	WP,a	;Write protected
-	jr	nz,DEV_R_ERR3
-	ld	a,.WPROT
-	ld	b,0
-	ret
-DEV_R_ERR3:
-
-	ld	a,.DISK	;Other error
-	ld	b,0
-	ret
-
-	;--- Check for device fault
-	;    Output: NZ and A=.DISK on fault
-
-DEV_RW_FAULT:
-	ld	a,(IDE_STATUS)
-	and	M_DF	;Device fault
-	ret	z
-
-	call	IDE_OFF
-	ld	a,.DISK
-	ld	b,0
-	or	a
-	ret
-
-
-;-----------------------------------------------------------------------------
-; Wait the BSY flag to clear and RDY flag to be set
-; if we wait for more than 30s, send a soft reset to IDE BUS
-; if the soft reset didn't work after 30s return with error
-;
-; Input:  Nothing
-; Output: Cy=1 if timeout after soft reset 
-; Preserves: DE and BC
-;
-WAIT_CMD_RDY:
-	push	de
-	push	bc
-	ld	de,8142		;Limit the wait to 30s
-WAIT_RDY1:
-	ld	b,255
-WAIT_RDY2:
-	ld	a,(IDE_STATUS)
-	and	M_BSY+M_DRDY
-	cp	M_DRDY
-	jr	z,WAIT_RDY_END	;Wait for BSY to clear and DRDY to set		
-	djnz	WAIT_RDY2	;End of WAIT_RDY2 loop
-	dec	de
-	ld	a,d
-	or	e
-	jr	nz,WAIT_RDY1	;End of WAIT_RDY1 loop
-	scf
-WAIT_RDY_END:
-	pop	bc
-	pop	de
-	ret	
-
-
-;-----------------------------------------------------------------------------
-; Execute a command
-; Input:  A = Command code
-;         Other command registers appropriately set
-; Output: Cy=1 if ERR bit in status register set
-;
-DO_IDE:
-	ld	(IDE_CMD),a
-
-WAIT_IDE:
-	nop	; Wait 50us
-	ld	a,(IDE_STATUS)
-	bit	DRQ,a
-	jr	nz,IDE_END
-	bit	BSY,a
-	jr	nz,WAIT_IDE
-
-IDE_END:
-	rrca
-	ret
+	include	"../lib/ide.inc"
 
 
 ;------------------------------------------------------	
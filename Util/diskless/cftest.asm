@@ -20,85 +20,6 @@ SCR0WID	equ	#F3AE		; Screen0 width
 
 PPI_SLOT = 0xa8
 
-;-----------------------------------------------------------------------------
-;
-; IDE registers and bit definitions
-
-IDE_BANK	equ	0x4104	;bit 0: enable (1) or disable (0) IDE registers
-				;bits 5-7: select 16K ROM bank
-IDE_DATA	equ	0x7C00	;Data registers, this is a 512 byte area
-IDE_ERROR	equ	0x7E01	;Error register
-IDE_FEAT	equ	0x7E01	;Feature register
-IDE_SECCNT	equ	0x7E02	;Sector count
-IDE_SECNUM	equ	0x7E03	;Sector number (CHS mode)
-IDE_LBALOW	equ	0x7E03	;Logical sector low (LBA mode)
-IDE_CYLOW	equ	0x7E04	;Cylinder low (CHS mode)
-IDE_LBAMID	equ	0x7E04	;Logical sector mid (LBA mode)
-IDE_CYHIGH	equ	0x7E05	;Cylinder high (CHS mode)
-IDE_LBAHIGH	equ	0x7E05	;Logical sector high (LBA mode)
-IDE_HEAD	equ	0x7E06	;bits 0-3: Head (CHS mode), logical sector higher (LBA mode)
-IDE_STATUS	equ	0x7E07	;Status register
-IDE_CMD		equ	0x7E07	;Command register
-IDE_DEVCTRL	equ	0x7E0E	;Device control register
-
-; Bits in the error register
-
-UNC	equ	6	;Uncorrectable Data Error
-WP	equ	6	;Write protected
-MC	equ	5	;Media Changed
-IDNF	equ	4	;ID Not Found
-MCR	equ	3	;Media Change Requested
-ABRT	equ	2	;Aborted Command
-NM	equ	1	;No media
-
-M_ABRT	equ	1<<ABRT
-
-; Bits in the head register
-
-DEV	equ	4	;Device select: 0=master, 1=slave
-LBA	equ	6	;0=use CHS mode, 1=use LBA mode
-
-M_DEV	equ	1<<DEV
-M_LBA	equ	1<<LBA
-
-; Bits in the status register
-
-BSY	equ	7	;Busy
-DRDY	equ	6	;Device ready
-DF	equ	5	;Device fault
-DRQ	equ	3	;Data request
-ERR	equ	0	;Error
-
-M_BSY	equ	1<<BSY
-M_DRDY	equ	1<<DRDY
-M_DF	equ	1<<DF
-M_DRQ	equ	1<<DRQ
-M_ERR	equ	1<<ERR
-
-; Bits in the device control register register
-
-SRST	equ	2	;Software reset
-
-M_SRST	equ	1<<SRST
-;-----------------------------------------------------------------------------
-;
-; Error codes for DEV_RW and DEV_FORMAT
-;
-
-.NCOMP	equ	0x0FF
-.WRERR	equ	0x0FE
-.DISK	equ	0x0FD
-.NRDY	equ	0x0FC
-.DATA	equ	0x0FA
-.RNF	equ	0x0F9
-.WPROT	equ	0x0F8
-.UFORM	equ	0x0F7
-.SEEK	equ	0x0F3
-.IFORM	equ	0x0F0
-.IDEVL	equ	0x0B5
-.IPARM	equ	0x08B
-
-
 ;-----------------------------------------------------------------------------
 
 print	macro	
@@ -254,7 +175,7 @@ dumpIDE_do:
 	ld	(dumpROM_addr),de
 	ld	bc,1
 	ld	hl,BUFTOP
-	call	READSECT
+	call	IDE_READ
 	or	a
 	jr	z,sect0_OK
 	print	SECT0_ERR
@@ -286,174 +207,8 @@ getSSlot:
 	
 	
 	
-;----------------------------------------------------------------------------
-;          C = Number of sectors to read
-;          HL = Destination memory address for the transfer
-;          DE = 2 byte sector number
-;Output:   A = Error code (the same codes of MSX-DOS are used):
-;              0: Ok
-;          B = Number of sectors actually read/written
-READSECT:	
-	xor	a
-	ld	b,a
-	ld	a,c
-	or	a
-	jr	nz,DEV_RW_NO0SEC
-	xor	a
-	ld	b,0
-	ret	
-DEV_RW_NO0SEC:
-	call	IDE_ON
-	xor	a
-	or	M_LBA
-	ld	(IDE_HEAD),a	;IDE_HEAD must be written first,
-	ld	a,e		;or the other IDE_LBAxxx and IDE_SECCNT
-	ld	(IDE_LBALOW),a	;registers will not get a correct value
-	ld	a,d		;(blueMSX issue?)
-	ld	(IDE_LBAMID),a
-	xor	a
-	ld	(IDE_LBAHIGH),a
-	ld	a,c
-	ld	(IDE_SECCNT),a
-	call	WAIT_CMD_RDY
-	jr	c,DEV_RW_ERR
-	ld	a,0x20
-	push	bc	;Save sector count
-	call	DO_IDE
-	pop	bc
-	jr	c,DEV_RW_ERR
-
-	call	DEV_RW_FAULT
-	ret	nz
-
-	ld	b,c	;Retrieve sector count
-	ex	de,hl
-DEV_R_GDATA:
-	push	bc
-	ld	hl,IDE_DATA
-	ld	bc,512
-	ldir
-	pop	bc
-	djnz	DEV_R_GDATA
-
-	call	IDE_OFF
-	xor	a
-	ret
-;-----------------------------------------------------------------------------
-;
-; Enable or disable the IDE registers
-
-;Note that bank 7 (the driver code bank) must be kept switched
-
-IDE_ON:
-	ld	a,1+7*32
-	ld	(IDE_BANK),a
-	ret
+	include	"../lib/ide.inc"
 
-IDE_OFF:
-	ld	a,7*32
-	ld	(IDE_BANK),a
-	ret
-	
-DEV_RW_ERR:
-	ld	a,(IDE_ERROR)
-	ld	b,a
-	call	IDE_OFF
-	ld	a,b	
-
-	bit	NM,a	;Not ready
-	jr	nz,DEV_R_ERR1
-	ld	a,.NRDY
-	ld	b,0
-	ret
-DEV_R_ERR1:
-
-	bit	IDNF,a	;Sector not found
-	jr	nz,DEV_R_ERR2
-	ld	a,.RNF
-	ld	b,0
-	ret
-DEV_R_ERR2:
-
-	bit	WP,a	;Write protected
-	jr	nz,DEV_R_ERR3
-	ld	a,.WPROT
-	ld	b,0
-	ret
-DEV_R_ERR3:
-
-	ld	a,.DISK	;Other error
-	ld	b,0
-	ret
-
-	;--- Check for device fault
-	;    Output: NZ and A=.DISK on fault
-
-DEV_RW_FAULT:
-	ld	a,(IDE_STATUS)
-	and	M_DF	;Device fault
-	ret	z
-
-	call	IDE_OFF
-	ld	a,.DISK
-	ld	b,0
-	or	a
-	ret
-;-----------------------------------------------------------------------------
-;
-; Wait the BSY flag to clear and RDY flag to be set
-; if we wait for more than 30s, send a soft reset to IDE BUS
-; if the soft reset didn't work after 30s return with error
-;
-; Input:  Nothing
-; Output: Cy=1 if timeout after soft reset 
-; Preserves: DE and BC
-
-WAIT_CMD_RDY:
-	push	de
-	push	bc
-	ld	de,8142		;Limit the wait to 30s
-WAIT_RDY1:
-	ld	b,255
-WAIT_RDY2:
-	ld	a,(IDE_STATUS)
-	and	M_BSY+M_DRDY
-	cp	M_DRDY
-	jr	z,WAIT_RDY_END	;Wait for BSY to clear and DRDY to set		
-	djnz	WAIT_RDY2	;End of WAIT_RDY2 loop
-	dec	de
-	ld	a,d
-	or	e
-	jr	nz,WAIT_RDY1	;End of WAIT_RDY1 loop
-	scf
-WAIT_RDY_END:
-	pop	bc
-	pop	de
-	ret	
-
-;-----------------------------------------------------------------------------
-;
-; Execute a command
-;
-; Input:  A = Command code
-;         Other command registers appropriately set
-; Output: Cy=1 if ERR bit in status register set
-
-DO_IDE:
-	ld	(IDE_CMD),a
-
-WAIT_IDE:
-	nop	; Wait 50us
-	ld	a,(IDE_STATUS)
-	bit	DRQ,a
-	jr	nz,IDE_END
-	bit	BSY,a
-	jr	nz,WAIT_IDE
-
-IDE_END:
-	rrca
-	ret
-	
 ;-----------------------------------------------------------------------------
 
 ; Input string to buffer in HL
@@ -250,6 +250,8 @@ static char rcp_file[256];
 static uint8_t rcp_data[30];
 static uint8_t record[64];
 static uint8_t *block_buffer = (uint8_t *)0x6000;
+static SECTOR_map rom_map;
+static bool rom_mapped;
 static uint8_t B2ON[6] = { 0xF0, 0x70, 0x01, 0x15, 0x7F, 0x80 };
 static uint8_t SRSize;
 
@@ -840,6 +842,14 @@ int main(char** argv, int argc)
         print("\r\n");
     }
 
+    // Nextor: map the file clusters once and read it with raw sector reads
+    if (dosVersion() >= VER_NextorDOS && smap_open(filename, &rom_map) == 0) {
+        rom_mapped = true;
+        if (flag_verbose) {
+            printf("Raw sector reads, file fragments: %d\r\n", rom_map.count);
+        }
+    }
+
     // Enable bank 2
     MapRegWrite(MConf, MapRegRead(MConf)); // overwrite any pending configuration change
     MapRegWrite(CardMDR, 0x20); // immediate changes enabled
@@ -911,7 +921,14 @@ int main(char** argv, int argc)
     uint8_t PreBnk = 0;              // no shift for the first block
     while(blocks8k--) {
         // load portion from file
-        if (!fread(block_buffer, blocks8k? 0x2000 : lastsize, fh)) {
+        uint16_t size = blocks8k? 0x2000 : lastsize;
+        if (rom_mapped) {
+            if (smap_read(&rom_map, block_buffer, (size + 511) >> 9)) {
+                print("\r\nFile read error!\r\n");
+                return 1;
+            }
+        }else
+        if (!fread(block_buffer, size, fh)) {
             print("\r\nFile read error!\r\n");
             return 1;
         }
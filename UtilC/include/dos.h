@@ -61,7 +61,9 @@ typedef uint8_t  FILEH;
 // http://map.grauw.nl/resources/msxsystemvars.php
 // https://www.msx.org/wiki/System_variables_and_work_area
 #define SYSFCB	0x005c	// File control block in the CP/M system area
-#define EXPTBL  0xfcc1	// (BYTE) BIOS slot
+#ifndef EXPTBL
+	#define EXPTBL  0xfcc1	// (BYTE) BIOS slot
+#endif
 #define PUTPNT	0xf3f8	// (WORD) Address in the keyboard buffer where a character will be written
 #define GETPNT	0xf3fa	// (WORD) Address in the keyboard buffer where the next character is read
 
@@ -144,6 +146,9 @@ typedef uint8_t  FILEH;
 #define VER_MSXDOS2x    2
 #define VER_NextorDOS   3
 
+/* Nextor versions from nextorVersion() */
+#define NXTR_VER_2_1    0x0201	// _ZSTROUT, _FOUT and the other 71h-7Eh functions
+
 /* open/create flags */
 #define O_RDWR     0x00
 #define O_RDONLY   0x01
@@ -175,6 +180,14 @@ typedef uint8_t  FILEH;
 #define FASTOUT_OFF   0x00
 #define FASTOUT_ON    0xff
 
+/* STREAM flags */
+#define STREAM_FCB      0x01	// Read through the SYSFCB (MSX-DOS 1.x) instead of a file handle
+#define STREAM_HEAPBUF  0x02	// Buffer was taken from the heap by sopen(...)
+#define STREAM_EOF      0x40	// End of file reached
+#define STREAM_ERROR    0x80	// Read error
+
+#define STREAM_BUFSIZE  1024	// Default buffer size when sopen(...) allocates it
+
 /* GDLI Drive Status values */
 #define DRVSTAT_UNASSIGNED   0
 #define DRVSTAT_ASSIGNED     1
@@ -417,6 +430,40 @@ typedef struct {
 	uint8_t slotAddress;	// F000SSPP
 } MAPPER_Segment;
 
+#define FAR_MAXSEGS     64		// Max 16KB segments of a far buffer (1MB)
+#define FAR_SEGSIZE     0x4000	// Size of a mapper segment
+#define FAR_PAGE2       ((uint8_t*)0x8000)	// Far buffers are mapped in page 2
+
+typedef struct {			// Far memory buffer, see far_alloc(...)
+	uint32_t size;			// Size in bytes
+	uint8_t  count;			// Count of allocated segments
+	uint8_t  segs[FAR_MAXSEGS];	// Segment numbers (primary mapper)
+} FARBUF;
+
+typedef struct {			// Buffered read stream, see sopen(...)
+	FILEH    fh;			// File handle (unused with STREAM_FCB)
+	uint8_t  flags;			// STREAM_xxx flags
+	char    *buf;			// Buffer address
+	uint16_t size;			// Buffer size in bytes
+	uint16_t pos;			// Offset of the next byte to return
+	uint16_t len;			// Count of valid bytes in the buffer
+} STREAM;
+
+#define SMAP_MAXRUNS    32		// Max runs of contiguous sectors of a mapped file
+
+typedef struct {			// Contiguous sectors of a file
+	uint32_t sector;		// First sector of the run
+	uint16_t count;			// Sectors in the run
+} SECTOR_run;
+
+typedef struct {			// Sector map of a file, see smap_open(...) (Nextor only)
+	uint8_t  drive;			// Drive number (0=A: etc)
+	uint8_t  count;			// Runs in use
+	uint8_t  pos;			// Run of the next sector to read
+	uint16_t offset;		// Offset of the next sector in its run
+	SECTOR_run run[SMAP_MAXRUNS];
+} SECTOR_map;
+
 /* MSX-DOS/Nextor data structures */
 
 #define MAX_INSTALLED_DRIVERS 8
@@ -537,9 +584,20 @@ RETDW ftell(FILEH fh);
 RETDW filesize(char *filename);
 bool  fileexists(char* filename);
 
+// Buffered streams (MSX-DOS 1 or 2)
+ERRB  sopen(STREAM *s, FILEH fh, char *buf, uint16_t size);
+void  sclose(STREAM *s);
+RETW  sfill(STREAM *s);
+int   sgetc(STREAM *s);
+char* sgets(char *str, uint16_t size, STREAM *s);
+RETW  sread(char *buf, uint16_t size, STREAM *s);
+RETDW ssync(STREAM *s);
+char* _fgets(char *str, uint16_t size, FILEH fh, uint8_t flags);	// fgets on a handle, or the SYSFCB with STREAM_FCB
+
 // MSX-DOS 1.x
 void  dos_initializeFCB(void);
 RETB  dosVersion(void) __sdcccall(1);
+RETW  nextorVersion(void);
 RETB  supportDos2(void) __sdcccall(1);
 RETB  getCurrentDrive(void) __sdcccall(1);
 char* getProgramPath(char *path);
@@ -606,6 +664,10 @@ ERRB nxtr_writeAbsoluteSectorDrv(uint8_t drive, uint32_t startsec, uint8_t nsec)
 ERRB nxtr_set_drive_lock(uint8_t drive, uint8_t value);
 ERRB nxtr_get_drive_lock(uint8_t drive);
 
+// Sector maps: raw sector reads of a file (NextorDOS only, FAT12/FAT16)
+ERRB  smap_open(const char *filename, SECTOR_map *map);
+ERRB  smap_read(SECTOR_map *map, char *buf, uint8_t nsec);
+
 // Memory mapper (MSX-DOS 2.x)
 RETB mapperInit(void);
 RETB mapperGetSlot(void);
@@ -616,3 +678,18 @@ ERRB mapperFreeSegment(MAPPER_Segment *segmentToFree) __z88dk_fastcall;
 void mapperSetSegment(uint8_t page, MAPPER_Segment *segment);
 RETB mapperGetCurrentSegment(uint8_t page);
 void mapperSetOriginalSegmentBack(uint8_t page);
+
+// Memory mapper (MSX-DOS 1.x direct port access)
+RETB mapperProbeDos1(void) __sdcccall(1);
+void mapperPutP2Dos1(uint8_t segment) __sdcccall(1);
+void mapperRestoreP2Dos1(void) __sdcccall(1);
+
+// Far memory: buffers spanning many mapper segments, mapped in page 2 (MSX-DOS 1 or 2)
+RETB  far_init(void);
+ERRB  far_alloc(FARBUF *fb, uint32_t size);
+void  far_free(FARBUF *fb);
+uint8_t* far_map(FARBUF *fb, uint32_t offset);
+void  far_unmap(void);
+RETW  far_read(FARBUF *fb, uint32_t offset, char *dst, uint16_t size);
+RETW  far_write(FARBUF *fb, uint32_t offset, char *src, uint16_t size);
+RETDW far_fread(FARBUF *fb, uint32_t offset, uint32_t size, FILEH fh);
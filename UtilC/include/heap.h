@@ -1,4 +1,3 @@
-
 #ifndef  __HEAP_MSXDOS_H__
 #define  __HEAP_MSXDOS_H__
 
@@ -7,15 +6,39 @@
 #endif
 
 #include <stdint.h>
+#include <stdbool.h>
+
+
+#define HEAP_MAXPUSH	8		// Nesting levels for heapPush/heapPop
 
+typedef uint8_t* HEAPMARK;		// Heap position returned by heapMark()
+
+typedef struct {				// Fixed-size object pool, see poolInit(...)
+	uint16_t objSize;			// Size of each object (at least 2 bytes)
+	void    *freeList;			// Freed objects, linked through their first word
+	uint8_t *next;				// Next never used object
+	uint8_t *end;				// End of the pool area
+} POOL;
 
 extern uint8_t *heap_top;
 
 extern void *malloc(uint16_t size);
 extern void free(uint16_t size);
 
+// Arena (mark/release)
+HEAPMARK heapMark(void);
+void heapRelease(HEAPMARK mark);
 void *heapPush();
 void *heapPop();
+void heapCheckStack(uint16_t margin);
+
+// Object pools
+bool  poolInit(POOL *pool, uint16_t objSize, uint16_t count);
+void *poolAlloc(POOL *pool);
+void  poolFree(POOL *pool, void *obj);
+
+#define POOL_INIT(pool, type, count)	poolInit(pool, sizeof(type), count)
+#define POOL_ALLOC(pool, type)			((type*)poolAlloc(pool))
 
 
 #endif//__HEAP_MSXDOS_H__
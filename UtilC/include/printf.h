@@ -28,6 +28,9 @@
 #include <stdio.h>
 
 void print(char* s);
+#ifdef MSXDOS
+void print_flush(void);
+#endif
 int printf_custom(const char *fmt, ...);
 int sprintf_custom(const char* buf, const char* fmt, ...);
 
@@ -29,8 +29,6 @@
 #include <stdarg.h>
 #include <system.h>
 
-#define CONOUT 2
-
 #ifdef SUPPORT_LONG
 extern void __ultoa(long val, char* buffer, char base);
 extern void __ltoa(long val, char* buffer, char base);
@@ -42,26 +40,90 @@ static int format_string(const char* buf, const char *fmt, va_list ap);
 
 #ifdef MSXDOS
 
-void print(char* s) __naked
+/*
+   Console output is collected in a buffer and sent with one DOS call per
+   buffer: _ZSTROUT on Nextor 2.1 and later, _STROUT on MSX-DOS 2 and
+   older Nextor ('$' is the _STROUT terminator, so it is sent apart with
+   _CONOUT) and one _CONOUT per char on MSX-DOS 1. The buffer is flushed
+   when full and at the end of each print/printf call.
+*/
+
+#include "dos.h"
+
+#define STROUT  0x09
+#define OUTBUF_SIZE 128
+
+#define OUT_UNKNOWN 0
+#define OUT_CONOUT  1
+#define OUT_STROUT  2
+#define OUT_ZSTROUT 3
+
+static char outbuf[OUTBUF_SIZE + 1];
+static unsigned char outlen;
+static unsigned char outmode;
+
+static void bdos_de(char function, const char *de) __naked __sdcccall(1)
 {
-    __asm
+  function; de;
+  __asm
 
-    ;HL = *s
+  ;A  = function
+  ;DE = parameter
 
-loop:
-    ld      a,(hl)
-    or      a
-    jr      z,end
-    ld      e,a
-    ld      c,#2
-    push    hl
-    call    #5
-    pop     hl
-    inc     hl
-    jr      loop
-end:
-    ret
-    __endasm;
+  push    ix
+  ld      c,a
+  call    #5
+  pop     ix
+  ret
+
+  __endasm;
+}
+
+void print_flush(void)
+{
+  char *p = outbuf;
+  char *q;
+  char c;
+
+  if (!outlen) return;
+  outbuf[outlen] = '\0';
+  outlen = 0;
+
+  if (outmode == OUT_UNKNOWN) {
+    c = dosVersion();
+    if (c >= VER_NextorDOS && nextorVersion() >= NXTR_VER_2_1) outmode = OUT_ZSTROUT;
+    else outmode = (c >= VER_MSXDOS2x)? OUT_STROUT : OUT_CONOUT;
+  }
+
+  if (outmode == OUT_ZSTROUT) {
+    bdos_de(ZSTROUT, outbuf);
+  }
+  else if (outmode == OUT_STROUT) {
+    while (1) {
+      for (q = p; *q && *q != '$'; q++);
+      c = *q;
+      *q = '$';
+      if (q != p) bdos_de(STROUT, p);
+      if (!c) break;
+      bdos_de(CONOUT, (const char*)'$');
+      p = q + 1;
+    }
+  }
+  else {
+    while ((c = *p++) != 0) bdos_de(CONOUT, (const char*)c);
+  }
+}
+
+static void print_putc(char c) __sdcccall(1)
+{
+  outbuf[outlen++] = c;
+  if (outlen == OUTBUF_SIZE) print_flush();
+}
+
+void print(char* s)
+{
+  while (*s) print_putc(*s++);
+  print_flush();
 }
 
 #elif MSXBIOS
@@ -106,8 +168,8 @@ static void do_char(char c, const char* buf) __naked
   or l
 
 #ifdef MSXDOS
-  ld c,#CONOUT
-  jp z,5
+  ld a,e
+  jp z,_print_putc
 #else
   ld a,e
   jr z,DO_CHPUT
@@ -131,8 +193,13 @@ DO_CHPUT:
 int printf_custom(const char *fmt, ...)
 {
   va_list arg;
+  int count;
   va_start(arg, fmt);
-  return format_string(0, fmt, arg);
+  count = format_string(0, fmt, arg);
+#ifdef MSXDOS
+  print_flush();
+#endif
+  return count;
 }
 
 int sprintf_custom(const char* buf, const char* fmt, ...)
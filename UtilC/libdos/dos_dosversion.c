@@ -1,6 +1,7 @@
 #include "dos.h"
 
 static RETB s_dos_version;
+static RETW s_nextor_version;		// Nextor: primary version << 8 | secondary version
 
 RETB supportDos2(void) __naked __sdcccall(1)
 {
@@ -87,6 +88,12 @@ the MSXDOS2.SYS version in register DE.
 		jr   ret_version$
 
 	is_nextor$:				; A = VER_NextorDOS (is NextorDOS)
+		ld   a,l				; IXl: primary version
+		ld   (_s_nextor_version+1),a
+		push iy				; IYh: secondary version
+		pop  hl
+		ld   a,h
+		ld   (_s_nextor_version),a
 		ld   a,#VER_NextorDOS
 
 	ret_version$:
@@ -96,3 +103,15 @@ the MSXDOS2.SYS version in register DE.
 	__endasm;
 }
 
+/**
+ * nextorVersion
+ * Gets the Nextor kernel version reported by _DOSVER.
+ *
+ * @return Primary version in the high byte and secondary version in the
+ *         low byte (0x0201 for Nextor 2.1), or 0 if not running Nextor.
+ */
+RETW nextorVersion(void)
+{
+	dosVersion();
+	return s_nextor_version;
+}
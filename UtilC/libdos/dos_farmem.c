@@ -0,0 +1,233 @@
+//https://www.msx.org/wiki/Memory_Mapper
+#include <string.h>
+#include "dos.h"
+
+
+#define FAR_DOS1_FIRSTSEG	4		// Segments 0..3 hold the MSX-DOS 1.x TPA
+
+//###################################################################
+// Variables & Func.Definitions
+
+static bool    _farDos2;
+static uint8_t _farTotalSegs;		// MSX-DOS 1.x: segments found by the probe
+static uint8_t _farNextSeg;			// MSX-DOS 1.x: next free segment
+static bool    _farMapped;			// A far segment is in page 2
+static uint8_t _farMappedSeg;
+
+static ERRB _farAllocSeg(uint8_t *seg);
+static void _farFreeSeg(uint8_t seg);
+
+//###################################################################
+// Public Functions
+
+/**
+ * far_init
+ * Initialize the far memory layer.
+ * Uses the mapper support routines in MSX-DOS 2.x, and probes the mapper
+ * through its ports in MSX-DOS 1.x.
+ *
+ * @return Count of free segments.
+ */
+RETB far_init(void)
+{
+	_farDos2 = supportDos2();
+	if (_farDos2) {
+		return mapperInit();
+	}
+	_farTotalSegs = mapperProbeDos1();
+	_farNextSeg = FAR_DOS1_FIRSTSEG;
+	return _farTotalSegs > FAR_DOS1_FIRSTSEG ? _farTotalSegs - FAR_DOS1_FIRSTSEG : 0;
+}
+
+/**
+ * far_alloc
+ * Allocates a far buffer of the given size in 16KB mapper segments.
+ *
+ * @param fb Far buffer to initialize.
+ * @param size Size in bytes (up to FAR_MAXSEGS segments).
+ * @return Error code (0 if successful, ERR_NORAM if not enough free segments).
+ *
+ * In MSX-DOS 1.x segments are handed out in sequence, so buffers must be
+ * freed in reverse order of allocation to get their segments back.
+ */
+ERRB far_alloc(FARBUF *fb, uint32_t size)
+{
+	uint32_t count;
+
+	fb->size = size;
+	fb->count = 0;
+	if (size > (uint32_t)FAR_MAXSEGS * FAR_SEGSIZE) return ERR_NORAM;	// before the rounding can wrap
+	count = (size + FAR_SEGSIZE - 1) >> 14;
+
+	while (fb->count < (uint8_t)count) {
+		if (_farAllocSeg(&fb->segs[fb->count])) {
+			far_free(fb);
+			return ERR_NORAM;
+		}
+		fb->count++;
+	}
+	return 0;
+}
+
+/**
+ * far_free
+ * Frees all the segments of a far buffer.
+ *
+ * @param fb Far buffer to free.
+ */
+void far_free(FARBUF *fb)
+{
+	far_unmap();
+	while (fb->count) {
+		_farFreeSeg(fb->segs[--fb->count]);
+	}
+	fb->size = 0;
+}
+
+/**
+ * far_map
+ * Maps in page 2 the segment that holds the given far buffer offset.
+ *
+ * @param fb Far buffer.
+ * @param offset Offset inside the far buffer.
+ * @return Pointer in page 2 to the byte at offset. It is valid up to the
+ *         end of its segment, and until the next far_* call.
+ */
+uint8_t* far_map(FARBUF *fb, uint32_t offset)
+{
+	uint8_t seg = fb->segs[(uint8_t)(offset >> 14)];
+
+	if (!_farMapped || seg != _farMappedSeg) {
+		_farMapped = true;
+		_farMappedSeg = seg;
+		if (_farDos2) {
+			MAPPER_Segment m = { seg, 0 };
+			mapperSetSegment(2, &m);
+		} else {
+			mapperPutP2Dos1(seg);
+		}
+	}
+	return FAR_PAGE2 + ((uint16_t)offset & (FAR_SEGSIZE - 1));
+}
+
+/**
+ * far_unmap
+ * Restores the original TPA segment in page 2.
+ */
+void far_unmap(void)
+{
+	if (!_farMapped) return;
+	_farMapped = false;
+	if (_farDos2) {
+		mapperSetOriginalSegmentBack(2);
+	} else {
+		mapperRestoreP2Dos1();
+	}
+}
+
+/**
+ * far_read
+ * Copies bytes from a far buffer to near memory (outside page 2).
+ *
+ * @return Count of bytes copied.
+ */
+RETW far_read(FARBUF *fb, uint32_t offset, char *dst, uint16_t size)
+{
+	uint16_t left = size;
+	uint16_t n;
+
+	while (left) {
+		n = FAR_SEGSIZE - ((uint16_t)offset & (FAR_SEGSIZE - 1));
+		if (n > left) n = left;
+		memcpy(dst, far_map(fb, offset), n);
+		dst += n;
+		offset += n;
+		left -= n;
+	}
+	far_unmap();
+	return size;
+}
+
+/**
+ * far_write
+ * Copies bytes from near memory (outside page 2) to a far buffer.
+ *
+ * @return Count of bytes copied.
+ */
+RETW far_write(FARBUF *fb, uint32_t offset, char *src, uint16_t size)
+{
+	uint16_t left = size;
+	uint16_t n;
+
+	while (left) {
+		n = FAR_SEGSIZE - ((uint16_t)offset & (FAR_SEGSIZE - 1));
+		if (n > left) n = left;
+		memcpy(far_map(fb, offset), src, n);
+		src += n;
+		offset += n;
+		left -= n;
+	}
+	far_unmap();
+	return size;
+}
+
+/**
+ * far_fread
+ * Reads a file straight into a far buffer, one DOS read per segment.
+ *
+ * @param fb Far buffer.
+ * @param offset Offset inside the far buffer.
+ * @param size Count of bytes to read.
+ * @param fh Opened file handle (ignored in MSX-DOS 1.x).
+ * @return Count of bytes read (less than size at EOF), or -1 on read error.
+ */
+RETDW far_fread(FARBUF *fb, uint32_t offset, uint32_t size, FILEH fh)
+{
+	STREAM s;
+	uint32_t total = 0;
+	uint16_t n;
+
+	while (size) {
+		n = FAR_SEGSIZE - ((uint16_t)offset & (FAR_SEGSIZE - 1));
+		if (n > size) n = size;
+		sopen(&s, fh, (char*)far_map(fb, offset), n);
+		n = sfill(&s);
+		if (s.flags & STREAM_ERROR) {
+			total = -1;
+			break;
+		}
+		total += n;
+		if (!n || (s.flags & STREAM_EOF)) break;
+		offset += n;
+		size -= n;
+	}
+	far_unmap();
+	return total;
+}
+
+
+//###################################################################
+// Private Functions
+
+static ERRB _farAllocSeg(uint8_t *seg)
+{
+	if (_farDos2) {
+		MAPPER_Segment m;
+		if (mapperAllocateSegment(&m)) return ERR_NORAM;
+		*seg = m.segment;
+		return 0;
+	}
+	if (_farNextSeg >= _farTotalSegs) return ERR_NORAM;
+	*seg = _farNextSeg++;
+	return 0;
+}
+
+static void _farFreeSeg(uint8_t seg)
+{
+	if (_farDos2) {
+		MAPPER_Segment m = { seg, 0 };
+		mapperFreeSegment(&m);
+		return;
+	}
+	if (seg == _farNextSeg - 1) _farNextSeg--;
+}
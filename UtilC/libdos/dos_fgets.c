@@ -1,11 +1,31 @@
+#include <string.h>
 #include "dos.h"
 
 
-char* fgets(char *str, uint16_t size, FILEH fh)
+/**
+ * Reads a line using the destination buffer itself as the stream buffer:
+ * one block read, then the file pointer is moved back to the byte that
+ * follows the line.
+ */
+char* _fgets(char *str, uint16_t size, FILEH fh, uint8_t flags)
 {
-	if (supportDos2())
-		return dos2_fgets(str, size, fh);
-	else {
-		return dos1_fgets(str, size);
+	STREAM s;
+	char *nl;
+
+	sopen(&s, fh, str, size - 1);
+	s.flags = flags;
+	if (!sfill(&s)) {
+		*str = '\0';
+		return (s.flags & STREAM_ERROR) ? NULL : str;
 	}
+	nl = memchr(str, '\n', s.len);
+	s.pos = nl ? nl - str + 1 : s.len;
+	str[s.pos] = '\0';
+	if (s.pos != s.len) ssync(&s);
+	return str;
+}
+
+char* fgets(char *str, uint16_t size, FILEH fh)
+{
+	return _fgets(str, size, fh, supportDos2() ? 0 : STREAM_FCB);
 }
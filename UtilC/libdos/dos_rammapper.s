@@ -2,95 +2,74 @@
 ;-----------------------------------------------------------
 ; Info about: https://www.msx.org/wiki/Memory_Mapper
 ; Developed by NataliaPC
+;
+; Direct mapper port access for MSX-DOS 1.x, where there are no mapper
+; support routines. The default BIOS layout is assumed for the TPA:
+; pages 0..3 hold segments 3..0, so the free segments start at 4.
+; These routines switch page 2, so they, the stack and any buffer they
+; use must not be located in page 2.
 
-FIRST_RAMSEG =	4
-SET_RAMSEG_P0 =	0xFC	; Default to segment 3
-SET_RAMSEG_P1 =	0xFD	; Default to segment 2
 SET_RAMSEG_P2 =	0xFE	; Default to segment 1
-SET_RAMSEG_P3 =	0xFF	; Default to segment 0
+TPA_RAMSEG_P2 =	1
 
-    .globl  _initializeMapper	; void initializeMapper();
-	.globl  _setMapperPage2		; void setMapperPage2(uint8_t page);
-	.globl  _restoreMapperPage2	; void restoreMapperPage2();
+	.globl  _mapperProbeDos1	; uint8_t mapperProbeDos1(void) __sdcccall(1)
+	.globl  _mapperPutP2Dos1	; void mapperPutP2Dos1(uint8_t segment) __sdcccall(1)
+	.globl  _mapperRestoreP2Dos1	; void mapperRestoreP2Dos1(void) __sdcccall(1)
 
-	.globl  _dosver
+	.area _CODE
 
-	.globl  _DOS2MAPPER
-	.globl  _MAX_MAPPER_PAGES
-	.globl  _PAGE2_RAMSEG
-	.globl  _FIRST_RAMSEG
-
-
-; void initializeMapper();
-_initializeMapper::			
-initializeMapper::
-
-		call _dosver
-		ld   a,l
-		dec  a
-		ld   (#_DOS2MAPPER),a		; Store the DOS version -1 (0:MSXDOS1 non-0:MSXDOS2 or better)
-		jr   z,.im_msxdos1			; if MSX-DOS 1.x is detected we can use pagination without care
-		
-	.im_msxdos2:					; for MSX-DOS2 we disable RAM pagination
-		xor  a						; TODO: implement MSX-DOS2 mapper functions
-		ld   (#_FIRST_RAMSEG),a
-		ret
-
-	.im_msxdos1:
+; uint8_t mapperProbeDos1(void) __sdcccall(1);
+; Returns A = number of mapper segments (255 for 4MB mappers, 1 if no mapper).
+; The first byte of every segment is saved on the stack (512 bytes) and restored.
+_mapperProbeDos1::
 		ld   hl,#0x8000
-		xor  a						; Set first byte of each page with their number
-	.im_loop0:
-		out  (SET_RAMSEG_P2),a
+		ld   c,#SET_RAMSEG_P2
+		di
+
+		ld   a,#255					; Going down, so mirrored segments end up
+	.mp_save:						; holding the lowest of their numbers
+		out  (c),a
+		ld   e,(hl)
+		ld   d,a
+		push de
 		ld   (hl),a
-		inc  a
-		jr   nz,.im_loop0
+		sub  #1
+		jr   nc,.mp_save
 
-		ld   a,#255					; Check if the page exists reading their number
-		ld   ix,#_MAX_MAPPER_PAGES
-		ld   (ix),#0
-	.im_loop1:
-		out  (SET_RAMSEG_P2),a
+		ld   b,#0					; Count segments holding their own number
+	.mp_count:
+		ld   a,b
+		out  (c),a
 		cp   (hl)
-		jr   nz,.im_cont0
-		inc  (ix)
-		dec  a
-		jr   nz,.im_loop1
-	.im_cont0:
-		add  a,#2					;  Skip First failed mapper segment & Page3 default mapper segment
-		ld   (#_PAGE2_RAMSEG),a		; STORE Page2 default mapper segment
-		add  a,#3					;  Skip Page2, Page1, Page0 default mapper segment2 & MSXDOS2 page
-		ld   (#_FIRST_RAMSEG+0),a	; STORE First free mapper segment
-		inc  a
-		ld   (#_FIRST_RAMSEG+1),a
-		inc  a
-		ld   (#_FIRST_RAMSEG+2),a
+		jr   nz,.mp_restore0
+		inc  b
+		jr   nz,.mp_count
+		dec  b						; 256 segments, report 255
+
+	.mp_restore0:					; Restore in reverse order, so the first
+	.mp_restore:					; saved (original) byte is written last
+		pop  de
+		ld   a,d
+		out  (c),a
+		ld   (hl),e
 		inc  a
-		ld   (#_FIRST_RAMSEG+3),a
-		dec  (ix)					;  Decrement available segments in 4 (64kb main RAM)
-		dec  (ix)
-		dec  (ix)
-		dec  (ix)
-		; Restore page 2 to default segment & Return
+		jr   nz,.mp_restore
 
-; void restoreMapperPage2();
-_restoreMapperPage2::
-restoreMapperPage2::
-		ld   a,(#_PAGE2_RAMSEG)
-		out  (SET_RAMSEG_P2),a
+		ld   a,#TPA_RAMSEG_P2
+		out  (c),a
+		ei
+		ld   a,b
 		ret
 
 
-; void setMapperPage2(uint8_t page);
-_setMapperPage2::
-		pop  af
-		pop  bc
-		push bc
-		push af
-		ld   a,c
-setMapperPage::
+; void mapperPutP2Dos1(uint8_t segment) __sdcccall(1);
+_mapperPutP2Dos1::
 		out  (SET_RAMSEG_P2),a
 		ret
 
-MAPPER_JMP_TABLE:
-		.dw	0
 
+; void mapperRestoreP2Dos1(void) __sdcccall(1);
+_mapperRestoreP2Dos1::
+		ld   a,#TPA_RAMSEG_P2
+		out  (SET_RAMSEG_P2),a
+		ret
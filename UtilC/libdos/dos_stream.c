@@ -0,0 +1,216 @@
+#include <string.h>
+#include "dos.h"
+#include "heap.h"
+
+
+#define STREAM_MAXREAD	0xfe00	// dos2_fread returns 0xffXX on error
+
+static uint16_t _sraw(STREAM *s, char *buf, uint16_t size);
+
+
+//###################################################################
+// Public Functions
+
+/**
+ * sopen
+ * Initializes a buffered read stream over an already opened file.
+ *
+ * @param s Stream to initialize.
+ * @param fh File handle (ignored in MSX-DOS 1.x, the SYSFCB is used).
+ * @param buf Buffer to use, or NULL to take it from the heap.
+ * @param size Buffer size in bytes (0 = STREAM_BUFSIZE when taken from the heap).
+ * @return Error code (0 if successful, ERR_NORAM if the heap buffer can't be taken).
+ *
+ * A heap buffer is released by sclose(...), so streams must be closed in
+ * reverse order of any later malloc(...) calls.
+ */
+ERRB sopen(STREAM *s, FILEH fh, char *buf, uint16_t size)
+{
+	s->fh = fh;
+	s->flags = supportDos2() ? 0 : STREAM_FCB;
+	s->pos = 0;
+	s->len = 0;
+	if (!buf) {
+		if (!size) size = STREAM_BUFSIZE;
+		buf = malloc(size);
+		if (!buf) {
+			s->buf = 0;
+			s->size = 0;
+			s->flags |= STREAM_ERROR;
+			return ERR_NORAM;
+		}
+		s->flags |= STREAM_HEAPBUF;
+	}
+	s->buf = buf;
+	s->size = size;
+	return 0;
+}
+
+/**
+ * sclose
+ * Releases the stream buffer if it was taken from the heap.
+ * The file itself is not closed.
+ *
+ * @param s Stream to close.
+ */
+void sclose(STREAM *s)
+{
+	if (s->flags & STREAM_HEAPBUF) {
+		free(s->size);
+		s->flags &= ~STREAM_HEAPBUF;
+	}
+	s->pos = s->len = 0;
+}
+
+/**
+ * sfill
+ * Discards the buffer contents and reads the next block from the file.
+ *
+ * @param s Stream to refill.
+ * @return Count of bytes now available in the buffer (0 at EOF or error).
+ */
+RETW sfill(STREAM *s)
+{
+	s->pos = 0;
+	s->len = 0;
+	if (s->flags & (STREAM_EOF | STREAM_ERROR)) return 0;
+	s->len = _sraw(s, s->buf, s->size);
+	return s->len;
+}
+
+/**
+ * sgetc
+ * Reads a single byte from the stream.
+ *
+ * @param s Stream to read from.
+ * @return The byte read, or -1 at EOF or error.
+ */
+int sgetc(STREAM *s)
+{
+	if (s->pos == s->len && !sfill(s)) return -1;
+	return (uint8_t)s->buf[s->pos++];
+}
+
+/**
+ * sgets
+ * Reads a line from the stream, '\n' included, up to size-1 chars.
+ *
+ * @param str Destination buffer, always terminated with '\0'.
+ * @param size Destination buffer size.
+ * @return str, or NULL if nothing could be read (EOF or error).
+ */
+char* sgets(char *str, uint16_t size, STREAM *s)
+{
+	char *p = str;
+	char *src, *nl;
+	uint16_t n;
+
+	if (!size--) return NULL;
+	while (size) {
+		if (s->pos == s->len && !sfill(s)) break;
+		src = s->buf + s->pos;
+		n = s->len - s->pos;
+		if (n > size) n = size;
+		nl = memchr(src, '\n', n);
+		if (nl) n = nl - src + 1;
+		memcpy(p, src, n);
+		p += n;
+		s->pos += n;
+		size -= n;
+		if (nl) break;
+	}
+	*p = '\0';
+	return p == str ? NULL : str;
+}
+
+/**
+ * sread
+ * Reads a block of bytes from the stream.
+ * Requests as big as the stream buffer bypass it and go straight to DOS.
+ *
+ * @param buf Destination buffer.
+ * @param size Count of bytes to read.
+ * @return Count of bytes actually read.
+ */
+RETW sread(char *buf, uint16_t size, STREAM *s)
+{
+	uint16_t total = 0;
+	uint16_t n;
+
+	while (size) {
+		n = s->len - s->pos;
+		if (!n) {
+			if (size >= s->size) {
+				if (s->flags & (STREAM_EOF | STREAM_ERROR)) break;
+				n = _sraw(s, buf, size);
+				if (!n) break;
+				buf += n;
+				size -= n;
+				total += n;
+				continue;
+			}
+			if (!sfill(s)) break;
+			n = s->len;
+		}
+		if (n > size) n = size;
+		memcpy(buf, s->buf + s->pos, n);
+		s->pos += n;
+		buf += n;
+		size -= n;
+		total += n;
+	}
+	return total;
+}
+
+/**
+ * ssync
+ * Moves the file pointer back over the buffered but unread bytes and
+ * empties the buffer, so the file can be used directly again.
+ *
+ * @param s Stream to synchronize.
+ * @return The new file pointer.
+ */
+RETDW ssync(STREAM *s)
+{
+	int32_t back = -(int32_t)(s->len - s->pos);
+
+	s->pos = s->len = 0;
+	s->flags &= ~STREAM_EOF;
+	if (s->flags & STREAM_FCB)
+		return dos1_fseek(back, SEEK_CUR);
+	return dos2_fseek(s->fh, back, SEEK_CUR);
+}
+
+
+//###################################################################
+// Private Functions
+
+/**
+ * _sraw
+ * Reads a block from the file, setting STREAM_EOF/STREAM_ERROR as needed.
+ *
+ * @return Count of bytes read.
+ */
+static uint16_t _sraw(STREAM *s, char *buf, uint16_t size)
+{
+	uint16_t ret;
+	uint32_t pos;
+
+	if (size > STREAM_MAXREAD) size = STREAM_MAXREAD;
+
+	if (s->flags & STREAM_FCB) {
+		// _RDBLK returns an error on partial reads, the random record tells the truth
+		pos = dos1_ftell();
+		dos1_fread(buf, size);
+		ret = dos1_ftell() - pos;
+		if (ret < size) s->flags |= STREAM_EOF;
+		return ret;
+	}
+
+	ret = dos2_fread(buf, size, s->fh);
+	if ((ret & 0xff00) == 0xff00) {
+		s->flags |= (ret == (0xff00 | ERR_EOF)) ? STREAM_EOF : STREAM_ERROR;
+		return 0;
+	}
+	return ret;
+}
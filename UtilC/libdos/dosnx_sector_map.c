@@ -0,0 +1,101 @@
+#include "dos.h"
+
+
+#define SMAP_SECSIZE	512
+
+//###################################################################
+// Public Functions
+
+/**
+ * smap_open
+ * Builds the sector map of a file: the cluster chain is walked once with
+ * _GETCLUS and coalesced into runs of contiguous sectors, so the file can be
+ * read with big _RDDRV calls that skip the FAT lookups and the sector buffer
+ * copies of the DOS kernel.
+ *
+ * @param filename File to map.
+ * @param map Sector map to initialize.
+ * @return Error code (0 if successful, ERR_NORAM if the file has more than
+ *         SMAP_MAXRUNS fragments, ERR_ICLUS if the cluster chain is broken).
+ */
+ERRB smap_open(const char *filename, SECTOR_map *map)
+{
+	FFBLK ffblk;
+	CLUSTER_info info;
+	SECTOR_run *run = NULL;
+	uint16_t cluster;
+	uint32_t left;
+	uint8_t n;
+	ERRB err;
+
+	map->count = 0;
+	map->pos = 0;
+	map->offset = 0;
+
+	err = dos2_findfirst(filename, &ffblk, ATTR_NONE);
+	if (err) return err;
+	map->drive = ffblk.drive - 1;
+	cluster = ffblk.startcluster;
+	left = (ffblk.filesize + SMAP_SECSIZE - 1) / SMAP_SECSIZE;
+
+	while (left) {
+		err = nxtr_getClusterInfoFAT(ffblk.drive, cluster, &info);
+		if (err) return err;
+		if (info.flags.isFree) return ERR_ICLUS;
+
+		n = info.clusterSize;
+		if (n > left) n = left;
+		if (run && run->sector + run->count == info.sectorData && run->count <= 0xffff - n) {
+			run->count += n;
+		} else {
+			if (map->count == SMAP_MAXRUNS) return ERR_NORAM;
+			run = &map->run[map->count++];
+			run->sector = info.sectorData;
+			run->count = n;
+		}
+
+		left -= n;
+		if (left && info.flags.isLast) return ERR_ICLUS;
+		cluster = info.clusterValue;
+	}
+	return 0;
+}
+
+/**
+ * smap_read
+ * Reads the next sectors of a mapped file, one _RDDRV call per run.
+ *
+ * @param map Sector map of the file.
+ * @param buf Destination address.
+ * @param nsec Count of sectors to read.
+ * @return Error code (0 if successful, ERR_EOF if the file has less sectors).
+ *
+ * The last sector is read whole, so buf must have room for nsec sectors
+ * even if the file ends halfway through it.
+ */
+ERRB smap_read(SECTOR_map *map, char *buf, uint8_t nsec)
+{
+	SECTOR_run *run;
+	uint16_t n;
+	ERRB err;
+
+	while (nsec) {
+		if (map->pos >= map->count) return ERR_EOF;
+		run = &map->run[map->pos];
+		n = run->count - map->offset;
+		if (n > nsec) n = nsec;
+
+		setTransferAddress(buf);
+		err = nxtr_readAbsoluteSectorDrv(map->drive, run->sector + map->offset, n);
+		if (err) return err;
+
+		buf += n * SMAP_SECSIZE;
+		nsec -= n;
+		map->offset += n;
+		if (map->offset == run->count) {
+			map->pos++;
+			map->offset = 0;
+		}
+	}
+	return 0;
+}
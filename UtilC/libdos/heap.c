@@ -1,13 +1,152 @@
 #include <stdint.h>
+#include <stdbool.h>
 #include "heap.h"
 
 
+static uint16_t _heapMargin;				// 0: no stack check
+static HEAPMARK _heapMarks[HEAP_MAXPUSH];
+static uint8_t  _heapPushed;
+
+static uint16_t _getSP(void) __naked __sdcccall(1)
+{
+	__asm
+		ld hl,#2			; skip our own return address
+		add hl,sp
+		ex de,hl			; Returns DE
+		ret
+	__endasm;
+}
+
+
+/**
+ * malloc
+ * Takes size bytes from the top of the heap.
+ *
+ * @return Pointer to the block, or NULL if the stack check is enabled and
+ *         the heap would get closer to SP than the configured margin.
+ */
 void *malloc(uint16_t size) {
 	uint8_t *ret = heap_top;
+	uint16_t room;
+	if (_heapMargin) {
+		// computed as the room left below SP, a large size can't wrap around
+		room = _getSP();
+		if (room < (uint16_t)ret) return 0;
+		room -= (uint16_t)ret;
+		if (room < _heapMargin || size > room - _heapMargin) return 0;
+	}
 	heap_top += size;
 	return (void*)ret;
 }
 
+/**
+ * free
+ * Returns the last size bytes taken from the heap.
+ */
 void free(uint16_t size) {
 	heap_top -= size;
-}
\ No newline at end of file
+}
+
+/**
+ * heapMark
+ * Gets the current heap position, to release everything allocated after it
+ * at once with heapRelease(...).
+ */
+HEAPMARK heapMark(void)
+{
+	return heap_top;
+}
+
+/**
+ * heapRelease
+ * Frees every block allocated after the given mark.
+ */
+void heapRelease(HEAPMARK mark)
+{
+	heap_top = mark;
+}
+
+/**
+ * heapPush
+ * Saves the current heap position in an internal stack.
+ *
+ * @return The saved position, or NULL if HEAP_MAXPUSH levels are in use.
+ */
+void *heapPush()
+{
+	if (_heapPushed == HEAP_MAXPUSH) return 0;
+	return _heapMarks[_heapPushed++] = heap_top;
+}
+
+/**
+ * heapPop
+ * Frees every block allocated since the matching heapPush().
+ *
+ * @return The restored heap position, or NULL if nothing was pushed.
+ */
+void *heapPop()
+{
+	if (!_heapPushed) return 0;
+	return heap_top = _heapMarks[--_heapPushed];
+}
+
+/**
+ * heapCheckStack
+ * Enables the heap/stack collision check in malloc(...).
+ *
+ * @param margin Minimum free bytes to keep below SP (0 disables the check).
+ */
+void heapCheckStack(uint16_t margin)
+{
+	_heapMargin = margin;
+}
+
+/**
+ * poolInit
+ * Takes room for count objects of objSize bytes from the heap.
+ *
+ * @return false if the heap has not enough room, or if objSize * count
+ *         doesn't fit in 16 bits.
+ */
+bool poolInit(POOL *pool, uint16_t objSize, uint16_t count)
+{
+	if (objSize < sizeof(void*)) objSize = sizeof(void*);
+	pool->objSize = objSize;
+	pool->freeList = 0;
+	if (count && objSize > 0xffff / count) {
+		pool->next = pool->end = 0;
+		return false;
+	}
+	pool->next = malloc(objSize * count);
+	pool->end = pool->next ? pool->next + objSize * count : 0;
+	return pool->next != 0;
+}
+
+/**
+ * poolAlloc
+ * Gets an object from the pool, reusing freed objects first.
+ *
+ * @return Pointer to the object, or NULL if the pool is exhausted.
+ */
+void *poolAlloc(POOL *pool)
+{
+	void *obj = pool->freeList;
+	if (obj) {
+		pool->freeList = *(void**)obj;
+		return obj;
+	}
+	if (pool->next == pool->end) return 0;
+	obj = pool->next;
+	pool->next += pool->objSize;
+	return obj;
+}
+
+/**
+ * poolFree
+ * Returns an object to its pool, in any order.
+ */
+void poolFree(POOL *pool, void *obj)
+{
+	*(void**)obj = pool->freeList;
+	pool->freeList = obj;
+}
@@ -485,6 +485,104 @@ void test_fgets_FAILS()
 	SUCCEED();
 }
 
+void test_stream_sgets()
+{
+	const char *_func = __func__;
+	beforeEach();
+
+	//BDD given
+	STREAM s;
+	create_file(TEXT_CRLF);
+	FILEH fh = fopen(TEMP_FILE, O_RDONLY);
+
+	//BDD when
+	sopen(&s, fh, NULL, 8);
+	resultp = sgets(buff, sizeof(buff), &s);
+	char *second = sgets(buff + 32, sizeof(buff) - 32, &s);
+	char *third = sgets(buff + 64, sizeof(buff) - 64, &s);
+	sclose(&s);
+	fclose(fh);
+
+	//BDD then
+	ASSERT_EQUAL(resultp, buff, ERROR);
+	ASSERT_EQUAL(strcmp(resultp, TEXT_CRLF_15), 0, ERROR);
+	ASSERT_EQUAL(strcmp(second, TEXT_CRLF + strlen(TEXT_CRLF_15)), 0, ERROR);
+	ASSERT_EQUAL(third, NULL, ERROR);
+	SUCCEED();
+}
+
+void test_stream_sread()
+{
+	const char *_func = __func__;
+	beforeEach();
+
+	//BDD given
+	STREAM s;
+	create_file(TEXT_CRLF);
+	FILEH fh = fopen(TEMP_FILE, O_RDONLY);
+	memset(buff, 0, sizeof(buff));
+
+	//BDD when
+	sopen(&s, fh, heap_top + 256, 4);
+	result8 = sgetc(&s);
+	result16 = sread(buff, sizeof(buff), &s);
+
+	//BDD then
+	ASSERT_EQUAL(result8, TEXT_CRLF[0], ERROR);
+	ASSERT_EQUAL(result16, strlen(TEXT_CRLF) - 1, ERROR);
+	ASSERT_EQUAL(strcmp(buff, TEXT_CRLF + 1), 0, ERROR);
+	ASSERT_EQUAL(sgetc(&s), -1, ERROR);
+	sclose(&s);
+	fclose(fh);
+	SUCCEED();
+}
+
+void test_stream_ssync()
+{
+	const char *_func = __func__;
+	beforeEach();
+
+	//BDD given
+	STREAM s;
+	create_temp_file();
+	FILEH fh = fopen(TEMP_FILE, O_RDONLY);
+
+	//BDD when
+	sopen(&s, fh, NULL, 0);
+	sgetc(&s);
+	sgetc(&s);
+	result32 = ssync(&s);
+	sclose(&s);
+	fclose(fh);
+
+	//BDD then
+	ASSERT_EQUAL(result32, 2, ERROR);
+	SUCCEED();
+}
+
+void test_stream_NORAM()
+{
+	const char *_func = __func__;
+	beforeEach();
+
+	//BDD given
+	STREAM s;
+	uint8_t *top = heap_top;
+	heapCheckStack(0xff00);
+
+	//BDD when
+	result8 = sopen(&s, 0, NULL, 0);
+	heapCheckStack(0);
+
+	//BDD then
+	ASSERT_EQUAL(result8, ERR_NORAM, ERROR);
+	ASSERT_EQUAL(heap_top, top, ERROR);
+	ASSERT_EQUAL(sgetc(&s), -1, ERROR);
+	sclose(&s);
+	ASSERT_EQUAL(heap_top, top, ERROR);
+	SUCCEED();
+}
+
 void test_fseek_SET()
 {
 	const char *_func = __func__;
@@ -668,6 +766,26 @@ void test_dosversion()
 	SUCCEED();
 }
 
+void test_nextor_version()
+{
+	const char *_func = __func__;
+	beforeEach();
+
+	//BDD given
+	result8 = dosVersion();
+
+	//BDD when
+	result16 = nextorVersion();
+
+	//BDD then
+	if (result8 == VER_NextorDOS) {
+		ASSERT(result16 >= 0x0200, ERROR);
+	} else {
+		ASSERT_EQUAL(result16, 0, ERROR);
+	}
+	SUCCEED();
+}
+
 void test_set_transfer_address()
 {
 	const char *_func = __func__;
@@ -1461,6 +1579,168 @@ void test_dos2_ram_mapper()
 	SUCCEED();
 }
 
+void test_heap_mark_release()
+{
+	const char *_func = __func__;
+	beforeEach();
+
+	//BDD given
+	uint8_t *top = heap_top;
+
+	//BDD when
+	HEAPMARK mark = heapMark();
+	malloc(100);
+	malloc(20);
+	ASSERT_EQUAL(heap_top, top + 120, ERROR);
+	heapRelease(mark);
+
+	//BDD then
+	ASSERT_EQUAL(heap_top, top, ERROR);
+	SUCCEED();
+}
+
+void test_heap_push_pop()
+{
+	const char *_func = __func__;
+	beforeEach();
+
+	//BDD given
+	uint8_t *top = heap_top;
+
+	//BDD when
+	resultp = heapPush();
+	malloc(10);
+	heapPush();
+	malloc(30);
+	heapPop();
+	ASSERT_EQUAL(heap_top, top + 10, ERROR);
+	heapPop();
+
+	//BDD then
+	ASSERT_EQUAL(resultp, top, ERROR);
+	ASSERT_EQUAL(heap_top, top, ERROR);
+	ASSERT_EQUAL(heapPop(), NULL, ERROR);
+	SUCCEED();
+}
+
+void test_heap_check_stack()
+{
+	const char *_func = __func__;
+	beforeEach();
+
+	//BDD given
+	uint8_t *top = heap_top;
+	heapCheckStack(256);
+
+	//BDD when
+	resultp = malloc(0xffff - (uint16_t)heap_top);
+	heapCheckStack(0);
+
+	//BDD then
+	ASSERT_EQUAL(resultp, NULL, ERROR);
+	ASSERT_EQUAL(heap_top, top, ERROR);
+	SUCCEED();
+}
+
+void test_heap_pool()
+{
+	const char *_func = __func__;
+	beforeEach();
+
+	//BDD given
+	POOL pool;
+	HEAPMARK mark = heapMark();
+	resultbool = POOL_INIT(&pool, DIRENTRY, 3);
+	ASSERT_EQUAL(resultbool, true, ERROR);
+
+	//BDD when
+	DIRENTRY *a = POOL_ALLOC(&pool, DIRENTRY);
+	DIRENTRY *b = POOL_ALLOC(&pool, DIRENTRY);
+	DIRENTRY *c = POOL_ALLOC(&pool, DIRENTRY);
+	DIRENTRY *d = POOL_ALLOC(&pool, DIRENTRY);
+	poolFree(&pool, b);
+	DIRENTRY *e = POOL_ALLOC(&pool, DIRENTRY);
+	heapRelease(mark);
+
+	//BDD then
+	ASSERT_EQUAL(b, a + 1, ERROR);
+	ASSERT_EQUAL(c, a + 2, ERROR);
+	ASSERT_EQUAL(d, NULL, ERROR);
+	ASSERT_EQUAL(e, b, ERROR);
+	SUCCEED();
+}
+
+void test_heap_pool_OVERFLOW()
+{
+	const char *_func = __func__;
+	beforeEach();
+
+	//BDD given
+	POOL pool;
+	uint8_t *top = heap_top;
+
+	//BDD when
+	resultbool = poolInit(&pool, 0x100, 0x101);
+
+	//BDD then
+	ASSERT_EQUAL(resultbool, false, ERROR);
+	ASSERT_EQUAL(heap_top, top, ERROR);
+	ASSERT_EQUAL(poolAlloc(&pool), NULL, ERROR);
+	SUCCEED();
+}
+
+void test_far_mem()
+{
+	const char *_func = __func__;
+	beforeEach();
+
+	//BDD given
+	FARBUF fb;
+	RETB freeSegments = far_init();
+	ASSERT_EQUAL(freeSegments >= 3, true, ERROR);
+
+	//BDD when
+	result8 = far_alloc(&fb, 40000L);
+	ASSERT_EQUAL(result8, 0, ERROR);
+	ASSERT_EQUAL(fb.count, 3, ERROR);
+	far_write(&fb, 16380L, TEXT_CRLF, 8);
+	far_write(&fb, 39990L, TEXT_CRLF, 10);
+	memset(buff, 0, sizeof(buff));
+	far_read(&fb, 16380L, buff, 8);
+	far_read(&fb, 39990L, buff + 8, 10);
+	uint8_t *p = far_map(&fb, 16384L);
+	result16 = p[0];
+	far_unmap();
+	far_free(&fb);
+
+	//BDD then
+	ASSERT_EQUAL(strncmp(buff, TEXT_CRLF, 8), 0, ERROR);
+	ASSERT_EQUAL(strncmp(buff + 8, TEXT_CRLF, 10), 0, ERROR);
+	ASSERT_EQUAL(result16, TEXT_CRLF[4], ERROR);
+	ASSERT_EQUAL(fb.count, 0, ERROR);
+	ASSERT_EQUAL(far_init(), freeSegments, ERROR);
+	SUCCEED();
+}
+
+void test_far_mem_NORAM()
+{
+	const char *_func = __func__;
+	beforeEach();
+
+	//BDD given
+	FARBUF fb;
+	RETB freeSegments = far_init();
+
+	//BDD when
+	result8 = far_alloc(&fb, (FAR_MAXSEGS + 1) * (uint32_t)FAR_SEGSIZE);
+
+	//BDD then
+	ASSERT_EQUAL(result8, ERR_NORAM, ERROR);
+	ASSERT_EQUAL(fb.count, 0, ERROR);
+	ASSERT_EQUAL(far_init(), freeSegments, ERROR);
+	SUCCEED();
+}
+
 // =============================================================================
 // TESTS NEXTOR
 
@@ -1527,6 +1807,45 @@ void test_nxtr_get_cluster_info_fat_FAILS()
 	SUCCEED();
 }
 
+void test_nxtr_sector_map()
+{
+	const char *_func = __func__;
+	beforeEach();
+
+	//BDD given
+	SECTOR_map *map = (SECTOR_map*)heap_top;
+	create_temp_file();
+	memset(buff, 0, sizeof(buff));
+
+	//BDD when
+	result8 = smap_open(TEMP_FILE, map);
+	ASSERT_EQUAL(result8, 0, ERROR);
+	result16 = smap_read(map, buff, 1);
+
+	//BDD then
+	ASSERT_EQUAL(result16, 0, ERROR);
+	ASSERT_EQUAL(map->count, 1, ERROR);
+	ASSERT_EQUAL(strncmp(buff, TEMP_FILE, strlen(TEMP_FILE)), 0, ERROR);
+	ASSERT_EQUAL(smap_read(map, buff, 1), ERR_EOF, ERROR);
+	SUCCEED();
+}
+
+void test_nxtr_sector_map_FAILS()
+{
+	const char *_func = __func__;
+	beforeEach();
+
+	//BDD given
+	SECTOR_map *map = (SECTOR_map*)heap_top;
+
+	//BDD when
+	result8 = smap_open(NO_FILE, map);
+
+	//BDD then
+	ASSERT_EQUAL(result8, ERR_NOFIL, ERROR);
+	SUCCEED();
+}
+
 
 // =============================================================================
 // =============================================================================
@@ -1554,12 +1873,16 @@ int main(char** argv, int argc)
 	test_fwrite(); test_fwrite_FAILS();
 	test_fputs(); test_fputs_FAILS();
 	test_fgets(); test_fgets_CRLF(); test_fgets_FAILS();
+	test_stream_sgets(); test_stream_sread(); test_stream_ssync(); test_stream_NORAM();
 	test_fseek_SET(); test_fseek_CUR(); test_fseek_END(); test_fseek_FAILS();
 	test_fflush();
 	test_filesize(); test_filesize_FAILS();
 	test_fileexists(); test_fileexists_FAILS();
 
-	test_dosversion();
+	test_dosversion(); test_nextor_version();
+
+	test_heap_mark_release(); test_heap_push_pop(); test_heap_check_stack(); test_heap_pool(); test_heap_pool_OVERFLOW();
+	test_far_mem(); test_far_mem_NORAM();
 
 	test_set_transfer_address();
 	test_read_abs_sector();
@@ -1602,6 +1925,7 @@ int main(char** argv, int argc)
 		test_nxtr_get_drive_letter_info();
 		test_nxtr_get_cluster_info_fat();
 		test_nxtr_get_cluster_info_fat_FAILS();
+		test_nxtr_sector_map(); test_nxtr_sector_map_FAILS();
 	}
 
 	return 0;
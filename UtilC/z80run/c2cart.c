@@ -0,0 +1,1072 @@
+/*
+ * Behavioural model of the Carnivore2 cartridge, after Firmware/Sources/mcscc.vhd.
+ *
+ * The cartridge takes a primary slot, expanded in four subslots:
+ *   0 = cartridge: CardMDR registers and the R1..R4 banks over the flash and the RAM
+ *   1 = Sunrise IDE: the IDE ROM (flash 10000h) and a CF card on a disk image
+ *   2 = RAM mapper: the 1MB RAM, paged by the ports FCh..FFh
+ *   3 = FMPAC: the ROM only (flash 30000h), no sound
+ *
+ * The flash is a MX29LV640ET with its command state machine: autoselect,
+ * byte program, sector and chip erase, unlock bypass, and the DQ7/DQ6/DQ5/
+ * DQ3/DQ2 status while it's busy. The busy times are the typical ones of the
+ * datasheet, counted in Z80 T-states, so the polling loops of the tools run
+ * as long as they would on the real cartridge.
+ *
+ * Not modelled: SCC, PSG and OPLL sound, the second cartridge (SCART_xxx),
+ * the subslot order of SLM_cfg (fixed E4h) and a slot without expansion
+ * (Mconf bit 7). With delayed reconfiguration on reset (CardMDR bit 2 = 0)
+ * the banks are loaded on a read of 0000h in the cartridge or by c2cart_reset(...).
+ */
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "c2cart.h"
+
+
+#define REG_BASE		0x0f80		// Registers inside the page selected by CardMDR bits 6,5
+#define BOOT_SECTORS	0x7f0000	// First 8KB boot sector
+#define IDE_ROM			0x10000		// Flash/RAM address of the IDE ROM
+#define IDE_CONF		0x4104		// Sunrise IDE control register
+#define FMPAC_ROM		0x30000
+#define FMPAC_BANK		0x7ff7
+
+// CF geometry for the CHS addressing
+#define CF_HEADS		16
+#define CF_SPT			63
+
+// ATA status and error bits
+#define ATA_BSY			0x80
+#define ATA_DRDY		0x40
+#define ATA_DSC			0x10
+#define ATA_DRQ			0x08
+#define ATA_ERR			0x01
+#define ATA_ABRT		0x04
+#define ATA_IDNF		0x10
+#define ATA_MAX_MULTIPLE	16
+
+// 93C46 cycles started when CS goes low
+enum { C2E_NONE, C2E_WRITE, C2E_ERASE, C2E_WRAL, C2E_ERAL };
+
+//###################################################################
+// Variables & Func.Definitions
+
+static uint8_t cartRead(void *ctx, uint16_t addr);
+static void    cartWrite(void *ctx, uint16_t addr, uint8_t value);
+static void    cartReset(void *ctx);
+static uint8_t ideRead(void *ctx, uint16_t addr);
+static void    ideWrite(void *ctx, uint16_t addr, uint8_t value);
+static uint8_t mapRead(void *ctx, uint16_t addr);
+static void    mapWrite(void *ctx, uint16_t addr, uint8_t value);
+static uint8_t fmRead(void *ctx, uint16_t addr);
+static void    fmWrite(void *ctx, uint16_t addr, uint8_t value);
+static uint8_t portIn(void *ctx, uint8_t port);
+static void    portOut(void *ctx, uint8_t port, uint8_t value);
+
+static void    ideResetDevice(C2Cart *c);
+
+
+//###################################################################
+// Public Functions
+
+/**
+ * c2cart_init
+ * Creates the cartridge with an erased flash and plugs it in a slot.
+ *
+ * @param slot Primary slot, 1 or 2.
+ * @return false if out of memory.
+ */
+bool c2cart_init(C2Cart *c, Msx *msx, uint8_t slot)
+{
+	static const C2Timing timing = { 9, 700000, 40000000, 50, 2000 };
+	MsxPort port = { portIn, portOut, c };
+
+	memset(c, 0, sizeof(C2Cart));
+	c->msx = msx;
+	c->slot = slot & 3;
+	c->flash = malloc(C2_FLASH_SIZE);
+	c->ram = calloc(1, C2_RAM_SIZE);
+	if (!c->flash || !c->ram) {
+		c2cart_free(c);
+		return false;
+	}
+	memset(c->flash, 0xff, C2_FLASH_SIZE);
+	memset(c->eeprom, 0xff, C2_EEPROM_SIZE);
+	c->timing = timing;
+	c->ide.fd = -1;
+	c2cart_reset(c);
+
+	c->dev[0] = (MsxDevice){ cartRead, cartWrite, cartReset, c };
+	c->dev[1] = (MsxDevice){ ideRead, ideWrite, NULL, c };
+	c->dev[2] = (MsxDevice){ mapRead, mapWrite, NULL, c };
+	c->dev[3] = (MsxDevice){ fmRead, fmWrite, NULL, c };
+	for (int i = 0; i < 4; i++) {
+		msx_insert(msx, c->slot, i, &c->dev[i]);
+		msx_setPort(msx, 0xf0 + i, &port);
+	}
+	return true;
+}
+
+void c2cart_free(C2Cart *c)
+{
+	if (c->ide.fd >= 0) close(c->ide.fd);
+	free(c->flash);
+	free(c->ram);
+	c->flash = c->ram = NULL;
+	c->ide.fd = -1;
+}
+
+/**
+ * c2cart_reset
+ * Power on state of the registers, as in the reset branch of mcscc.vhd.
+ * The flash aborts any operation, the contents of the memories are kept.
+ */
+void c2cart_reset(C2Cart *c)
+{
+	static const uint8_t bank1[] = { 0xf8, 0x50, 0x00, 0x85, 0x03, 0x40 };
+
+	memset(c->reg, 0, sizeof(c->reg));
+	c->reg[C2_CARDMDR] = 0x30;
+	c->reg[C2_CONFFL] = 0x02;
+	memcpy(c->reg + C2_R1MASK, bank1, sizeof(bank1));
+	c->reg[C2_MCONF] = 0xff;
+	c->reg[C2_SLM_CFG] = 0xe4;
+	memcpy(c->act, c->reg, sizeof(c->act));
+	c->portMode = 0;
+	c->ideConf = 0;
+	c->fmBank = 0;
+
+	memset(&c->fl, 0, sizeof(c->fl));
+	c->fl.state = C2F_READ;
+	memset(&c->ee, 0, sizeof(c->ee));
+	c->ee.readBit = -1;
+	ideResetDevice(c);
+}
+
+/**
+ * c2cart_loadFlash
+ * Loads a flash image (up to 8MB, the rest stays erased).
+ */
+bool c2cart_loadFlash(C2Cart *c, const char *filename)
+{
+	FILE *f = fopen(filename, "rb");
+	bool ok;
+
+	if (!f) return false;
+	memset(c->flash, 0xff, C2_FLASH_SIZE);
+	ok = fread(c->flash, 1, C2_FLASH_SIZE, f) > 0 || !ferror(f);
+	fclose(f);
+	c->flashDirty = false;
+	return ok;
+}
+
+/**
+ * c2cart_saveFlash
+ * Writes the whole 8MB flash to a file.
+ */
+bool c2cart_saveFlash(C2Cart *c, const char *filename)
+{
+	FILE *f = fopen(filename, "wb");
+	bool ok;
+
+	if (!f) return false;
+	ok = fwrite(c->flash, 1, C2_FLASH_SIZE, f) == C2_FLASH_SIZE;
+	if (fclose(f)) ok = false;
+	if (ok) c->flashDirty = false;
+	return ok;
+}
+
+/**
+ * c2cart_openDisk
+ * Inserts a CF card: a raw image of the whole device, written in place.
+ * A read-only file makes a write protected card (writes end with an error).
+ */
+bool c2cart_openDisk(C2Cart *c, const char *filename)
+{
+	struct stat st;
+
+	if (c->ide.fd >= 0) close(c->ide.fd);
+	c->ide.fd = open(filename, O_RDWR);
+	if (c->ide.fd < 0) c->ide.fd = open(filename, O_RDONLY);
+	if (c->ide.fd < 0 || fstat(c->ide.fd, &st) || st.st_size < C2_SECSIZE) {
+		if (c->ide.fd >= 0) close(c->ide.fd);
+		c->ide.fd = -1;
+		return false;
+	}
+	c->ide.sectors = st.st_size / C2_SECSIZE;
+	ideResetDevice(c);
+	return true;
+}
+
+//-------------------------------------------------------------------
+// Flash
+
+static inline uint64_t now(const C2Cart *c)
+{
+	return c->msx->cpu.cycles;
+}
+
+static inline uint64_t usToCycles(uint32_t us)
+{
+	return (uint64_t)us * MSX_CLOCK / 1000000;
+}
+
+static int sectorOf(uint32_t addr)
+{
+	return addr < BOOT_SECTORS ? (int)(addr >> 16) : 127 + (int)((addr - BOOT_SECTORS) >> 13);
+}
+
+static void sectorRange(int sector, uint32_t *start, uint32_t *size)
+{
+	if (sector < 127) {
+		*start = (uint32_t)sector << 16;
+		*size = 0x10000;
+	} else {
+		*start = BOOT_SECTORS + ((uint32_t)(sector - 127) << 13);
+		*size = 0x2000;
+	}
+}
+
+static bool isErasing(const C2Flash *fl, uint32_t addr)
+{
+	int s = sectorOf(addr);
+	return fl->chip || (fl->sectors[s >> 3] & (1 << (s & 7)));
+}
+
+static void flashDone(C2Cart *c)
+{
+	C2Flash *fl = &c->fl;
+
+	c->stats.busyCycles += fl->busyEnd - fl->busyStart;
+	fl->state = fl->bypass ? C2F_BYPASS : C2F_READ;
+}
+
+// Ends the operations whose time is over
+static void flashUpdate(C2Cart *c)
+{
+	C2Flash *fl = &c->fl;
+
+	switch (fl->state) {
+		case C2F_ERASE_WINDOW:
+			if (now(c) < fl->busyEnd) return;
+			{
+				int n = 0;
+				for (int s = 0; s < C2_FLASH_SECTORS; s++) n += (fl->sectors[s >> 3] >> (s & 7)) & 1;
+				fl->busyEnd += usToCycles(c->timing.sectorErase) * n;
+			}
+			fl->state = C2F_BUSY_ERASE;
+			// Fall through
+		case C2F_BUSY_ERASE:
+			if (now(c) < fl->busyEnd) return;
+			if (fl->chip) {
+				memset(c->flash, 0xff, C2_FLASH_SIZE);
+			} else {
+				for (int s = 0; s < C2_FLASH_SECTORS; s++) {
+					uint32_t start, size;
+					if (!(fl->sectors[s >> 3] & (1 << (s & 7)))) continue;
+					sectorRange(s, &start, &size);
+					memset(c->flash + start, 0xff, size);
+				}
+			}
+			c->flashDirty = true;
+			flashDone(c);
+			return;
+		case C2F_BUSY_PROGRAM:
+			if (now(c) < fl->busyEnd) return;
+			if (fl->fail) {
+				c->stats.busyCycles += fl->busyEnd - fl->busyStart;
+				fl->state = C2F_FAILED;
+				return;
+			}
+			flashDone(c);
+			return;
+		default:
+			return;
+	}
+}
+
+static uint8_t flashStatus(C2Cart *c, uint32_t addr)
+{
+	C2Flash *fl = &c->fl;
+	uint8_t v;
+
+	c->stats.busyReads++;
+	fl->toggle ^= 0x44;
+	switch (fl->state) {
+		case C2F_BUSY_PROGRAM:
+			return (~fl->data & 0x80) | (fl->toggle & 0x40);
+		case C2F_FAILED:
+			return (~fl->data & 0x80) | (fl->toggle & 0x40) | 0x20;
+		default:
+			v = fl->toggle & 0x40;
+			if (fl->state == C2F_BUSY_ERASE) v |= 0x08;
+			if (isErasing(fl, addr)) v |= fl->toggle & 0x04;
+			return v;
+	}
+}
+
+static void flashProgram(C2Cart *c, uint32_t addr, uint8_t value)
+{
+	C2Flash *fl = &c->fl;
+
+	fl->addr = addr;
+	fl->data = value;
+	fl->fail = (c->flash[addr] & value) != value;
+	if (fl->fail) c->stats.commandErrors++;
+	c->flash[addr] &= value;
+	c->flashDirty = true;
+	c->stats.programs++;
+	if (fl->bypass) c->stats.bypassPrograms++;
+	fl->busyStart = now(c);
+	fl->busyEnd = fl->busyStart + usToCycles(c->timing.program);
+	fl->state = C2F_BUSY_PROGRAM;
+}
+
+static void flashErase(C2Cart *c, uint32_t addr, bool chip)
+{
+	C2Flash *fl = &c->fl;
+	int s = sectorOf(addr);
+
+	fl->busyStart = now(c);
+	fl->chip = chip;
+	memset(fl->sectors, 0, sizeof(fl->sectors));
+	if (chip) {
+		c->stats.chipErases++;
+		fl->busyEnd = fl->busyStart + usToCycles(c->timing.chipErase);
+		fl->state = C2F_BUSY_ERASE;
+		return;
+	}
+	c->stats.sectorErases++;
+	fl->sectors[s >> 3] |= 1 << (s & 7);
+	fl->busyEnd = fl->busyStart + usToCycles(c->timing.eraseWindow);
+	fl->state = C2F_ERASE_WINDOW;
+}
+
+/**
+ * c2cart_flashRead
+ * Flash read cycle: array data, autoselect codes, or the status while busy.
+ *
+ * @param addr Flash address, 0..7FFFFFh.
+ */
+uint8_t c2cart_flashRead(C2Cart *c, uint32_t addr)
+{
+	addr &= C2_FLASH_SIZE - 1;
+	if (!(c->reg[C2_CONFFL] & 0x02)) return 0xff;	// RESET# low
+	flashUpdate(c);
+	switch (c->fl.state) {
+		case C2F_BUSY_PROGRAM:
+		case C2F_ERASE_WINDOW:
+		case C2F_BUSY_ERASE:
+		case C2F_FAILED:
+			return flashStatus(c, addr);
+		case C2F_AUTOSELECT:
+			switch (addr & 0xff) {
+				case 0x00: return 0xc2;		// Manufacturer: Macronix
+				case 0x02: return 0xc9;		// Device: MX29LV640ET
+				case 0x04: return 0x00;		// Sector not protected
+				case 0x06: return 0x08;		// Security sector not locked
+				case 0x1c: return 0xff;
+				case 0x1e: return 0x08;
+			}
+			return 0x00;
+		default:
+			return c->flash[addr];
+	}
+}
+
+/**
+ * c2cart_flashWrite
+ * Flash write cycle, fed to the command state machine.
+ * The unlock cycles are decoded on the address bits A10..A-1 (AAAh/555h).
+ *
+ * @param addr Flash address, 0..7FFFFFh.
+ */
+void c2cart_flashWrite(C2Cart *c, uint32_t addr, uint8_t value)
+{
+	C2Flash *fl = &c->fl;
+	uint16_t low;
+
+	addr &= C2_FLASH_SIZE - 1;
+	low = addr & 0xfff;
+	if (!(c->reg[C2_CONFFL] & 0x02)) return;
+	flashUpdate(c);
+	switch (fl->state) {
+		case C2F_BUSY_PROGRAM:
+		case C2F_BUSY_ERASE:
+			c->stats.commandErrors++;
+			return;
+		case C2F_ERASE_WINDOW:
+			// More sectors can be added until the time-out ends
+			if (value == 0x30 && !fl->chip) {
+				int s = sectorOf(addr);
+				if (!(fl->sectors[s >> 3] & (1 << (s & 7)))) c->stats.sectorErases++;
+				fl->sectors[s >> 3] |= 1 << (s & 7);
+				fl->busyEnd = now(c) + usToCycles(c->timing.eraseWindow);
+			} else {
+				c->stats.commandErrors++;
+			}
+			return;
+		case C2F_FAILED:
+			if (value == 0xf0) {
+				fl->bypass = false;
+				fl->state = C2F_READ;
+			}
+			return;
+		case C2F_READ:
+		case C2F_AUTOSELECT:
+			if (low == 0xaaa && value == 0xaa) fl->state = C2F_UNLOCK1;
+			else if (value == 0xf0) fl->state = C2F_READ;
+			return;
+		case C2F_UNLOCK1:
+			fl->state = low == 0x555 && value == 0x55 ? C2F_UNLOCK2 : C2F_READ;
+			return;
+		case C2F_UNLOCK2:
+			fl->state = C2F_READ;
+			if (low != 0xaaa) return;
+			switch (value) {
+				case 0x90: fl->state = C2F_AUTOSELECT; break;
+				case 0xa0: fl->state = C2F_PROGRAM; break;
+				case 0x80: fl->state = C2F_ERASE; break;
+				case 0x20: fl->state = C2F_BYPASS; fl->bypass = true; break;
+			}
+			return;
+		case C2F_PROGRAM:
+		case C2F_BYPASS_PROGRAM:
+			flashProgram(c, addr, value);
+			return;
+		case C2F_ERASE:
+			fl->state = low == 0xaaa && value == 0xaa ? C2F_ERASE_UNLOCK1 : C2F_READ;
+			return;
+		case C2F_ERASE_UNLOCK1:
+			fl->state = low == 0x555 && value == 0x55 ? C2F_ERASE_UNLOCK2 : C2F_READ;
+			return;
+		case C2F_ERASE_UNLOCK2:
+		case C2F_BYPASS_ERASE:
+			if (value == 0x30) flashErase(c, addr, false);
+			else if (value == 0x10 && low == 0xaaa) flashErase(c, addr, true);
+			else fl->state = fl->bypass ? C2F_BYPASS : C2F_READ;
+			return;
+		case C2F_BYPASS:
+			if (value == 0xa0) fl->state = C2F_BYPASS_PROGRAM;
+			else if (value == 0x80) fl->state = C2F_BYPASS_ERASE;
+			else if (value == 0x90) fl->state = C2F_BYPASS_RESET;
+			return;
+		case C2F_BYPASS_RESET:
+			if (value == 0x00) fl->bypass = false;
+			fl->state = fl->bypass ? C2F_BYPASS : C2F_READ;
+			return;
+	}
+}
+
+/**
+ * c2cart_printStats
+ * Prints the flash, EEPROM and IDE activity.
+ */
+void c2cart_printStats(const C2Cart *c, FILE *f)
+{
+	const C2Stats *s = &c->stats;
+
+	fprintf(f, "Carnivore2: %llu bytes programmed (%llu in unlock bypass), %llu sectors and %llu chip erases\n",
+			(unsigned long long)s->programs, (unsigned long long)s->bypassPrograms,
+			(unsigned long long)s->sectorErases, (unsigned long long)s->chipErases);
+	fprintf(f, "Carnivore2: flash busy %llu T-states (%.3f s), %llu status reads, %llu command errors\n",
+			(unsigned long long)s->busyCycles, (double)s->busyCycles / MSX_CLOCK,
+			(unsigned long long)s->busyReads, (unsigned long long)s->commandErrors);
+	fprintf(f, "Carnivore2: %llu EEPROM writes, %llu IDE commands, %llu sectors read, %llu sectors written\n",
+			(unsigned long long)s->eepromWrites, (unsigned long long)s->ideCommands,
+			(unsigned long long)s->ideSectorsRead, (unsigned long long)s->ideSectorsWritten);
+}
+
+
+//###################################################################
+// Private Functions
+
+//-------------------------------------------------------------------
+// EEPROM 93C46 (8 bit), bit-banged at CardMDR+#23: CS bit 3, CK bit 2, DI bit 1, DO bit 0
+
+static uint8_t eepromOut(C2Cart *c)
+{
+	C2Eeprom *ee = &c->ee;
+
+	if (!(ee->pins & 0x08)) return 1;				// CS low: DO floats high
+	if (ee->readBit >= 0) return ee->out;
+	if (ee->status) return now(c) >= ee->busyEnd;	// Ready/busy
+	return 1;
+}
+
+static void eepromCommand(C2Cart *c)
+{
+	C2Eeprom *ee = &c->ee;
+	uint8_t op = (ee->shift >> 7) & 3;
+
+	ee->addr = ee->shift & 0x7f;
+	switch (op) {
+		case 2:		// READ
+			ee->readBit = 8;
+			ee->out = 0;			// Dummy bit
+			break;
+		case 3:		// ERASE
+			ee->pending = C2E_ERASE;
+			break;
+		case 0:
+			switch (ee->addr >> 5) {
+				case 0: ee->writeEnable = false; break;		// EWDS
+				case 2: ee->pending = C2E_ERAL; break;
+				case 3: ee->writeEnable = true; break;		// EWEN
+			}
+			break;
+	}
+}
+
+static void eepromCycle(C2Cart *c)
+{
+	C2Eeprom *ee = &c->ee;
+
+	if (ee->pending == C2E_NONE || !ee->writeEnable || now(c) < ee->busyEnd) {
+		ee->pending = C2E_NONE;
+		return;
+	}
+	switch (ee->pending) {
+		case C2E_WRITE: c->eeprom[ee->addr] = ee->data; break;
+		case C2E_ERASE: c->eeprom[ee->addr] = 0xff; break;
+		case C2E_WRAL: memset(c->eeprom, ee->data, C2_EEPROM_SIZE); break;
+		case C2E_ERAL: memset(c->eeprom, 0xff, C2_EEPROM_SIZE); break;
+	}
+	ee->pending = C2E_NONE;
+	ee->status = true;
+	ee->busyEnd = now(c) + usToCycles(c->timing.eepromWrite);
+	c->stats.eepromWrites++;
+}
+
+static void eepromWrite(C2Cart *c, uint8_t value)
+{
+	C2Eeprom *ee = &c->ee;
+	uint8_t old = ee->pins;
+
+	ee->pins = value & 0x0e;
+	if (!(value & 0x08)) {
+		if (old & 0x08) eepromCycle(c);
+		ee->started = false;
+		ee->readBit = -1;
+		return;
+	}
+	if (!(value & 0x04) || (old & 0x0c) == 0x0c) return;
+
+	// Rising clock with CS high
+	if (ee->readBit >= 0) {
+		if (ee->readBit == 0) {
+			ee->addr = (ee->addr + 1) & 0x7f;
+			ee->readBit = 8;
+		}
+		ee->readBit--;
+		ee->out = (c->eeprom[ee->addr] >> ee->readBit) & 1;
+		return;
+	}
+	if (!ee->started) {
+		if (!(value & 0x02)) return;
+		ee->started = true;
+		ee->status = false;
+		ee->shift = 0;
+		ee->bits = 0;
+		return;
+	}
+	ee->shift = (ee->shift << 1) | ((value >> 1) & 1);
+	ee->bits++;
+	if (ee->bits == 9) {
+		eepromCommand(c);
+	} else if (ee->bits == 17) {
+		uint8_t op = (ee->shift >> 15) & 3, addr = (ee->shift >> 8) & 0x7f;
+		ee->data = ee->shift;
+		if (op == 1) ee->pending = C2E_WRITE;
+		else if (op == 0 && (addr >> 5) == 1) ee->pending = C2E_WRAL;
+	}
+}
+
+//-------------------------------------------------------------------
+// Cartridge subslot: registers and banks
+
+static bool isReg(const C2Cart *c, uint16_t addr)
+{
+	uint8_t mdr = c->reg[C2_CARDMDR];
+	return (addr & 0x3fc0) == REG_BASE && !(mdr & 0x80) && (addr >> 14) == ((mdr >> 5) & 3);
+}
+
+// Loads the registers of the delayed reconfiguration
+static void reload(C2Cart *c)
+{
+	memcpy(c->act + C2_ADDRFR, c->reg + C2_ADDRFR, C2_MCONF - C2_ADDRFR + 1);
+	c->act[C2_NSREG] = c->reg[C2_NSREG];
+	memcpy(c->act + C2_SLM_CFG, c->reg + C2_SLM_CFG, C2_SCART_STBL - C2_SLM_CFG + 1);
+}
+
+static uint8_t regRead(C2Cart *c, uint8_t offset)
+{
+	static const char version[] = "250";
+
+	switch (offset) {
+		case C2_DATM0:
+			return c2cart_flashRead(c, c->reg[C2_ADDRM0] | (c->reg[C2_ADDRM1] << 8) | (c->reg[C2_ADDRM2] << 16));
+		case C2_CARDMDR2:
+			return c->reg[C2_CARDMDR];
+		case C2_EECS:
+			return (c->ee.pins & 0x0e) | eepromOut(c);
+		case C2_VERSION: case C2_VERSION + 1: case C2_VERSION + 2:
+			return version[offset - C2_VERSION];
+		case 0x31: case 0x32: case 0x33:
+			return 0x00;
+		case 0x34:
+			return c->msx->slotReg;
+		case C2_PFXN:
+			return 0xf0 | (c->reg[C2_PFXN] & 3);
+	}
+	if (offset < C2_LVL1 + 1 || (offset >= C2_SLM_CFG && offset <= 0x30)) return c->reg[offset];
+	return 0xff;
+}
+
+static void regWrite(C2Cart *c, uint8_t offset, uint8_t value)
+{
+	switch (offset) {
+		case C2_CARDMDR:
+		case C2_CARDMDR2:
+			c->reg[C2_CARDMDR] = value;
+			break;
+		case C2_ADDRM2:
+		case C2_ADDRFR:
+			c->reg[offset] = value & 0x7f;
+			break;
+		case C2_DATM0:
+			c2cart_flashWrite(c, c->reg[C2_ADDRM0] | (c->reg[C2_ADDRM1] << 8) | (c->reg[C2_ADDRM2] << 16), value);
+			return;
+		case C2_MCONF:
+			if ((value & 0x80) || (value & 0x0f) != 0x0f) c->reg[C2_MCONF] = value;
+			break;
+		case C2_CONFFL:
+			c->reg[C2_CONFFL] = value & 0x07;
+			if (!(value & 0x02)) {
+				c->fl.state = C2F_READ;		// RESET# aborts any operation
+				c->fl.bypass = false;
+			}
+			break;
+		case C2_EECS:
+			eepromWrite(c, value);
+			break;
+		case C2_PFXN:
+			c->reg[C2_PFXN] = value & 3;
+			break;
+		default:
+			if (offset <= 0x30 && (offset < C2_VERSION || offset > C2_VERSION + 2)) c->reg[offset] = value;
+			break;
+	}
+	if (!(c->reg[C2_CARDMDR] & 0x08)) reload(c);
+}
+
+/**
+ * findBank
+ * Looks for the bank (R1 first) that maps an address.
+ *
+ * @param addr Address in the slot.
+ * @param mem Address in the flash, or in the RAM for the low 20 bits.
+ * @return Offset of the bank registers (C2_RxMASK), -1 if none.
+ */
+static int findBank(const C2Cart *c, uint16_t addr, uint32_t *mem)
+{
+	for (int b = 0; b < 4; b++) {
+		const uint8_t *r = c->act + C2_R1MASK + b * 6;		// Mask, Addr, Reg, Mult, MaskR, AdrD
+		uint8_t mult = r[3], diff = r[5] ^ (addr >> 8);
+		int shift;
+
+		if (mult & 0x08) continue;
+		switch (mult & 7) {
+			case 7: shift = 16; break;
+			case 6: if (diff & 0x80) continue; shift = 15; break;
+			case 5: if (diff & 0xc0) continue; shift = 14; break;
+			case 4: if ((diff & 0x60) || ((mult & 0x40) && (diff & 0x80))) continue; shift = 13; break;
+			default: continue;
+		}
+		*mem = ((((uint32_t)(r[4] & r[2]) << shift) | (addr & ((1 << shift) - 1))) +
+				((uint32_t)c->act[C2_ADDRFR] << 16)) & (C2_FLASH_SIZE - 1);
+		return C2_R1MASK + b * 6;
+	}
+	return -1;
+}
+
+static uint8_t cartRead(void *ctx, uint16_t addr)
+{
+	C2Cart *c = ctx;
+	uint8_t mdr = c->reg[C2_CARDMDR];
+	uint32_t mem;
+	int bank;
+
+	if (!(c->act[C2_MCONF] & 0x01)) return 0xff;
+	if (isReg(c, addr) && !(mdr & 0x01)) return regRead(c, addr & 0x3f);
+	if ((mdr & 0x08) && ((mdr & 0x04) ? (addr & 0xfff0) == 0x4000 : addr == 0x0000)) reload(c);
+	bank = findBank(c, addr, &mem);
+	if (bank < 0) return 0xff;
+	if (c->act[bank + 3] & 0x20) return c->ram[mem & (C2_RAM_SIZE - 1)];
+	return c2cart_flashRead(c, mem);
+}
+
+static void cartWrite(void *ctx, uint16_t addr, uint8_t value)
+{
+	C2Cart *c = ctx;
+	uint32_t mem;
+	int bank;
+
+	if (!(c->act[C2_MCONF] & 0x01)) return;
+	if (isReg(c, addr)) {
+		regWrite(c, addr & 0x3f, value);
+		return;
+	}
+
+	// The data goes to the bank as mapped before the bank registers change
+	bank = findBank(c, addr, &mem);
+	for (int b = C2_R1MASK; b <= C2_R4MASK; b += 6) {
+		const uint8_t *r = c->act + b;
+		if ((r[3] & 0x80) && !(((addr >> 8) ^ r[1]) & r[0])) c->act[b + 2] = c->reg[b + 2] = value;
+	}
+	if (bank < 0 || !(c->act[bank + 3] & 0x10)) return;
+	if (c->act[bank + 3] & 0x20) c->ram[mem & (C2_RAM_SIZE - 1)] = value;
+	else c2cart_flashWrite(c, mem, value);
+}
+
+static void cartReset(void *ctx)
+{
+	c2cart_reset(ctx);
+}
+
+//-------------------------------------------------------------------
+// IDE subslot: Sunrise compatible interface with a CF card
+
+static bool isIdeReg(const C2Cart *c, uint16_t addr)
+{
+	return (c->ideConf & 0x01) && (addr & 0xfc00) == 0x7c00 && (addr & 0x0300) != 0x0300;
+}
+
+static void ideResetDevice(C2Cart *c)
+{
+	C2Ide *ide = &c->ide;
+
+	memset(ide->reg, 0, sizeof(ide->reg));
+	ide->reg[2] = ide->reg[3] = 1;
+	ide->error = 0x01;				// Diagnostic passed
+	ide->status = ATA_DRDY | ATA_DSC;
+	ide->command = 0;
+	ide->count = 0;
+	ide->pos = 0;
+	ide->multiple = 0;
+}
+
+static void ideError(C2Ide *ide, uint8_t error)
+{
+	ide->error = error;
+	ide->status = ATA_DRDY | ATA_DSC | ATA_ERR;
+	ide->command = 0;
+}
+
+static void ideSetLba(C2Ide *ide)
+{
+	ide->reg[3] = ide->lba;
+	ide->reg[4] = ide->lba >> 8;
+	ide->reg[5] = ide->lba >> 16;
+	ide->reg[6] = (ide->reg[6] & 0xf0) | ((ide->lba >> 24) & 0x0f);
+	ide->reg[2] = ide->count;
+}
+
+static bool ideLoadSector(C2Cart *c)
+{
+	C2Ide *ide = &c->ide;
+
+	if (ide->lba >= ide->sectors ||
+		pread(ide->fd, ide->buf, C2_SECSIZE, (off_t)ide->lba * C2_SECSIZE) != C2_SECSIZE) {
+		ideError(ide, ATA_IDNF);
+		return false;
+	}
+	c->stats.ideSectorsRead++;
+	ide->pos = 0;
+	ide->status = ATA_DRDY | ATA_DSC | ATA_DRQ;
+	return true;
+}
+
+static void ideString(uint8_t *p, const char *s, int len)
+{
+	for (int i = 0; i < len; i++) p[i ^ 1] = *s ? *s++ : ' ';
+}
+
+static void ideIdentify(C2Ide *ide)
+{
+	uint16_t w[256];
+	uint32_t cyls = ide->sectors / (CF_HEADS * CF_SPT);
+
+	memset(w, 0, sizeof(w));
+	if (cyls > 16383) cyls = 16383;
+	w[0] = 0x848a;					// CompactFlash
+	w[1] = w[54] = cyls;
+	w[3] = w[55] = CF_HEADS;
+	w[6] = w[56] = CF_SPT;
+	w[47] = 0x8000 | ATA_MAX_MULTIPLE;
+	w[49] = 0x0200;					// LBA
+	w[53] = 0x0001;
+	w[57] = (cyls * CF_HEADS * CF_SPT) & 0xffff;
+	w[58] = (cyls * CF_HEADS * CF_SPT) >> 16;
+	w[59] = ide->multiple ? 0x0100 | ide->multiple : 0;
+	w[60] = ide->sectors & 0xffff;
+	w[61] = ide->sectors >> 16;
+	for (int i = 0; i < 256; i++) {
+		ide->buf[i * 2] = w[i];
+		ide->buf[i * 2 + 1] = w[i] >> 8;
+	}
+	ideString(ide->buf + 20, "C2MODEL0001", 20);
+	ideString(ide->buf + 46, "1.0", 8);
+	ideString(ide->buf + 54, "z80run CF card", 40);
+	ide->pos = 0;
+	ide->count = 1;
+	ide->status = ATA_DRDY | ATA_DSC | ATA_DRQ;
+}
+
+static void ideCommand(C2Cart *c, uint8_t cmd)
+{
+	C2Ide *ide = &c->ide;
+
+	c->stats.ideCommands++;
+	ide->error = 0;
+	ide->command = 0;
+	ide->status = ATA_DRDY | ATA_DSC;
+	if (ide->reg[6] & 0x40) {
+		ide->lba = ide->reg[3] | (ide->reg[4] << 8) | (ide->reg[5] << 16) | ((uint32_t)(ide->reg[6] & 0x0f) << 24);
+	} else {
+		uint32_t cyl = ide->reg[4] | (ide->reg[5] << 8);
+		ide->lba = (cyl * CF_HEADS + (ide->reg[6] & 0x0f)) * CF_SPT + ide->reg[3] - 1;
+	}
+	ide->count = ide->reg[2] ? ide->reg[2] : 256;
+
+	switch (cmd) {
+		case 0xc4:		// READ MULTIPLE
+		case 0xc5:		// WRITE MULTIPLE
+			if (!ide->multiple) {
+				ideError(ide, ATA_ABRT);
+				return;
+			}
+			// Fall through
+		case 0x20: case 0x21:	// READ SECTORS
+		case 0x30: case 0x31:	// WRITE SECTORS
+			ide->command = cmd;
+			if (cmd == 0x30 || cmd == 0x31 || cmd == 0xc5) {
+				ide->pos = 0;
+				ide->status = ATA_DRDY | ATA_DSC | ATA_DRQ;
+			} else {
+				ideLoadSector(c);
+			}
+			return;
+		case 0xec:		// IDENTIFY DEVICE
+			ideIdentify(ide);
+			ide->command = cmd;
+			return;
+		case 0xc6:		// SET MULTIPLE MODE
+			if (ide->reg[2] > ATA_MAX_MULTIPLE || (ide->reg[2] & (ide->reg[2] - 1))) ideError(ide, ATA_ABRT);
+			else ide->multiple = ide->reg[2];
+			return;
+		case 0x90:		// EXECUTE DEVICE DIAGNOSTIC
+			ide->error = 0x01;
+			return;
+		case 0x10: case 0x91: case 0xe7: case 0xef:
+		case 0xe0: case 0xe1: case 0xe2: case 0xe3: case 0xe5:
+			return;
+	}
+	ideError(ide, ATA_ABRT);
+}
+
+static uint16_t ideDataRead(C2Cart *c)
+{
+	C2Ide *ide = &c->ide;
+	uint16_t w;
+
+	if (!(ide->status & ATA_DRQ) || ide->command == 0x30 || ide->command == 0x31 || ide->command == 0xc5) return 0xffff;
+	w = ide->buf[ide->pos] | (ide->buf[ide->pos + 1] << 8);
+	ide->pos += 2;
+	if (ide->pos < C2_SECSIZE) return w;
+	ide->count--;
+	if (ide->command == 0xec || !ide->count) {
+		ideSetLba(ide);
+		ide->status = ATA_DRDY | ATA_DSC;
+		ide->command = 0;
+		return w;
+	}
+	ide->lba++;
+	ideLoadSector(c);
+	return w;
+}
+
+static void ideDataWrite(C2Cart *c, uint16_t w)
+{
+	C2Ide *ide = &c->ide;
+
+	if (!(ide->status & ATA_DRQ) || !(ide->command == 0x30 || ide->command == 0x31 || ide->command == 0xc5)) return;
+	ide->buf[ide->pos] = w;
+	ide->buf[ide->pos + 1] = w >> 8;
+	ide->pos += 2;
+	if (ide->pos < C2_SECSIZE) return;
+	if (ide->lba >= ide->sectors ||
+		pwrite(ide->fd, ide->buf, C2_SECSIZE, (off_t)ide->lba * C2_SECSIZE) != C2_SECSIZE) {
+		ideError(ide, ATA_IDNF);
+		return;
+	}
+	c->stats.ideSectorsWritten++;
+	ide->pos = 0;
+	if (--ide->count) {
+		ide->lba++;
+		return;
+	}
+	ideSetLba(ide);
+	ide->status = ATA_DRDY | ATA_DSC;
+	ide->command = 0;
+}
+
+static uint8_t ideReadReg(C2Cart *c, uint16_t addr)
+{
+	C2Ide *ide = &c->ide;
+	uint8_t r = addr & 7;
+
+	if (ide->fd < 0) return 0xff;			// No card
+	if (addr & 8) return r == 6 ? ide->status : 0xff;
+	switch (r) {
+		case 0: return ideDataRead(c);
+		case 1: return ide->error;
+		case 7: return ide->status;
+	}
+	return ide->reg[r];
+}
+
+static void ideWriteReg(C2Cart *c, uint16_t addr, uint8_t value)
+{
+	C2Ide *ide = &c->ide;
+	uint8_t r = addr & 7;
+
+	if (ide->fd < 0) return;
+	if (addr & 8) {
+		if (r != 6) return;
+		if ((value & 0x04) && !(ide->control & 0x04)) ideResetDevice(c);	// SRST
+		ide->control = value;
+		return;
+	}
+	switch (r) {
+		case 0: ideDataWrite(c, value | (value << 8)); break;
+		case 7: ideCommand(c, value); break;
+		default: ide->reg[r] = value; break;
+	}
+}
+
+static uint8_t ideRead(void *ctx, uint16_t addr)
+{
+	C2Cart *c = ctx;
+	uint32_t mem;
+
+	if (!(c->act[C2_MCONF] & 0x02)) return 0xff;
+	if (isIdeReg(c, addr)) {
+		if (addr & 0x0200) return ideReadReg(c, addr);
+		if (addr & 1) return c->ide.latchIn;
+		if (c->ide.fd < 0) return 0xff;
+		{
+			uint16_t w = ideDataRead(c);
+			c->ide.latchIn = w >> 8;
+			return w;
+		}
+	}
+	if ((addr & 0xc000) != 0x4000) return 0xff;
+	mem = IDE_ROM + ((((c->ideConf >> 5) & 1) << 2 | ((c->ideConf >> 6) & 1) << 1 | (c->ideConf >> 7)) << 14) +
+		  (addr & 0x3fff);
+	return (c->reg[C2_CARDMDR] & 0x02) ? c->ram[mem] : c2cart_flashRead(c, mem);
+}
+
+static void ideWrite(void *ctx, uint16_t addr, uint8_t value)
+{
+	C2Cart *c = ctx;
+
+	if (!(c->act[C2_MCONF] & 0x02)) return;
+	if (addr == IDE_CONF) {
+		c->ideConf = value;
+		return;
+	}
+	if (!isIdeReg(c, addr)) return;
+	if (addr & 0x0200) ideWriteReg(c, addr, value);
+	else if (addr & 1) ideDataWrite(c, c->ide.latchOut | (value << 8));
+	else c->ide.latchOut = value;
+}
+
+//-------------------------------------------------------------------
+// RAM mapper and FMPAC subslots
+
+static inline uint32_t mapAddr(const C2Cart *c, uint16_t addr)
+{
+	return ((uint32_t)(c->msx->mapper[addr >> 14] & 0x3f) << 14) | (addr & 0x3fff);
+}
+
+static uint8_t mapRead(void *ctx, uint16_t addr)
+{
+	C2Cart *c = ctx;
+	return (c->act[C2_MCONF] & 0x04) ? c->ram[mapAddr(c, addr)] : 0xff;
+}
+
+static void mapWrite(void *ctx, uint16_t addr, uint8_t value)
+{
+	C2Cart *c = ctx;
+	if (c->act[C2_MCONF] & 0x04) c->ram[mapAddr(c, addr)] = value;
+}
+
+static uint8_t fmRead(void *ctx, uint16_t addr)
+{
+	C2Cart *c = ctx;
+	uint32_t mem = FMPAC_ROM + (c->fmBank << 14) + (addr & 0x3fff);
+
+	if (!(c->act[C2_MCONF] & 0x08) || (addr & 0xc000) != 0x4000) return 0xff;
+	if (addr == FMPAC_BANK) return c->fmBank;
+	return (c->reg[C2_CARDMDR] & 0x02) ? c->ram[mem] : c2cart_flashRead(c, mem);
+}
+
+static void fmWrite(void *ctx, uint16_t addr, uint8_t value)
+{
+	C2Cart *c = ctx;
+	if ((c->act[C2_MCONF] & 0x08) && addr == FMPAC_BANK) c->fmBank = value & 3;
+}
+
+//-------------------------------------------------------------------
+// Port #F0 (or #F1..#F3, see PFXN): detection and control
+
+static uint8_t portIn(void *ctx, uint8_t port)
+{
+	C2Cart *c = ctx;
+
+	if (port != 0xf0 + (c->reg[C2_PFXN] & 3)) return 0xff;
+	switch (c->portMode) {
+		case 1: return '2';
+		case 2: return '0' + c->slot;
+	}
+	return 0xff;
+}
+
+static void portOut(void *ctx, uint8_t port, uint8_t value)
+{
+	C2Cart *c = ctx;
+	uint8_t *mdr = &c->reg[C2_CARDMDR];
+
+	if (port != 0xf0 + (c->reg[C2_PFXN] & 3)) return;
+	switch (value) {
+		case 'C': c->portMode = 1; break;				// Version, "2"
+		case 'S': c->portMode = 2; break;				// Slot
+		case 'R': *mdr &= 0x7f; break;					// Registers on
+		case 'H': *mdr |= 0x80; break;					// Registers off
+		case '0': case '1': case '2': case '3':			// Registers at #0F80/#4F80/#8F80/#CF80
+			*mdr = (*mdr & 0x9f) | ((value - '0') << 5);
+			break;
+		case 'A':										// Cartridge only
+			c->reg[C2_MCONF] = c->act[C2_MCONF] = (c->act[C2_MCONF] & 0x70) | 0x01;
+			break;
+		case 'M':										// Default subslots
+			c->reg[C2_MCONF] = c->act[C2_MCONF] = (c->act[C2_MCONF] & 0x70) | 0x8f;
+			break;
+		default:
+			c->portMode = 0;
+			break;
+	}
+}
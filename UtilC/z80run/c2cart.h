@@ -0,0 +1,139 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "msx.h"
+
+
+#define C2_FLASH_SIZE		0x800000	// MX29LV640ET, 8MB
+#define C2_RAM_SIZE			0x100000	// 1MB: cartridge RAM banks, RAM mapper, shadow ROMs
+#define C2_EEPROM_SIZE		128			// 93C46 in 8 bit mode
+#define C2_FLASH_SECTORS	135			// 127 sectors of 64KB and 8 boot sectors of 8KB at the top
+#define C2_REGS				0x40		// CardMDR+#00..#3F
+#define C2_SECSIZE			512
+
+// Register offsets from CardMDR, see Util/lib/defs.inc
+enum {
+	C2_CARDMDR = 0x00,
+	C2_ADDRM0, C2_ADDRM1, C2_ADDRM2, C2_DATM0, C2_ADDRFR,
+	C2_R1MASK, C2_R1ADDR, C2_R1REG, C2_R1MULT, C2_B1MASKR, C2_B1ADRD,
+	C2_R2MASK = 0x0c,
+	C2_R3MASK = 0x12,
+	C2_R4MASK = 0x18,
+	C2_MCONF = 0x1e,
+	C2_CARDMDR2, C2_CONFFL, C2_NSREG, C2_LVL, C2_EECS, C2_LVL1,
+	C2_SLM_CFG = 0x28,
+	C2_SCART_CFG, C2_SCART_SLT, C2_SCART_STBL,
+	C2_VERSION = 0x2c,			// "250", three bytes
+	C2_PFXN = 0x35
+};
+
+// Typical times of the datasheets, in microseconds
+typedef struct {
+	uint32_t program;			// Byte program (MX29LV640E: 9us)
+	uint32_t sectorErase;		// Sector erase (0.7s)
+	uint32_t chipErase;			// Chip erase (40s)
+	uint32_t eraseWindow;		// Time-out to add sectors to a sector erase (50us)
+	uint32_t eepromWrite;		// 93C46 write/erase cycle (2ms)
+} C2Timing;
+
+typedef struct {
+	uint64_t programs;			// Bytes programmed
+	uint64_t bypassPrograms;	// ... of them in unlock bypass mode
+	uint64_t sectorErases;		// Sectors erased
+	uint64_t chipErases;
+	uint64_t busyReads;			// Flash reads answered with the status
+	uint64_t busyCycles;		// T-states the flash was busy
+	uint64_t commandErrors;		// Programs of 0 to 1 bits, commands while busy
+	uint64_t eepromWrites;
+	uint64_t ideCommands;
+	uint64_t ideSectorsRead;
+	uint64_t ideSectorsWritten;
+} C2Stats;
+
+// Flash command state machine
+typedef enum {
+	C2F_READ, C2F_UNLOCK1, C2F_UNLOCK2, C2F_AUTOSELECT, C2F_PROGRAM,
+	C2F_ERASE, C2F_ERASE_UNLOCK1, C2F_ERASE_UNLOCK2,
+	C2F_BYPASS, C2F_BYPASS_PROGRAM, C2F_BYPASS_ERASE, C2F_BYPASS_RESET,
+	C2F_BUSY_PROGRAM, C2F_ERASE_WINDOW, C2F_BUSY_ERASE, C2F_FAILED
+} C2FlashState;
+
+typedef struct {
+	C2FlashState state;
+	bool      bypass;			// Unlock bypass mode, kept while busy
+	uint64_t  busyEnd;			// T-state the operation ends
+	uint64_t  busyStart;
+	uint32_t  addr;				// Byte being programmed
+	uint8_t   data;
+	uint8_t   toggle;			// DQ6 and DQ2, toggle on every status read
+	bool      chip;				// Chip erase
+	bool      fail;				// Program of 0 to 1 bits: ends with DQ5 set
+	uint8_t   sectors[(C2_FLASH_SECTORS + 7) / 8];
+} C2Flash;
+
+typedef struct {
+	uint8_t   pins;				// Last CS/CK/DI written (bits 3..1)
+	uint8_t   out;				// DO while shifting out data
+	bool      writeEnable;
+	bool      started;			// Start bit received
+	bool      status;			// DO shows ready/busy after a write cycle
+	uint32_t  shift;			// Bits received after the start bit
+	int       bits;
+	int       readBit;			// Bit of the data on DO, -1 if not reading
+	uint8_t   addr;
+	uint8_t   pending;			// Cycle started by the falling CS, C2E_xxx
+	uint8_t   data;
+	uint64_t  busyEnd;
+} C2Eeprom;
+
+typedef struct {
+	int       fd;				// CF image, -1 if none
+	uint32_t  sectors;
+	uint8_t   reg[8];			// Task file, as last written
+	uint8_t   error;
+	uint8_t   status;
+	uint8_t   control;
+	uint8_t   multiple;			// Sectors per block of READ/WRITE MULTIPLE, 0 = not set
+	uint8_t   command;			// Data transfer in progress, 0 = none
+	uint32_t  lba;
+	uint32_t  count;			// Sectors left
+	uint16_t  pos;
+	uint8_t   latchIn, latchOut;	// High byte of the data register
+	uint8_t   buf[C2_SECSIZE];
+} C2Ide;
+
+typedef struct C2Cart {
+	Msx      *msx;
+	uint8_t   slot;				// Primary slot, always expanded
+	uint8_t  *flash;
+	uint8_t  *ram;
+	uint8_t   eeprom[C2_EEPROM_SIZE];
+
+	uint8_t   reg[C2_REGS];		// Registers as written (delayed reconfiguration set)
+	uint8_t   act[C2_REGS];		// Registers in use
+	uint8_t   portMode;			// Port #F0: 0=none 1=version 2=slot
+	uint8_t   ideConf;			// Sunrise IDE control register at 4104h
+	uint8_t   fmBank;			// FMPAC ROM bank (7FF7h)
+	bool      flashDirty;
+
+	C2Flash   fl;
+	C2Eeprom  ee;
+	C2Ide     ide;
+	C2Timing  timing;
+	C2Stats   stats;
+
+	MsxDevice dev[4];			// Subslots: cartridge, IDE, RAM mapper, FMPAC
+} C2Cart;
+
+
+bool    c2cart_init(C2Cart *c, Msx *msx, uint8_t slot);
+void    c2cart_free(C2Cart *c);
+void    c2cart_reset(C2Cart *c);
+bool    c2cart_loadFlash(C2Cart *c, const char *filename);
+bool    c2cart_saveFlash(C2Cart *c, const char *filename);
+bool    c2cart_openDisk(C2Cart *c, const char *filename);
+uint8_t c2cart_flashRead(C2Cart *c, uint32_t addr);
+void    c2cart_flashWrite(C2Cart *c, uint32_t addr, uint8_t value);
+void    c2cart_printStats(const C2Cart *c, FILE *f);
@@ -0,0 +1,298 @@
+/*
+ * FAT volume for the sector level calls (_RDABS, _RDDRV, _GETCLUS...).
+ *
+ * The volume is either a disk image (a raw FAT partition, or a device image
+ * whose MBR points to one) or a FAT12 volume synthesized from the files in
+ * the root of the host directory, laid out in consecutive clusters.
+ * The device is modelled as a MBR in sector 0 followed by the volume.
+ */
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "disk.h"
+#include "hostfs.h"
+
+
+#define FAT12_MAXCLUS	4084
+#define SYNTH_MINSECS	1440		// 720KB
+#define SYNTH_ROOTNUM	112
+
+static const char bootMessage[] = "Boot error\r\nPress any key for retry\r\n$";
+
+//###################################################################
+// Variables & Func.Definitions
+
+static bool readBPB(Disk *disk);
+static uint16_t rd16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+static uint32_t rd32(const uint8_t *p) { return rd16(p) | ((uint32_t)rd16(p + 2) << 16); }
+static void wr16(uint8_t *p, uint16_t v) { p[0] = v; p[1] = v >> 8; }
+static void wr32(uint8_t *p, uint32_t v) { wr16(p, v); wr16(p + 2, v >> 16); }
+
+
+//###################################################################
+// Public Functions
+
+/**
+ * disk_open
+ * Opens a disk image. If sector 0 is a MBR the first FAT partition is used.
+ *
+ * @return false if the image can't be read or has no FAT volume.
+ */
+bool disk_open(Disk *disk, const char *image)
+{
+	struct stat st;
+	uint8_t mbr[DISK_SECSIZE];
+
+	memset(disk, 0, sizeof(Disk));
+	disk->fd = open(image, O_RDWR);
+	if (disk->fd < 0) disk->fd = open(image, O_RDONLY);
+	if (disk->fd < 0 || fstat(disk->fd, &st) || st.st_size < DISK_SECSIZE) goto fail;
+	if (pread(disk->fd, mbr, DISK_SECSIZE, 0) != DISK_SECSIZE) goto fail;
+
+	// A boot sector starts with a jump, a MBR does not
+	if (mbr[0] != 0xe9 && mbr[0] != 0xeb && mbr[510] == 0x55 && mbr[511] == 0xaa) {
+		for (int i = 0; i < 4; i++) {
+			uint8_t *pe = &mbr[446 + i * 16];
+			if (pe[4] == 0x01 || pe[4] == 0x04 || pe[4] == 0x06 || pe[4] == 0x0e) {
+				disk->partStart = rd32(pe + 8);
+				disk->sectors = rd32(pe + 12);
+				break;
+			}
+		}
+		if (!disk->partStart) goto fail;
+		disk->imageOffset = disk->partStart * DISK_SECSIZE;
+	} else {
+		// Bare volume, shown to the program behind a virtual MBR
+		disk->partStart = 1;
+		disk->sectors = st.st_size / DISK_SECSIZE;
+		disk->imageOffset = 0;
+	}
+	if ((uint64_t)disk->imageOffset + (uint64_t)disk->sectors * DISK_SECSIZE > (uint64_t)st.st_size) {
+		disk->sectors = (st.st_size - disk->imageOffset) / DISK_SECSIZE;
+	}
+	disk->data = malloc((size_t)disk->sectors * DISK_SECSIZE);
+	if (!disk->data) goto fail;
+	if (pread(disk->fd, disk->data, (size_t)disk->sectors * DISK_SECSIZE, disk->imageOffset) !=
+		(ssize_t)disk->sectors * DISK_SECSIZE) goto fail;
+	if (!readBPB(disk)) goto fail;
+	return true;
+
+fail:
+	disk_close(disk);
+	return false;
+}
+
+/**
+ * disk_synthesize
+ * Builds a FAT12 volume holding the files in the root of a host directory.
+ * Sub-directories are not included. The volume is 720KB or bigger if the
+ * files need it.
+ *
+ * @param nextor Write the boot sector as Nextor FORMAT does.
+ * @return false if the directory can't be read or the files don't fit.
+ */
+bool disk_synthesize(Disk *disk, const char *hostDir, bool nextor)
+{
+	HostEntry *list;
+	int count = hostfs_list(hostDir, &list);
+	uint32_t clusters, rootSecs, total;
+	uint8_t *boot, *dir;
+	uint16_t clus;
+
+	memset(disk, 0, sizeof(Disk));
+	disk->fd = -1;
+	disk->partStart = 1;
+	if (count < 0) return false;
+
+	disk->secClus = 2;
+	disk->resvSec = 1;
+	disk->numFats = 2;
+	disk->media = 0xf9;
+	disk->rootNum = SYNTH_ROOTNUM;
+	while (disk->rootNum < count) disk->rootNum += 16;
+	rootSecs = disk->rootNum * 32 / DISK_SECSIZE;
+
+	for (;;) {
+		uint32_t bytesClus = disk->secClus * DISK_SECSIZE;
+		clusters = 0;
+		for (int i = 0; i < count; i++) {
+			if (!(list[i].attr & HOSTFS_ATTR_DIRECTORY)) clusters += (list[i].size + bytesClus - 1) / bytesClus;
+		}
+		if (clusters <= FAT12_MAXCLUS || disk->secClus == 64) break;
+		disk->secClus *= 2;
+	}
+	if (clusters > FAT12_MAXCLUS) {
+		free(list);
+		return false;
+	}
+	disk->secFat = ((FAT12_MAXCLUS + 2) * 3 / 2 + DISK_SECSIZE - 1) / DISK_SECSIZE;
+	total = disk->resvSec + disk->numFats * disk->secFat + rootSecs + clusters * disk->secClus;
+	if (total < SYNTH_MINSECS) total = SYNTH_MINSECS;
+	// Shrink the FAT to the clusters that really exist
+	disk->maxClus = (total - disk->resvSec - disk->numFats * disk->secFat - rootSecs) / disk->secClus + 1;
+	if (disk->maxClus > FAT12_MAXCLUS + 1) disk->maxClus = FAT12_MAXCLUS + 1;
+	disk->secFat = ((disk->maxClus + 1) * 3 / 2 + DISK_SECSIZE) / DISK_SECSIZE;
+	disk->rootSec = disk->resvSec + disk->numFats * disk->secFat;
+	disk->dataSec = disk->rootSec + rootSecs;
+	disk->maxClus = (total - disk->dataSec) / disk->secClus + 1;
+	disk->sectors = total;
+	disk->data = calloc(total, DISK_SECSIZE);
+	if (!disk->data) {
+		free(list);
+		return false;
+	}
+
+	// Boot sector
+	boot = disk->data;
+	boot[0] = 0xeb; boot[1] = 0xfe; boot[2] = 0x90;
+	memcpy(&boot[3], nextor ? "NEXTOR20" : "MSX_02.0", 8);
+	wr16(&boot[11], DISK_SECSIZE);
+	boot[13] = disk->secClus;
+	wr16(&boot[14], disk->resvSec);
+	boot[16] = disk->numFats;
+	wr16(&boot[17], disk->rootNum);
+	wr16(&boot[19], total);
+	boot[21] = disk->media;
+	wr16(&boot[22], disk->secFat);
+	wr16(&boot[24], 9);
+	wr16(&boot[26], 2);
+	memcpy(&boot[133], bootMessage, sizeof(bootMessage) - 1);
+	boot[510] = 0x55;
+	boot[511] = 0xaa;
+
+	// FAT, root directory and data
+	disk_setFat(disk, 0, 0xf00 | disk->media);
+	disk_setFat(disk, 1, 0xfff);
+	dir = disk->data + disk->rootSec * DISK_SECSIZE;
+	clus = 2;
+	for (int i = 0; i < count; i++) {
+		HostEntry *e = &list[i];
+		uint32_t nclus = (e->size + disk->secClus * DISK_SECSIZE - 1) / (disk->secClus * DISK_SECSIZE);
+		char path[4096];
+		FILE *f;
+
+		if (e->attr & HOSTFS_ATTR_DIRECTORY) continue;
+		memcpy(dir, e->fcb, 11);
+		dir[11] = e->attr;
+		wr16(&dir[22], hostfs_dosTime(e->mtime));
+		wr16(&dir[24], hostfs_dosDate(e->mtime));
+		wr16(&dir[26], nclus ? clus : 0);
+		wr32(&dir[28], e->size);
+		dir += 32;
+
+		snprintf(path, sizeof(path), "%s/%s", hostDir, e->host);
+		f = fopen(path, "rb");
+		if (f) {
+			if (fread(disk->data + (disk->dataSec + (clus - 2) * disk->secClus) * DISK_SECSIZE, 1, e->size, f) != e->size) {
+				fprintf(stderr, "z80run: can't read %s\n", path);
+			}
+			fclose(f);
+		}
+		for (uint32_t c = 0; c < nclus; c++, clus++) {
+			disk_setFat(disk, clus, c + 1 < nclus ? clus + 1 : 0xfff);
+		}
+	}
+	memcpy(disk->data + (disk->resvSec + disk->secFat) * DISK_SECSIZE,
+		   disk->data + disk->resvSec * DISK_SECSIZE, disk->secFat * DISK_SECSIZE);
+	free(list);
+	return true;
+}
+
+void disk_close(Disk *disk)
+{
+	if (disk->fd >= 0) close(disk->fd);
+	free(disk->data);
+	disk->data = NULL;
+	disk->fd = -1;
+	disk->sectors = 0;
+}
+
+/**
+ * disk_read
+ * Reads sectors of the volume.
+ *
+ * @return false if out of the volume.
+ */
+bool disk_read(Disk *disk, uint32_t sector, void *buf, uint32_t count)
+{
+	if (!disk->data || sector + count > disk->sectors || sector + count < sector) return false;
+	memcpy(buf, disk->data + (size_t)sector * DISK_SECSIZE, (size_t)count * DISK_SECSIZE);
+	return true;
+}
+
+/**
+ * disk_write
+ * Writes sectors of the volume. Image files are updated at once, the
+ * synthesized volume only lives in memory.
+ *
+ * @return false if out of the volume or the image can't be written.
+ */
+bool disk_write(Disk *disk, uint32_t sector, const void *buf, uint32_t count)
+{
+	size_t size = (size_t)count * DISK_SECSIZE;
+
+	if (!disk->data || sector + count > disk->sectors || sector + count < sector) return false;
+	memcpy(disk->data + (size_t)sector * DISK_SECSIZE, buf, size);
+	if (disk->fd >= 0) {
+		if (pwrite(disk->fd, buf, size, disk->imageOffset + (off_t)sector * DISK_SECSIZE) != (ssize_t)size) return false;
+	}
+	return true;
+}
+
+/**
+ * disk_getFat
+ * @return Value of the FAT entry of a cluster (first FAT copy).
+ */
+uint16_t disk_getFat(const Disk *disk, uint32_t cluster)
+{
+	const uint8_t *fat = disk->data + disk->resvSec * DISK_SECSIZE;
+
+	if (disk->fat16) return rd16(fat + cluster * 2);
+	if (cluster & 1) return rd16(fat + cluster * 3 / 2) >> 4;
+	return rd16(fat + cluster * 3 / 2) & 0xfff;
+}
+
+void disk_setFat(Disk *disk, uint32_t cluster, uint16_t value)
+{
+	uint8_t *fat = disk->data + disk->resvSec * DISK_SECSIZE;
+	uint8_t *p;
+
+	if (disk->fat16) {
+		wr16(fat + cluster * 2, value);
+		return;
+	}
+	p = fat + cluster * 3 / 2;
+	if (cluster & 1) wr16(p, (rd16(p) & 0x000f) | (value << 4));
+	else wr16(p, (rd16(p) & 0xf000) | (value & 0xfff));
+}
+
+
+//###################################################################
+// Private Functions
+
+static bool readBPB(Disk *disk)
+{
+	const uint8_t *b = disk->data;
+	uint32_t total, clusters;
+
+	if (rd16(b + 11) != DISK_SECSIZE || !b[13] || !b[16] || !rd16(b + 22)) return false;
+	disk->secClus = b[13];
+	disk->resvSec = rd16(b + 14);
+	disk->numFats = b[16];
+	disk->rootNum = rd16(b + 17);
+	total = rd16(b + 19);
+	if (!total) total = rd32(b + 32);
+	disk->media = b[21];
+	disk->secFat = rd16(b + 22);
+	disk->rootSec = disk->resvSec + disk->numFats * disk->secFat;
+	disk->dataSec = disk->rootSec + (disk->rootNum * 32 + DISK_SECSIZE - 1) / DISK_SECSIZE;
+	if (total > disk->sectors || total <= disk->dataSec) return false;
+	clusters = (total - disk->dataSec) / disk->secClus;
+	disk->maxClus = clusters + 1;
+	disk->fat16 = clusters > FAT12_MAXCLUS;
+	disk->sectors = total;
+	return true;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+#define DISK_SECSIZE	512
+
+// A FAT12/FAT16 volume, either a disk image or synthesized from a host directory
+typedef struct {
+	uint8_t  *data;
+	uint32_t  sectors;
+	uint32_t  partStart;		// Device sector of the volume (sector 0 holds the MBR)
+	int       fd;				// Image file, -1 when synthesized
+	uint32_t  imageOffset;		// Byte offset of the volume inside the image file
+
+	uint8_t   secClus;
+	uint16_t  resvSec;
+	uint8_t   numFats;
+	uint16_t  rootNum;
+	uint16_t  secFat;
+	uint8_t   media;
+	bool      fat16;
+	uint32_t  rootSec;
+	uint32_t  dataSec;
+	uint32_t  maxClus;
+} Disk;
+
+
+bool     disk_open(Disk *disk, const char *image);
+bool     disk_synthesize(Disk *disk, const char *hostDir, bool nextor);
+void     disk_close(Disk *disk);
+bool     disk_read(Disk *disk, uint32_t sector, void *buf, uint32_t count);
+bool     disk_write(Disk *disk, uint32_t sector, const void *buf, uint32_t count);
+uint16_t disk_getFat(const Disk *disk, uint32_t cluster);
+void     disk_setFat(Disk *disk, uint32_t cluster, uint16_t value);
@@ -0,0 +1,166 @@
+/*
+ * Host directory access with MSX-DOS 8.3 names.
+ *
+ * Host files whose names don't fit in 8.3 are not visible. Attributes:
+ * directories get ATTR_DIRECTORY, files without owner write permission
+ * ATTR_READONLY, and files with the owner execute bit ATTR_ARCHIVE (the
+ * same mapping Samba uses for the archive bit).
+ */
+#include <ctype.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "hostfs.h"
+
+
+static const char invalidChars[] = "\"*+,./:;<=>?[\\]|";
+
+static int compareEntries(const void *a, const void *b)
+{
+	return memcmp(((const HostEntry*)a)->fcb, ((const HostEntry*)b)->fcb, 11);
+}
+
+//###################################################################
+// Public Functions
+
+/**
+ * hostfs_list
+ * Lists the entries of a host directory, sorted by name.
+ *
+ * @param dir Host directory.
+ * @param entries Returns an array to release with free(...).
+ * @return Count of entries, or -1 if the directory can't be read.
+ */
+int hostfs_list(const char *dir, HostEntry **entries)
+{
+	DIR *d = opendir(dir);
+	struct dirent *de;
+	HostEntry *list = NULL;
+	int count = 0, cap = 0;
+
+	*entries = NULL;
+	if (!d) return -1;
+	while ((de = readdir(d))) {
+		HostEntry e;
+		struct stat st;
+		char path[4096];
+
+		if (de->d_name[0] == '.') continue;
+		if (strlen(de->d_name) >= sizeof(e.host)) continue;
+		if (!hostfs_toFcb(de->d_name, e.fcb, false)) continue;
+		snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+		if (stat(path, &st)) continue;
+		if (!S_ISREG(st.st_mode) && !S_ISDIR(st.st_mode)) continue;
+
+		strcpy(e.host, de->d_name);
+		e.attr = 0;
+		if (S_ISDIR(st.st_mode)) {
+			e.attr |= HOSTFS_ATTR_DIRECTORY;
+		} else {
+			if (!(st.st_mode & S_IWUSR)) e.attr |= HOSTFS_ATTR_READONLY;
+			if (st.st_mode & S_IXUSR) e.attr |= HOSTFS_ATTR_ARCHIVE;
+		}
+		e.size = S_ISDIR(st.st_mode) ? 0 : (uint32_t)st.st_size;
+		e.mtime = st.st_mtime;
+
+		if (count == cap) {
+			cap = cap ? cap * 2 : 32;
+			list = realloc(list, cap * sizeof(HostEntry));
+			if (!list) {
+				closedir(d);
+				return -1;
+			}
+		}
+		list[count++] = e;
+	}
+	closedir(d);
+	if (count) qsort(list, count, sizeof(HostEntry), compareEntries);
+	*entries = list;
+	return count;
+}
+
+/**
+ * hostfs_toFcb
+ * Converts a filename to FCB form: 8+3 upper case chars padded with spaces.
+ * Names longer than 8.3 are rejected.
+ *
+ * @param name Filename ("NAME.EXT").
+ * @param fcb Returns the 11 chars (not terminated).
+ * @param wildcards Allow '?' and '*' ('*' fills the rest of the field with '?').
+ * @return false if the name is not valid.
+ */
+bool hostfs_toFcb(const char *name, char *fcb, bool wildcards)
+{
+	int i = 0, max = 8;
+	unsigned char c;
+
+	memset(fcb, ' ', 11);
+	if (!*name || *name == '.') return false;
+	while ((c = *name++)) {
+		if (c == '.') {
+			if (max == 11) return false;
+			i = 8;
+			max = 11;
+			continue;
+		}
+		if (wildcards && c == '*') {
+			while (i < max) fcb[i++] = '?';
+			continue;
+		}
+		if (wildcards && c == '?') {
+			if (i >= max) return false;
+			fcb[i++] = '?';
+			continue;
+		}
+		if (c <= ' ' || strchr(invalidChars, c)) return false;
+		if (i >= max) return false;
+		fcb[i++] = toupper(c);
+	}
+	return true;
+}
+
+/**
+ * hostfs_fromFcb
+ * Converts a name in FCB form to "NAME.EXT".
+ *
+ * @param name Returns the ASCIIZ name (13 bytes max).
+ */
+void hostfs_fromFcb(const char *fcb, char *name)
+{
+	int i;
+
+	for (i = 0; i < 8 && fcb[i] != ' '; i++) *name++ = fcb[i];
+	if (fcb[8] != ' ') {
+		*name++ = '.';
+		for (i = 8; i < 11 && fcb[i] != ' '; i++) *name++ = fcb[i];
+	}
+	*name = '\0';
+}
+
+/**
+ * hostfs_match
+ * Compares two names in FCB form, '?' in the pattern matches any char.
+ */
+bool hostfs_match(const char *pattern, const char *fcb)
+{
+	for (int i = 0; i < 11; i++) {
+		if (pattern[i] != '?' && toupper((unsigned char)pattern[i]) != fcb[i]) return false;
+	}
+	return true;
+}
+
+uint16_t hostfs_dosTime(time_t t)
+{
+	struct tm *tm = localtime(&t);
+	return (tm->tm_hour << 11) | (tm->tm_min << 5) | (tm->tm_sec / 2);
+}
+
+uint16_t hostfs_dosDate(time_t t)
+{
+	struct tm *tm = localtime(&t);
+	int year = tm->tm_year + 1900 - 1980;
+	if (year < 0) year = 0;
+	return (year << 9) | ((tm->tm_mon + 1) << 5) | tm->tm_mday;
+}
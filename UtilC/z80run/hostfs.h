@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+
+#define HOSTFS_ATTR_READONLY	0x01
+#define HOSTFS_ATTR_HIDDEN		0x02
+#define HOSTFS_ATTR_SYSTEM		0x04
+#define HOSTFS_ATTR_VOLUME		0x08
+#define HOSTFS_ATTR_DIRECTORY	0x10
+#define HOSTFS_ATTR_ARCHIVE		0x20
+
+// A host directory entry with a valid 8.3 name
+typedef struct {
+	char     host[256];		// Host file name
+	char     fcb[11];		// Upper case name in FCB form (8+3, space padded)
+	uint8_t  attr;
+	uint32_t size;
+	time_t   mtime;
+} HostEntry;
+
+
+int      hostfs_list(const char *dir, HostEntry **entries);
+bool     hostfs_toFcb(const char *name, char *fcb, bool wildcards);
+void     hostfs_fromFcb(const char *fcb, char *name);
+bool     hostfs_match(const char *pattern, const char *fcb);
+uint16_t hostfs_dosTime(time_t t);
+uint16_t hostfs_dosDate(time_t t);
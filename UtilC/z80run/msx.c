@@ -0,0 +1,850 @@
+/*
+ * MSX machine for the host-side runner: slots, RAM mapper, VDP, interrupts
+ * and the BIOS/MSX-DOS entry points, which are served by host traps.
+ *
+ * Slot map: 0 = main BIOS (page 0 only, traps), 3 = RAM mapper.
+ * Slots 1 and 2 are free for cartridge models (see msx_insert).
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "msx.h"
+
+
+#define TRAP_BYTES(id)	Z80_TRAP_PREFIX, Z80_TRAP_OPCODE, (id)
+
+#define BIOS_FIRST_ENTRY	0x003b		// From here the BIOS entries are 3 bytes apart
+#define BIOS_LAST_ENTRY		0x0186
+
+// Mapper support routines, in jump table order
+enum {
+	MAP_ALL_SEG, MAP_FRE_SEG, MAP_RD_SEG, MAP_WR_SEG, MAP_CAL_SEG, MAP_CALLS,
+	MAP_PUT_PH, MAP_GET_PH, MAP_PUT_P0, MAP_GET_P0, MAP_PUT_P1, MAP_GET_P1,
+	MAP_PUT_P2, MAP_GET_P2, MAP_PUT_P3, MAP_GET_P3, MAP_COUNT
+};
+
+#define SEG_FREE	0
+#define SEG_USER	1
+#define SEG_SYSTEM	2
+
+//###################################################################
+// Variables & Func.Definitions
+
+static uint8_t busRead(void *ctx, uint16_t addr);
+static void    busWrite(void *ctx, uint16_t addr, uint8_t value);
+static uint8_t busIn(void *ctx, uint16_t port);
+static void    busOut(void *ctx, uint16_t port, uint8_t value);
+static bool    busTrap(void *ctx, Z80 *cpu, uint8_t id);
+
+static void    putTrap(Msx *msx, uint16_t addr, uint8_t id);
+static void    updateMapperVars(Msx *msx);
+static void    enableSlot(Msx *msx, uint8_t slotId, uint8_t page);
+static void    callFar(Msx *msx, uint16_t addr, int slotId, int segment);
+static void    biosCall(Msx *msx, uint16_t entry);
+static void    mapperCall(Msx *msx, uint8_t fn);
+static void    interrupt(Msx *msx);
+
+
+//###################################################################
+// Public Functions
+
+/**
+ * msx_init
+ * Creates the machine: BIOS traps, RAM mapper and VDP.
+ *
+ * @param dos MSX-DOS version to emulate.
+ * @param segments Size of the RAM mapper in 16KB segments (power of 2, 4..256).
+ * @return false if out of memory.
+ */
+bool msx_init(Msx *msx, DosKind dos, uint16_t segments)
+{
+	static const Z80Bus bus = { busRead, busWrite, busIn, busOut, busTrap };
+
+	memset(msx, 0, sizeof(Msx));
+	msx->dos = dos;
+	msx->segments = segments;
+	msx->ram = calloc(segments, 0x4000);
+	msx->vram = calloc(1, 0x20000);
+	if (!msx->ram || !msx->vram) return false;
+
+	// Main BIOS: entries are traps, everything else returns
+	memset(msx->bios, 0xc9, sizeof(msx->bios));
+	{
+		static const uint16_t low[] = { 0x000c, 0x0014, 0x001c, 0x0024, 0x0030, 0x0038 };
+		static const uint8_t lowId[] = { TRAP_RDSLT, TRAP_WRSLT, TRAP_CALSLT, TRAP_ENASLT, TRAP_CALLF, TRAP_KEYINT };
+		for (int i = 0; i < 6; i++) {
+			msx->bios[low[i]] = Z80_TRAP_PREFIX;
+			msx->bios[low[i] + 1] = Z80_TRAP_OPCODE;
+			msx->bios[low[i] + 2] = lowId[i];
+		}
+		for (uint16_t a = BIOS_FIRST_ENTRY; a <= BIOS_LAST_ENTRY; a += 3) {
+			msx->bios[a] = Z80_TRAP_PREFIX;
+			msx->bios[a + 1] = Z80_TRAP_OPCODE;
+			msx->bios[a + 2] = TRAP_BIOS + (a - BIOS_FIRST_ENTRY) / 3;
+		}
+		msx->bios[0x0006] = 0x98;		// VDP.DR
+		msx->bios[0x0007] = 0x98;		// VDP.DW
+		msx->bios[0x002b] = 0x11;		// IDBYT1: 60Hz, Japanese charset
+		msx->bios[0x002c] = 0x00;
+		msx->bios[0x002d] = 0x01;		// MSX2
+	}
+
+	z80_init(&msx->cpu, &bus, msx);
+	msx->cpu.m1Wait = 1;
+	return true;
+}
+
+void msx_free(Msx *msx)
+{
+	free(msx->ram);
+	free(msx->vram);
+	msx->ram = msx->vram = NULL;
+}
+
+/**
+ * msx_insert
+ * Plugs a device in a slot. Inserting in a secondary slot other than 0
+ * marks the primary slot as expanded.
+ */
+void msx_insert(Msx *msx, uint8_t slot, uint8_t sub, MsxDevice *dev)
+{
+	msx->dev[slot & 3][sub & 3] = dev;
+	if (sub) msx->expanded[slot & 3] = true;
+}
+
+/**
+ * msx_setPort
+ * Installs a handler for an I/O port, NULL to remove it.
+ */
+void msx_setPort(Msx *msx, uint8_t port, const MsxPort *handler)
+{
+	if (handler) msx->ports[port] = *handler;
+	else memset(&msx->ports[port], 0, sizeof(MsxPort));
+}
+
+/**
+ * msx_load
+ * Loads a .COM program file at 0100h, see msx_start(...).
+ *
+ * @param filename Host path of the program.
+ * @param args Command line, without the program name.
+ * @return false if the program can't be read or doesn't fit in the TPA.
+ */
+bool msx_load(Msx *msx, const char *filename, const char *args)
+{
+	FILE *f = fopen(filename, "rb");
+	uint8_t *tpa = malloc(MSX_DOS_TOP);
+	size_t size;
+	bool ok;
+
+	if (!f || !tpa) {
+		if (f) fclose(f);
+		free(tpa);
+		return false;
+	}
+	size = fread(tpa, 1, MSX_DOS_TOP - 0x100, f);
+	if (!feof(f) && fgetc(f) != EOF) size = 0;
+	fclose(f);
+	ok = size && msx_start(msx, tpa, size, args);
+	free(tpa);
+	return ok;
+}
+
+/**
+ * msx_start
+ * Sets up the MSX-DOS environment and places a program image at 0100h.
+ *
+ * @param args Command line, without the program name.
+ * @return false if the program doesn't fit in the TPA.
+ */
+bool msx_start(Msx *msx, const void *program, size_t size, const char *args)
+{
+	uint16_t a;
+
+	if (size > MSX_DOS_TOP - 0x100) return false;
+
+	// Slots and mapper as left by MSX-DOS: RAM everywhere
+	msx->slotReg = (MSX_RAM_SLOT << 6) | (MSX_RAM_SLOT << 4) | (MSX_RAM_SLOT << 2) | MSX_RAM_SLOT;
+	for (int p = 0; p < 4; p++) msx->mapper[p] = 3 - p;
+	memset(msx->segOwner, SEG_FREE, sizeof(msx->segOwner));
+	for (int s = 0; s < 4; s++) msx->segOwner[s] = SEG_USER;
+	if (msx->dos != DOS_MSXDOS1) {
+		for (int s = msx->segments - 3; s < msx->segments; s++) msx->segOwner[s] = SEG_SYSTEM;
+	}
+
+	// Page 0: MSX-DOS entry points
+	putTrap(msx, 0x0000, TRAP_WBOOT);
+	msx_write(msx, 0x0003, 0);
+	msx_write(msx, 0x0004, 0);
+	msx_write(msx, 0x0005, 0xc3);
+	msx_write(msx, 0x0006, MSX_DOS_TOP & 0xff);
+	msx_write(msx, 0x0007, MSX_DOS_TOP >> 8);
+	putTrap(msx, 0x000c, TRAP_RDSLT);
+	putTrap(msx, 0x0014, TRAP_WRSLT);
+	putTrap(msx, 0x001c, TRAP_CALSLT);
+	putTrap(msx, 0x0024, TRAP_ENASLT);
+	putTrap(msx, 0x0030, TRAP_CALLF);
+	putTrap(msx, 0x0038, TRAP_KEYINT);
+
+	// Page 3: kernel entry, mapper routines and system variables
+	putTrap(msx, MSX_DOS_TOP, TRAP_BDOS);
+	putTrap(msx, SV_BDOS, TRAP_BDOS);
+	putTrap(msx, MSX_TRAP_RET, TRAP_CALL_RET);
+	putTrap(msx, MSX_TRAP_RET + 3, TRAP_INT_RET);
+	for (int i = 0; i < MAP_COUNT; i++) {
+		putTrap(msx, MSX_MAPPER_JT + i * 3, TRAP_MAPPER + i);
+	}
+	updateMapperVars(msx);
+	for (a = SV_RAMAD0; a <= SV_RAMAD3; a++) msx_write(msx, a, MSX_RAM_SLOT);
+	for (a = 0xfd9a; a < SV_EXTBIO; a++) msx_write(msx, a, 0xc9);	// Hooks
+	for (a = SV_EXTBIO; a < 0xffd9; a++) msx_write(msx, a, 0xc9);
+	if (msx->dos != DOS_MSXDOS1) {
+		putTrap(msx, SV_EXTBIO, TRAP_EXTBIO);
+		msx_write(msx, SV_HOKVLD, 0x01);
+	}
+	for (int s = 0; s < 4; s++) {
+		msx_write(msx, SV_EXPTBL + s, msx->expanded[s] ? 0x80 : 0);
+		msx_write(msx, SV_SLTTBL + s, 0);
+	}
+	msx_write(msx, SV_LINL40, 80);
+	msx_write(msx, SV_LINLEN, 80);
+	msx_write(msx, SV_CRTCNT, 24);
+	msx_write(msx, SV_CSRX, 1);
+	msx_write(msx, SV_CSRY, 1);
+	msx_write(msx, SV_FORCLR, 15);
+	msx_write(msx, SV_BAKCLR, 4);
+	msx_write(msx, SV_BDRCLR, 4);
+	msx_write(msx, SV_PUTPNT, SV_KEYBUF & 0xff);
+	msx_write(msx, SV_PUTPNT + 1, SV_KEYBUF >> 8);
+	msx_write(msx, SV_GETPNT, SV_KEYBUF & 0xff);
+	msx_write(msx, SV_GETPNT + 1, SV_KEYBUF >> 8);
+	msx->vdpReg[1] = 0x60;			// Screen on, VBLANK interrupt enabled
+	msx->vdpReg[9] = 0x02;			// 60Hz
+
+	// The program and its command line
+	msx_writeBlock(msx, 0x100, program, size);
+	for (a = 0x5c; a < 0x80; a++) msx_write(msx, a, 0);
+	for (a = 0x5d; a < 0x68; a++) msx_write(msx, a, ' ');
+	for (a = 0x6d; a < 0x78; a++) msx_write(msx, a, ' ');
+	{
+		char tail[128];
+		int n = args && *args ? snprintf(tail, sizeof(tail), " %s", args) : 0;
+		if (n > 126) n = 126;
+		msx_write(msx, 0x80, n);
+		msx_writeBlock(msx, 0x81, tail, n);
+		msx_write(msx, 0x81 + n, 0);
+	}
+
+	z80_reset(&msx->cpu);
+	msx->cpu.sp = MSX_DOS_TOP;
+	z80_push(&msx->cpu, 0x0000);
+	msx->cpu.pc = 0x0100;
+	msx->cpu.im = 1;
+	msx->cpu.iff1 = msx->cpu.iff2 = 1;
+	msx->nextFrame = msx->cpu.cycles + MSX_FRAME_CYCLES;
+	msx->finished = false;
+	msx->exitCode = 0;
+	msx->error = NULL;
+	return true;
+}
+
+/**
+ * msx_run
+ * Runs the loaded program until it ends, fails or reaches the T-state limit.
+ */
+void msx_run(Msx *msx, uint64_t maxCycles)
+{
+	Z80 *cpu = &msx->cpu;
+	uint64_t end = cpu->cycles + maxCycles;
+
+	while (!msx->finished) {
+		if (cpu->cycles >= end) {
+			msx->error = "T-state limit reached";
+			break;
+		}
+		if (cpu->halted && !cpu->iff1) {
+			msx->error = "HALT with interrupts disabled";
+			break;
+		}
+		z80_step(cpu);
+		if (cpu->cycles >= msx->nextFrame) {
+			msx->nextFrame += MSX_FRAME_CYCLES;
+			msx->vdpStatus |= 0x80;
+			if (msx->vdpReg[1] & 0x20) cpu->irq = true;
+		}
+	}
+}
+
+//-------------------------------------------------------------------
+// Memory
+
+static inline uint8_t readSlot(Msx *msx, uint8_t ps, uint8_t ss, uint16_t addr)
+{
+	MsxDevice *dev = msx->dev[ps][ss];
+
+	if (dev) return dev->read(dev->ctx, addr);
+	if (ps == MSX_RAM_SLOT && ss == 0) {
+		uint8_t seg = msx->mapper[addr >> 14] & (msx->segments - 1);
+		return msx->ram[(seg << 14) | (addr & 0x3fff)];
+	}
+	if (ps == MSX_BIOS_SLOT && ss == 0 && addr < 0x8000) return msx->bios[addr];
+	return 0xff;
+}
+
+static inline void writeSlot(Msx *msx, uint8_t ps, uint8_t ss, uint16_t addr, uint8_t value)
+{
+	MsxDevice *dev = msx->dev[ps][ss];
+
+	if (dev) {
+		if (dev->write) dev->write(dev->ctx, addr, value);
+		return;
+	}
+	if (ps == MSX_RAM_SLOT && ss == 0) {
+		uint8_t seg = msx->mapper[addr >> 14] & (msx->segments - 1);
+		msx->ram[(seg << 14) | (addr & 0x3fff)] = value;
+	}
+}
+
+uint8_t msx_read(Msx *msx, uint16_t addr)
+{
+	uint8_t page = addr >> 14;
+	uint8_t ps = (msx->slotReg >> (page * 2)) & 3;
+	uint8_t ss = 0;
+
+	if (msx->expanded[ps]) {
+		if (addr == 0xffff) return ~msx->subReg[ps];
+		ss = (msx->subReg[ps] >> (page * 2)) & 3;
+	}
+	return readSlot(msx, ps, ss, addr);
+}
+
+void msx_write(Msx *msx, uint16_t addr, uint8_t value)
+{
+	uint8_t page = addr >> 14;
+	uint8_t ps = (msx->slotReg >> (page * 2)) & 3;
+	uint8_t ss = 0;
+
+	if (msx->expanded[ps]) {
+		if (addr == 0xffff) {
+			msx->subReg[ps] = value;
+			return;
+		}
+		ss = (msx->subReg[ps] >> (page * 2)) & 3;
+	}
+	writeSlot(msx, ps, ss, addr, value);
+}
+
+/**
+ * msx_readSlot
+ * Reads a byte from a slot without switching it in, like RDSLT.
+ *
+ * @param slotId Slot in the form ExxxSSPP.
+ */
+uint8_t msx_readSlot(Msx *msx, uint8_t slotId, uint16_t addr)
+{
+	uint8_t ps = slotId & 3;
+	uint8_t ss = (slotId & 0x80) ? (slotId >> 2) & 3 : 0;
+
+	if ((slotId & 0x80) && addr == 0xffff) return ~msx->subReg[ps];
+	return readSlot(msx, ps, ss, addr);
+}
+
+void msx_writeSlot(Msx *msx, uint8_t slotId, uint16_t addr, uint8_t value)
+{
+	uint8_t ps = slotId & 3;
+	uint8_t ss = (slotId & 0x80) ? (slotId >> 2) & 3 : 0;
+
+	if ((slotId & 0x80) && addr == 0xffff) {
+		msx->subReg[ps] = value;
+		return;
+	}
+	writeSlot(msx, ps, ss, addr, value);
+}
+
+void msx_readBlock(Msx *msx, uint16_t addr, void *dst, uint16_t size)
+{
+	uint8_t *p = dst;
+	while (size--) *p++ = msx_read(msx, addr++);
+}
+
+void msx_writeBlock(Msx *msx, uint16_t addr, const void *src, uint16_t size)
+{
+	const uint8_t *p = src;
+	while (size--) msx_write(msx, addr++, *p++);
+}
+
+//-------------------------------------------------------------------
+// Console
+
+void msx_putc(Msx *msx, uint8_t ch)
+{
+	if (msx->console) msx->console(msx->consoleCtx, ch);
+}
+
+/**
+ * msx_getKey
+ * Takes a key from the MSX keyboard buffer, or from the host standard
+ * input when the buffer is empty.
+ *
+ * @param wait Read from the host if the buffer is empty.
+ * @return The key, or -1 if there is none and wait is false.
+ *         A CR is returned when the host input is exhausted.
+ */
+int msx_getKey(Msx *msx, bool wait)
+{
+	uint16_t get = msx_read(msx, SV_GETPNT) | (msx_read(msx, SV_GETPNT + 1) << 8);
+	uint16_t put = msx_read(msx, SV_PUTPNT) | (msx_read(msx, SV_PUTPNT + 1) << 8);
+	int ch;
+
+	if (get != put) {
+		ch = msx_read(msx, get++);
+		if (get >= SV_KEYBUF_END) get = SV_KEYBUF;
+		msx_write(msx, SV_GETPNT, get & 0xff);
+		msx_write(msx, SV_GETPNT + 1, get >> 8);
+		return ch;
+	}
+	if (!wait) return -1;
+	ch = getchar();
+	if (ch == EOF) return '\r';
+	return ch == '\n' ? '\r' : ch;
+}
+
+
+//###################################################################
+// Private Functions
+
+static void putTrap(Msx *msx, uint16_t addr, uint8_t id)
+{
+	msx_write(msx, addr, Z80_TRAP_PREFIX);
+	msx_write(msx, addr + 1, Z80_TRAP_OPCODE);
+	msx_write(msx, addr + 2, id);
+}
+
+static void updateMapperVars(Msx *msx)
+{
+	uint8_t freeSegs = 0, sys = 0, user = 0;
+
+	for (int s = 0; s < msx->segments; s++) {
+		if (msx->segOwner[s] == SEG_FREE) freeSegs++;
+		else if (msx->segOwner[s] == SEG_SYSTEM) sys++;
+		else user++;
+	}
+	msx_write(msx, MSX_MAPPER_VARS + 0, MSX_RAM_SLOT);
+	msx_write(msx, MSX_MAPPER_VARS + 1, msx->segments & 0xff);
+	msx_write(msx, MSX_MAPPER_VARS + 2, freeSegs);
+	msx_write(msx, MSX_MAPPER_VARS + 3, sys);
+	msx_write(msx, MSX_MAPPER_VARS + 4, user);
+	for (int i = 5; i < 9; i++) msx_write(msx, MSX_MAPPER_VARS + i, 0);
+}
+
+static uint8_t freeSegments(Msx *msx)
+{
+	return msx_read(msx, MSX_MAPPER_VARS + 2);
+}
+
+//-------------------------------------------------------------------
+// Bus
+
+static uint8_t busRead(void *ctx, uint16_t addr)
+{
+	return msx_read(ctx, addr);
+}
+
+static void busWrite(void *ctx, uint16_t addr, uint8_t value)
+{
+	msx_write(ctx, addr, value);
+}
+
+static uint8_t busIn(void *ctx, uint16_t port)
+{
+	Msx *msx = ctx;
+	uint8_t p = port & 0xff;
+	uint8_t v;
+
+	if (msx->ports[p].in) return msx->ports[p].in(msx->ports[p].ctx, p);
+	switch (p) {
+		case 0x98:
+			msx->vdpLatchFull = false;
+			v = msx->vram[msx->vdpAddr];
+			msx->vdpAddr = (msx->vdpAddr + 1) & 0x1ffff;
+			return v;
+		case 0x99:
+			msx->vdpLatchFull = false;
+			if (msx->vdpReg[15] & 0x0f) return (msx->vdpReg[15] & 0x0f) == 2 ? 0x0c : 0;
+			v = msx->vdpStatus;
+			msx->vdpStatus &= 0x7f;
+			msx->cpu.irq = false;
+			return v;
+		case 0xa8:
+			return msx->slotReg;
+		case 0xfc: case 0xfd: case 0xfe: case 0xff:
+			return msx->mapper[p - 0xfc] | ~(msx->segments - 1);
+	}
+	return 0xff;
+}
+
+static void busOut(void *ctx, uint16_t port, uint8_t value)
+{
+	Msx *msx = ctx;
+	uint8_t p = port & 0xff;
+
+	if (msx->ports[p].out) {
+		msx->ports[p].out(msx->ports[p].ctx, p, value);
+		return;
+	}
+	switch (p) {
+		case 0x98:
+			msx->vdpLatchFull = false;
+			msx->vram[msx->vdpAddr] = value;
+			msx->vdpAddr = (msx->vdpAddr + 1) & 0x1ffff;
+			break;
+		case 0x99:
+			if (!msx->vdpLatchFull) {
+				msx->vdpLatch = value;
+				msx->vdpLatchFull = true;
+				break;
+			}
+			msx->vdpLatchFull = false;
+			if (value & 0x80) {
+				msx->vdpReg[value & 0x3f] = msx->vdpLatch;
+			} else {
+				msx->vdpAddr = ((msx->vdpReg[14] & 7) << 14) | ((value & 0x3f) << 8) | msx->vdpLatch;
+			}
+			break;
+		case 0xa8:
+			msx->slotReg = value;
+			break;
+		case 0xfc: case 0xfd: case 0xfe: case 0xff:
+			msx->mapper[p - 0xfc] = value;
+			break;
+	}
+}
+
+static bool busTrap(void *ctx, Z80 *cpu, uint8_t id)
+{
+	Msx *msx = ctx;
+
+	switch (id) {
+		case TRAP_WBOOT:
+			msx->finished = true;
+			return true;
+		case TRAP_BDOS:
+			msx->dosCalls++;
+			cpu->cycles += msx->trapCost;
+			dos_call(msx);
+			if (!msx->finished) z80_ret(cpu);
+			return msx->finished;
+		case TRAP_RDSLT:
+			cpu->af.b.h = msx_readSlot(msx, cpu->af.b.h, cpu->hl.w);
+			z80_ret(cpu);
+			break;
+		case TRAP_WRSLT:
+			msx_writeSlot(msx, cpu->af.b.h, cpu->hl.w, cpu->de.b.l);
+			z80_ret(cpu);
+			break;
+		case TRAP_CALSLT:
+			callFar(msx, cpu->ix.w, cpu->iy.b.h, -1);
+			break;
+		case TRAP_ENASLT:
+			enableSlot(msx, cpu->af.b.h, cpu->hl.b.h >> 6);
+			z80_ret(cpu);
+			break;
+		case TRAP_CALLF: {
+			uint16_t ret = z80_pop(cpu);
+			uint8_t slot = msx_read(msx, ret);
+			uint16_t addr = msx_read(msx, ret + 1) | (msx_read(msx, ret + 2) << 8);
+			z80_push(cpu, ret + 3);
+			callFar(msx, addr, slot, -1);
+			break;
+		}
+		case TRAP_KEYINT:
+			interrupt(msx);
+			break;
+		case TRAP_INT_RET:
+			msx->intSaved.pc = cpu->pc;
+			msx->intSaved.cycles = cpu->cycles;
+			msx->intSaved.bus = cpu->bus;
+			msx->intSaved.ctx = cpu->ctx;
+			msx->intSaved.m1Wait = cpu->m1Wait;
+			msx->intSaved.irq = cpu->irq;
+			*cpu = msx->intSaved;
+			cpu->iff1 = cpu->iff2 = 1;
+			z80_ret(cpu);
+			break;
+		case TRAP_EXTBIO:
+			if (cpu->de.w == 0x0402) {
+				cpu->af.b.h = msx->segments & 0xff;
+				cpu->bc.b.h = MSX_RAM_SLOT;
+				cpu->bc.b.l = freeSegments(msx);
+				cpu->hl.w = MSX_MAPPER_JT;
+			} else if (cpu->de.w == 0x0401) {
+				cpu->af.b.h = MSX_RAM_SLOT;
+				cpu->hl.w = MSX_MAPPER_VARS;
+			}
+			z80_ret(cpu);
+			break;
+		case TRAP_CALL_RET: {
+			MsxCallFrame *fr;
+			if (msx->callDepth == 0) {
+				msx->error = "Unbalanced inter-slot return";
+				msx->finished = true;
+				return true;
+			}
+			fr = &msx->calls[--msx->callDepth];
+			msx->slotReg = fr->slotReg;
+			memcpy(msx->subReg, fr->subReg, sizeof(msx->subReg));
+			if (fr->restoreMapper) memcpy(msx->mapper, fr->mapper, sizeof(msx->mapper));
+			z80_ret(cpu);
+			break;
+		}
+		default:
+			if (id >= TRAP_MAPPER && id < TRAP_MAPPER + MAP_COUNT) {
+				mapperCall(msx, id - TRAP_MAPPER);
+			} else if (id >= TRAP_BIOS) {
+				msx->biosCalls++;
+				cpu->cycles += msx->trapCost;
+				biosCall(msx, BIOS_FIRST_ENTRY + (id - TRAP_BIOS) * 3);
+			} else {
+				msx->error = "Unknown trap";
+				msx->finished = true;
+				return true;
+			}
+			break;
+	}
+	return msx->finished;
+}
+
+//-------------------------------------------------------------------
+// Inter-slot calls
+
+static void enableSlot(Msx *msx, uint8_t slotId, uint8_t page)
+{
+	uint8_t ps = slotId & 3;
+
+	msx->slotReg = (msx->slotReg & ~(3 << (page * 2))) | (ps << (page * 2));
+	if (slotId & 0x80) {
+		uint8_t ss = (slotId >> 2) & 3;
+		msx->subReg[ps] = (msx->subReg[ps] & ~(3 << (page * 2))) | (ss << (page * 2));
+	}
+}
+
+/**
+ * callFar
+ * Calls a routine in another slot (slotId >= 0) or mapper segment
+ * (segment >= 0), restoring the previous state when it returns.
+ */
+static void callFar(Msx *msx, uint16_t addr, int slotId, int segment)
+{
+	Z80 *cpu = &msx->cpu;
+	MsxCallFrame *fr;
+
+	if (msx->callDepth >= (int)(sizeof(msx->calls) / sizeof(msx->calls[0]))) {
+		msx->error = "Inter-slot calls nested too deep";
+		msx->finished = true;
+		cpu->stop = true;
+		return;
+	}
+	fr = &msx->calls[msx->callDepth++];
+	fr->slotReg = msx->slotReg;
+	memcpy(fr->subReg, msx->subReg, sizeof(msx->subReg));
+	memcpy(fr->mapper, msx->mapper, sizeof(msx->mapper));
+	fr->restoreMapper = segment >= 0;
+
+	if (slotId >= 0) enableSlot(msx, slotId, addr >> 14);
+	if (segment >= 0) msx->mapper[addr >> 14] = segment;
+	z80_push(cpu, MSX_TRAP_RET);
+	cpu->pc = addr;
+}
+
+static void interrupt(Msx *msx)
+{
+	Z80 *cpu = &msx->cpu;
+	uint16_t jiffy = msx_read(msx, SV_JIFFY) | (msx_read(msx, SV_JIFFY + 1) << 8);
+	uint8_t status = msx->vdpStatus;
+
+	jiffy++;
+	msx_write(msx, SV_JIFFY, jiffy & 0xff);
+	msx_write(msx, SV_JIFFY + 1, jiffy >> 8);
+	msx->vdpStatus &= 0x7f;
+	cpu->irq = false;
+
+	if (msx_read(msx, SV_H_TIMI) != 0xc9) {
+		msx->intSaved = *cpu;
+		cpu->af.b.h = status;
+		z80_push(cpu, MSX_TRAP_RET + 3);
+		cpu->pc = SV_H_TIMI;
+		return;
+	}
+	cpu->iff1 = cpu->iff2 = 1;
+	z80_ret(cpu);
+}
+
+//-------------------------------------------------------------------
+// Mapper support routines
+
+static void setCarry(Z80 *cpu, bool carry)
+{
+	cpu->af.b.l = (cpu->af.b.l & ~Z80_FLAG_C) | (carry ? Z80_FLAG_C : 0);
+}
+
+static void mapperCall(Msx *msx, uint8_t fn)
+{
+	Z80 *cpu = &msx->cpu;
+	uint8_t *a = &cpu->af.b.h;
+	int s;
+
+	switch (fn) {
+		case MAP_ALL_SEG:
+			if (*a == 0) {
+				for (s = 0; s < msx->segments && msx->segOwner[s] != SEG_FREE; s++);
+			} else {
+				for (s = msx->segments - 1; s >= 0 && msx->segOwner[s] != SEG_FREE; s--);
+			}
+			if (s < 0 || s >= msx->segments) {
+				setCarry(cpu, true);
+				break;
+			}
+			msx->segOwner[s] = *a ? SEG_SYSTEM : SEG_USER;
+			*a = s;
+			cpu->bc.b.h = MSX_RAM_SLOT;
+			setCarry(cpu, false);
+			updateMapperVars(msx);
+			break;
+		case MAP_FRE_SEG:
+			if (*a >= msx->segments || msx->segOwner[*a] == SEG_FREE) {
+				setCarry(cpu, true);
+				break;
+			}
+			msx->segOwner[*a] = SEG_FREE;
+			setCarry(cpu, false);
+			updateMapperVars(msx);
+			break;
+		case MAP_RD_SEG:
+			*a = msx->ram[((*a & (msx->segments - 1)) << 14) | (cpu->hl.w & 0x3fff)];
+			break;
+		case MAP_WR_SEG:
+			msx->ram[((*a & (msx->segments - 1)) << 14) | (cpu->hl.w & 0x3fff)] = cpu->de.b.l;
+			break;
+		case MAP_CAL_SEG:
+			callFar(msx, cpu->ix.w, -1, cpu->iy.b.h);
+			return;
+		case MAP_CALLS: {
+			uint16_t ret = z80_pop(cpu);
+			uint8_t seg = msx_read(msx, ret);
+			uint16_t addr = msx_read(msx, ret + 1) | (msx_read(msx, ret + 2) << 8);
+			z80_push(cpu, ret + 3);
+			callFar(msx, addr, -1, seg);
+			return;
+		}
+		case MAP_PUT_PH:
+			if ((cpu->hl.b.h >> 6) != 3) msx->mapper[cpu->hl.b.h >> 6] = *a;
+			break;
+		case MAP_GET_PH:
+			*a = msx->mapper[cpu->hl.b.h >> 6];
+			break;
+		case MAP_PUT_P3:
+			break;			// Page 3 is never switched
+		default:
+			if (fn & 1) *a = msx->mapper[(fn - MAP_PUT_P0) >> 1];
+			else msx->mapper[(fn - MAP_PUT_P0) >> 1] = *a;
+			break;
+	}
+	z80_ret(cpu);
+}
+
+//-------------------------------------------------------------------
+// BIOS
+
+static void biosCall(Msx *msx, uint16_t entry)
+{
+	Z80 *cpu = &msx->cpu;
+	uint8_t *a = &cpu->af.b.h;
+	uint8_t *f = &cpu->af.b.l;
+	int ch;
+
+	switch (entry) {
+		case 0x0047:						// WRTVDP
+			msx->vdpReg[cpu->bc.b.l & 0x3f] = cpu->bc.b.h;
+			break;
+		case 0x004a:						// RDVRM
+			*a = msx->vram[cpu->hl.w];
+			break;
+		case 0x004d:						// WRTVRM
+			msx->vram[cpu->hl.w] = *a;
+			break;
+		case 0x0050:						// SETRD
+		case 0x0053:						// SETWRT
+			msx->vdpAddr = cpu->hl.w;
+			break;
+		case 0x0056:						// FILVRM
+			for (uint16_t i = 0; i < cpu->bc.w; i++) msx->vram[(cpu->hl.w + i) & 0xffff] = *a;
+			break;
+		case 0x0059:						// LDIRMV
+			for (uint16_t i = 0; i < cpu->bc.w; i++)
+				msx_write(msx, cpu->de.w + i, msx->vram[(cpu->hl.w + i) & 0xffff]);
+			break;
+		case 0x005c:						// LDIRVM
+			for (uint16_t i = 0; i < cpu->bc.w; i++)
+				msx->vram[(cpu->de.w + i) & 0xffff] = msx_read(msx, cpu->hl.w + i);
+			break;
+		case 0x005f:						// CHGMOD
+			msx_write(msx, SV_SCRMOD, *a);
+			break;
+		case 0x006c:						// INITXT
+		case 0x006f:						// INIT32
+			msx_write(msx, SV_SCRMOD, entry == 0x006c ? 0 : 1);
+			msx_write(msx, SV_CSRX, 1);
+			msx_write(msx, SV_CSRY, 1);
+			break;
+		case 0x0096:						// RDPSG
+			*a = 0;
+			break;
+		case 0x009c:						// CHSNS
+			ch = msx_read(msx, SV_GETPNT) != msx_read(msx, SV_PUTPNT) ||
+				 msx_read(msx, SV_GETPNT + 1) != msx_read(msx, SV_PUTPNT + 1);
+			*f = (*f & ~Z80_FLAG_Z) | (ch ? 0 : Z80_FLAG_Z);
+			break;
+		case 0x009f:						// CHGET
+			*a = msx_getKey(msx, true);
+			break;
+		case 0x00a2:						// CHPUT
+			msx_putc(msx, *a);
+			break;
+		case 0x00a5:						// LPTOUT
+		case 0x00b7:						// BREAKX
+			*f &= ~Z80_FLAG_C;
+			break;
+		case 0x00a8:						// LPTSTT
+			*a = 0;
+			*f |= Z80_FLAG_Z;
+			break;
+		case 0x00c6:						// POSIT
+			msx_write(msx, SV_CSRX, cpu->hl.b.h);
+			msx_write(msx, SV_CSRY, cpu->hl.b.l);
+			break;
+		case 0x00d5:						// GTSTCK
+		case 0x00d8:						// GTTRIG
+			*a = 0;
+			break;
+		case 0x0138:						// RSLREG
+			*a = msx->slotReg;
+			break;
+		case 0x013b:						// WSLREG
+			msx->slotReg = *a;
+			break;
+		case 0x013e:						// RDVDP
+			*a = msx->vdpStatus;
+			msx->vdpStatus &= 0x7f;
+			cpu->irq = false;
+			break;
+		case 0x0141:						// SNSMAT
+			*a = 0xff;
+			break;
+		case 0x0156:						// KILBUF
+			msx_write(msx, SV_GETPNT, msx_read(msx, SV_PUTPNT));
+			msx_write(msx, SV_GETPNT + 1, msx_read(msx, SV_PUTPNT + 1));
+			break;
+		default:							// Screen, PSG, etc: nothing to do
+			break;
+	}
+	z80_ret(cpu);
+}
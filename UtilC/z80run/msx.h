@@ -0,0 +1,170 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "z80.h"
+
+
+#define MSX_CLOCK			3579545		// Z80 clock in Hz
+#define MSX_FRAME_CYCLES	59736		// 262 lines of 228 T-states (60Hz)
+
+#define MSX_RAM_SLOT		3			// Slot of the RAM mapper
+#define MSX_BIOS_SLOT		0			// Slot of the (host served) main BIOS
+#define MSX_MAX_SEGMENTS	256
+
+// Layout of the emulated MSX-DOS kernel area in page 3
+#define MSX_DOS_TOP			0xdc06		// Address at 0006h, BDOS entry and TPA top
+#define MSX_MAPPER_JT		0xdc10		// Mapper support routines jump table
+#define MSX_MAPPER_VARS		0xdc40		// Mapper variables table
+#define MSX_TRAP_RET		0xdc50		// Return point of the host driven calls
+
+// System variables
+#define SV_RAMAD0		0xf341
+#define SV_RAMAD1		0xf342
+#define SV_RAMAD2		0xf343
+#define SV_RAMAD3		0xf344
+#define SV_BDOS			0xf37d
+#define SV_LINL40		0xf3ae
+#define SV_LINLEN		0xf3b0
+#define SV_CRTCNT		0xf3b1
+#define SV_CSRY			0xf3dc
+#define SV_CSRX			0xf3dd
+#define SV_FORCLR		0xf3e9
+#define SV_BAKCLR		0xf3ea
+#define SV_BDRCLR		0xf3eb
+#define SV_PUTPNT		0xf3f8
+#define SV_GETPNT		0xf3fa
+#define SV_KEYBUF		0xfbf0
+#define SV_KEYBUF_END	0xfc18
+#define SV_HOKVLD		0xfb20
+#define SV_JIFFY		0xfc9e
+#define SV_SCRMOD		0xfcaf
+#define SV_EXPTBL		0xfcc1
+#define SV_SLTTBL		0xfcc5
+#define SV_H_TIMI		0xfd9f
+#define SV_EXTBIO		0xffca
+
+// Host traps (ED FE id)
+enum {
+	TRAP_WBOOT = 1,		// 0000h: program end
+	TRAP_BDOS,			// 0005h and F37Dh
+	TRAP_RDSLT,
+	TRAP_WRSLT,
+	TRAP_CALSLT,
+	TRAP_ENASLT,
+	TRAP_CALLF,
+	TRAP_KEYINT,		// 0038h
+	TRAP_EXTBIO,
+	TRAP_CALL_RET,		// Return from a CALSLT/CALLF/CAL_SEG call
+	TRAP_INT_RET,		// Return from H.TIMI
+	TRAP_MAPPER,		// +0..+15: mapper support routines
+	TRAP_BIOS = 0x40	// +0..: BIOS entries served by the host
+};
+
+// Device mapped in a (sub)slot
+typedef struct MsxDevice {
+	uint8_t (*read)(void *ctx, uint16_t addr);
+	void    (*write)(void *ctx, uint16_t addr, uint8_t value);
+	void    (*reset)(void *ctx);
+	void    *ctx;
+} MsxDevice;
+
+// I/O port handler
+typedef struct MsxPort {
+	uint8_t (*in)(void *ctx, uint8_t port);
+	void    (*out)(void *ctx, uint8_t port, uint8_t value);
+	void    *ctx;
+} MsxPort;
+
+typedef enum {
+	DOS_MSXDOS1 = 1,
+	DOS_MSXDOS2,
+	DOS_NEXTOR
+} DosKind;
+
+typedef struct {
+	uint16_t pc;
+	uint8_t  slotReg;
+	uint8_t  subReg[4];
+	uint8_t  mapper[4];
+	bool     restoreMapper;
+} MsxCallFrame;
+
+typedef struct Msx Msx;
+typedef void (*MsxConsole)(void *ctx, uint8_t ch);
+
+struct Msx {
+	Z80       cpu;
+	DosKind   dos;
+
+	// Slots
+	uint8_t   slotReg;					// Port A8h
+	uint8_t   subReg[4];				// FFFFh of each expanded slot
+	bool      expanded[4];
+	MsxDevice *dev[4][4];				// [primary][secondary], NULL = empty
+
+	// RAM mapper in MSX_RAM_SLOT
+	uint8_t  *ram;
+	uint16_t  segments;
+	uint8_t   mapper[4];				// Ports FCh..FFh
+	uint8_t   segOwner[MSX_MAX_SEGMENTS];	// 0=free 1=user 2=system
+
+	// Main BIOS (page 0 of MSX_BIOS_SLOT is served by traps)
+	uint8_t   bios[0x8000];
+
+	// VDP
+	uint8_t  *vram;
+	uint8_t   vdpReg[64];
+	uint8_t   vdpStatus;
+	uint8_t   vdpLatch;
+	bool      vdpLatchFull;
+	uint32_t  vdpAddr;
+	bool      vdpIrq;
+
+	MsxPort   ports[256];
+
+	// Host driven calls
+	MsxCallFrame calls[32];
+	int       callDepth;
+	Z80       intSaved;
+
+	// Timing
+	uint64_t  nextFrame;
+	uint64_t  trapCost;					// T-states charged per DOS/BIOS call
+	uint64_t  dosCalls;
+	uint64_t  biosCalls;
+
+	// Program end
+	bool      finished;
+	int       exitCode;
+	const char *error;
+
+	MsxConsole console;
+	void     *consoleCtx;
+	void     *dosCtx;
+};
+
+
+bool    msx_init(Msx *msx, DosKind dos, uint16_t segments);
+void    msx_free(Msx *msx);
+void    msx_insert(Msx *msx, uint8_t slot, uint8_t sub, MsxDevice *dev);
+void    msx_setPort(Msx *msx, uint8_t port, const MsxPort *handler);
+bool    msx_load(Msx *msx, const char *filename, const char *args);
+bool    msx_start(Msx *msx, const void *program, size_t size, const char *args);
+void    msx_run(Msx *msx, uint64_t maxCycles);
+
+uint8_t msx_read(Msx *msx, uint16_t addr);
+void    msx_write(Msx *msx, uint16_t addr, uint8_t value);
+uint8_t msx_readSlot(Msx *msx, uint8_t slotId, uint16_t addr);
+void    msx_writeSlot(Msx *msx, uint8_t slotId, uint16_t addr, uint8_t value);
+void    msx_readBlock(Msx *msx, uint16_t addr, void *dst, uint16_t size);
+void    msx_writeBlock(Msx *msx, uint16_t addr, const void *src, uint16_t size);
+void    msx_putc(Msx *msx, uint8_t ch);
+int     msx_getKey(Msx *msx, bool wait);
+
+// msxdos.c
+void    dos_init(Msx *msx, const char *hostDir, const char *image);
+void    dos_free(Msx *msx);
+void    dos_call(Msx *msx);
+void    dos_setProgram(Msx *msx, const char *name, const char *args);
@@ -0,0 +1,1920 @@
+/*
+ * MSX-DOS 1/2 and Nextor BDOS served by the host.
+ *
+ * Files live in a host directory (drive A:). The FCB and file handle calls
+ * work on the host files directly, the sector level calls (_RDABS, _RDDRV,
+ * _GETCLUS...) see a FAT volume synthesized from the same directory, or a
+ * disk image when one is given.
+ *
+ * Only the drive A: exists. FCBs opened by the program are bound to a host
+ * file through a tag stored in the reserved bytes of the FCB (+26/+27), so
+ * an FCB cleared by the program is no longer open.
+ */
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "msx.h"
+#include "disk.h"
+#include "hostfs.h"
+
+
+// Function calls
+enum {
+	TERM0 = 0x00, CONIN, CONOUT, AUXIN, AUXOUT, LSTOUT, DIRIO, DIRIN, INNOE, STROUT, BUFIN, CONST,
+	CPMVER, DSKRST, SELDSK, FOPEN, FCLOSE, SFIRST, SNEXT, FDEL, RDSEQ, WRSEQ, FMAKE, FREN,
+	LOGIN, CURDRV, SETDTA, ALLOC,
+	RDRND = 0x21, WRRND, FSIZE, SETRND,
+	WRBLK = 0x26, RDBLK, WRZER,
+	GDATE = 0x2a, SDATE, GTIME, STIME, VERIFY, RDABS, WRABS,
+	DPARM,
+	FFIRST = 0x40, FNEXT, FNEW, OPEN, CREATE, CLOSE, ENSURE, DUP, READ, WRITE, SEEK, IOCTL,
+	HTEST, DELETE, RENAME, MOVE, ATTR, FTIME, HDELETE, HRENAME, HMOVE, HATTR, HFTIME,
+	GETDTA, GETVFY, GETCD, CHDIR, PARSE, PFILE, CHKCHR, WPATH, FLUSH, FORK, JOIN, TERM,
+	DEFAB, DEFER, ERROR, EXPLAIN, FORMAT, RAMD, BUFFER, ASSIGN, GENV, SENV, FENV, DSKCHK,
+	DOSVER, REDIR,
+	FOUT, ZSTROUT, RDDRV, WRDRV, RALLOC, DSPACE, LOCK, GDRVR, GDLI, GPART, CDRVR, MAPDRV,
+	Z80MODE, GETCLUS
+};
+
+// Errors
+enum {
+	ERR_ICLUS = 0xb0, ERR_ISBFN = 0xb8, ERR_ELONG = 0xbf, ERR_IENV, ERR_IDEV, ERR_NOPEN,
+	ERR_IHAND, ERR_NHAND, ERR_ACCV = 0xc6, ERR_EOF, ERR_FOPEN = 0xca, ERR_FILEX, ERR_DIRX,
+	ERR_SYSX, ERR_DOT, ERR_IATTR, ERR_DIRNE, ERR_FILRO, ERR_DUPF = 0xd3, ERR_DKFUL, ERR_DRFUL,
+	ERR_NODIR, ERR_NOFIL, ERR_PLONG, ERR_IPATH, ERR_IFNM, ERR_IDRV, ERR_IBDOS, ERR_NORAM = 0xde,
+	ERR_INTER, ERR_IFORM = 0xf0
+};
+
+#define MAX_HANDLES		64
+#define MAX_FCBS		16
+#define MAX_ENV			32
+#define MAX_SEARCHES	8
+#define MSX_PATHLEN		64
+
+#define HANDLE_CLOSED	0
+#define HANDLE_FILE		1
+#define HANDLE_CON		2
+#define HANDLE_NUL		3
+
+#define OPEN_RDONLY		0x01
+#define OPEN_WRONLY		0x02
+
+#define FIB_MAGIC		0xff
+#define FIB_TAG			0xa5		// Internal byte marking the FIBs filled by the runner
+
+typedef struct {
+	uint8_t  kind;
+	uint8_t  mode;
+	int      fd;
+	bool     eof;
+	char     path[4096];
+} DosHandle;
+
+typedef struct {
+	uint16_t addr;					// FCB address
+	uint16_t tag;					// Tag stored at FCB+26, 0 = free entry
+	int      fd;
+	bool     readOnly;
+	char     path[4096];
+} DosFcb;
+
+typedef struct {
+	char     name[256];
+	char     value[256];
+} DosEnv;
+
+typedef struct {
+	char     dir[4096];				// Host directory of a FFIRST/SFIRST search
+} DosSearch;
+
+typedef struct {
+	Msx      *msx;
+	char     root[4096];			// Host directory of the drive A:
+	char     cwd[MSX_PATHLEN];		// Current directory, MSX form without leading '\'
+	Disk     disk;
+	bool     image;
+	bool     dirty;					// Host files changed, the synthesized volume is old
+	uint16_t dta;
+	uint8_t  lastError;
+	uint8_t  fastOut;
+	uint8_t  lock;
+	uint16_t abortRoutine;
+
+	DosHandle handles[MAX_HANDLES];
+	DosFcb   fcbs[MAX_FCBS];
+	uint16_t fcbTag;
+	DosEnv   env[MAX_ENV];
+	DosSearch searches[MAX_SEARCHES];
+	uint8_t  nextSearch;
+	uint8_t  sfirstPattern[11];		// SFIRST/SNEXT (FCB search) state
+	int      sfirstIndex;
+} DosState;
+
+typedef struct {
+	uint8_t code;
+	const char *msg;
+} DosMessage;
+
+static const DosMessage messages[] = {
+	{ 0xff, "Incompatible disk" }, { 0xfe, "Write error" }, { 0xfd, "Disk error" },
+	{ 0xfc, "Not ready" }, { 0xfb, "Verify error" }, { 0xfa, "Data error" },
+	{ 0xf9, "Sector not found" }, { 0xf8, "Write protected disk" }, { 0xf7, "Unformatted disk" },
+	{ 0xf6, "Not a DOS disk" }, { 0xf5, "Wrong disk" }, { 0xf4, "Wrong disk for file" },
+	{ 0xf3, "Seek error" }, { 0xf2, "Bad file allocation table" }, { 0xf0, "Cannot format this drive" },
+	{ 0xdf, "Internal error" }, { 0xde, "Not enough memory" }, { 0xdc, "Invalid MSX-DOS call" },
+	{ 0xdb, "Invalid drive" }, { 0xda, "Invalid filename" }, { 0xd9, "Invalid pathname" },
+	{ 0xd8, "Pathname too long" }, { 0xd7, "File not found" }, { 0xd6, "Directory not found" },
+	{ 0xd5, "Root directory full" }, { 0xd4, "Disk full" }, { 0xd3, "Duplicate filename" },
+	{ 0xd2, "Invalid directory move" }, { 0xd1, "Read only file" }, { 0xd0, "Directory not empty" },
+	{ 0xcf, "Invalid attributes" }, { 0xce, "Invalid . or .. operation" }, { 0xcd, "System file exists" },
+	{ 0xcc, "Directory exists" }, { 0xcb, "File exists" }, { 0xca, "File already in use" },
+	{ 0xc9, "Cannot transfer above 64K" }, { 0xc8, "File allocation error" }, { 0xc7, "End of file" },
+	{ 0xc6, "File access violation" }, { 0xc5, "Invalid process id" }, { 0xc4, "No spare file handles" },
+	{ 0xc3, "Invalid file handle" }, { 0xc2, "File handle not open" }, { 0xc1, "Invalid device operation" },
+	{ 0xc0, "Invalid environment string" }, { 0xbf, "Environment string too long" },
+	{ 0xbe, "Invalid date" }, { 0xbd, "Invalid time" }, { 0xbc, "RAM disk (drive H:) already exists" },
+	{ 0xbb, "RAM disk does not exist" }, { 0xba, "File handle has been deleted" },
+	{ 0xb9, "Internal error" }, { 0xb8, "Invalid sub-function number" },
+	{ 0xb4, "Invalid partition number" }, { 0xb3, "Partition is already in use" },
+	{ 0xb2, "File is mounted" }, { 0xb1, "Bad file size" }, { 0xb0, "Invalid cluster number or sequence" },
+	{ 0x9f, "Ctrl-STOP pressed" }, { 0x9e, "Ctrl-C pressed" }, { 0x9d, "Disk operation aborted" },
+	{ 0x9c, "Error on standard output" }, { 0x9b, "Error on standard input" },
+	{ 0x8f, "Wrong version of command" }, { 0x8e, "Unrecognized command" }, { 0x8d, "Command too long" },
+	{ 0x8b, "Invalid parameter" }, { 0x8a, "Too many parameters" }, { 0x89, "Missing parameter" },
+	{ 0x88, "Invalid option" }, { 0x87, "Invalid number" }, { 0x86, "File for HELP not found" },
+	{ 0x85, "Wrong version of MSX-DOS" }, { 0x84, "Cannot concatenate destination file" },
+	{ 0x83, "Cannot create destination file" }, { 0x82, "File cannot be copied onto itself" },
+	{ 0x81, "Cannot overwrite previous destination file" },
+};
+
+//###################################################################
+// Variables & Func.Definitions
+
+static void fcbCall(DosState *s, uint8_t fn);
+static void handleCall(DosState *s, uint8_t fn);
+static void nextorCall(DosState *s, uint8_t fn);
+static bool sectorCall(DosState *s, uint8_t fn);
+static void setEnv(DosState *s, const char *name, const char *value);
+
+
+//###################################################################
+// Public Functions
+
+/**
+ * dos_init
+ * Sets up the BDOS for a MSX already initialized with msx_init(...).
+ *
+ * @param hostDir Host directory seen as drive A:.
+ * @param image Disk image for the sector level calls, or NULL to build
+ *              the volume from the files in hostDir.
+ */
+void dos_init(Msx *msx, const char *hostDir, const char *image)
+{
+	DosState *s = calloc(1, sizeof(DosState));
+	time_t now = time(NULL);
+	struct tm *tm = localtime(&now);
+	char buf[32];
+
+	msx->dosCtx = s;
+	s->msx = msx;
+	snprintf(s->root, sizeof(s->root), "%s", hostDir ? hostDir : ".");
+	s->dta = 0x0080;
+	s->dirty = true;
+	s->disk.fd = -1;
+	if (image) {
+		s->image = disk_open(&s->disk, image);
+		if (!s->image) msx->error = "can't open the disk image";
+	}
+	for (int h = 0; h < MAX_HANDLES; h++) s->handles[h].fd = -1;
+	for (int h = 0; h < 5; h++) {
+		s->handles[h].kind = h < 3 ? HANDLE_CON : HANDLE_NUL;
+		s->handles[h].mode = h == 0 ? OPEN_RDONLY : (h < 3 ? OPEN_WRONLY : 0);
+	}
+
+	// Environment as left by COMMAND2.COM
+	setEnv(s, "PATH", "A:\\");
+	setEnv(s, "SHELL", "A:\\COMMAND2.COM");
+	setEnv(s, "TEMP", "A:\\");
+	setEnv(s, "PROMPT", "off");
+	setEnv(s, "ECHO", "off");
+	setEnv(s, "UPPER", "off");
+	setEnv(s, "REDIR", "on");
+	setEnv(s, "EXPAND", "on");
+	setEnv(s, "TIME", "24");
+	strftime(buf, sizeof(buf), "%d-%m-%y", tm);
+	setEnv(s, "DATE", buf);
+}
+
+void dos_free(Msx *msx)
+{
+	DosState *s = msx->dosCtx;
+
+	if (!s) return;
+	for (int h = 0; h < MAX_HANDLES; h++) {
+		if (s->handles[h].fd >= 0) close(s->handles[h].fd);
+	}
+	for (int f = 0; f < MAX_FCBS; f++) {
+		if (s->fcbs[f].tag) close(s->fcbs[f].fd);
+	}
+	disk_close(&s->disk);
+	free(s);
+	msx->dosCtx = NULL;
+}
+
+/**
+ * dos_setProgram
+ * Sets the PROGRAM and PARAMETERS environment items for the loaded program.
+ *
+ * @param name Host filename of the program.
+ */
+void dos_setProgram(Msx *msx, const char *name, const char *args)
+{
+	DosState *s = msx->dosCtx;
+	const char *base = strrchr(name, '/');
+	char path[MSX_PATHLEN];
+	int i;
+
+	base = base ? base + 1 : name;
+	i = snprintf(path, sizeof(path), "A:\\");
+	while (*base && i < MSX_PATHLEN - 1) path[i++] = toupper((unsigned char)*base++);
+	path[i] = '\0';
+	setEnv(s, "PROGRAM", path);
+	setEnv(s, "PARAMETERS", args ? args : "");
+}
+
+/**
+ * dos_call
+ * Serves a BDOS call (function number in C) with the Z80 registers.
+ */
+void dos_call(Msx *msx)
+{
+	DosState *s = msx->dosCtx;
+	Z80 *cpu = &msx->cpu;
+	uint8_t fn = cpu->bc.b.l;
+
+	if (fn > WRABS && msx->dos == DOS_MSXDOS1) {
+		// MSX-DOS 1 returns zeroes for the functions it doesn't know
+		cpu->af.b.h = 0;
+		cpu->bc.b.h = 0;
+		cpu->hl.w = 0;
+		return;
+	}
+	if (fn >= FOUT && msx->dos != DOS_NEXTOR) {
+		cpu->af.b.h = ERR_IBDOS;
+		return;
+	}
+	if (fn < DPARM) fcbCall(s, fn);
+	else if (fn < FOUT) handleCall(s, fn);
+	else nextorCall(s, fn);
+	if (fn >= DPARM && cpu->af.b.h) s->lastError = cpu->af.b.h;
+}
+
+
+//###################################################################
+// Private Functions
+
+//-------------------------------------------------------------------
+// Helpers
+
+static uint16_t rd16(DosState *s, uint16_t addr)
+{
+	return msx_read(s->msx, addr) | (msx_read(s->msx, addr + 1) << 8);
+}
+
+static void wr16(DosState *s, uint16_t addr, uint16_t value)
+{
+	msx_write(s->msx, addr, value & 0xff);
+	msx_write(s->msx, addr + 1, value >> 8);
+}
+
+static uint32_t rd32(DosState *s, uint16_t addr)
+{
+	return rd16(s, addr) | ((uint32_t)rd16(s, addr + 2) << 16);
+}
+
+static void wr32(DosState *s, uint16_t addr, uint32_t value)
+{
+	wr16(s, addr, value & 0xffff);
+	wr16(s, addr + 2, value >> 16);
+}
+
+static void readString(DosState *s, uint16_t addr, char *buf, int size)
+{
+	int i;
+	for (i = 0; i < size - 1; i++) {
+		buf[i] = msx_read(s->msx, addr + i);
+		if (!buf[i]) break;
+	}
+	buf[i] = '\0';
+}
+
+static void writeString(DosState *s, uint16_t addr, const char *str)
+{
+	do {
+		msx_write(s->msx, addr++, *str);
+	} while (*str++);
+}
+
+static void setEnv(DosState *s, const char *name, const char *value)
+{
+	DosEnv *slot = NULL;
+
+	for (int i = 0; i < MAX_ENV; i++) {
+		if (!s->env[i].name[0]) {
+			if (!slot) slot = &s->env[i];
+		} else if (!strcmp(s->env[i].name, name)) {
+			if (*value) snprintf(s->env[i].value, sizeof(s->env[i].value), "%s", value);
+			else s->env[i].name[0] = '\0';
+			return;
+		}
+	}
+	if (slot && *value) {
+		snprintf(slot->name, sizeof(slot->name), "%s", name);
+		snprintf(slot->value, sizeof(slot->value), "%s", value);
+	}
+}
+
+static const char* getEnv(DosState *s, const char *name)
+{
+	for (int i = 0; i < MAX_ENV; i++) {
+		if (s->env[i].name[0] && !strcmp(s->env[i].name, name)) return s->env[i].value;
+	}
+	return "";
+}
+
+static bool validDrive(DosState *s, uint8_t drive)
+{
+	(void)s;
+	return drive <= 1;				// 0 = current, 1 = A:
+}
+
+/**
+ * updateDisk
+ * Rebuilds the synthesized volume if the host files changed since the last
+ * sector level call.
+ */
+static void updateDisk(DosState *s)
+{
+	if (s->image || !s->dirty) return;
+	disk_close(&s->disk);
+	if (!disk_synthesize(&s->disk, s->root, s->msx->dos == DOS_NEXTOR)) {
+		fprintf(stderr, "z80run: can't build the disk volume from %s\n", s->root);
+	}
+	s->dirty = false;
+}
+
+/**
+ * findEntry
+ * Looks for the first entry of a host directory matching a name pattern
+ * in FCB form, starting at a given index of the sorted listing.
+ *
+ * @param attr Attributes of the entries to include (ATTR_HIDDEN, ATTR_SYSTEM,
+ *             ATTR_DIRECTORY), plain files are always included.
+ * @return Index of the entry found, or -1.
+ */
+static int findEntry(const char *dir, const char *pattern, uint8_t attr, int start, HostEntry *found)
+{
+	HostEntry *list;
+	int count = hostfs_list(dir, &list), i;
+
+	for (i = start < 0 ? 0 : start; i < count; i++) {
+		uint8_t a = list[i].attr;
+		if ((a & HOSTFS_ATTR_DIRECTORY) && !(attr & HOSTFS_ATTR_DIRECTORY)) continue;
+		if ((a & (HOSTFS_ATTR_HIDDEN | HOSTFS_ATTR_SYSTEM)) & ~attr) continue;
+		if (hostfs_match(pattern, list[i].fcb)) {
+			*found = list[i];
+			break;
+		}
+	}
+	free(list);
+	return i < count ? i : -1;
+}
+
+/**
+ * resolvePath
+ * Splits a MSX drive/path/file string in the host directory holding the
+ * last item and the last item itself.
+ *
+ * @param dir Returns the host directory.
+ * @param last Returns the last item (may be empty or ambiguous).
+ * @return 0 or the DOS error.
+ */
+static uint8_t resolvePath(DosState *s, const char *path, char *dir, char *last)
+{
+	char items[MSX_PATHLEN * 2];
+	char *item, *next;
+
+	if (strlen(path) >= MSX_PATHLEN) return ERR_PLONG;
+	if (path[0] && path[1] == ':') {
+		if (toupper((unsigned char)path[0]) != 'A') return ERR_IDRV;
+		path += 2;
+	}
+	if (*path == '\\') {
+		snprintf(items, sizeof(items), "%s", path + 1);
+	} else {
+		snprintf(items, sizeof(items), "%s%s%s", s->cwd, s->cwd[0] ? "\\" : "", path);
+	}
+	strcpy(dir, s->root);
+	for (item = items; (next = strchr(item, '\\')); item = next + 1) {
+		char fcb[11];
+		HostEntry e;
+
+		*next = '\0';
+		if (!*item || !strcmp(item, ".")) continue;
+		if (!strcmp(item, "..")) {
+			char *sep = strrchr(dir, '/');
+			if (strlen(dir) <= strlen(s->root)) return ERR_NODIR;
+			*sep = '\0';
+			continue;
+		}
+		if (!hostfs_toFcb(item, fcb, false)) return ERR_IPATH;
+		if (findEntry(dir, fcb, HOSTFS_ATTR_DIRECTORY | HOSTFS_ATTR_HIDDEN | HOSTFS_ATTR_SYSTEM, 0, &e) < 0 ||
+			!(e.attr & HOSTFS_ATTR_DIRECTORY)) return ERR_NODIR;
+		strcat(dir, "/");
+		strcat(dir, e.host);
+	}
+	for (const char *c = item; *c; c++) {
+		if ((unsigned char)*c < ' ') return ERR_IPATH;
+	}
+	strcpy(last, item);
+	return 0;
+}
+
+/**
+ * lookupFile
+ * Finds the entry named by a MSX path.
+ *
+ * @param wildcards Allow an ambiguous last item (the first match is taken).
+ * @return 0, ERR_NOFIL or the path error.
+ */
+static uint8_t lookupFile(DosState *s, const char *path, uint8_t attr, bool wildcards, char *dir, HostEntry *e)
+{
+	char last[MSX_PATHLEN * 2], fcb[11];
+	uint8_t err = resolvePath(s, path, dir, last);
+
+	if (err) return err;
+	if (!hostfs_toFcb(last, fcb, wildcards)) return ERR_IFNM;
+	if (findEntry(dir, fcb, attr, 0, e) < 0) return ERR_NOFIL;
+	return 0;
+}
+
+static void hostPath(char *path, const char *dir, const char *name)
+{
+	snprintf(path, 4096, "%s/%s", dir, name);
+}
+
+/**
+ * fillFib
+ * Fills a File Info Block with a directory entry.
+ */
+static void fillFib(DosState *s, uint16_t fib, const HostEntry *e, const char *pattern,
+					uint8_t attr, int index, uint8_t search)
+{
+	char name[13];
+
+	hostfs_fromFcb(e->fcb, name);
+	msx_write(s->msx, fib, FIB_MAGIC);
+	for (int i = 0; i < 13; i++) msx_write(s->msx, fib + 1 + i, 0);
+	writeString(s, fib + 1, name);
+	msx_write(s->msx, fib + 14, e->attr);
+	wr16(s, fib + 15, hostfs_dosTime(e->mtime));
+	wr16(s, fib + 17, hostfs_dosDate(e->mtime));
+	wr16(s, fib + 19, 0);
+	wr32(s, fib + 21, e->size);
+	msx_write(s->msx, fib + 25, 1);
+	// Internal: search pattern, attributes, next index and search slot
+	for (int i = 0; i < 11; i++) msx_write(s->msx, fib + 26 + i, pattern[i]);
+	msx_write(s->msx, fib + 37, attr);
+	wr16(s, fib + 38, index + 1);
+	msx_write(s->msx, fib + 40, search);
+	msx_write(s->msx, fib + 41, FIB_TAG);
+}
+
+/**
+ * fibPath
+ * Host path of the entry described by a FIB filled by FFIRST/FNEXT.
+ *
+ * @return false if the FIB was not filled by the runner.
+ */
+static bool fibPath(DosState *s, uint16_t fib, char *path)
+{
+	uint8_t search = msx_read(s->msx, fib + 40);
+	char name[13], fcb[11];
+	HostEntry e;
+
+	if (msx_read(s->msx, fib) != FIB_MAGIC || msx_read(s->msx, fib + 41) != FIB_TAG ||
+		search >= MAX_SEARCHES) return false;
+	readString(s, fib + 1, name, sizeof(name));
+	if (!hostfs_toFcb(name, fcb, false)) return false;
+	if (findEntry(s->searches[search].dir, fcb, 0xff, 0, &e) < 0) return false;
+	hostPath(path, s->searches[search].dir, e.host);
+	return true;
+}
+
+/**
+ * objectPath
+ * Host path of the object named by DE: an ASCIIZ path or a FIB.
+ */
+static uint8_t objectPath(DosState *s, uint16_t addr, uint8_t attr, char *path, HostEntry *e)
+{
+	char str[MSX_PATHLEN * 2], dir[4096];
+	uint8_t err;
+
+	if (msx_read(s->msx, addr) == FIB_MAGIC) {
+		if (!fibPath(s, addr, path)) return ERR_NOFIL;
+		if (e) {
+			struct stat st;
+			if (stat(path, &st)) return ERR_NOFIL;
+			e->attr = S_ISDIR(st.st_mode) ? HOSTFS_ATTR_DIRECTORY :
+					  ((st.st_mode & S_IWUSR) ? 0 : HOSTFS_ATTR_READONLY) | ((st.st_mode & S_IXUSR) ? HOSTFS_ATTR_ARCHIVE : 0);
+			e->size = st.st_size;
+			e->mtime = st.st_mtime;
+		}
+		return 0;
+	}
+	readString(s, addr, str, sizeof(str));
+	{
+		HostEntry tmp;
+		if (!e) e = &tmp;
+		err = lookupFile(s, str, attr, false, dir, e);
+		if (err) return err;
+		hostPath(path, dir, e->host);
+	}
+	return 0;
+}
+
+static uint8_t newSearch(DosState *s, const char *dir)
+{
+	uint8_t n = s->nextSearch;
+	s->nextSearch = (n + 1) % MAX_SEARCHES;
+	snprintf(s->searches[n].dir, sizeof(s->searches[n].dir), "%s", dir);
+	return n;
+}
+
+static void setAttributes(const char *path, uint8_t attr)
+{
+	struct stat st;
+
+	if (stat(path, &st)) return;
+	st.st_mode &= ~(S_IWUSR | S_IXUSR);
+	if (!(attr & HOSTFS_ATTR_READONLY)) st.st_mode |= S_IWUSR;
+	if (attr & HOSTFS_ATTR_ARCHIVE) st.st_mode |= S_IXUSR;
+	chmod(path, st.st_mode & 07777);
+}
+
+//-------------------------------------------------------------------
+// Console
+
+static void putStr(DosState *s, uint16_t addr, char end)
+{
+	char ch;
+	while ((ch = msx_read(s->msx, addr++)) != end) msx_putc(s->msx, ch);
+}
+
+static void bufferedInput(DosState *s, uint16_t buf)
+{
+	uint8_t max = msx_read(s->msx, buf);
+	uint8_t len = 0;
+	int ch;
+
+	while ((ch = msx_getKey(s->msx, true)) != '\r') {
+		if (ch == 8 && len) {
+			len--;
+			continue;
+		}
+		if (len + 1 < max) {
+			msx_write(s->msx, buf + 2 + len++, ch);
+			msx_putc(s->msx, ch);
+		}
+	}
+	msx_write(s->msx, buf + 2 + len, '\r');
+	msx_write(s->msx, buf + 1, len);
+	msx_putc(s->msx, '\r');
+}
+
+//-------------------------------------------------------------------
+// FCB functions (MSX-DOS 1 and CP/M)
+
+static DosFcb* boundFcb(DosState *s, uint16_t fcb)
+{
+	uint16_t tag = rd16(s, fcb + 26);
+
+	if (!tag) return NULL;
+	for (int i = 0; i < MAX_FCBS; i++) {
+		if (s->fcbs[i].tag == tag && s->fcbs[i].addr == fcb) return &s->fcbs[i];
+	}
+	return NULL;
+}
+
+/**
+ * fcbName
+ * Takes the name of a FCB, upper cased.
+ *
+ * @return false if the drive doesn't exist or the name has invalid chars.
+ */
+static bool fcbName(DosState *s, uint16_t fcb, char *name, bool wildcards)
+{
+	if (!validDrive(s, msx_read(s->msx, fcb))) return false;
+	for (int i = 0; i < 11; i++) {
+		unsigned char c = toupper(msx_read(s->msx, fcb + 1 + i));
+		if (c == '?' && wildcards) {
+			name[i] = c;
+			continue;
+		}
+		if (c < ' ' || (c != ' ' && strchr("\"*+,./:;<=>?[\\]|", c))) return false;
+		name[i] = c;
+	}
+	return name[0] != ' ';
+}
+
+static bool bindFcb(DosState *s, uint16_t fcb, const char *dir, const HostEntry *e)
+{
+	DosFcb *b = boundFcb(s, fcb), *slot = b;
+	char path[4096];
+	int fd;
+	bool readOnly = false;
+
+	hostPath(path, dir, e->host);
+	fd = open(path, O_RDWR);
+	if (fd < 0) {
+		fd = open(path, O_RDONLY);
+		readOnly = true;
+	}
+	if (fd < 0) return false;
+	if (!slot) {
+		for (int i = 0; i < MAX_FCBS && !slot; i++) {
+			if (!s->fcbs[i].tag) slot = &s->fcbs[i];
+		}
+	}
+	if (!slot) slot = &s->fcbs[s->fcbTag % MAX_FCBS];	// Reuse the oldest binding
+	if (slot->tag) close(slot->fd);
+
+	if (++s->fcbTag == 0) s->fcbTag = 1;
+	slot->addr = fcb;
+	slot->tag = s->fcbTag;
+	slot->fd = fd;
+	slot->readOnly = readOnly;
+	strcpy(slot->path, path);
+
+	// Directory data as left by the kernel
+	for (int i = 0; i < 11; i++) msx_write(s->msx, fcb + 1 + i, e->fcb[i]);
+	msx_write(s->msx, fcb + 13, e->attr);
+	msx_write(s->msx, fcb + 14, 0x80);
+	msx_write(s->msx, fcb + 15, 0x00);
+	wr32(s, fcb + 16, e->size);
+	wr16(s, fcb + 20, hostfs_dosDate(e->mtime));
+	wr16(s, fcb + 22, hostfs_dosTime(e->mtime));
+	msx_write(s->msx, fcb + 24, 0x40);
+	msx_write(s->msx, fcb + 25, 0);
+	wr16(s, fcb + 26, slot->tag);
+	wr16(s, fcb + 28, 0);
+	wr16(s, fcb + 30, 0);
+	return true;
+}
+
+static uint32_t fcbRecSize(DosState *s, uint16_t fcb)
+{
+	uint16_t size = rd16(s, fcb + 14);
+	return size ? size : 128;
+}
+
+static uint32_t fcbRandom(DosState *s, uint16_t fcb)
+{
+	uint32_t rn = rd32(s, fcb + 33);
+	return fcbRecSize(s, fcb) < 64 ? rn : rn & 0xffffff;
+}
+
+static void fcbSetRandom(DosState *s, uint16_t fcb, uint32_t rn)
+{
+	if (fcbRecSize(s, fcb) < 64) wr32(s, fcb + 33, rn);
+	else {
+		wr16(s, fcb + 33, rn & 0xffff);
+		msx_write(s->msx, fcb + 35, rn >> 16);
+	}
+}
+
+static uint32_t fcbSequential(DosState *s, uint16_t fcb)
+{
+	return msx_read(s->msx, fcb + 12) * 128 + msx_read(s->msx, fcb + 32);
+}
+
+static void fcbSetSequential(DosState *s, uint16_t fcb, uint32_t rec)
+{
+	msx_write(s->msx, fcb + 12, rec / 128);
+	msx_write(s->msx, fcb + 32, rec % 128);
+}
+
+/**
+ * fcbTransfer
+ * Reads or writes records between the DTA and a FCB file.
+ *
+ * @return Count of whole or partial records transferred.
+ */
+static uint32_t fcbTransfer(DosState *s, uint16_t fcb, uint32_t record, uint32_t count, bool write, bool *eof)
+{
+	DosFcb *b = boundFcb(s, fcb);
+	uint32_t recSize = fcbRecSize(s, fcb);
+	uint32_t bytes = recSize * count;
+	uint8_t *buf;
+	ssize_t done;
+
+	*eof = false;
+	if (bytes > 0x10000u - s->dta) bytes = 0x10000u - s->dta;
+	if (!b) {
+		// Not open: writes are lost as in MSX-DOS, reads find nothing
+		*eof = !write;
+		return write ? count : 0;
+	}
+	buf = calloc(1, bytes + 1);
+	if (write) {
+		msx_readBlock(s->msx, s->dta, buf, bytes);
+		done = b->readOnly ? -1 : pwrite(b->fd, buf, bytes, (off_t)record * recSize);
+		if (done < 0) done = 0;
+		s->dirty = true;
+		{
+			struct stat st;
+			if (!fstat(b->fd, &st)) wr32(s, fcb + 16, st.st_size);
+		}
+	} else {
+		done = pread(b->fd, buf, bytes, (off_t)record * recSize);
+		if (done < 0) done = 0;
+		if ((uint32_t)done < bytes) *eof = true;
+		// Partial records are padded with zeroes
+		msx_writeBlock(s->msx, s->dta, buf, ((done + recSize - 1) / recSize) * recSize);
+	}
+	free(buf);
+	return (done + recSize - 1) / recSize;
+}
+
+static uint8_t fcbSearch(DosState *s, uint16_t fcb, bool first)
+{
+	char dir[4096], last[4];
+	HostEntry e;
+	int idx;
+
+	if (first) {
+		char name[11];
+		if (!fcbName(s, fcb, name, true)) return 0xff;
+		memcpy(s->sfirstPattern, name, 11);
+		s->sfirstIndex = 0;
+	}
+	if (s->sfirstIndex < 0 || resolvePath(s, "", dir, last)) return 0xff;
+	idx = findEntry(dir, (char*)s->sfirstPattern, 0, s->sfirstIndex, &e);
+	if (idx < 0) {
+		s->sfirstIndex = -1;
+		return 0xff;
+	}
+	s->sfirstIndex = idx + 1;
+	// The directory entry is copied to the DTA after a drive byte
+	msx_write(s->msx, s->dta, msx_read(s->msx, fcb));
+	for (int i = 0; i < 11; i++) msx_write(s->msx, s->dta + 1 + i, e.fcb[i]);
+	msx_write(s->msx, s->dta + 12, e.attr);
+	for (int i = 13; i < 23; i++) msx_write(s->msx, s->dta + i, 0);
+	wr16(s, s->dta + 23, hostfs_dosTime(e.mtime));
+	wr16(s, s->dta + 25, hostfs_dosDate(e.mtime));
+	wr16(s, s->dta + 27, 0);
+	wr32(s, s->dta + 29, e.size);
+	return 0;
+}
+
+static void fcbCall(DosState *s, uint8_t fn)
+{
+	Msx *msx = s->msx;
+	Z80 *cpu = &msx->cpu;
+	uint16_t de = cpu->de.w;
+	uint8_t a = 0;
+	int ch;
+
+	switch (fn) {
+		case TERM0:
+			msx->finished = true;
+			msx->exitCode = 0;
+			return;
+		case CONIN:
+			ch = msx_getKey(msx, true);
+			msx_putc(msx, ch);
+			a = ch;
+			break;
+		case CONOUT:
+			msx_putc(msx, cpu->de.b.l);
+			break;
+		case AUXIN:
+			a = 0x1a;
+			break;
+		case AUXOUT:
+		case LSTOUT:
+			break;
+		case DIRIO:
+			if (cpu->de.b.l != 0xff) {
+				msx_putc(msx, cpu->de.b.l);
+				break;
+			}
+			ch = msx_getKey(msx, false);
+			a = ch < 0 ? 0 : ch;
+			break;
+		case DIRIN:
+		case INNOE:
+			a = msx_getKey(msx, true);
+			break;
+		case STROUT:
+			putStr(s, de, '$');
+			break;
+		case BUFIN:
+			bufferedInput(s, de);
+			break;
+		case CONST:
+			a = rd16(s, SV_GETPNT) != rd16(s, SV_PUTPNT) ? 0xff : 0x00;
+			break;
+		case CPMVER:
+			cpu->hl.w = 0x0022;
+			cpu->bc.b.h = 0;
+			break;
+		case DSKRST:
+			s->dta = 0x0080;
+			break;
+		case SELDSK:
+			a = 1;					// Count of drives
+			break;
+		case FOPEN: {
+			char name[11], dir[4096], last[4];
+			HostEntry e;
+			if (!fcbName(s, de, name, true) || resolvePath(s, "", dir, last) ||
+				findEntry(dir, name, 0, 0, &e) < 0 || !bindFcb(s, de, dir, &e)) a = 0xff;
+			break;
+		}
+		case FCLOSE:
+			a = boundFcb(s, de) ? 0 : 0xff;
+			break;
+		case SFIRST:
+		case SNEXT:
+			a = fcbSearch(s, de, fn == SFIRST);
+			break;
+		case FDEL: {
+			char name[11], dir[4096], last[4], path[4096];
+			HostEntry e;
+			int idx = 0;
+			a = 0xff;
+			if (!fcbName(s, de, name, true) || resolvePath(s, "", dir, last)) break;
+			while ((idx = findEntry(dir, name, 0, idx, &e)) >= 0) {
+				idx++;
+				if (e.attr & HOSTFS_ATTR_READONLY) continue;
+				hostPath(path, dir, e.host);
+				if (!unlink(path)) a = 0;
+			}
+			if (!a) s->dirty = true;
+			break;
+		}
+		case RDSEQ:
+		case WRSEQ: {
+			uint32_t rec = fcbSequential(s, de);
+			uint16_t size = rd16(s, de + 14);
+			bool eof;
+			wr16(s, de + 14, 128);
+			a = fcbTransfer(s, de, rec, 1, fn == WRSEQ, &eof) ? 0 : 1;
+			if (fn == WRSEQ) a = 0;
+			wr16(s, de + 14, size);
+			if (!a) fcbSetSequential(s, de, rec + 1);
+			break;
+		}
+		case FMAKE: {
+			char name[11], dir[4096], last[4], path[4096];
+			HostEntry e;
+			int fd;
+			a = 0xff;
+			if (!fcbName(s, de, name, false) || resolvePath(s, "", dir, last)) break;
+			if (findEntry(dir, name, HOSTFS_ATTR_DIRECTORY, 0, &e) >= 0) {
+				if (e.attr & (HOSTFS_ATTR_DIRECTORY | HOSTFS_ATTR_READONLY)) break;
+				if (msx_read(msx, de + 12)) {
+					a = bindFcb(s, de, dir, &e) ? 0 : 0xff;
+					break;
+				}
+			} else {
+				hostfs_fromFcb(name, e.host);
+				for (char *c = e.host; *c; c++) *c = tolower((unsigned char)*c);
+			}
+			hostPath(path, dir, e.host);
+			fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			if (fd < 0) break;
+			close(fd);
+			s->dirty = true;
+			if (findEntry(dir, name, 0, 0, &e) >= 0 && bindFcb(s, de, dir, &e)) a = 0;
+			break;
+		}
+		case FREN: {
+			char from[11], to[11], dir[4096], last[4], src[4096], dst[4096];
+			HostEntry e, other;
+			a = 0xff;
+			if (!fcbName(s, de, from, true) || !fcbName(s, de + 16, to, false) ||
+				resolvePath(s, "", dir, last)) break;
+			if (findEntry(dir, from, 0, 0, &e) < 0 || findEntry(dir, to, HOSTFS_ATTR_DIRECTORY, 0, &other) >= 0) break;
+			hostPath(src, dir, e.host);
+			hostfs_fromFcb(to, other.host);
+			for (char *c = other.host; *c; c++) *c = tolower((unsigned char)*c);
+			hostPath(dst, dir, other.host);
+			if (!rename(src, dst)) {
+				a = 0;
+				s->dirty = true;
+			}
+			break;
+		}
+		case LOGIN:
+			cpu->hl.w = 0x0001;		// Drive A: only
+			break;
+		case CURDRV:
+			a = 0;
+			break;
+		case SETDTA:
+			s->dta = de;
+			break;
+		case ALLOC:
+			updateDisk(s);
+			if (!validDrive(s, cpu->de.b.l)) {
+				a = 0xff;
+				break;
+			}
+			a = s->disk.secClus;
+			cpu->bc.w = DISK_SECSIZE;
+			cpu->de.w = s->disk.maxClus - 1;
+			{
+				uint32_t freeClus = 0;
+				for (uint32_t c = 2; c <= s->disk.maxClus; c++) freeClus += !disk_getFat(&s->disk, c);
+				cpu->hl.w = freeClus;
+			}
+			break;
+		case RDRND:
+		case WRRND: {
+			uint32_t rec = rd32(s, de + 33) & 0xffffff;
+			uint16_t size = rd16(s, de + 14);
+			bool eof;
+			wr16(s, de + 14, 128);
+			fcbSetSequential(s, de, rec);
+			a = fcbTransfer(s, de, rec, 1, fn == WRRND, &eof) ? 0 : 1;
+			if (fn == WRRND) a = 0;
+			wr16(s, de + 14, size);
+			break;
+		}
+		case FSIZE: {
+			char name[11], dir[4096], last[4];
+			HostEntry e;
+			a = 0xff;
+			if (!fcbName(s, de, name, true) || resolvePath(s, "", dir, last) ||
+				findEntry(dir, name, 0, 0, &e) < 0) break;
+			wr16(s, de + 33, ((e.size + 127) / 128) & 0xffff);
+			msx_write(msx, de + 35, ((e.size + 127) / 128) >> 16);
+			a = 0;
+			break;
+		}
+		case SETRND:
+			wr16(s, de + 33, fcbSequential(s, de) & 0xffff);
+			msx_write(msx, de + 35, fcbSequential(s, de) >> 16);
+			break;
+		case WRBLK:
+		case WRZER:
+		case RDBLK: {
+			uint32_t rec = fcbRandom(s, de), count = cpu->hl.w, done;
+			DosFcb *b = boundFcb(s, de);
+			bool eof;
+			if (fn == WRZER) {
+				// Random write of a 128 bytes record filled with zeroes
+				uint8_t zero[128] = { 0 };
+				rec = rd32(s, de + 33) & 0xffffff;
+				fcbSetSequential(s, de, rec);
+				if (b && !b->readOnly && pwrite(b->fd, zero, 128, (off_t)rec * 128) == 128) s->dirty = true;
+				break;
+			}
+			if (fn == WRBLK && !count) {
+				// Sets the file size to the random record
+				if (b && !b->readOnly && !ftruncate(b->fd, (off_t)rec * fcbRecSize(s, de))) {
+					wr32(s, de + 16, rec * fcbRecSize(s, de));
+					s->dirty = true;
+				}
+				break;
+			}
+			done = fcbTransfer(s, de, rec, count, fn == WRBLK, &eof);
+			fcbSetRandom(s, de, rec + done);
+			if (fn == RDBLK) {
+				cpu->hl.w = done;
+				a = eof ? 1 : 0;
+			}
+			break;
+		}
+		case GDATE:
+		case GTIME: {
+			time_t now = time(NULL);
+			struct tm *tm = localtime(&now);
+			if (fn == GDATE) {
+				cpu->hl.w = tm->tm_year + 1900;
+				cpu->de.b.h = tm->tm_mon + 1;
+				cpu->de.b.l = tm->tm_mday;
+				a = tm->tm_wday;
+			} else {
+				cpu->hl.b.h = tm->tm_hour;
+				cpu->hl.b.l = tm->tm_min;
+				cpu->de.b.h = tm->tm_sec;
+				cpu->de.b.l = 0;
+			}
+			break;
+		}
+		case SDATE:
+		case STIME:
+		case VERIFY:
+			break;
+		case RDABS:
+		case WRABS:
+			sectorCall(s, fn);
+			return;
+		default:
+			break;
+	}
+	cpu->af.b.h = a;
+	if (fn != CPMVER && fn != LOGIN && fn != ALLOC && fn != RDBLK && fn != GDATE && fn != GTIME) {
+		// CP/M style result, also in HL
+		cpu->hl.w = a;
+	}
+}
+
+//-------------------------------------------------------------------
+// Sector level functions
+
+/**
+ * sectorCall
+ * RDABS/WRABS (drive in L, sector in DE, count in H) and Nextor's
+ * RDDRV/WRDRV (drive in A, sector in HL:DE, count in B), through the DTA.
+ */
+static bool sectorCall(DosState *s, uint8_t fn)
+{
+	Z80 *cpu = &s->msx->cpu;
+	bool write = fn == WRABS || fn == WRDRV;
+	uint8_t drive, count;
+	uint32_t sector;
+	uint8_t *buf;
+	bool ok;
+
+	if (fn == RDABS || fn == WRABS) {
+		drive = cpu->hl.b.l;
+		sector = cpu->de.w;
+		count = cpu->hl.b.h;
+	} else {
+		drive = cpu->af.b.h;
+		sector = ((uint32_t)cpu->hl.w << 16) | cpu->de.w;
+		count = cpu->bc.b.h;
+	}
+	if (drive != 0) {
+		cpu->af.b.h = ERR_IDRV;
+		return false;
+	}
+	if ((uint32_t)count * DISK_SECSIZE > 0x10000u - s->dta) {
+		cpu->af.b.h = 0xc9;			// .OV64K
+		return false;
+	}
+	updateDisk(s);
+	buf = malloc((size_t)count * DISK_SECSIZE + 1);
+	if (write) {
+		msx_readBlock(s->msx, s->dta, buf, count * DISK_SECSIZE);
+		ok = disk_write(&s->disk, sector, buf, count);
+	} else {
+		ok = disk_read(&s->disk, sector, buf, count);
+		if (ok) msx_writeBlock(s->msx, s->dta, buf, count * DISK_SECSIZE);
+	}
+	free(buf);
+	cpu->af.b.h = ok ? 0 : 0xf9;	// .RNF
+	return ok;
+}
+
+//-------------------------------------------------------------------
+// MSX-DOS 2 functions
+
+static uint8_t allocHandle(DosState *s)
+{
+	for (int h = 5; h < MAX_HANDLES; h++) {
+		if (s->handles[h].kind == HANDLE_CLOSED) return h;
+	}
+	return 0xff;
+}
+
+static uint8_t checkHandle(DosState *s, uint8_t h)
+{
+	if (h >= MAX_HANDLES) return ERR_IHAND;
+	if (s->handles[h].kind == HANDLE_CLOSED) return ERR_NOPEN;
+	return 0;
+}
+
+static void closeHandle(DosState *s, uint8_t h)
+{
+	DosHandle *dh = &s->handles[h];
+	if (dh->fd >= 0) close(dh->fd);
+	dh->fd = -1;
+	dh->kind = HANDLE_CLOSED;
+}
+
+static uint8_t openHostFile(DosState *s, const char *path, uint8_t mode, int flags, uint8_t *handle)
+{
+	uint8_t h = allocHandle(s);
+	DosHandle *dh;
+	int fd;
+
+	if (h == 0xff) return ERR_NHAND;
+	if (mode & OPEN_RDONLY) flags |= O_RDONLY;
+	else if (mode & OPEN_WRONLY) flags |= O_WRONLY;
+	else flags |= O_RDWR;
+	fd = open(path, flags, 0644);
+	if (fd < 0) return errno == EACCES ? ERR_FILRO : ERR_NOFIL;
+	dh = &s->handles[h];
+	dh->kind = HANDLE_FILE;
+	dh->mode = mode;
+	dh->fd = fd;
+	dh->eof = false;
+	snprintf(dh->path, sizeof(dh->path), "%s", path);
+	*handle = h;
+	return 0;
+}
+
+static bool deviceName(const char *path, uint8_t *kind)
+{
+	static const char *const names[] = { "CON", "NUL", "AUX", "PRN", "LST" };
+	const char *base = strrchr(path, '\\');
+	char name[9];
+	int i;
+
+	base = base ? base + 1 : (path[0] && path[1] == ':' ? path + 2 : path);
+	for (i = 0; i < 8 && base[i] && base[i] != '.'; i++) name[i] = toupper((unsigned char)base[i]);
+	name[i] = '\0';
+	for (i = 0; i < 5; i++) {
+		if (!strcmp(name, names[i])) {
+			*kind = i ? HANDLE_NUL : HANDLE_CON;
+			return true;
+		}
+	}
+	return false;
+}
+
+static uint8_t parsePath(DosState *s, uint16_t str, uint16_t *term, uint16_t *lastItem, uint8_t *flags, uint8_t *drive)
+{
+	uint16_t p = str, last;
+	uint8_t f = 0, c;
+	int nameLen = 0, extLen = 0;
+	bool dot = false;
+
+	*drive = 1;
+	if (msx_read(s->msx, p) && msx_read(s->msx, p + 1) == ':') {
+		c = toupper(msx_read(s->msx, p));
+		if (c < 'A' || c > 'H') return ERR_IDRV;
+		*drive = c - 'A' + 1;
+		f |= 0x04;
+		p += 2;
+	}
+	last = p;
+	for (;; p++) {
+		c = msx_read(s->msx, p);
+		if (c == '\\') {
+			f |= 0x02;
+			last = p + 1;
+			nameLen = extLen = 0;
+			dot = false;
+			continue;
+		}
+		if (c <= ' ' || strchr("\"+,/:;<=>[]|", c)) break;
+		if (c == '.' && !dot) dot = true;
+		else if (dot) extLen++;
+		else nameLen++;
+		if (c == '?' || c == '*') f |= 0x20;
+	}
+	if (p - str > MSX_PATHLEN) return ERR_PLONG;
+	if (p != str + ((f & 0x04) ? 2 : 0)) f |= 0x01;
+	if (p - last == 1 && msx_read(s->msx, last) == '.') {
+		f |= 0x40;
+	} else if (p - last == 2 && msx_read(s->msx, last) == '.' && msx_read(s->msx, last + 1) == '.') {
+		f |= 0xc0;
+	} else {
+		if (nameLen) f |= 0x08;
+		if (extLen) f |= 0x10;
+	}
+	*term = p;
+	*lastItem = last;
+	*flags = f;
+	return 0;
+}
+
+static void handleCall(DosState *s, uint8_t fn)
+{
+	Msx *msx = s->msx;
+	Z80 *cpu = &msx->cpu;
+	uint16_t de = cpu->de.w, hl = cpu->hl.w;
+	uint8_t b = cpu->bc.b.h;
+	char str[MSX_PATHLEN * 2], dir[4096], path[4096], last[MSX_PATHLEN * 2];
+	uint8_t err = 0;
+	HostEntry e;
+
+	switch (fn) {
+		case DPARM: {
+			uint8_t drive = cpu->hl.b.l;
+			if (!validDrive(s, drive)) {
+				err = ERR_IDRV;
+				break;
+			}
+			updateDisk(s);
+			msx_write(msx, de + 0, 1);
+			wr16(s, de + 1, DISK_SECSIZE);
+			msx_write(msx, de + 3, s->disk.secClus);
+			wr16(s, de + 4, s->disk.resvSec);
+			msx_write(msx, de + 6, s->disk.numFats);
+			wr16(s, de + 7, s->disk.rootNum);
+			wr16(s, de + 9, s->disk.sectors > 0xffff || msx->dos == DOS_NEXTOR ? 0 : s->disk.sectors);
+			msx_write(msx, de + 11, s->disk.media);
+			msx_write(msx, de + 12, s->disk.secFat);
+			wr16(s, de + 13, s->disk.rootSec);
+			wr16(s, de + 15, s->disk.dataSec);
+			wr16(s, de + 17, s->disk.maxClus);
+			msx_write(msx, de + 19, 0);
+			wr32(s, de + 20, 0xffffffff);
+			wr32(s, de + 24, msx->dos == DOS_NEXTOR ? s->disk.sectors : 0);
+			msx_write(msx, de + 28, msx->dos == DOS_NEXTOR ? s->disk.fat16 : 0);
+			for (int i = 29; i < 32; i++) msx_write(msx, de + i, 0);
+			break;
+		}
+		case FFIRST:
+		case FNEXT: {
+			uint16_t fib = cpu->ix.w;
+			char pattern[11];
+			uint8_t attr, search;
+			int index;
+			if (fn == FFIRST) {
+				attr = b;
+				if (msx_read(msx, de) == FIB_MAGIC) {
+					// Search inside the directory given by a FIB
+					if (!fibPath(s, de, dir)) {
+						err = ERR_NOFIL;
+						break;
+					}
+					readString(s, hl, last, sizeof(last));
+				} else {
+					readString(s, de, str, sizeof(str));
+					if ((err = resolvePath(s, str, dir, last))) break;
+				}
+				if (!last[0]) strcpy(last, "*.*");
+				if (!hostfs_toFcb(last, pattern, true)) {
+					err = ERR_IFNM;
+					break;
+				}
+				search = newSearch(s, dir);
+				index = 0;
+				msx_write(msx, fib, FIB_MAGIC);
+			} else {
+				if (msx_read(msx, fib + 41) != FIB_TAG) {
+					err = ERR_NOFIL;
+					break;
+				}
+				for (int i = 0; i < 11; i++) pattern[i] = msx_read(msx, fib + 26 + i);
+				attr = msx_read(msx, fib + 37);
+				index = rd16(s, fib + 38);
+				search = msx_read(msx, fib + 40) % MAX_SEARCHES;
+			}
+			if (attr & HOSTFS_ATTR_VOLUME) {
+				err = ERR_NOFIL;
+				break;
+			}
+			index = findEntry(s->searches[search].dir, pattern, attr, index, &e);
+			if (index < 0) {
+				err = ERR_NOFIL;
+				break;
+			}
+			fillFib(s, fib, &e, pattern, attr, index, search);
+			break;
+		}
+		case FNEW:
+		case CREATE: {
+			uint8_t attr = b, h = 0xff, kind;
+			bool createNew = attr & 0x80;
+			char fcb[11];
+			if (fn == FNEW) {
+				readString(s, msx_read(msx, de) == FIB_MAGIC ? hl : de, str, sizeof(str));
+			} else {
+				readString(s, de, str, sizeof(str));
+			}
+			if (fn == CREATE && deviceName(str, &kind)) {
+				if ((h = allocHandle(s)) == 0xff) {
+					err = ERR_NHAND;
+					break;
+				}
+				s->handles[h].kind = kind;
+				s->handles[h].mode = cpu->af.b.h;
+				cpu->bc.b.h = h;
+				break;
+			}
+			if ((err = resolvePath(s, str, dir, last))) break;
+			if (!hostfs_toFcb(last, fcb, false)) {
+				err = ERR_IFNM;
+				break;
+			}
+			if (findEntry(dir, fcb, 0xff, 0, &e) >= 0) {
+				if (e.attr & HOSTFS_ATTR_DIRECTORY) err = ERR_DIRX;
+				else if (createNew || (attr & HOSTFS_ATTR_DIRECTORY)) err = ERR_FILEX;
+				else if (e.attr & HOSTFS_ATTR_READONLY) err = ERR_FILRO;
+				else if (e.attr & HOSTFS_ATTR_SYSTEM) err = ERR_SYSX;
+				if (err) break;
+				hostPath(path, dir, e.host);
+			} else {
+				char name[13];
+				hostfs_fromFcb(fcb, name);
+				for (char *c = name; *c; c++) *c = tolower((unsigned char)*c);
+				hostPath(path, dir, name);
+			}
+			s->dirty = true;
+			if (attr & HOSTFS_ATTR_DIRECTORY) {
+				if (mkdir(path, 0755)) err = ERR_DKFUL;
+				cpu->bc.b.h = 0xff;
+			} else if (fn == FNEW) {
+				int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+				if (fd < 0) err = ERR_DKFUL;
+				else close(fd);
+			} else {
+				err = openHostFile(s, path, cpu->af.b.h, O_CREAT | O_TRUNC, &h);
+				cpu->bc.b.h = h;
+			}
+			if (!err) {
+				setAttributes(path, attr & (HOSTFS_ATTR_READONLY | HOSTFS_ATTR_ARCHIVE));
+				if (fn == FNEW) {
+					HostEntry ne;
+					if (findEntry(dir, fcb, 0xff, 0, &ne) >= 0) fillFib(s, cpu->ix.w, &ne, fcb, 0, 0, newSearch(s, dir));
+				}
+			}
+			break;
+		}
+		case OPEN: {
+			uint8_t h, kind;
+			if (msx_read(msx, de) != FIB_MAGIC) {
+				readString(s, de, str, sizeof(str));
+				if (deviceName(str, &kind)) {
+					if ((h = allocHandle(s)) == 0xff) {
+						err = ERR_NHAND;
+						break;
+					}
+					s->handles[h].kind = kind;
+					s->handles[h].mode = cpu->af.b.h;
+					cpu->bc.b.h = h;
+					break;
+				}
+			}
+			if ((err = objectPath(s, de, 0, path, &e))) break;
+			if (e.attr & HOSTFS_ATTR_DIRECTORY) {
+				err = ERR_NOFIL;
+				break;
+			}
+			if ((e.attr & HOSTFS_ATTR_READONLY) && !(cpu->af.b.h & OPEN_RDONLY)) {
+				err = ERR_FILRO;
+				break;
+			}
+			err = openHostFile(s, path, cpu->af.b.h, 0, &h);
+			if (!err) cpu->bc.b.h = h;
+			break;
+		}
+		case CLOSE:
+		case ENSURE:
+			if ((err = checkHandle(s, b))) break;
+			if (fn == CLOSE) closeHandle(s, b);
+			else if (s->handles[b].fd >= 0) fsync(s->handles[b].fd);
+			break;
+		case DUP: {
+			uint8_t h;
+			if ((err = checkHandle(s, b))) break;
+			if ((h = allocHandle(s)) == 0xff) {
+				err = ERR_NHAND;
+				break;
+			}
+			s->handles[h] = s->handles[b];
+			if (s->handles[b].fd >= 0) s->handles[h].fd = dup(s->handles[b].fd);
+			cpu->bc.b.h = h;
+			break;
+		}
+		case READ:
+		case WRITE: {
+			DosHandle *dh;
+			uint32_t count = hl;
+			uint8_t *buf;
+			ssize_t done = 0;
+			if ((err = checkHandle(s, b))) break;
+			dh = &s->handles[b];
+			if (fn == READ && (dh->mode & OPEN_WRONLY)) err = ERR_ACCV;
+			if (fn == WRITE && (dh->mode & OPEN_RDONLY)) err = ERR_ACCV;
+			if (err) break;
+			if (count > 0x10000u - de) {
+				err = 0xc9;				// .OV64K
+				break;
+			}
+			buf = malloc(count + 1);
+			if (dh->kind == HANDLE_FILE) {
+				if (fn == READ) {
+					done = read(dh->fd, buf, count);
+					if (done < 0) done = 0;
+					msx_writeBlock(msx, de, buf, done);
+				} else {
+					msx_readBlock(msx, de, buf, count);
+					done = write(dh->fd, buf, count);
+					if (done < 0) done = 0;
+					s->dirty = true;
+				}
+			} else if (dh->kind == HANDLE_CON) {
+				if (fn == READ) {
+					// A line of input, ended with CR LF
+					while ((uint32_t)done < count) {
+						int ch = msx_getKey(msx, true);
+						msx_write(msx, de + done++, ch);
+						if (ch != '\r') continue;
+						if ((uint32_t)done < count) msx_write(msx, de + done++, '\n');
+						break;
+					}
+				} else {
+					for (done = 0; (uint32_t)done < count; done++) msx_putc(msx, msx_read(msx, de + done));
+				}
+			} else if (fn == WRITE) {
+				done = count;
+			}
+			free(buf);
+			if (fn == READ && count && !done) err = ERR_EOF;
+			cpu->hl.w = done;
+			break;
+		}
+		case SEEK: {
+			DosHandle *dh;
+			int32_t offset = (int32_t)(((uint32_t)de << 16) | hl);
+			off_t pos;
+			if ((err = checkHandle(s, b))) break;
+			dh = &s->handles[b];
+			if (dh->fd < 0) {
+				cpu->de.w = cpu->hl.w = 0;
+				break;
+			}
+			// Method 0: from the start, 1: from the current position, else from the end
+			pos = lseek(dh->fd, offset, cpu->af.b.h == 0 ? SEEK_SET : (cpu->af.b.h == 1 ? SEEK_CUR : SEEK_END));
+			if (pos < 0) pos = lseek(dh->fd, 0, SEEK_CUR);
+			cpu->de.w = (uint32_t)pos >> 16;
+			cpu->hl.w = pos & 0xffff;
+			break;
+		}
+		case IOCTL: {
+			DosHandle *dh;
+			uint8_t sub = cpu->af.b.h;
+			if (sub == 4) {
+				// Screen size of the console: D = rows, E = columns
+				cpu->de.b.h = msx_read(msx, SV_CRTCNT);
+				cpu->de.b.l = msx_read(msx, SV_LINLEN);
+				break;
+			}
+			if ((err = checkHandle(s, b))) break;
+			dh = &s->handles[b];
+			switch (sub) {
+				case 0: {
+					uint16_t status;
+					if (dh->kind == HANDLE_FILE) {
+						off_t cur = lseek(dh->fd, 0, SEEK_CUR), end = lseek(dh->fd, 0, SEEK_END);
+						lseek(dh->fd, cur, SEEK_SET);
+						status = (cur >= end ? 0x40 : 0) | 0x00;		// Drive A:
+					} else {
+						status = 0x80 | 0x20 | (dh->kind == HANDLE_CON ? 0x03 : 0x0c);
+					}
+					cpu->de.w = status;
+					break;
+				}
+				case 1:
+					if (dh->kind == HANDLE_FILE) err = ERR_IDEV;
+					break;
+				case 2:
+				case 3:
+					cpu->af.b.l = 0;
+					cpu->de.b.l = 0xff;
+					break;
+				default:
+					err = ERR_ISBFN;
+					break;
+			}
+			break;
+		}
+		case HTEST:
+			if ((err = checkHandle(s, b))) break;
+			readString(s, de, str, sizeof(str));
+			cpu->bc.b.h = 0;
+			if (s->handles[b].kind == HANDLE_FILE && !lookupFile(s, str, 0xff, false, dir, &e)) {
+				hostPath(path, dir, e.host);
+				if (!strcmp(path, s->handles[b].path)) cpu->bc.b.h = 0xff;
+			}
+			break;
+		case DELETE:
+		case HDELETE:
+			if (fn == HDELETE) {
+				if ((err = checkHandle(s, b))) break;
+				strcpy(path, s->handles[b].path);
+				e.attr = 0;
+			} else if ((err = objectPath(s, de, 0xff & ~HOSTFS_ATTR_VOLUME, path, &e))) {
+				break;
+			}
+			if (e.attr & HOSTFS_ATTR_READONLY) {
+				err = ERR_FILRO;
+				break;
+			}
+			if (e.attr & HOSTFS_ATTR_DIRECTORY) {
+				if (rmdir(path)) err = ERR_DIRNE;
+			} else if (unlink(path)) {
+				err = ERR_NOFIL;
+			}
+			if (!err) s->dirty = true;
+			break;
+		case RENAME:
+		case HRENAME:
+		case MOVE:
+		case HMOVE: {
+			char to[MSX_PATHLEN * 2], dst[4096], toDir[4096], fcb[11];
+			if (fn == HRENAME || fn == HMOVE) {
+				if ((err = checkHandle(s, b))) break;
+				strcpy(path, s->handles[b].path);
+			} else if ((err = objectPath(s, de, HOSTFS_ATTR_DIRECTORY | HOSTFS_ATTR_HIDDEN | HOSTFS_ATTR_SYSTEM, path, NULL))) {
+				break;
+			}
+			readString(s, hl, to, sizeof(to));
+			if (fn == RENAME || fn == HRENAME) {
+				char *sep = strrchr(path, '/');
+				if (!hostfs_toFcb(to, fcb, false)) {
+					err = ERR_IFNM;
+					break;
+				}
+				*sep = '\0';
+				strcpy(toDir, path);
+				*sep = '/';
+			} else {
+				const char *base = strrchr(path, '/') + 1;
+				strcat(to, "\\");
+				if ((err = resolvePath(s, to, toDir, last))) break;
+				if (!hostfs_toFcb(base, fcb, false)) {
+					err = ERR_IFNM;
+					break;
+				}
+			}
+			if (findEntry(toDir, fcb, 0xff, 0, &e) >= 0) {
+				err = ERR_DUPF;
+				break;
+			}
+			hostfs_fromFcb(fcb, last);
+			for (char *c = last; *c; c++) *c = tolower((unsigned char)*c);
+			hostPath(dst, toDir, last);
+			if (rename(path, dst)) err = ERR_NOFIL;
+			else s->dirty = true;
+			break;
+		}
+		case ATTR:
+		case HATTR:
+			if (fn == HATTR) {
+				if ((err = checkHandle(s, b))) break;
+				if (s->handles[b].kind != HANDLE_FILE) {
+					err = ERR_IDEV;
+					break;
+				}
+				strcpy(path, s->handles[b].path);
+				{
+					struct stat st;
+					stat(path, &st);
+					e.attr = ((st.st_mode & S_IWUSR) ? 0 : HOSTFS_ATTR_READONLY) | ((st.st_mode & S_IXUSR) ? HOSTFS_ATTR_ARCHIVE : 0);
+				}
+			} else if ((err = objectPath(s, de, HOSTFS_ATTR_DIRECTORY | HOSTFS_ATTR_HIDDEN | HOSTFS_ATTR_SYSTEM, path, &e))) {
+				break;
+			}
+			if (cpu->af.b.h) {
+				if ((cpu->hl.b.l ^ e.attr) & HOSTFS_ATTR_DIRECTORY) {
+					err = ERR_IATTR;
+					break;
+				}
+				setAttributes(path, cpu->hl.b.l);
+				e.attr = (e.attr & HOSTFS_ATTR_DIRECTORY) | (cpu->hl.b.l & (HOSTFS_ATTR_READONLY | HOSTFS_ATTR_ARCHIVE));
+				s->dirty = true;
+			}
+			cpu->hl.b.l = e.attr;
+			break;
+		case FTIME:
+		case HFTIME:
+			if (fn == HFTIME) {
+				struct stat st;
+				if ((err = checkHandle(s, b))) break;
+				if (s->handles[b].kind != HANDLE_FILE || fstat(s->handles[b].fd, &st)) {
+					err = ERR_IDEV;
+					break;
+				}
+				e.mtime = st.st_mtime;
+			} else if ((err = objectPath(s, de, 0, path, &e))) {
+				break;
+			}
+			if (!cpu->af.b.h) {
+				cpu->de.w = hostfs_dosTime(e.mtime);
+				cpu->hl.w = hostfs_dosDate(e.mtime);
+			}
+			break;
+		case GETDTA:
+			cpu->de.w = s->dta;
+			break;
+		case GETVFY:
+			cpu->bc.b.h = 0;
+			break;
+		case GETCD:
+			writeString(s, de, "");
+			if (!validDrive(s, b)) {
+				err = ERR_IDRV;
+				break;
+			}
+			writeString(s, de, s->cwd);
+			break;
+		case CHDIR: {
+			char cwd[MSX_PATHLEN * 2], *item, *next;
+			readString(s, de, str, sizeof(str));
+			strcat(str, "\\");
+			if ((err = resolvePath(s, str, dir, last))) break;
+			// Keep the MSX form of the new directory
+			{
+				const char *p = str[0] && str[1] == ':' ? str + 2 : str;
+				if (*p == '\\') cwd[0] = '\0';
+				else strcpy(cwd, s->cwd);
+				for (item = (char*)p; (next = strchr(item, '\\')); item = next + 1) {
+					*next = '\0';
+					if (!*item || !strcmp(item, ".")) continue;
+					if (!strcmp(item, "..")) {
+						char *sep = strrchr(cwd, '\\');
+						if (sep) *sep = '\0';
+						else cwd[0] = '\0';
+						continue;
+					}
+					if (strlen(cwd) + strlen(item) + 2 >= MSX_PATHLEN) {
+						err = ERR_PLONG;
+						break;
+					}
+					if (cwd[0]) strcat(cwd, "\\");
+					for (char *c = item; *c; c++) *c = toupper((unsigned char)*c);
+					strcat(cwd, item);
+				}
+			}
+			if (!err) strcpy(s->cwd, cwd);
+			break;
+		}
+		case PARSE: {
+			uint16_t term, lastItem;
+			uint8_t flags, drive;
+			if ((err = parsePath(s, de, &term, &lastItem, &flags, &drive))) break;
+			cpu->de.w = term;
+			cpu->hl.w = lastItem;
+			cpu->bc.b.h = flags;
+			cpu->bc.b.l = drive;
+			break;
+		}
+		case PFILE: {
+			uint16_t p = de;
+			char name[MSX_PATHLEN], fcb[11];
+			uint8_t flags = 0;
+			int i = 0;
+			while (i < MSX_PATHLEN - 1) {
+				uint8_t c = msx_read(msx, p);
+				if (c <= ' ' || strchr("\"+,/:;<=>[\\]|", c)) break;
+				name[i++] = c;
+				p++;
+			}
+			name[i] = '\0';
+			memset(fcb, ' ', 11);
+			if (i && !hostfs_toFcb(name, fcb, true)) memset(fcb, ' ', 11);
+			for (i = 0; i < 11; i++) msx_write(msx, hl + i, fcb[i]);
+			if (fcb[0] != ' ') flags |= 0x09;
+			if (fcb[8] != ' ') flags |= 0x11;
+			if (memchr(fcb, '?', 11)) flags |= 0x20;
+			if (!strcmp(name, ".") || !strcmp(name, "..")) flags |= 0x40 | (name[1] ? 0x80 : 0);
+			cpu->de.w = p;
+			cpu->bc.b.h = flags;
+			break;
+		}
+		case CHKCHR:
+			cpu->de.b.l = toupper(cpu->de.b.l);
+			break;
+		case WPATH:
+			writeString(s, de, s->cwd);
+			cpu->hl.w = de + strlen(s->cwd);
+			break;
+		case FLUSH:
+			for (int h = 5; h < MAX_HANDLES; h++) {
+				if (s->handles[h].fd >= 0) fsync(s->handles[h].fd);
+			}
+			break;
+		case FORK:
+			cpu->bc.b.h = 1;
+			break;
+		case JOIN:
+			cpu->bc.b.h = 0;
+			cpu->bc.b.l = 0;
+			break;
+		case TERM:
+			msx->finished = true;
+			msx->exitCode = b;
+			return;
+		case DEFAB:
+			s->abortRoutine = de;
+			break;
+		case DEFER:
+			break;
+		case ERROR:
+			cpu->bc.b.h = s->lastError;
+			break;
+		case EXPLAIN: {
+			const char *msg = NULL;
+			char buf[MSX_PATHLEN];
+			for (size_t i = 0; i < sizeof(messages) / sizeof(messages[0]); i++) {
+				if (messages[i].code == b) msg = messages[i].msg;
+			}
+			if (msg) {
+				cpu->bc.b.h = 0;
+			} else {
+				snprintf(buf, sizeof(buf), "%s error %u", b >= 0x40 ? "System" : "User", b);
+				msg = buf;
+			}
+			writeString(s, de, msg);
+			break;
+		}
+		case FORMAT:
+			err = ERR_IFORM;
+			break;
+		case RAMD:
+			if (b == 0xff) cpu->bc.b.h = 0;
+			else err = b ? ERR_NORAM : 0xbb;	// .NRAMD
+			break;
+		case BUFFER:
+			cpu->bc.b.h = 10;
+			break;
+		case ASSIGN:
+			if (!cpu->de.b.h && b) cpu->de.b.h = b;
+			break;
+		case GENV:
+		case FENV: {
+			const char *value = NULL;
+			char name[256];
+			uint8_t size = b;
+			if (fn == GENV) {
+				readString(s, hl, name, sizeof(name));
+				for (char *c = name; *c; c++) {
+					if ((unsigned char)*c <= ' ' || strchr("\"+,/:;<=>[\\]|", *c)) err = ERR_IENV;
+					*c = toupper((unsigned char)*c);
+				}
+				if (err || !name[0]) {
+					err = ERR_IENV;
+					break;
+				}
+				value = getEnv(s, name);
+			} else {
+				int n = cpu->de.b.h;
+				value = "";
+				for (int i = 0; i < MAX_ENV && n; i++) {
+					if (s->env[i].name[0] && !--n) value = s->env[i].name;
+				}
+				de = hl;
+			}
+			// The buffer size is a byte: 256 wraps to 0
+			if (strlen(value) + 1 > size) {
+				for (uint8_t i = 0; i < size; i++) msx_write(msx, de + i, value[i]);
+				err = ERR_ELONG;
+				break;
+			}
+			writeString(s, de, value);
+			break;
+		}
+		case SENV: {
+			char name[256], value[256];
+			readString(s, hl, name, sizeof(name));
+			readString(s, de, value, sizeof(value));
+			for (char *c = name; *c; c++) {
+				if ((unsigned char)*c <= ' ' || strchr("\"+,/:;<=>[\\]|", *c)) err = ERR_IENV;
+				*c = toupper((unsigned char)*c);
+			}
+			if (err || !name[0]) {
+				err = ERR_IENV;
+				break;
+			}
+			setEnv(s, name, value);
+			break;
+		}
+		case DSKCHK:
+			if (!cpu->af.b.h) cpu->bc.b.h = 0;
+			break;
+		case DOSVER:
+			cpu->bc.w = 0x0231;
+			cpu->de.w = 0x0231;
+			if (msx->dos == DOS_NEXTOR) {
+				// Nextor answers the magic numbers with IXh=1, IXl.IYh = its version (2.1)
+				cpu->ix.w = 0x0102;
+				cpu->iy.w = 0x0100;
+			}
+			break;
+		case REDIR:
+			if (!cpu->af.b.h) cpu->bc.b.h = 0;
+			break;
+		default:
+			err = ERR_IBDOS;
+			break;
+	}
+	cpu->af.b.h = err;
+}
+
+//-------------------------------------------------------------------
+// Nextor functions
+
+static void nextorCall(DosState *s, uint8_t fn)
+{
+	Msx *msx = s->msx;
+	Z80 *cpu = &msx->cpu;
+	uint16_t hl = cpu->hl.w;
+	uint8_t err = 0;
+
+	switch (fn) {
+		case FOUT:
+			if (cpu->af.b.h) s->fastOut = cpu->bc.b.h;
+			else cpu->bc.b.h = s->fastOut;
+			break;
+		case ZSTROUT:
+			putStr(s, cpu->de.w, '\0');
+			break;
+		case RDDRV:
+		case WRDRV:
+			sectorCall(s, fn);
+			return;
+		case RALLOC:
+			if (!cpu->af.b.h) cpu->hl.w = 0;
+			break;
+		case DSPACE: {
+			uint32_t clusters = 0, kb;
+			if (!validDrive(s, cpu->de.b.l)) {
+				err = ERR_IDRV;
+				break;
+			}
+			updateDisk(s);
+			for (uint32_t c = 2; c <= s->disk.maxClus; c++) {
+				if (cpu->af.b.h || !disk_getFat(&s->disk, c)) clusters++;
+			}
+			kb = clusters * s->disk.secClus / 2;
+			cpu->hl.w = kb & 0xffff;
+			cpu->de.w = kb >> 16;
+			cpu->bc.w = 0;
+			break;
+		}
+		case LOCK:
+			if (!validDrive(s, cpu->de.b.l)) err = ERR_IDRV;
+			else if (cpu->af.b.h) s->lock = cpu->bc.b.h;
+			else cpu->bc.b.h = s->lock;
+			break;
+		case GDLI: {
+			uint8_t drive = cpu->af.b.h;
+			for (int i = 0; i < 64; i++) msx_write(msx, hl + i, 0);
+			if (drive > 7) {
+				err = ERR_IDRV;
+				break;
+			}
+			if (drive != 0) break;			// Unassigned
+			updateDisk(s);
+			msx_write(msx, hl + 0, 1);		// Assigned to a device-based driver
+			msx_write(msx, hl + 1, 1);		// Driver slot
+			msx_write(msx, hl + 2, 0xff);
+			msx_write(msx, hl + 3, 0xff);
+			msx_write(msx, hl + 4, 1);		// Device 1, LUN 1
+			msx_write(msx, hl + 5, 1);
+			wr32(s, hl + 6, s->disk.partStart);
+			break;
+		}
+		case GETCLUS: {
+			uint32_t cluster = cpu->de.w;
+			uint32_t entry, value;
+			uint8_t flags;
+			if (!validDrive(s, cpu->af.b.h)) {
+				err = ERR_IDRV;
+				break;
+			}
+			updateDisk(s);
+			if (cluster < 2 || cluster > s->disk.maxClus) {
+				err = ERR_ICLUS;
+				break;
+			}
+			entry = s->disk.fat16 ? cluster * 2 : cluster * 3 / 2;
+			value = disk_getFat(&s->disk, cluster);
+			flags = s->disk.fat16 ? 0x02 : 0x01;
+			if (!s->disk.fat16 && (cluster & 1)) flags |= 0x04;
+			if (value >= (s->disk.fat16 ? 0xfff8u : 0xff8u)) flags |= 0x08;
+			if (!value) flags |= 0x10;
+			wr16(s, hl + 0, s->disk.resvSec + entry / DISK_SECSIZE);
+			wr16(s, hl + 2, entry % DISK_SECSIZE);
+			wr32(s, hl + 4, s->disk.dataSec + (cluster - 2) * s->disk.secClus);
+			wr16(s, hl + 8, value);
+			msx_write(msx, hl + 10, s->disk.secClus);
+			msx_write(msx, hl + 11, flags);
+			wr32(s, hl + 12, 0);
+			break;
+		}
+		default:
+			// GDRVR, GPART, CDRVR, MAPDRV, Z80MODE: there are no drivers to talk to
+			err = ERR_IBDOS;
+			break;
+	}
+	cpu->af.b.h = err;
+}
@@ -0,0 +1,934 @@
+/*
+ * Z80 CPU core for the host-side runner.
+ *
+ * Covers the documented and undocumented instruction set (IXh/IXl, SLL,
+ * DDCB copies to registers, X/Y flags) and counts T-states per instruction.
+ * Every M1 cycle (opcode and prefix fetches, interrupt acknowledge) gets
+ * m1Wait extra T-states, as the MSX inserts one wait state there.
+ */
+#include "z80.h"
+
+
+#define FC	Z80_FLAG_C
+#define FN	Z80_FLAG_N
+#define FP	Z80_FLAG_P
+#define FX	Z80_FLAG_X
+#define FH	Z80_FLAG_H
+#define FY	Z80_FLAG_Y
+#define FZ	Z80_FLAG_Z
+#define FS	Z80_FLAG_S
+#define FXY	(FX | FY)
+
+#define A	cpu->af.b.h
+#define F	cpu->af.b.l
+#define B	cpu->bc.b.h
+#define C	cpu->bc.b.l
+#define D	cpu->de.b.h
+#define E	cpu->de.b.l
+#define H	cpu->hl.b.h
+#define L	cpu->hl.b.l
+#define AF	cpu->af.w
+#define BC	cpu->bc.w
+#define DE	cpu->de.w
+#define HL	cpu->hl.w
+#define PC	cpu->pc
+#define SP	cpu->sp
+#define WZ	cpu->wz
+
+//###################################################################
+// Variables & Func.Definitions
+
+static uint8_t sz53[256];		// S, Z, X and Y flags of a result
+static uint8_t sz53p[256];		// Same plus the parity flag
+static bool    tablesReady;
+
+// T-states of the unprefixed opcodes, without the M1 wait states and
+// without the extra cycles of the taken conditional branches
+static const uint8_t cyclesMain[256] = {
+	 4,10, 7, 6, 4, 4, 7, 4, 4,11, 7, 6, 4, 4, 7, 4,
+	 8,10, 7, 6, 4, 4, 7, 4,12,11, 7, 6, 4, 4, 7, 4,
+	 7,10,16, 6, 4, 4, 7, 4, 7,11,16, 6, 4, 4, 7, 4,
+	 7,10,13, 6,11,11,10, 4, 7,11,13, 6, 4, 4, 7, 4,
+	 4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+	 4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+	 4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+	 7, 7, 7, 7, 7, 7, 4, 7, 4, 4, 4, 4, 4, 4, 7, 4,
+	 4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+	 4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+	 4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+	 4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+	 5,10,10,10,10,11, 7,11, 5,10,10, 0,10,17, 7,11,
+	 5,10,10,11,10,11, 7,11, 5, 4,10,11,10, 0, 7,11,
+	 5,10,10,19,10,11, 7,11, 5, 4,10, 4,10, 0, 7,11,
+	 5,10,10, 4,10,11, 7,11, 5, 6,10, 4,10, 0, 7,11
+};
+
+static void initTables(void);
+static uint32_t execMain(Z80 *cpu, uint8_t op, Z80Pair *xy);
+static uint32_t execCB(Z80 *cpu);
+static uint32_t execIndexCB(Z80 *cpu, Z80Pair *xy);
+static uint32_t execED(Z80 *cpu);
+static uint32_t acceptIrq(Z80 *cpu);
+
+//###################################################################
+// Bus helpers
+
+static inline uint8_t rd(Z80 *cpu, uint16_t addr)
+{
+	return cpu->bus.read(cpu->ctx, addr);
+}
+
+static inline void wr(Z80 *cpu, uint16_t addr, uint8_t value)
+{
+	cpu->bus.write(cpu->ctx, addr, value);
+}
+
+static inline uint16_t rd16(Z80 *cpu, uint16_t addr)
+{
+	return rd(cpu, addr) | (rd(cpu, addr + 1) << 8);
+}
+
+static inline void wr16(Z80 *cpu, uint16_t addr, uint16_t value)
+{
+	wr(cpu, addr, value & 0xff);
+	wr(cpu, addr + 1, value >> 8);
+}
+
+static inline uint8_t fetch(Z80 *cpu)
+{
+	return rd(cpu, PC++);
+}
+
+static inline uint16_t fetch16(Z80 *cpu)
+{
+	uint16_t v = rd16(cpu, PC);
+	PC += 2;
+	return v;
+}
+
+static inline uint8_t fetchM1(Z80 *cpu)
+{
+	cpu->r++;
+	return rd(cpu, PC++);
+}
+
+//###################################################################
+// Public Functions
+
+/**
+ * z80_init
+ * Sets up the bus callbacks and resets the CPU.
+ *
+ * @param cpu CPU to initialize.
+ * @param bus Memory, I/O and trap callbacks.
+ * @param ctx Context passed to every callback.
+ */
+void z80_init(Z80 *cpu, const Z80Bus *bus, void *ctx)
+{
+	if (!tablesReady) initTables();
+	cpu->bus = *bus;
+	cpu->ctx = ctx;
+	cpu->m1Wait = 0;
+	cpu->cycles = 0;
+	z80_reset(cpu);
+}
+
+/**
+ * z80_reset
+ * Puts the CPU in the power-on state. The cycle counter is kept.
+ */
+void z80_reset(Z80 *cpu)
+{
+	AF = SP = 0xffff;
+	BC = DE = HL = 0xffff;
+	cpu->af_.w = cpu->bc_.w = cpu->de_.w = cpu->hl_.w = 0xffff;
+	cpu->ix.w = cpu->iy.w = 0xffff;
+	PC = WZ = 0;
+	cpu->i = cpu->r = cpu->r7 = 0;
+	cpu->iff1 = cpu->iff2 = cpu->im = 0;
+	cpu->halted = cpu->eiDelay = cpu->irq = cpu->stop = false;
+}
+
+/**
+ * z80_step
+ * Executes one instruction, or accepts a pending interrupt.
+ *
+ * @return T-states spent.
+ */
+uint32_t z80_step(Z80 *cpu)
+{
+	uint32_t t;
+
+	if (cpu->irq && cpu->iff1 && !cpu->eiDelay) {
+		t = acceptIrq(cpu);
+	} else {
+		cpu->eiDelay = false;
+		if (cpu->halted) {
+			cpu->r++;
+			t = 4 + cpu->m1Wait;
+		} else {
+			t = execMain(cpu, fetchM1(cpu), &cpu->hl) + cpu->m1Wait;
+		}
+	}
+	cpu->cycles += t;
+	return t;
+}
+
+/**
+ * z80_run
+ * Executes instructions until the given T-states are spent or a trap
+ * asks to stop.
+ *
+ * @param cycles Count of T-states to run.
+ * @return T-states actually spent.
+ */
+uint64_t z80_run(Z80 *cpu, uint64_t cycles)
+{
+	uint64_t start = cpu->cycles;
+	uint64_t end = start + cycles;
+
+	cpu->stop = false;
+	while (cpu->cycles < end && !cpu->stop) {
+		z80_step(cpu);
+	}
+	return cpu->cycles - start;
+}
+
+/**
+ * z80_getR
+ * @return Current value of the R register.
+ */
+uint8_t z80_getR(const Z80 *cpu)
+{
+	return (cpu->r & 0x7f) | cpu->r7;
+}
+
+void z80_push(Z80 *cpu, uint16_t value)
+{
+	SP -= 2;
+	wr16(cpu, SP, value);
+}
+
+uint16_t z80_pop(Z80 *cpu)
+{
+	uint16_t v = rd16(cpu, SP);
+	SP += 2;
+	return v;
+}
+
+/**
+ * z80_ret
+ * Returns from the current subroutine, for traps that replace one.
+ */
+void z80_ret(Z80 *cpu)
+{
+	PC = WZ = z80_pop(cpu);
+}
+
+
+//###################################################################
+// Private Functions
+
+static void initTables(void)
+{
+	for (int i = 0; i < 256; i++) {
+		uint8_t p = i;
+		p ^= p >> 4;
+		p ^= p >> 2;
+		p ^= p >> 1;
+		sz53[i] = (i & (FS | FXY)) | (i ? 0 : FZ);
+		sz53p[i] = sz53[i] | ((p & 1) ? 0 : FP);
+	}
+	tablesReady = true;
+}
+
+static uint32_t acceptIrq(Z80 *cpu)
+{
+	uint32_t t;
+
+	cpu->halted = false;
+	cpu->iff1 = cpu->iff2 = 0;
+	cpu->r++;
+	z80_push(cpu, PC);
+	if (cpu->im == 2) {
+		PC = rd16(cpu, (cpu->i << 8) | 0xff);	// Data bus floats to FFh
+		t = 19;
+	} else {
+		PC = 0x0038;							// IM 0 executes RST 38h
+		t = 13;
+	}
+	WZ = PC;
+	return t + cpu->m1Wait;
+}
+
+//-------------------------------------------------------------------
+// ALU
+
+static inline void add8(Z80 *cpu, uint8_t v, uint8_t carry)
+{
+	uint16_t r = A + v + carry;
+	F = sz53[r & 0xff] | ((A ^ v ^ r) & FH) | ((r >> 8) & FC) |
+		(((A ^ ~v) & (A ^ r) & 0x80) >> 5);
+	A = r;
+}
+
+static inline void sub8(Z80 *cpu, uint8_t v, uint8_t carry)
+{
+	uint16_t r = A - v - carry;
+	F = sz53[r & 0xff] | FN | ((A ^ v ^ r) & FH) | ((r >> 8) & FC) |
+		(((A ^ v) & (A ^ r) & 0x80) >> 5);
+	A = r;
+}
+
+static inline void cp8(Z80 *cpu, uint8_t v)
+{
+	uint16_t r = A - v;
+	F = (sz53[r & 0xff] & ~FXY) | (v & FXY) | FN | ((A ^ v ^ r) & FH) |
+		((r >> 8) & FC) | (((A ^ v) & (A ^ r) & 0x80) >> 5);
+}
+
+static inline void alu(Z80 *cpu, uint8_t op, uint8_t v)
+{
+	switch (op) {
+		case 0: add8(cpu, v, 0); break;
+		case 1: add8(cpu, v, F & FC); break;
+		case 2: sub8(cpu, v, 0); break;
+		case 3: sub8(cpu, v, F & FC); break;
+		case 4: A &= v; F = sz53p[A] | FH; break;
+		case 5: A ^= v; F = sz53p[A]; break;
+		case 6: A |= v; F = sz53p[A]; break;
+		case 7: cp8(cpu, v); break;
+	}
+}
+
+static inline uint8_t inc8(Z80 *cpu, uint8_t v)
+{
+	uint8_t r = v + 1;
+	F = (F & FC) | sz53[r] | ((r & 0x0f) ? 0 : FH) | (r == 0x80 ? FP : 0);
+	return r;
+}
+
+static inline uint8_t dec8(Z80 *cpu, uint8_t v)
+{
+	uint8_t r = v - 1;
+	F = (F & FC) | FN | sz53[r] | ((v & 0x0f) ? 0 : FH) | (r == 0x7f ? FP : 0);
+	return r;
+}
+
+static inline uint16_t add16(Z80 *cpu, uint16_t a, uint16_t v)
+{
+	uint32_t r = a + v;
+	WZ = a + 1;
+	F = (F & (FS | FZ | FP)) | ((r >> 8) & FXY) | (((a ^ v ^ r) >> 8) & FH) | ((r >> 16) & FC);
+	return r;
+}
+
+static inline void adc16(Z80 *cpu, uint16_t v)
+{
+	uint32_t r = HL + v + (F & FC);
+	WZ = HL + 1;
+	F = ((r >> 8) & (FS | FXY)) | ((r & 0xffff) ? 0 : FZ) | (((HL ^ v ^ r) >> 8) & FH) |
+		((r >> 16) & FC) | (((HL ^ ~v) & (HL ^ r) & 0x8000) >> 13);
+	HL = r;
+}
+
+static inline void sbc16(Z80 *cpu, uint16_t v)
+{
+	uint32_t r = HL - v - (F & FC);
+	WZ = HL + 1;
+	F = FN | ((r >> 8) & (FS | FXY)) | ((r & 0xffff) ? 0 : FZ) | (((HL ^ v ^ r) >> 8) & FH) |
+		((r >> 16) & FC) | (((HL ^ v) & (HL ^ r) & 0x8000) >> 13);
+	HL = r;
+}
+
+static inline uint8_t rot(Z80 *cpu, uint8_t op, uint8_t v)
+{
+	uint8_t r, c;
+
+	switch (op) {
+		case 0:  r = (v << 1) | (v >> 7); c = v >> 7; break;			// RLC
+		case 1:  r = (v >> 1) | (v << 7); c = v & 1; break;			// RRC
+		case 2:  r = (v << 1) | (F & FC); c = v >> 7; break;			// RL
+		case 3:  r = (v >> 1) | ((F & FC) << 7); c = v & 1; break;	// RR
+		case 4:  r = v << 1; c = v >> 7; break;						// SLA
+		case 5:  r = (v >> 1) | (v & 0x80); c = v & 1; break;			// SRA
+		case 6:  r = (v << 1) | 1; c = v >> 7; break;					// SLL
+		default: r = v >> 1; c = v & 1; break;						// SRL
+	}
+	F = sz53p[r] | c;
+	return r;
+}
+
+static inline void bitTest(Z80 *cpu, uint8_t n, uint8_t v, uint8_t xy)
+{
+	F = (F & FC) | FH | (sz53p[v & (1 << n)] & ~FXY) | (xy & FXY);
+}
+
+static inline bool cond(Z80 *cpu, uint8_t cc)
+{
+	switch (cc) {
+		case 0: return !(F & FZ);
+		case 1: return F & FZ;
+		case 2: return !(F & FC);
+		case 3: return F & FC;
+		case 4: return !(F & FP);
+		case 5: return F & FP;
+		case 6: return !(F & FS);
+		default: return F & FS;
+	}
+}
+
+//-------------------------------------------------------------------
+// Register decoding
+
+// r: 0=B 1=C 2=D 3=E 4=H 5=L 7=A; H/L are IXh/IXl when xy is an index register
+static inline uint8_t getR(Z80 *cpu, uint8_t r, Z80Pair *xy)
+{
+	switch (r) {
+		case 0: return B;
+		case 1: return C;
+		case 2: return D;
+		case 3: return E;
+		case 4: return xy->b.h;
+		case 5: return xy->b.l;
+		default: return A;
+	}
+}
+
+static inline void setR(Z80 *cpu, uint8_t r, Z80Pair *xy, uint8_t v)
+{
+	switch (r) {
+		case 0: B = v; break;
+		case 1: C = v; break;
+		case 2: D = v; break;
+		case 3: E = v; break;
+		case 4: xy->b.h = v; break;
+		case 5: xy->b.l = v; break;
+		default: A = v; break;
+	}
+}
+
+// rp: 0=BC 1=DE 2=HL/IX/IY 3=SP
+static inline uint16_t getRP(Z80 *cpu, uint8_t rp, Z80Pair *xy)
+{
+	switch (rp) {
+		case 0: return BC;
+		case 1: return DE;
+		case 2: return xy->w;
+		default: return SP;
+	}
+}
+
+static inline void setRP(Z80 *cpu, uint8_t rp, Z80Pair *xy, uint16_t v)
+{
+	switch (rp) {
+		case 0: BC = v; break;
+		case 1: DE = v; break;
+		case 2: xy->w = v; break;
+		default: SP = v; break;
+	}
+}
+
+// rp2: as rp, but 3=AF
+static inline uint16_t getRP2(Z80 *cpu, uint8_t rp, Z80Pair *xy)
+{
+	return rp == 3 ? AF : getRP(cpu, rp, xy);
+}
+
+static inline void setRP2(Z80 *cpu, uint8_t rp, Z80Pair *xy, uint16_t v)
+{
+	if (rp == 3) AF = v; else setRP(cpu, rp, xy, v);
+}
+
+// Address of the (HL) operand, (IX+d)/(IY+d) when prefixed
+static inline uint16_t memOperand(Z80 *cpu, Z80Pair *xy)
+{
+	if (xy == &cpu->hl) return HL;
+	WZ = xy->w + (int8_t)fetch(cpu);
+	return WZ;
+}
+
+//-------------------------------------------------------------------
+// Opcodes
+
+static uint32_t execMain(Z80 *cpu, uint8_t op, Z80Pair *xy)
+{
+	uint32_t t = cyclesMain[op];
+	bool indexed = xy != &cpu->hl;
+	uint8_t x = op >> 6, y = (op >> 3) & 7, z = op & 7;
+	uint8_t p = y >> 1;
+	uint16_t addr, v16;
+	uint8_t v;
+
+	// LD r,r' / LD r,(HL) / LD (HL),r / HALT
+	if (x == 1) {
+		if (op == 0x76) {
+			cpu->halted = true;
+			return t;
+		}
+		if (z == 6) {
+			addr = memOperand(cpu, xy);
+			if (indexed) t += 8;
+			setR(cpu, y, &cpu->hl, rd(cpu, addr));
+		} else if (y == 6) {
+			addr = memOperand(cpu, xy);
+			if (indexed) t += 8;
+			wr(cpu, addr, getR(cpu, z, &cpu->hl));
+		} else {
+			setR(cpu, y, xy, getR(cpu, z, xy));
+		}
+		return t;
+	}
+
+	// ALU A,r / ALU A,(HL)
+	if (x == 2) {
+		if (z == 6) {
+			addr = memOperand(cpu, xy);
+			if (indexed) t += 8;
+			v = rd(cpu, addr);
+		} else {
+			v = getR(cpu, z, xy);
+		}
+		alu(cpu, y, v);
+		return t;
+	}
+
+	switch (op) {
+		case 0x00:									// NOP
+			break;
+		case 0x08: {								// EX AF,AF'
+			uint16_t tmp = AF; AF = cpu->af_.w; cpu->af_.w = tmp;
+			break;
+		}
+		case 0x10:									// DJNZ e
+			v = fetch(cpu);
+			if (--B) {
+				PC = WZ = PC + (int8_t)v;
+				t += 5;
+			}
+			break;
+		case 0x18:									// JR e
+			v = fetch(cpu);
+			PC = WZ = PC + (int8_t)v;
+			break;
+		case 0x20: case 0x28: case 0x30: case 0x38:	// JR cc,e
+			v = fetch(cpu);
+			if (cond(cpu, y - 4)) {
+				PC = WZ = PC + (int8_t)v;
+				t += 5;
+			}
+			break;
+		case 0x01: case 0x11: case 0x21: case 0x31:	// LD rr,nn
+			setRP(cpu, p, xy, fetch16(cpu));
+			break;
+		case 0x09: case 0x19: case 0x29: case 0x39:	// ADD HL,rr
+			xy->w = add16(cpu, xy->w, getRP(cpu, p, xy));
+			break;
+		case 0x02:									// LD (BC),A
+			wr(cpu, BC, A);
+			WZ = ((BC + 1) & 0xff) | (A << 8);
+			break;
+		case 0x12:									// LD (DE),A
+			wr(cpu, DE, A);
+			WZ = ((DE + 1) & 0xff) | (A << 8);
+			break;
+		case 0x22:									// LD (nn),HL
+			addr = fetch16(cpu);
+			wr16(cpu, addr, xy->w);
+			WZ = addr + 1;
+			break;
+		case 0x32:									// LD (nn),A
+			addr = fetch16(cpu);
+			wr(cpu, addr, A);
+			WZ = ((addr + 1) & 0xff) | (A << 8);
+			break;
+		case 0x0a:									// LD A,(BC)
+			A = rd(cpu, BC);
+			WZ = BC + 1;
+			break;
+		case 0x1a:									// LD A,(DE)
+			A = rd(cpu, DE);
+			WZ = DE + 1;
+			break;
+		case 0x2a:									// LD HL,(nn)
+			addr = fetch16(cpu);
+			xy->w = rd16(cpu, addr);
+			WZ = addr + 1;
+			break;
+		case 0x3a:									// LD A,(nn)
+			addr = fetch16(cpu);
+			A = rd(cpu, addr);
+			WZ = addr + 1;
+			break;
+		case 0x03: case 0x13: case 0x23: case 0x33:	// INC rr
+			setRP(cpu, p, xy, getRP(cpu, p, xy) + 1);
+			break;
+		case 0x0b: case 0x1b: case 0x2b: case 0x3b:	// DEC rr
+			setRP(cpu, p, xy, getRP(cpu, p, xy) - 1);
+			break;
+		case 0x34:									// INC (HL)
+			addr = memOperand(cpu, xy);
+			if (indexed) t += 8;
+			wr(cpu, addr, inc8(cpu, rd(cpu, addr)));
+			break;
+		case 0x35:									// DEC (HL)
+			addr = memOperand(cpu, xy);
+			if (indexed) t += 8;
+			wr(cpu, addr, dec8(cpu, rd(cpu, addr)));
+			break;
+		case 0x04: case 0x0c: case 0x14: case 0x1c: case 0x24: case 0x2c: case 0x3c:
+			setR(cpu, y, xy, inc8(cpu, getR(cpu, y, xy)));
+			break;
+		case 0x05: case 0x0d: case 0x15: case 0x1d: case 0x25: case 0x2d: case 0x3d:
+			setR(cpu, y, xy, dec8(cpu, getR(cpu, y, xy)));
+			break;
+		case 0x36:									// LD (HL),n
+			addr = memOperand(cpu, xy);
+			if (indexed) t += 5;
+			wr(cpu, addr, fetch(cpu));
+			break;
+		case 0x06: case 0x0e: case 0x16: case 0x1e: case 0x26: case 0x2e: case 0x3e:
+			setR(cpu, y, xy, fetch(cpu));
+			break;
+		case 0x07:									// RLCA
+			A = (A << 1) | (A >> 7);
+			F = (F & (FS | FZ | FP)) | (A & (FXY | FC));
+			break;
+		case 0x0f:									// RRCA
+			F = (F & (FS | FZ | FP)) | (A & FC);
+			A = (A >> 1) | (A << 7);
+			F |= A & FXY;
+			break;
+		case 0x17:									// RLA
+			v = A >> 7;
+			A = (A << 1) | (F & FC);
+			F = (F & (FS | FZ | FP)) | (A & FXY) | v;
+			break;
+		case 0x1f:									// RRA
+			v = A & 1;
+			A = (A >> 1) | ((F & FC) << 7);
+			F = (F & (FS | FZ | FP)) | (A & FXY) | v;
+			break;
+		case 0x27: {								// DAA
+			uint8_t corr = 0, c = F & FC, h;
+			if ((F & FH) || (A & 0x0f) > 9) corr |= 0x06;
+			if (c || A > 0x99) { corr |= 0x60; c = FC; }
+			if (F & FN) {
+				h = ((F & FH) && (A & 0x0f) < 6) ? FH : 0;
+				A -= corr;
+			} else {
+				h = ((A & 0x0f) > 9) ? FH : 0;
+				A += corr;
+			}
+			F = (F & FN) | c | h | sz53p[A];
+			break;
+		}
+		case 0x2f:									// CPL
+			A ^= 0xff;
+			F = (F & (FS | FZ | FP | FC)) | FH | FN | (A & FXY);
+			break;
+		case 0x37:									// SCF
+			F = (F & (FS | FZ | FP)) | FC | (A & FXY);
+			break;
+		case 0x3f:									// CCF
+			F = (F & (FS | FZ | FP)) | ((F & FC) ? FH : FC) | (A & FXY);
+			break;
+
+		case 0xc0: case 0xc8: case 0xd0: case 0xd8:	// RET cc
+		case 0xe0: case 0xe8: case 0xf0: case 0xf8:
+			if (cond(cpu, y)) {
+				PC = WZ = z80_pop(cpu);
+				t += 6;
+			}
+			break;
+		case 0xc1: case 0xd1: case 0xe1: case 0xf1:	// POP rr
+			setRP2(cpu, p, xy, z80_pop(cpu));
+			break;
+		case 0xc5: case 0xd5: case 0xe5: case 0xf5:	// PUSH rr
+			z80_push(cpu, getRP2(cpu, p, xy));
+			break;
+		case 0xc9:									// RET
+			PC = WZ = z80_pop(cpu);
+			break;
+		case 0xd9: {								// EXX
+			uint16_t tmp;
+			tmp = BC; BC = cpu->bc_.w; cpu->bc_.w = tmp;
+			tmp = DE; DE = cpu->de_.w; cpu->de_.w = tmp;
+			tmp = HL; HL = cpu->hl_.w; cpu->hl_.w = tmp;
+			break;
+		}
+		case 0xe9:									// JP (HL)
+			PC = xy->w;
+			break;
+		case 0xf9:									// LD SP,HL
+			SP = xy->w;
+			break;
+		case 0xc2: case 0xca: case 0xd2: case 0xda:	// JP cc,nn
+		case 0xe2: case 0xea: case 0xf2: case 0xfa:
+			WZ = fetch16(cpu);
+			if (cond(cpu, y)) PC = WZ;
+			break;
+		case 0xc3:									// JP nn
+			PC = WZ = fetch16(cpu);
+			break;
+		case 0xd3:									// OUT (n),A
+			v = fetch(cpu);
+			cpu->bus.out(cpu->ctx, v | (A << 8), A);
+			WZ = ((v + 1) & 0xff) | (A << 8);
+			break;
+		case 0xdb:									// IN A,(n)
+			v = fetch(cpu);
+			WZ = ((A << 8) | v) + 1;
+			A = cpu->bus.in(cpu->ctx, v | (A << 8));
+			break;
+		case 0xe3:									// EX (SP),HL
+			v16 = rd16(cpu, SP);
+			wr16(cpu, SP, xy->w);
+			xy->w = WZ = v16;
+			break;
+		case 0xeb: {								// EX DE,HL (never indexed)
+			uint16_t tmp = DE; DE = HL; HL = tmp;
+			break;
+		}
+		case 0xf3:									// DI
+			cpu->iff1 = cpu->iff2 = 0;
+			break;
+		case 0xfb:									// EI
+			cpu->iff1 = cpu->iff2 = 1;
+			cpu->eiDelay = true;
+			break;
+		case 0xc4: case 0xcc: case 0xd4: case 0xdc:	// CALL cc,nn
+		case 0xe4: case 0xec: case 0xf4: case 0xfc:
+			WZ = fetch16(cpu);
+			if (cond(cpu, y)) {
+				z80_push(cpu, PC);
+				PC = WZ;
+				t += 7;
+			}
+			break;
+		case 0xcd:									// CALL nn
+			WZ = fetch16(cpu);
+			z80_push(cpu, PC);
+			PC = WZ;
+			break;
+		case 0xc6: case 0xce: case 0xd6: case 0xde:	// ALU A,n
+		case 0xe6: case 0xee: case 0xf6: case 0xfe:
+			alu(cpu, y, fetch(cpu));
+			break;
+		case 0xc7: case 0xcf: case 0xd7: case 0xdf:	// RST p
+		case 0xe7: case 0xef: case 0xf7: case 0xff:
+			z80_push(cpu, PC);
+			PC = WZ = y << 3;
+			break;
+
+		case 0xcb:
+			if (indexed) return 4 + execIndexCB(cpu, xy);
+			return execCB(cpu) + cpu->m1Wait;
+		case 0xed:
+			return execED(cpu) + cpu->m1Wait;
+		case 0xdd:
+			return 4 + execMain(cpu, fetchM1(cpu), &cpu->ix) + cpu->m1Wait;
+		case 0xfd:
+			return 4 + execMain(cpu, fetchM1(cpu), &cpu->iy) + cpu->m1Wait;
+	}
+	return t;
+}
+
+static uint32_t execCB(Z80 *cpu)
+{
+	uint8_t op = fetchM1(cpu);
+	uint8_t x = op >> 6, y = (op >> 3) & 7, z = op & 7;
+	uint8_t v;
+
+	if (z == 6) {
+		v = rd(cpu, HL);
+		switch (x) {
+			case 0: wr(cpu, HL, rot(cpu, y, v)); return 4 + 11;
+			case 1: bitTest(cpu, y, v, WZ >> 8); return 4 + 8;
+			case 2: wr(cpu, HL, v & ~(1 << y)); return 4 + 11;
+			default: wr(cpu, HL, v | (1 << y)); return 4 + 11;
+		}
+	}
+	v = getR(cpu, z, &cpu->hl);
+	switch (x) {
+		case 0: setR(cpu, z, &cpu->hl, rot(cpu, y, v)); break;
+		case 1: bitTest(cpu, y, v, v); break;
+		case 2: setR(cpu, z, &cpu->hl, v & ~(1 << y)); break;
+		default: setR(cpu, z, &cpu->hl, v | (1 << y)); break;
+	}
+	return 4 + 4;
+}
+
+// DD CB d op / FD CB d op: neither d nor op are M1 cycles
+static uint32_t execIndexCB(Z80 *cpu, Z80Pair *xy)
+{
+	uint16_t addr = WZ = xy->w + (int8_t)fetch(cpu);
+	uint8_t op = fetch(cpu);
+	uint8_t x = op >> 6, y = (op >> 3) & 7, z = op & 7;
+	uint8_t v = rd(cpu, addr);
+
+	switch (x) {
+		case 0: v = rot(cpu, y, v); break;
+		case 1: bitTest(cpu, y, v, addr >> 8); return 12;
+		case 2: v &= ~(1 << y); break;
+		default: v |= 1 << y; break;
+	}
+	wr(cpu, addr, v);
+	if (z != 6) setR(cpu, z, &cpu->hl, v);	// Undocumented copy to a register
+	return 15;
+}
+
+static void blockFlagsIO(Z80 *cpu, uint8_t v, uint16_t k)
+{
+	F = sz53[B] | ((v & 0x80) ? FN : 0) | ((k > 0xff) ? (FH | FC) : 0) |
+		(sz53p[(k & 7) ^ B] & FP);
+}
+
+static uint32_t execED(Z80 *cpu)
+{
+	uint8_t op = fetchM1(cpu);
+	uint8_t x = op >> 6, y = (op >> 3) & 7, z = op & 7;
+	uint8_t p = y >> 1, q = y & 1;
+	uint16_t addr;
+	uint8_t v;
+
+	if (op == Z80_TRAP_OPCODE) {
+		v = fetch(cpu);
+		if (cpu->bus.trap && cpu->bus.trap(cpu->ctx, cpu, v)) cpu->stop = true;
+		return 8;
+	}
+
+	if (x == 1) {
+		switch (z) {
+			case 0:									// IN r,(C)
+				v = cpu->bus.in(cpu->ctx, BC);
+				WZ = BC + 1;
+				if (y != 6) setR(cpu, y, &cpu->hl, v);
+				F = (F & FC) | sz53p[v];
+				return 12;
+			case 1:									// OUT (C),r
+				cpu->bus.out(cpu->ctx, BC, y == 6 ? 0 : getR(cpu, y, &cpu->hl));
+				WZ = BC + 1;
+				return 12;
+			case 2:									// SBC/ADC HL,rr
+				if (q) adc16(cpu, getRP(cpu, p, &cpu->hl));
+				else   sbc16(cpu, getRP(cpu, p, &cpu->hl));
+				return 15;
+			case 3:									// LD (nn),rr / LD rr,(nn)
+				addr = fetch16(cpu);
+				if (q) setRP(cpu, p, &cpu->hl, rd16(cpu, addr));
+				else   wr16(cpu, addr, getRP(cpu, p, &cpu->hl));
+				WZ = addr + 1;
+				return 20;
+			case 4:									// NEG
+				v = A;
+				A = 0;
+				sub8(cpu, v, 0);
+				return 8;
+			case 5:									// RETN / RETI
+				cpu->iff1 = cpu->iff2;
+				PC = WZ = z80_pop(cpu);
+				return 14;
+			case 6:									// IM 0/1/2
+				cpu->im = (y & 3) < 2 ? 0 : (y & 3) - 1;
+				return 8;
+			default:
+				switch (y) {
+					case 0: cpu->i = A; return 9;	// LD I,A
+					case 1: cpu->r = A; cpu->r7 = A & 0x80; return 9;	// LD R,A
+					case 2:							// LD A,I
+						A = cpu->i;
+						F = (F & FC) | sz53[A] | (cpu->iff2 ? FP : 0);
+						return 9;
+					case 3:							// LD A,R
+						A = z80_getR(cpu);
+						F = (F & FC) | sz53[A] | (cpu->iff2 ? FP : 0);
+						return 9;
+					case 4:							// RRD
+						v = rd(cpu, HL);
+						wr(cpu, HL, (A << 4) | (v >> 4));
+						A = (A & 0xf0) | (v & 0x0f);
+						F = (F & FC) | sz53p[A];
+						WZ = HL + 1;
+						return 18;
+					case 5:							// RLD
+						v = rd(cpu, HL);
+						wr(cpu, HL, (v << 4) | (A & 0x0f));
+						A = (A & 0xf0) | (v >> 4);
+						F = (F & FC) | sz53p[A];
+						WZ = HL + 1;
+						return 18;
+					default:
+						return 8;
+				}
+		}
+	}
+
+	if (x == 2 && z <= 3 && y >= 4) {
+		bool dec = y & 1;
+		bool rep = y & 2;
+		int8_t step = dec ? -1 : 1;
+		uint32_t t = 16;
+		uint16_t n;
+
+		switch (z) {
+			case 0:									// LDI/LDD/LDIR/LDDR
+				v = rd(cpu, HL);
+				wr(cpu, DE, v);
+				HL += step;
+				DE += step;
+				BC--;
+				n = v + A;
+				F = (F & (FS | FZ | FC)) | (BC ? FP : 0) | (n & FX) | ((n & 0x02) << 4);
+				if (rep && BC) {
+					PC -= 2;
+					WZ = PC + 1;
+					t += 5;
+				}
+				return t;
+			case 1: {								// CPI/CPD/CPIR/CPDR
+				uint8_t r, h;
+				v = rd(cpu, HL);
+				r = A - v;
+				h = (A ^ v ^ r) & FH;
+				HL += step;
+				BC--;
+				WZ += step;
+				n = r - (h ? 1 : 0);
+				F = (F & FC) | (sz53[r] & ~FXY) | h | FN | (BC ? FP : 0) | (n & FX) | ((n & 0x02) << 4);
+				if (rep && BC && r) {
+					PC -= 2;
+					WZ = PC + 1;
+					t += 5;
+				}
+				return t;
+			}
+			case 2:									// INI/IND/INIR/INDR
+				v = cpu->bus.in(cpu->ctx, BC);
+				WZ = BC + step;
+				wr(cpu, HL, v);
+				B--;
+				HL += step;
+				blockFlagsIO(cpu, v, v + (uint8_t)(C + step));
+				if (rep && B) {
+					PC -= 2;
+					t += 5;
+				}
+				return t;
+			default:								// OUTI/OUTD/OTIR/OTDR
+				v = rd(cpu, HL);
+				B--;
+				WZ = BC + step;
+				cpu->bus.out(cpu->ctx, BC, v);
+				HL += step;
+				blockFlagsIO(cpu, v, v + L);
+				if (rep && B) {
+					PC -= 2;
+					t += 5;
+				}
+				return t;
+		}
+	}
+
+	return 8;										// Undefined ED opcodes are NOPs
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+#define Z80_FLAG_C	0x01
+#define Z80_FLAG_N	0x02
+#define Z80_FLAG_P	0x04
+#define Z80_FLAG_X	0x08
+#define Z80_FLAG_H	0x10
+#define Z80_FLAG_Y	0x20
+#define Z80_FLAG_Z	0x40
+#define Z80_FLAG_S	0x80
+
+// ED FE nn is a NOP on a real Z80, the runner uses it to call the host
+#define Z80_TRAP_PREFIX	0xed
+#define Z80_TRAP_OPCODE	0xfe
+
+typedef union {
+	uint16_t w;
+	struct {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		uint8_t h, l;
+#else
+		uint8_t l, h;
+#endif
+	} b;
+} Z80Pair;
+
+typedef struct Z80 Z80;
+
+typedef struct {
+	uint8_t (*read)(void *ctx, uint16_t addr);
+	void    (*write)(void *ctx, uint16_t addr, uint8_t value);
+	uint8_t (*in)(void *ctx, uint16_t port);
+	void    (*out)(void *ctx, uint16_t port, uint8_t value);
+	bool    (*trap)(void *ctx, Z80 *cpu, uint8_t id);	// Returns true to stop z80_run(...)
+} Z80Bus;
+
+struct Z80 {
+	Z80Pair  af, bc, de, hl;
+	Z80Pair  af_, bc_, de_, hl_;
+	Z80Pair  ix, iy;
+	uint16_t sp, pc, wz;
+	uint8_t  i, r, r7;			// R is kept as 7 counting bits plus bit 7
+	uint8_t  iff1, iff2, im;
+	bool     halted;
+	bool     eiDelay;			// No interrupt is taken right after EI
+	bool     irq;				// INT line, level triggered
+	bool     stop;				// Set by a trap to leave z80_run(...)
+	uint8_t  m1Wait;			// Wait states added to every M1 cycle (1 on MSX)
+	uint64_t cycles;			// T-states since reset
+	Z80Bus   bus;
+	void    *ctx;
+};
+
+
+void     z80_init(Z80 *cpu, const Z80Bus *bus, void *ctx);
+void     z80_reset(Z80 *cpu);
+uint32_t z80_step(Z80 *cpu);
+uint64_t z80_run(Z80 *cpu, uint64_t cycles);
+uint8_t  z80_getR(const Z80 *cpu);
+void     z80_push(Z80 *cpu, uint16_t value);
+uint16_t z80_pop(Z80 *cpu);
+void     z80_ret(Z80 *cpu);
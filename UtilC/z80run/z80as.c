@@ -0,0 +1,339 @@
+/*
+ * z80as: assembles a whole sjasm source of the tools into its binary, with
+ * the assembler of z80bench.
+ *
+ * The includes and the macros are expanded here, before the lines reach
+ * the assembler. Both macro forms of the sources are taken:
+ *   macro name arg,...   (the arguments by name, as c2man.asm)
+ *   name macro           (the arguments as \1..\9 and "local" labels, as
+ *                         the diskless tools)
+ * The output file holds the bytes in the order of the source, the way
+ * sjasm writes it: an org moves the address, not the file position.
+ *
+ *   z80as source.asm output.bin
+ */
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "z80asm.h"
+
+
+#define LINE_SIZE		1024
+#define MAX_MACROS		64
+#define MAX_ARGS		9
+#define MAX_LOCALS		8
+#define MAX_DEPTH		8			// Nested includes and macros
+#define OUTPUT_SIZE		0x100000
+
+typedef struct {
+	char   *name;
+	char   *params[MAX_ARGS];		// By name, or none for \1..\9
+	int     paramCount;
+	char  **body;
+	int     bodyCount;
+} Macro;
+
+typedef struct {
+	Asm     *as;
+	Macro    macros[MAX_MACROS];
+	int      macroCount;
+	Macro   *defining;				// Macro being read, up to its endm
+	int      expansions;			// Counter for the local labels
+	char   **files;					// File names, kept for the lines
+	int      fileCount;
+	const char *error;
+	char     errorBuf[LINE_SIZE];
+} Source;
+
+static const char usage[] =
+	"Usage: z80as source.asm output.bin\n"
+	"Assembles a sjasm source of the tools into its binary.\n";
+
+//###################################################################
+// Variables & Func.Definitions
+
+static bool    addFile(Source *src, const char *path, int depth);
+static bool    addLine(Source *src, const char *text, const char *file, int line, int depth);
+
+
+//###################################################################
+// Private Functions
+
+static bool sourceError(Source *src, const char *file, int line, const char *msg, const char *arg)
+{
+	snprintf(src->errorBuf, sizeof(src->errorBuf), "%s:%d: %s%s", file, line, msg, arg);
+	src->error = src->errorBuf;
+	return false;
+}
+
+static bool isIdent(char c)
+{
+	return isalnum((unsigned char)c) || c == '_' || c == '.' || c == '@' || c == '?';
+}
+
+// Splits a line into label, mnemonic and operands, comments excluded
+static void splitLine(const char *text, char *label, char *mnem, char *rest)
+{
+	const char *p = text, *end;
+	int n = 0;
+
+	label[0] = mnem[0] = rest[0] = '\0';
+	while (isIdent(*p) && n < 63) label[n++] = *p++;
+	label[n] = '\0';
+	if (*p == ':') p++;
+	while (*p == ' ' || *p == '\t') p++;
+	for (n = 0; *p && !isspace((unsigned char)*p) && *p != ';' && n < 63; ) mnem[n++] = *p++;
+	mnem[n] = '\0';
+	while (*p == ' ' || *p == '\t') p++;
+	end = p;
+	for (char quote = 0; *end && (quote || *end != ';'); end++) {
+		if (quote && *end == quote) quote = 0;
+		else if (!quote && (*end == '"' || (*end == '\'' && !(end - text >= 2 && tolower((unsigned char)end[-1]) == 'f')))) quote = *end;
+	}
+	while (end > p && isspace((unsigned char)end[-1])) end--;
+	snprintf(rest, LINE_SIZE, "%.*s", (int)(end - p), p);
+}
+
+static bool equalsNoCase(const char *a, const char *b)
+{
+	while (*a && tolower((unsigned char)*a) == tolower((unsigned char)*b)) a++, b++;
+	return !*a && !*b;
+}
+
+static Macro *findMacro(Source *src, const char *name)
+{
+	for (int i = 0; i < src->macroCount; i++) {
+		if (equalsNoCase(src->macros[i].name, name)) return &src->macros[i];
+	}
+	return NULL;
+}
+
+// Replaces the whole word 'word' of 'text' with 'with'
+static void replaceWord(char *text, const char *word, const char *with)
+{
+	char out[LINE_SIZE];
+	size_t len = strlen(word), n = 0;
+	const char *p = text;
+
+	while (*p && n < sizeof(out) - 1) {
+		if (!strncmp(p, word, len) && !isIdent(p[len]) && (p == text || !isIdent(p[-1]))) {
+			n += snprintf(out + n, sizeof(out) - n, "%s", with);
+			if (n >= sizeof(out)) n = sizeof(out) - 1;
+			p += len;
+		} else {
+			out[n++] = *p++;
+		}
+	}
+	out[n] = '\0';
+	strcpy(text, out);
+}
+
+static int splitArgs(char *text, char **args)
+{
+	int count = 0;
+	char *p = text;
+
+	if (!*p) return 0;
+	while (count < MAX_ARGS) {
+		char *start = p;
+		char quote = 0;
+		while (*p && (quote || *p != ',')) {
+			if (quote && *p == quote) quote = 0;
+			else if (!quote && (*p == '"' || *p == '\'')) quote = *p;
+			p++;
+		}
+		args[count++] = start;
+		if (!*p) break;
+		*p++ = '\0';
+	}
+	for (int i = 0; i < count; i++) {
+		char *a = args[i], *e;
+		while (isspace((unsigned char)*a)) a++;
+		e = a + strlen(a);
+		while (e > a && isspace((unsigned char)e[-1])) *--e = '\0';
+		args[i] = a;
+	}
+	return count;
+}
+
+static bool expandMacro(Source *src, Macro *m, char *argText, const char *file, int line, int depth)
+{
+	char *args[MAX_ARGS], *locals[MAX_LOCALS];
+	int argCount = splitArgs(argText, args), localCount = 0, id = ++src->expansions;
+
+	if (depth >= MAX_DEPTH) return sourceError(src, file, line, "macros nested too deep", "");
+	for (int i = 0; i < m->bodyCount; i++) {
+		char text[LINE_SIZE], label[64], mnem[64], rest[LINE_SIZE];
+
+		snprintf(text, sizeof(text), "%s", m->body[i]);
+		splitLine(text, label, mnem, rest);
+		if (equalsNoCase(mnem, "local")) {
+			localCount = splitArgs(rest, locals);
+			if (localCount > MAX_LOCALS) localCount = MAX_LOCALS;
+			for (int k = 0; k < localCount; k++) locals[k] = strdup(locals[k]);
+			continue;
+		}
+		for (int k = 0; k < m->paramCount; k++) replaceWord(text, m->params[k], k < argCount ? args[k] : "");
+		for (int k = 0; k < MAX_ARGS; k++) {
+			char param[4], *p;
+			snprintf(param, sizeof(param), "\\%d", k + 1);
+			while ((p = strstr(text, param))) {
+				char tail[LINE_SIZE];
+				snprintf(tail, sizeof(tail), "%s", p + 2);
+				snprintf(p, sizeof(text) - (p - text), "%s%s", k < argCount ? args[k] : "", tail);
+			}
+		}
+		for (int k = 0; k < localCount; k++) {
+			char unique[80];
+			snprintf(unique, sizeof(unique), "%s__%d", locals[k], id);
+			replaceWord(text, locals[k], unique);
+		}
+		if (!addLine(src, text, file, line, depth + 1)) return false;
+	}
+	for (int k = 0; k < localCount; k++) free(locals[k]);
+	return true;
+}
+
+static bool addLine(Source *src, const char *text, const char *file, int line, int depth)
+{
+	char label[64], mnem[64], rest[LINE_SIZE];
+	Macro *m;
+
+	splitLine(text, label, mnem, rest);
+
+	if (src->defining) {
+		m = src->defining;
+		if (equalsNoCase(mnem, "endm")) {
+			src->defining = NULL;
+			return true;
+		}
+		m->body = realloc(m->body, (m->bodyCount + 1) * sizeof(char*));
+		m->body[m->bodyCount++] = strdup(text);
+		return true;
+	}
+	if (equalsNoCase(mnem, "macro")) {
+		char *params[MAX_ARGS];
+		int count;
+
+		if (src->macroCount == MAX_MACROS) return sourceError(src, file, line, "too many macros", "");
+		m = &src->macros[src->macroCount++];
+		memset(m, 0, sizeof(Macro));
+		if (label[0]) {						// name macro
+			m->name = strdup(label);
+			count = splitArgs(rest, params);
+		} else {							// macro name arg,...
+			char *sp = rest;
+			while (*sp && !isspace((unsigned char)*sp)) sp++;
+			if (*sp) *sp++ = '\0';
+			m->name = strdup(rest);
+			count = splitArgs(sp, params);
+		}
+		if (!*m->name) return sourceError(src, file, line, "macro without a name", "");
+		for (int i = 0; i < count; i++) m->params[m->paramCount++] = strdup(params[i]);
+		src->defining = m;
+		return true;
+	}
+	if (equalsNoCase(mnem, "include")) {
+		char path[LINE_SIZE];
+		const char *slash = strrchr(file, '/');
+		size_t len = strlen(rest);
+
+		if (len < 3 || (rest[0] != '"' && rest[0] != '\'')) return sourceError(src, file, line, "bad include ", rest);
+		rest[len - 1] = '\0';
+		if (slash && rest[1] != '/') snprintf(path, sizeof(path), "%.*s/%s", (int)(slash - file), file, rest + 1);
+		else snprintf(path, sizeof(path), "%s", rest + 1);
+		return addFile(src, path, depth + 1);
+	}
+	if ((m = findMacro(src, mnem))) {
+		if (label[0]) asm_addLine(src->as, label, file, line);
+		return expandMacro(src, m, rest, file, line, depth);
+	}
+	if ((equalsNoCase(mnem, "push") || equalsNoCase(mnem, "pop")) && strchr(rest, ',')) {
+		char *regs[MAX_ARGS], one[LINE_SIZE];	// push af,hl: one push per register, in order
+		int count = splitArgs(rest, regs);
+
+		if (label[0]) asm_addLine(src->as, label, file, line);
+		for (int i = 0; i < count; i++) {
+			snprintf(one, sizeof(one), "\t%s\t%s", mnem, regs[i]);
+			asm_addLine(src->as, one, file, line);
+		}
+		return true;
+	}
+	asm_addLine(src->as, text, file, line);
+	return true;
+}
+
+static bool addFile(Source *src, const char *path, int depth)
+{
+	char text[LINE_SIZE], *name;
+	FILE *f;
+	int line = 0;
+
+	if (depth >= MAX_DEPTH) return sourceError(src, path, 0, "includes nested too deep", "");
+	f = fopen(path, "r");
+	if (!f) return sourceError(src, path, 0, "can't open the file", "");
+	name = strdup(path);
+	src->files = realloc(src->files, (src->fileCount + 1) * sizeof(char*));
+	src->files[src->fileCount++] = name;
+	while (fgets(text, sizeof(text), f)) {
+		text[strcspn(text, "\r\n")] = '\0';
+		if (!addLine(src, text, name, ++line, depth)) {
+			fclose(f);
+			return false;
+		}
+	}
+	fclose(f);
+	return true;
+}
+
+
+//###################################################################
+// Main
+
+int main(int argc, char **argv)
+{
+	static uint8_t mem[0x10000];
+	Source src = { 0 };
+	const char *input, *output;
+	uint8_t *out = malloc(OUTPUT_SIZE);
+	uint16_t start, size;
+	FILE *f;
+	int rc = 1;
+
+	src.as = asm_new();
+	if (!src.as || !out) {
+		fputs("z80as: out of memory\n", stderr);
+		return 1;
+	}
+	if (argc != 3 || argv[1][0] == '-') {
+		fputs(usage, stderr);
+		return 2;
+	}
+	input = argv[1];
+	output = argv[2];
+
+	if (!addFile(&src, input, 0)) {
+		fprintf(stderr, "z80as: %s\n", src.error);
+		goto done;
+	}
+	if (src.defining) {
+		fprintf(stderr, "z80as: %s: macro %s without endm\n", input, src.defining->name);
+		goto done;
+	}
+	asm_setOutput(src.as, out, OUTPUT_SIZE);
+	if (!asm_assemble(src.as, mem, &start, &size)) {
+		fprintf(stderr, "z80as: %s\n", asm_error(src.as));
+		goto done;
+	}
+	f = fopen(output, "wb");
+	if (!f || fwrite(out, 1, asm_outputSize(src.as), f) != asm_outputSize(src.as) || fclose(f)) {
+		fprintf(stderr, "z80as: can't write %s\n", output);
+		goto done;
+	}
+	rc = 0;
+done:
+	asm_free(src.as);
+	free(out);
+	return rc;
+}
@@ -0,0 +1,1315 @@
+/*
+ * Z80 assembler for the benchmark harness: assembles routines cut out of
+ * the sjasm sources of the tools, so they can be timed in isolation.
+ *
+ * Pass 1 collects the labels, pass 2 emits the code. Symbols still
+ * undefined after pass 1 can be given addresses in a variables area (see
+ * asm_setAutoVars), which is how the variables of a routine are found.
+ * "Soft" symbols are defaults (the equates of the whole source file) that a
+ * label or equate of the assembled text replaces.
+ */
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "z80asm.h"
+
+
+#define MAX_NAME		48
+#define MAX_OPERANDS	64
+#define MAX_IF_DEPTH	16
+
+typedef struct {
+	char     name[MAX_NAME];
+	int32_t  value;
+	bool     defined;
+	bool     soft;
+	int      pass;					// Pass that defined it (0 = before assembling)
+} Symbol;
+
+typedef struct {
+	char       *text;
+	const char *file;
+	int         line;
+} Line;
+
+// Operand kinds
+enum {
+	OP_IMM,			// n, nn
+	OP_MEM,			// (nn)
+	OP_R8,			// b c d e h l (hl) a, ixh ixl iyh iyl, (ix+d) (iy+d)
+	OP_RR,			// bc de hl sp, ix iy
+	OP_AF, OP_AFX,	// af, af'
+	OP_I, OP_R,
+	OP_MBC, OP_MDE, OP_MSP, OP_MC
+};
+
+#define R_MEM	6				// (hl) / (ix+d) code of OP_R8
+#define RR_HL	2
+
+typedef struct {
+	int      kind;
+	int      reg;
+	uint8_t  prefix;			// 0, DDh or FDh
+	bool     half;				// IXH, IXL, IYH, IYL
+	int32_t  value;				// Immediate, address or displacement
+	const char *text;
+} Operand;
+
+struct Asm {
+	Symbol  *syms;
+	int      symCount, symCap;
+	Line    *lines;
+	int      lineCount, lineCap;
+
+	int      pass;
+	uint16_t pc;
+	uint8_t *mem;
+	bool     undef;					// The last expression used an undefined symbol
+	const Line *cur;
+
+	uint16_t autoNext, autoSize, autoEnd;
+	bool     autoVars;
+
+	uint8_t  code[8];
+	int      codeLen;
+	uint32_t lo, hi;
+
+	uint8_t *out;					// Output file: the bytes in the order of the source
+	uint32_t outCap, outLen;
+
+	char     error[ASM_MAX_ERROR];
+};
+
+static const char *const reg8Names[] = { "b", "c", "d", "e", "h", "l", NULL, "a" };
+static const char *const condNames[] = { "nz", "z", "nc", "c", "po", "pe", "p", "m" };
+
+//###################################################################
+// Variables & Func.Definitions
+
+static bool    assemblePass(Asm *as);
+static bool    assembleLine(Asm *as, const Line *line, int *ifDepth, bool *ifActive, bool *ifDone);
+static bool    instruction(Asm *as, const char *mnem, char **ops, int opCount);
+static int32_t expression(Asm *as, const char **p);
+static void    fail(Asm *as, const char *fmt, ...);
+
+
+//###################################################################
+// Public Functions
+
+Asm *asm_new(void)
+{
+	return calloc(1, sizeof(Asm));
+}
+
+void asm_free(Asm *as)
+{
+	if (!as) return;
+	for (int i = 0; i < as->lineCount; i++) free(as->lines[i].text);
+	free(as->lines);
+	free(as->syms);
+	free(as);
+}
+
+static Symbol *findSymbol(const Asm *as, const char *name)
+{
+	for (int i = 0; i < as->symCount; i++) {
+		if (!strcmp(as->syms[i].name, name)) return &as->syms[i];
+	}
+	return NULL;
+}
+
+static Symbol *addSymbol(Asm *as, const char *name)
+{
+	Symbol *s;
+
+	if (as->symCount == as->symCap) {
+		as->symCap = as->symCap ? as->symCap * 2 : 256;
+		as->syms = realloc(as->syms, as->symCap * sizeof(Symbol));
+		if (!as->syms) abort();
+	}
+	s = &as->syms[as->symCount++];
+	memset(s, 0, sizeof(Symbol));
+	snprintf(s->name, sizeof(s->name), "%s", name);
+	return s;
+}
+
+/**
+ * asm_define
+ * Defines a symbol. A soft symbol never replaces an existing one, and is
+ * replaced by a later normal definition.
+ *
+ * @return false if the symbol already exists.
+ */
+bool asm_define(Asm *as, const char *name, int32_t value, bool soft)
+{
+	Symbol *s = findSymbol(as, name);
+
+	if (s && s->defined) {
+		if (soft || !s->soft) return false;
+	}
+	if (!s) s = addSymbol(as, name);
+	s->value = value;
+	s->defined = true;
+	s->soft = soft;
+	s->pass = as->pass;
+	return true;
+}
+
+/**
+ * asm_defineExpr
+ * Defines a symbol from an expression of the symbols defined so far.
+ *
+ * @return false if the expression can't be evaluated yet, or the symbol exists.
+ */
+bool asm_defineExpr(Asm *as, const char *name, const char *expr, bool soft)
+{
+	const char *p = expr;
+	int32_t value;
+
+	as->undef = false;
+	as->error[0] = '\0';
+	value = expression(as, &p);
+	while (isspace((unsigned char)*p)) p++;
+	if (as->undef || as->error[0] || *p) {
+		as->error[0] = '\0';
+		return false;
+	}
+	return asm_define(as, name, value, soft);
+}
+
+/**
+ * asm_addLine
+ * Appends a source line. The file name is kept by reference.
+ */
+void asm_addLine(Asm *as, const char *text, const char *file, int line)
+{
+	if (as->lineCount == as->lineCap) {
+		as->lineCap = as->lineCap ? as->lineCap * 2 : 256;
+		as->lines = realloc(as->lines, as->lineCap * sizeof(Line));
+		if (!as->lines) abort();
+	}
+	as->lines[as->lineCount].text = strdup(text);
+	as->lines[as->lineCount].file = file;
+	as->lines[as->lineCount].line = line;
+	as->lineCount++;
+}
+
+/**
+ * asm_setAutoVars
+ * Gives the symbols left undefined by pass 1 consecutive blocks of 'size'
+ * bytes from 'base' up to 'end', instead of failing.
+ */
+void asm_setAutoVars(Asm *as, uint16_t base, uint16_t size, uint16_t end)
+{
+	as->autoVars = true;
+	as->autoNext = base;
+	as->autoSize = size;
+	as->autoEnd = end;
+}
+
+/**
+ * asm_assemble
+ * Assembles the lines added so far into a 64KB memory image.
+ *
+ * @param start Returns the lowest address written.
+ * @param size Returns the size of the written range.
+ * @return false on error, see asm_error(...).
+ */
+bool asm_assemble(Asm *as, uint8_t *mem, uint16_t *start, uint16_t *size)
+{
+	as->mem = mem;
+	as->error[0] = '\0';
+	as->lo = 0x10000;
+	as->hi = 0;
+
+	as->pass = 1;
+	if (!assemblePass(as)) return false;
+	for (int i = 0; i < as->symCount; i++) {
+		Symbol *s = &as->syms[i];
+		if (s->defined) continue;
+		if (!as->autoVars || (uint32_t)as->autoNext + as->autoSize > as->autoEnd) {
+			fail(as, "undefined symbol %s", s->name);
+			return false;
+		}
+		s->value = as->autoNext;
+		s->defined = true;
+		s->pass = 1;
+		as->autoNext += as->autoSize;
+	}
+
+	as->pass = 2;
+	as->lo = 0x10000;
+	as->hi = 0;
+	if (!assemblePass(as)) return false;
+	*start = as->lo < 0x10000 ? as->lo : 0;
+	*size = as->hi > as->lo ? as->hi - as->lo : 0;
+	return true;
+}
+
+bool asm_lookup(const Asm *as, const char *name, int32_t *value)
+{
+	const Symbol *s = findSymbol(as, name);
+
+	if (!s || !s->defined) return false;
+	*value = s->value;
+	return true;
+}
+
+const char *asm_error(const Asm *as)
+{
+	return as->error[0] ? as->error : NULL;
+}
+
+/**
+ * asm_setOutput
+ * Collects the bytes emitted by pass 2 in the order of the source, as sjasm
+ * writes its output file: org moves the address, not the file position.
+ */
+void asm_setOutput(Asm *as, uint8_t *buf, uint32_t cap)
+{
+	as->out = buf;
+	as->outCap = cap;
+	as->outLen = 0;
+}
+
+uint32_t asm_outputSize(const Asm *as)
+{
+	return as->outLen;
+}
+
+
+//###################################################################
+// Private Functions
+
+static void fail(Asm *as, const char *fmt, ...)
+{
+	char msg[ASM_MAX_ERROR];
+	va_list ap;
+
+	if (as->error[0]) return;
+	va_start(ap, fmt);
+	vsnprintf(msg, sizeof(msg), fmt, ap);
+	va_end(ap);
+	if (as->cur) snprintf(as->error, sizeof(as->error), "%s:%d: %s", as->cur->file, as->cur->line, msg);
+	else snprintf(as->error, sizeof(as->error), "%s", msg);
+}
+
+// A byte of pass 2 at the current address + offset
+static void put(Asm *as, uint32_t offset, uint8_t b)
+{
+	if (as->pass != 2) return;
+	as->mem[(uint16_t)(as->pc + offset)] = b;
+	if (!as->out) return;
+	if (as->outLen == as->outCap) {
+		fail(as, "output too large");
+		return;
+	}
+	as->out[as->outLen++] = b;
+}
+
+static bool isIdentStart(char c)
+{
+	return isalpha((unsigned char)c) || c == '_' || c == '.' || c == '@';
+}
+
+static bool isIdentChar(char c)
+{
+	return isalnum((unsigned char)c) || c == '_' || c == '.' || c == '@' || c == '?';
+}
+
+// The quote of "af'" is not a string delimiter
+static bool isQuote(const char *line, const char *p)
+{
+	if (*p == '"') return true;
+	if (*p != '\'') return false;
+	return !(p - line >= 2 && tolower((unsigned char)p[-1]) == 'f' && tolower((unsigned char)p[-2]) == 'a');
+}
+
+static char *trim(char *s)
+{
+	char *e;
+
+	while (isspace((unsigned char)*s)) s++;
+	e = s + strlen(s);
+	while (e > s && isspace((unsigned char)e[-1])) *--e = '\0';
+	return s;
+}
+
+static bool equalsNoCase(const char *a, const char *b)
+{
+	while (*a && tolower((unsigned char)*a) == tolower((unsigned char)*b)) a++, b++;
+	return !*a && !*b;
+}
+
+//-------------------------------------------------------------------
+// Expressions
+
+static int32_t number(Asm *as, const char **p)
+{
+	const char *s = *p;
+	char digits[40];
+	int n = 0, base = 10;
+	int32_t v = 0;
+
+	if (*s == '#' || *s == '$') {
+		base = 16;
+		s++;
+	} else if (*s == '%') {
+		base = 2;
+		s++;
+	} else if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+		base = 16;
+		s += 2;
+	}
+	while (isalnum((unsigned char)*s) && n < (int)sizeof(digits) - 1) digits[n++] = *s++;
+	digits[n] = '\0';
+	*p = s;
+	if (base == 10 && n > 1) {
+		char suffix = tolower((unsigned char)digits[n - 1]);
+		if (suffix == 'h') {
+			base = 16;
+			digits[--n] = '\0';
+		} else if (suffix == 'b' && strspn(digits, "01") == (size_t)n - 1) {
+			base = 2;
+			digits[--n] = '\0';
+		}
+	}
+	if (!n) {
+		fail(as, "bad number");
+		return 0;
+	}
+	for (int i = 0; i < n; i++) {
+		int d = isdigit((unsigned char)digits[i]) ? digits[i] - '0' : tolower((unsigned char)digits[i]) - 'a' + 10;
+		if (d < 0 || d >= base) {
+			fail(as, "bad number %s", digits);
+			return 0;
+		}
+		v = v * base + d;
+	}
+	return v;
+}
+
+static int32_t primary(Asm *as, const char **p)
+{
+	const char *s = *p;
+	int32_t v;
+
+	while (isspace((unsigned char)*s)) s++;
+	if (*s == '(') {
+		s++;
+		v = expression(as, &s);
+		while (isspace((unsigned char)*s)) s++;
+		if (*s != ')') fail(as, "missing ')'");
+		else s++;
+	} else if (*s == '$' && !isxdigit((unsigned char)s[1])) {
+		s++;
+		v = as->pc;
+		if (!as->pass) as->undef = true;
+	} else if (*s == '#' || *s == '$' || *s == '%' || isdigit((unsigned char)*s)) {
+		v = number(as, &s);
+	} else if ((*s == '\'' || *s == '"') && s[1] && s[2] == s[0]) {
+		v = (uint8_t)s[1];
+		s += 3;
+	} else if (isIdentStart(*s)) {
+		char name[MAX_NAME];
+		int n = 0;
+		Symbol *sym;
+
+		while (isIdentChar(*s)) {
+			if (n < MAX_NAME - 1) name[n++] = *s;
+			s++;
+		}
+		name[n] = '\0';
+		sym = findSymbol(as, name);
+		if (sym && sym->defined) {
+			v = sym->value;
+		} else {
+			v = 0;
+			as->undef = true;
+			if (as->pass == 1 && !sym) addSymbol(as, name);
+			else if (as->pass == 2) fail(as, "undefined symbol %s", name);
+		}
+	} else {
+		fail(as, "bad expression");
+		v = 0;
+	}
+	*p = s;
+	return v;
+}
+
+static int32_t unary(Asm *as, const char **p)
+{
+	while (isspace((unsigned char)**p)) (*p)++;
+	switch (**p) {
+		case '-': (*p)++; return -unary(as, p);
+		case '+': (*p)++; return unary(as, p);
+		case '~': (*p)++; return ~unary(as, p);
+		case '!': (*p)++; return !unary(as, p);
+	}
+	return primary(as, p);
+}
+
+// Binary operators by precedence, lowest first
+static const char *const binaryOps[][7] = {
+	{ "==", "!=", "<>", "<=", ">=", "=", NULL },
+	{ "|", NULL },
+	{ "^", NULL },
+	{ "&", NULL },
+	{ "<<", ">>", NULL },
+	{ "+", "-", NULL },
+	{ "*", "/", "%", NULL },
+};
+#define BINARY_LEVELS	(int)(sizeof(binaryOps) / sizeof(binaryOps[0]))
+
+static int32_t binary(Asm *as, const char **p, int level)
+{
+	int32_t v;
+
+	if (level == BINARY_LEVELS) return unary(as, p);
+	v = binary(as, p, level + 1);
+	for (;;) {
+		const char *op = NULL;
+		int32_t r;
+
+		while (isspace((unsigned char)**p)) (*p)++;
+		for (int i = 0; binaryOps[level][i]; i++) {
+			size_t len = strlen(binaryOps[level][i]);
+			if (!strncmp(*p, binaryOps[level][i], len)) {
+				op = binaryOps[level][i];
+				break;
+			}
+		}
+		// '<' and '>' alone are comparisons, not the start of a shift
+		if (!op && level == 0 && (**p == '<' || **p == '>') && (*p)[1] != **p) op = **p == '<' ? "<" : ">";
+		if (!op) return v;
+		*p += strlen(op);
+		r = binary(as, p, level + 1);
+		if (!strcmp(op, "==") || !strcmp(op, "=")) v = v == r;
+		else if (!strcmp(op, "!=") || !strcmp(op, "<>")) v = v != r;
+		else if (!strcmp(op, "<=")) v = v <= r;
+		else if (!strcmp(op, ">=")) v = v >= r;
+		else if (!strcmp(op, "<")) v = v < r;
+		else if (!strcmp(op, ">")) v = v > r;
+		else if (!strcmp(op, "|")) v |= r;
+		else if (!strcmp(op, "^")) v ^= r;
+		else if (!strcmp(op, "&")) v &= r;
+		else if (!strcmp(op, "<<")) v <<= r;
+		else if (!strcmp(op, ">>")) v >>= r;
+		else if (!strcmp(op, "+")) v += r;
+		else if (!strcmp(op, "-")) v -= r;
+		else if (!strcmp(op, "*")) v *= r;
+		else if (r == 0) {
+			if (!as->undef) fail(as, "division by zero");
+			v = 0;
+		} else if (!strcmp(op, "/")) v /= r;
+		else v %= r;
+	}
+}
+
+static int32_t expression(Asm *as, const char **p)
+{
+	return binary(as, p, 0);
+}
+
+static int32_t evaluate(Asm *as, const char *text)
+{
+	const char *p = text;
+	int32_t v = expression(as, &p);
+
+	while (isspace((unsigned char)*p)) p++;
+	if (*p) fail(as, "bad expression '%s'", text);
+	return v;
+}
+
+//-------------------------------------------------------------------
+// Operands
+
+static int findName(const char *const *names, int count, const char *text)
+{
+	for (int i = 0; i < count; i++) {
+		if (names[i] && equalsNoCase(names[i], text)) return i;
+	}
+	return -1;
+}
+
+static bool parseOperand(Asm *as, const char *text, Operand *op)
+{
+	static const char *const rrNames[] = { "bc", "de", "hl", "sp" };
+	static const char *const halfNames[] = {
+		"ixh", "ixl", "iyh", "iyl", "xh", "xl", "yh", "yl", "hx", "lx", "hy", "ly"
+	};
+	size_t len = strlen(text);
+	int i;
+
+	memset(op, 0, sizeof(Operand));
+	op->text = text;
+	if ((i = findName(reg8Names, 8, text)) >= 0) {
+		op->kind = OP_R8;
+		op->reg = i;
+	} else if ((i = findName(halfNames, 12, text)) >= 0) {
+		static const uint8_t halfReg[] = { 4, 5, 4, 5, 4, 5, 4, 5, 4, 5, 4, 5 };
+		static const uint8_t halfIy[] = { 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1 };
+		op->kind = OP_R8;
+		op->reg = halfReg[i];
+		op->prefix = halfIy[i] ? 0xfd : 0xdd;
+		op->half = true;
+	} else if ((i = findName(rrNames, 4, text)) >= 0) {
+		op->kind = OP_RR;
+		op->reg = i;
+	} else if (equalsNoCase(text, "ix") || equalsNoCase(text, "iy")) {
+		op->kind = OP_RR;
+		op->reg = RR_HL;
+		op->prefix = tolower((unsigned char)text[1]) == 'x' ? 0xdd : 0xfd;
+	} else if (equalsNoCase(text, "af")) {
+		op->kind = OP_AF;
+	} else if (equalsNoCase(text, "af'")) {
+		op->kind = OP_AFX;
+	} else if (equalsNoCase(text, "i")) {
+		op->kind = OP_I;
+	} else if (equalsNoCase(text, "r")) {
+		op->kind = OP_R;
+	} else if (text[0] == '(' && len > 2 && text[len - 1] == ')') {
+		char inner[128];
+		int depth = 0;
+		bool whole = true;
+
+		// "(a)+(b)" is an expression, not an indirection
+		for (size_t k = 0; k < len - 1; k++) {
+			if (text[k] == '(') depth++;
+			else if (text[k] == ')' && --depth == 0) whole = false;
+		}
+		if (!whole) {
+			op->kind = OP_IMM;
+			op->value = evaluate(as, text);
+			return !as->error[0];
+		}
+		snprintf(inner, sizeof(inner), "%.*s", (int)len - 2, text + 1);
+		char *in = trim(inner);
+		if (equalsNoCase(in, "bc")) op->kind = OP_MBC;
+		else if (equalsNoCase(in, "de")) op->kind = OP_MDE;
+		else if (equalsNoCase(in, "sp")) op->kind = OP_MSP;
+		else if (equalsNoCase(in, "c")) op->kind = OP_MC;
+		else if (equalsNoCase(in, "hl")) {
+			op->kind = OP_R8;
+			op->reg = R_MEM;
+		} else if (tolower((unsigned char)in[0]) == 'i' &&
+				   (tolower((unsigned char)in[1]) == 'x' || tolower((unsigned char)in[1]) == 'y') &&
+				   !isIdentChar(in[2])) {
+			char *rest = trim(in + 2);
+			op->kind = OP_R8;
+			op->reg = R_MEM;
+			op->prefix = tolower((unsigned char)in[1]) == 'x' ? 0xdd : 0xfd;
+			if (*rest) {
+				if (*rest != '+' && *rest != '-') {
+					fail(as, "bad index '%s'", text);
+					return false;
+				}
+				op->value = evaluate(as, rest);
+			}
+		} else {
+			op->kind = OP_MEM;
+			op->value = evaluate(as, in);
+		}
+	} else {
+		op->kind = OP_IMM;
+		op->value = evaluate(as, text);
+	}
+	return !as->error[0];
+}
+
+//-------------------------------------------------------------------
+// Code
+
+static void emit(Asm *as, uint8_t b)
+{
+	if (as->codeLen < (int)sizeof(as->code)) as->code[as->codeLen++] = b;
+}
+
+static void emit16(Asm *as, int32_t v)
+{
+	emit(as, v & 0xff);
+	emit(as, (v >> 8) & 0xff);
+}
+
+static void emitPrefix(Asm *as, uint8_t prefix)
+{
+	if (prefix) emit(as, prefix);
+}
+
+static void emitDisp(Asm *as, const Operand *op)
+{
+	if (op->kind != OP_R8 || op->reg != R_MEM || !op->prefix) return;
+	if (as->pass == 2 && (op->value < -128 || op->value > 127)) fail(as, "index offset out of range");
+	emit(as, op->value & 0xff);
+}
+
+static void emitByte(Asm *as, int32_t v)
+{
+	if (as->pass == 2 && (v < -128 || v > 255)) fail(as, "byte value out of range");
+	emit(as, v & 0xff);
+}
+
+static void emitRelative(Asm *as, int32_t target)
+{
+	int32_t offset = target - (as->pc + as->codeLen + 1);
+
+	if (as->pass == 2 && (offset < -128 || offset > 127)) fail(as, "relative jump out of range");
+	emit(as, offset & 0xff);
+}
+
+// Prefix of an instruction with two 8-bit register operands
+static bool pairPrefix(Asm *as, const Operand *a, const Operand *b, uint8_t *prefix)
+{
+	bool memA = a->reg == R_MEM && a->prefix, memB = b->reg == R_MEM && b->prefix;
+
+	*prefix = a->prefix | b->prefix;
+	if ((a->prefix && b->prefix && a->prefix != b->prefix) || (memA && b->half) || (memB && a->half) ||
+		(a->half && !b->prefix && (b->reg == 4 || b->reg == 5 || b->reg == R_MEM)) ||
+		(b->half && !a->prefix && (a->reg == 4 || a->reg == 5 || a->reg == R_MEM))) {
+		fail(as, "invalid register combination");
+		return false;
+	}
+	return true;
+}
+
+// [prefix] op [d] for the instructions with one "r" operand
+static void emitR(Asm *as, uint8_t opcode, const Operand *r)
+{
+	emitPrefix(as, r->prefix);
+	emit(as, opcode);
+	emitDisp(as, r);
+}
+
+static bool isR8(const Operand *op)
+{
+	return op->kind == OP_R8;
+}
+
+static bool isA(const Operand *op)
+{
+	return op->kind == OP_R8 && op->reg == 7;
+}
+
+static int condition(const char *text, int count)
+{
+	return findName(condNames, count, text);
+}
+
+static bool badOperands(Asm *as, const char *mnem)
+{
+	fail(as, "invalid operands for %s", mnem);
+	return false;
+}
+
+static bool ld(Asm *as, Operand *d, Operand *s)
+{
+	uint8_t prefix;
+
+	if (isR8(d) && isR8(s)) {
+		if (d->reg == R_MEM && s->reg == R_MEM) return badOperands(as, "ld");
+		if (!pairPrefix(as, d, s, &prefix)) return false;
+		emitPrefix(as, prefix);
+		emit(as, 0x40 | (d->reg << 3) | s->reg);
+		emitDisp(as, d->reg == R_MEM ? d : s);
+		return true;
+	}
+	if (isR8(d) && s->kind == OP_IMM) {
+		emitR(as, 0x06 | (d->reg << 3), d);
+		emitByte(as, s->value);
+		return true;
+	}
+	if (isA(d)) {
+		switch (s->kind) {
+			case OP_MBC: emit(as, 0x0a); return true;
+			case OP_MDE: emit(as, 0x1a); return true;
+			case OP_MEM: emit(as, 0x3a); emit16(as, s->value); return true;
+			case OP_I: emit(as, 0xed); emit(as, 0x57); return true;
+			case OP_R: emit(as, 0xed); emit(as, 0x5f); return true;
+		}
+	}
+	if (isA(s)) {
+		switch (d->kind) {
+			case OP_MBC: emit(as, 0x02); return true;
+			case OP_MDE: emit(as, 0x12); return true;
+			case OP_MEM: emit(as, 0x32); emit16(as, d->value); return true;
+			case OP_I: emit(as, 0xed); emit(as, 0x47); return true;
+			case OP_R: emit(as, 0xed); emit(as, 0x4f); return true;
+		}
+	}
+	if (d->kind == OP_RR) {
+		if (s->kind == OP_IMM) {
+			emitPrefix(as, d->prefix);
+			emit(as, 0x01 | (d->reg << 4));
+			emit16(as, s->value);
+			return true;
+		}
+		if (s->kind == OP_MEM) {
+			if (d->reg == RR_HL) {
+				emitPrefix(as, d->prefix);
+				emit(as, 0x2a);
+			} else {
+				emit(as, 0xed);
+				emit(as, 0x4b | (d->reg << 4));
+			}
+			emit16(as, s->value);
+			return true;
+		}
+		if (d->reg == 3 && s->kind == OP_RR && s->reg == RR_HL) {
+			emitPrefix(as, s->prefix);
+			emit(as, 0xf9);
+			return true;
+		}
+		// sjasm fake instructions: ld rr,rr
+		if (s->kind == OP_RR && d->reg != 3 && s->reg != 3) {
+			bool xyD = d->prefix != 0, xyS = s->prefix != 0;
+			if ((xyD || xyS) && (d->reg == RR_HL || s->reg == RR_HL) && !(xyD && xyS && d->prefix == s->prefix)) {
+				if ((xyD && !xyS && s->reg != RR_HL) || (xyS && !xyD && d->reg != RR_HL)) {
+					// ld de,ix = ld d,ixh + ld e,ixl
+					uint8_t prefix = d->prefix | s->prefix;
+					int rd = d->prefix ? 4 : d->reg * 2, rs = s->prefix ? 4 : s->reg * 2;
+					emit(as, prefix);
+					emit(as, 0x40 | (rd << 3) | rs);
+					emit(as, prefix);
+					emit(as, 0x40 | ((rd + 1) << 3) | (rs + 1));
+					return true;
+				}
+				// ld hl,ix / ld ix,iy: push + pop
+				emitPrefix(as, s->prefix);
+				emit(as, 0xe5);
+				emitPrefix(as, d->prefix);
+				emit(as, 0xe1);
+				return true;
+			}
+			if (!xyD && !xyS) {
+				emit(as, 0x40 | ((d->reg * 2) << 3) | (s->reg * 2));
+				emit(as, 0x40 | ((d->reg * 2 + 1) << 3) | (s->reg * 2 + 1));
+				return true;
+			}
+		}
+	}
+	if (d->kind == OP_MEM && s->kind == OP_RR) {
+		if (s->reg == RR_HL) {
+			emitPrefix(as, s->prefix);
+			emit(as, 0x22);
+		} else {
+			emit(as, 0xed);
+			emit(as, 0x43 | (s->reg << 4));
+		}
+		emit16(as, d->value);
+		return true;
+	}
+	return badOperands(as, "ld");
+}
+
+static bool alu(Asm *as, int k, const char *mnem, Operand *ops, int count)
+{
+	Operand *s = &ops[count - 1];
+
+	if (count == 2 && ops[0].kind == OP_RR) {
+		Operand *d = &ops[0];
+		if (s->kind != OP_RR || d->reg != RR_HL) return badOperands(as, mnem);
+		if (s->prefix && s->prefix != d->prefix) return badOperands(as, mnem);
+		if (k == 0) {							// add hl/ix/iy,rr
+			if (s->reg == RR_HL && s->prefix != d->prefix) return badOperands(as, mnem);
+			emitPrefix(as, d->prefix);
+			emit(as, 0x09 | (s->reg << 4));
+			return true;
+		}
+		if ((k == 1 || k == 3) && !d->prefix && !s->prefix) {	// adc/sbc hl,rr
+			emit(as, 0xed);
+			emit(as, (k == 1 ? 0x4a : 0x42) | (s->reg << 4));
+			return true;
+		}
+		return badOperands(as, mnem);
+	}
+	if (count == 2 && !isA(&ops[0])) return badOperands(as, mnem);
+	if (isR8(s)) {
+		emitR(as, 0x80 | (k << 3) | s->reg, s);
+		return true;
+	}
+	if (s->kind == OP_IMM) {
+		emit(as, 0xc6 | (k << 3));
+		emitByte(as, s->value);
+		return true;
+	}
+	return badOperands(as, mnem);
+}
+
+static bool instruction(Asm *as, const char *mnem, char **texts, int count)
+{
+	static const char *const aluNames[] = { "add", "adc", "sub", "sbc", "and", "xor", "or", "cp" };
+	static const char *const rotNames[] = { "rlc", "rrc", "rl", "rr", "sla", "sra", "sll", "srl" };
+	static const char *const bitNames[] = { NULL, "bit", "res", "set" };
+	static const struct { const char *name; uint8_t ed, op; } simple[] = {
+		{ "nop", 0, 0x00 }, { "rlca", 0, 0x07 }, { "rrca", 0, 0x0f }, { "rla", 0, 0x17 },
+		{ "rra", 0, 0x1f }, { "daa", 0, 0x27 }, { "cpl", 0, 0x2f }, { "scf", 0, 0x37 },
+		{ "ccf", 0, 0x3f }, { "halt", 0, 0x76 }, { "exx", 0, 0xd9 }, { "di", 0, 0xf3 },
+		{ "ei", 0, 0xfb }, { "neg", 1, 0x44 }, { "retn", 1, 0x45 }, { "reti", 1, 0x4d },
+		{ "rrd", 1, 0x67 }, { "rld", 1, 0x6f }, { "ldi", 1, 0xa0 }, { "cpi", 1, 0xa1 },
+		{ "ini", 1, 0xa2 }, { "outi", 1, 0xa3 }, { "ldd", 1, 0xa8 }, { "cpd", 1, 0xa9 },
+		{ "ind", 1, 0xaa }, { "outd", 1, 0xab }, { "ldir", 1, 0xb0 }, { "cpir", 1, 0xb1 },
+		{ "inir", 1, 0xb2 }, { "otir", 1, 0xb3 }, { "lddr", 1, 0xb8 }, { "cpdr", 1, 0xb9 },
+		{ "indr", 1, 0xba }, { "otdr", 1, 0xbb },
+	};
+	Operand ops[MAX_OPERANDS];
+	int k, cc;
+
+	for (size_t i = 0; i < sizeof(simple) / sizeof(simple[0]); i++) {
+		if (!equalsNoCase(simple[i].name, mnem)) continue;
+		if (count) return badOperands(as, mnem);
+		if (simple[i].ed) emit(as, 0xed);
+		emit(as, simple[i].op);
+		return true;
+	}
+
+	// Jumps and calls take a condition as first operand
+	if (equalsNoCase(mnem, "jp") || equalsNoCase(mnem, "jr") || equalsNoCase(mnem, "call") ||
+		equalsNoCase(mnem, "ret")) {
+		bool jr = equalsNoCase(mnem, "jr");
+		bool ret = equalsNoCase(mnem, "ret");
+		Operand target;
+
+		cc = count >= 1 ? condition(texts[0], jr ? 4 : 8) : -1;
+		if (ret) {
+			if (count > 1 || (count == 1 && cc < 0)) return badOperands(as, mnem);
+			emit(as, cc < 0 ? 0xc9 : 0xc0 | (cc << 3));
+			return true;
+		}
+		if (count != (cc < 0 ? 1 : 2)) return badOperands(as, mnem);
+		if (!parseOperand(as, texts[count - 1], &target)) return false;
+		if (equalsNoCase(mnem, "jp") && cc < 0 && target.kind == OP_R8 && target.reg == R_MEM) {
+			if (target.value) return badOperands(as, mnem);
+			emitPrefix(as, target.prefix);
+			emit(as, 0xe9);
+			return true;
+		}
+		if (target.kind != OP_IMM) return badOperands(as, mnem);
+		if (jr) {
+			emit(as, cc < 0 ? 0x18 : 0x20 | (cc << 3));
+			emitRelative(as, target.value);
+		} else if (equalsNoCase(mnem, "jp")) {
+			emit(as, cc < 0 ? 0xc3 : 0xc2 | (cc << 3));
+			emit16(as, target.value);
+		} else {
+			emit(as, cc < 0 ? 0xcd : 0xc4 | (cc << 3));
+			emit16(as, target.value);
+		}
+		return true;
+	}
+
+	if (count > MAX_OPERANDS) return badOperands(as, mnem);
+	for (int i = 0; i < count; i++) {
+		if (!parseOperand(as, texts[i], &ops[i])) return false;
+	}
+
+	if (equalsNoCase(mnem, "ld")) {
+		if (count != 2) return badOperands(as, mnem);
+		return ld(as, &ops[0], &ops[1]);
+	}
+	if ((k = findName(aluNames, 8, mnem)) >= 0) {
+		if (count < 1 || count > 2) return badOperands(as, mnem);
+		return alu(as, k, mnem, ops, count);
+	}
+	if (equalsNoCase(mnem, "inc") || equalsNoCase(mnem, "dec")) {
+		bool dec = tolower((unsigned char)mnem[0]) == 'd';
+		if (count != 1) return badOperands(as, mnem);
+		if (isR8(&ops[0])) {
+			emitR(as, (dec ? 0x05 : 0x04) | (ops[0].reg << 3), &ops[0]);
+			return true;
+		}
+		if (ops[0].kind == OP_RR) {
+			emitPrefix(as, ops[0].prefix);
+			emit(as, (dec ? 0x0b : 0x03) | (ops[0].reg << 4));
+			return true;
+		}
+		return badOperands(as, mnem);
+	}
+	if (equalsNoCase(mnem, "push") || equalsNoCase(mnem, "pop")) {
+		uint8_t base = tolower((unsigned char)mnem[1]) == 'u' ? 0xc5 : 0xc1;
+		if (count != 1) return badOperands(as, mnem);
+		if (ops[0].kind == OP_AF) {
+			emit(as, base | 0x30);
+			return true;
+		}
+		if (ops[0].kind != OP_RR || ops[0].reg == 3) return badOperands(as, mnem);
+		emitPrefix(as, ops[0].prefix);
+		emit(as, base | (ops[0].reg << 4));
+		return true;
+	}
+	if (equalsNoCase(mnem, "ex")) {
+		if (count != 2) return badOperands(as, mnem);
+		if (ops[0].kind == OP_RR && ops[0].reg == 1 && ops[1].kind == OP_RR && ops[1].reg == RR_HL && !ops[1].prefix) {
+			emit(as, 0xeb);
+			return true;
+		}
+		if (ops[0].kind == OP_AF && ops[1].kind == OP_AFX) {
+			emit(as, 0x08);
+			return true;
+		}
+		if (ops[0].kind == OP_MSP && ops[1].kind == OP_RR && ops[1].reg == RR_HL) {
+			emitPrefix(as, ops[1].prefix);
+			emit(as, 0xe3);
+			return true;
+		}
+		return badOperands(as, mnem);
+	}
+	if ((k = findName(rotNames, 8, mnem)) >= 0 || (k = findName(bitNames, 4, mnem)) >= 0) {
+		bool bit = findName(rotNames, 8, mnem) < 0;
+		Operand *r = &ops[count - 1];
+		uint8_t op;
+
+		if (count != (bit ? 2 : 1) || !isR8(r) || r->half) return badOperands(as, mnem);
+		if (bit) {
+			if (ops[0].kind != OP_IMM || ops[0].value < 0 || ops[0].value > 7) return badOperands(as, mnem);
+			op = (k << 6) | (ops[0].value << 3) | r->reg;
+		} else {
+			op = (k << 3) | r->reg;
+		}
+		emitPrefix(as, r->prefix);
+		emit(as, 0xcb);
+		emitDisp(as, r);
+		emit(as, op);
+		return true;
+	}
+	if (equalsNoCase(mnem, "djnz")) {
+		if (count != 1 || ops[0].kind != OP_IMM) return badOperands(as, mnem);
+		emit(as, 0x10);
+		emitRelative(as, ops[0].value);
+		return true;
+	}
+	if (equalsNoCase(mnem, "rst")) {
+		if (count != 1 || ops[0].kind != OP_IMM || (ops[0].value & ~0x38)) return badOperands(as, mnem);
+		emit(as, 0xc7 | ops[0].value);
+		return true;
+	}
+	if (equalsNoCase(mnem, "im")) {
+		static const uint8_t modes[] = { 0x46, 0x56, 0x5e };
+		if (count != 1 || ops[0].kind != OP_IMM || ops[0].value < 0 || ops[0].value > 2) return badOperands(as, mnem);
+		emit(as, 0xed);
+		emit(as, modes[ops[0].value]);
+		return true;
+	}
+	if (equalsNoCase(mnem, "in")) {
+		if (count == 2 && isA(&ops[0]) && ops[1].kind == OP_MEM) {
+			emit(as, 0xdb);
+			emitByte(as, ops[1].value);
+			return true;
+		}
+		if (count == 2 && isR8(&ops[0]) && !ops[0].prefix && ops[0].reg != R_MEM && ops[1].kind == OP_MC) {
+			emit(as, 0xed);
+			emit(as, 0x40 | (ops[0].reg << 3));
+			return true;
+		}
+		if (count == 1 && ops[0].kind == OP_MC) {
+			emit(as, 0xed);
+			emit(as, 0x70);
+			return true;
+		}
+		return badOperands(as, mnem);
+	}
+	if (equalsNoCase(mnem, "out")) {
+		if (count == 2 && ops[0].kind == OP_MEM && isA(&ops[1])) {
+			emit(as, 0xd3);
+			emitByte(as, ops[0].value);
+			return true;
+		}
+		if (count == 2 && ops[0].kind == OP_MC && isR8(&ops[1]) && !ops[1].prefix && ops[1].reg != R_MEM) {
+			emit(as, 0xed);
+			emit(as, 0x41 | (ops[1].reg << 3));
+			return true;
+		}
+		if (count == 2 && ops[0].kind == OP_MC && ops[1].kind == OP_IMM && ops[1].value == 0) {
+			emit(as, 0xed);
+			emit(as, 0x71);
+			return true;
+		}
+		return badOperands(as, mnem);
+	}
+	fail(as, "unknown instruction %s", mnem);
+	return false;
+}
+
+//-------------------------------------------------------------------
+// Lines
+
+// Splits the operands at the commas outside of quotes and parentheses
+static int splitOperands(char *text, char **ops, int max)
+{
+	int count = 0, depth = 0;
+	char *start = text, *p;
+	char quote = 0;
+
+	if (!*trim(text)) return 0;
+	for (p = text; *p; p++) {
+		if (quote) {
+			if (*p == quote) quote = 0;
+		} else if (isQuote(text, p)) {
+			quote = *p;
+		} else if (*p == '(') {
+			depth++;
+		} else if (*p == ')') {
+			depth--;
+		} else if (*p == ',' && depth == 0) {
+			*p = '\0';
+			if (count < max) ops[count] = trim(start);
+			count++;
+			start = p + 1;
+		}
+	}
+	if (count < max) ops[count] = trim(start);
+	return count + 1;
+}
+
+static void stripComment(char *text)
+{
+	char quote = 0;
+
+	for (char *p = text; *p; p++) {
+		if (quote) {
+			if (*p == quote) quote = 0;
+		} else if (isQuote(text, p)) {
+			quote = *p;
+		} else if (*p == ';') {
+			*p = '\0';
+			return;
+		}
+	}
+}
+
+static void defineLabel(Asm *as, const char *name, int32_t value)
+{
+	Symbol *s = findSymbol(as, name);
+
+	if (s && s->defined && !s->soft) {
+		if ((s->pass == as->pass || s->pass == 0) && s->value != value) {
+			fail(as, "duplicate symbol %s", name);
+			return;
+		}
+		if (as->pass == 2 && s->value != value) {
+			fail(as, "symbol %s changed between passes", name);
+			return;
+		}
+	}
+	if (!s) s = addSymbol(as, name);
+	s->value = value;
+	s->defined = true;
+	s->soft = false;
+	s->pass = as->pass;
+}
+
+static bool data(Asm *as, const char *mnem, char **ops, int count)
+{
+	bool words = equalsNoCase(mnem, "dw") || equalsNoCase(mnem, "defw") || equalsNoCase(mnem, "word");
+
+	for (int i = 0; i < count; i++) {
+		const char *t = ops[i];
+		size_t len = strlen(t);
+
+		if (!words && len >= 2 && (t[0] == '"' || t[0] == '\'') && t[len - 1] == t[0] && len != 3) {
+			for (size_t k = 1; k < len - 1; k++) {
+				put(as, k - 1, t[k]);
+			}
+			if (as->pc < as->lo) as->lo = as->pc;
+			if (as->pc + len - 2 > as->hi) as->hi = as->pc + len - 2;
+			as->pc += len - 2;
+			continue;
+		}
+		int32_t v = evaluate(as, t);
+		if (as->error[0]) return false;
+		as->codeLen = 0;
+		if (words) emit16(as, v);
+		else emitByte(as, v);
+		for (int k = 0; k < as->codeLen; k++) {
+			put(as, k, as->code[k]);
+		}
+		if (as->pc < as->lo) as->lo = as->pc;
+		if (as->pc + (uint32_t)as->codeLen > as->hi) as->hi = as->pc + as->codeLen;
+		as->pc += as->codeLen;
+	}
+	return !as->error[0];
+}
+
+// incbin "file"[,offset[,length]], the file next to the source
+static bool incbin(Asm *as, char **ops, int count)
+{
+	char path[1024], name[512];
+	const char *slash = strrchr(as->cur->file, '/');
+	size_t len = strlen(ops[0]);
+	int32_t offset = 0, length = -1;
+	long size;
+	FILE *f;
+
+	if (count < 1 || count > 3 || len < 3 || ops[0][0] != '"' || ops[0][len - 1] != '"') {
+		return badOperands(as, "incbin");
+	}
+	snprintf(name, sizeof(name), "%.*s", (int)len - 2, ops[0] + 1);
+	if (slash && name[0] != '/') snprintf(path, sizeof(path), "%.*s/%s", (int)(slash - as->cur->file), as->cur->file, name);
+	else snprintf(path, sizeof(path), "%s", name);
+	if (count >= 2) offset = evaluate(as, ops[1]);
+	if (count == 3) length = evaluate(as, ops[2]);
+	if (as->error[0]) return false;
+	f = fopen(path, "rb");
+	if (!f) {
+		fail(as, "can't open %s", path);
+		return false;
+	}
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	if (length < 0) length = size - offset;
+	if (offset < 0 || length < 0 || offset + length > size) {
+		fclose(f);
+		fail(as, "incbin range out of %s", path);
+		return false;
+	}
+	fseek(f, offset, SEEK_SET);
+	for (int32_t k = 0; k < length; k++) {
+		int c = fgetc(f);
+		put(as, k, c);
+	}
+	fclose(f);
+	if (length && as->pc < as->lo) as->lo = as->pc;
+	if (as->pc + (uint32_t)length > as->hi) as->hi = as->pc + length;
+	as->pc += length;
+	return !as->error[0];
+}
+
+static bool assembleLine(Asm *as, const Line *line, int *ifDepth, bool *ifActive, bool *ifDone)
+{
+	char buf[512], *p, *mnem, *ops[MAX_OPERANDS];
+	char label[MAX_NAME] = "";
+	bool active = *ifDepth == 0 || ifActive[*ifDepth - 1];
+	int count;
+
+	snprintf(buf, sizeof(buf), "%s", line->text);
+	stripComment(buf);
+	p = buf;
+
+	if (isIdentStart(*p)) {
+		int n = 0;
+		while (isIdentChar(*p)) {
+			if (n < MAX_NAME - 1) label[n++] = *p;
+			p++;
+		}
+		label[n] = '\0';
+		if (*p == ':') p++;
+	}
+	while (isspace((unsigned char)*p)) p++;
+	mnem = p;
+	while (*p && !isspace((unsigned char)*p)) p++;
+	if (*p) *p++ = '\0';
+
+	// Conditional assembly
+	if (equalsNoCase(mnem, "if")) {
+		if (*ifDepth == MAX_IF_DEPTH) {
+			fail(as, "if nested too deep");
+			return false;
+		}
+		ifActive[*ifDepth] = active && evaluate(as, trim(p)) != 0;
+		ifDone[*ifDepth] = ifActive[*ifDepth] || !active;
+		(*ifDepth)++;
+		return !as->error[0];
+	}
+	if (equalsNoCase(mnem, "else")) {
+		if (!*ifDepth) {
+			fail(as, "else without if");
+			return false;
+		}
+		ifActive[*ifDepth - 1] = !ifDone[*ifDepth - 1];
+		ifDone[*ifDepth - 1] = true;
+		return true;
+	}
+	if (equalsNoCase(mnem, "endif")) {
+		if (!*ifDepth) {
+			fail(as, "endif without if");
+			return false;
+		}
+		(*ifDepth)--;
+		return true;
+	}
+	if (!active) return true;
+
+	if (equalsNoCase(mnem, "equ") || equalsNoCase(mnem, "=")) {
+		int32_t v;
+		if (!label[0]) {
+			fail(as, "equ without label");
+			return false;
+		}
+		v = evaluate(as, trim(p));
+		if (as->error[0]) return false;
+		defineLabel(as, label, v);
+		return !as->error[0];
+	}
+	if (label[0]) {
+		defineLabel(as, label, as->pc);
+		if (as->error[0]) return false;
+	}
+	if (!*mnem) return true;
+
+	count = splitOperands(p, ops, MAX_OPERANDS);
+	if (count > MAX_OPERANDS) {
+		fail(as, "too many operands");
+		return false;
+	}
+	if (equalsNoCase(mnem, "org")) {
+		if (count != 1) return badOperands(as, mnem);
+		as->pc = evaluate(as, ops[0]);
+		return !as->error[0];
+	}
+	if (equalsNoCase(mnem, "db") || equalsNoCase(mnem, "defb") || equalsNoCase(mnem, "byte") ||
+		equalsNoCase(mnem, "dm") || equalsNoCase(mnem, "defm") ||
+		equalsNoCase(mnem, "dw") || equalsNoCase(mnem, "defw") || equalsNoCase(mnem, "word")) {
+		return data(as, mnem, ops, count);
+	}
+	if (equalsNoCase(mnem, "ds") || equalsNoCase(mnem, "defs") || equalsNoCase(mnem, "block")) {
+		int32_t n, fill = 0;
+		if (count < 1 || count > 2) return badOperands(as, mnem);
+		n = evaluate(as, ops[0]);
+		if (count == 2) fill = evaluate(as, ops[1]);
+		if (as->error[0]) return false;
+		if (n < 0 || n > 0x10000) {
+			fail(as, "bad size");
+			return false;
+		}
+		for (int32_t k = 0; k < n; k++) {
+			put(as, k, fill);
+		}
+		if (n && as->pc < as->lo) as->lo = as->pc;
+		if (as->pc + (uint32_t)n > as->hi) as->hi = as->pc + n;
+		as->pc += n;
+		return true;
+	}
+
+	if (equalsNoCase(mnem, "incbin")) return incbin(as, ops, count);
+
+	as->codeLen = 0;
+	as->undef = false;
+	if (!instruction(as, mnem, ops, count)) return false;
+	for (int k = 0; k < as->codeLen; k++) {
+		put(as, k, as->code[k]);
+	}
+	if (as->pc < as->lo) as->lo = as->pc;
+	if (as->pc + (uint32_t)as->codeLen > as->hi) as->hi = as->pc + as->codeLen;
+	as->pc += as->codeLen;
+	return true;
+}
+
+static bool assemblePass(Asm *as)
+{
+	bool ifActive[MAX_IF_DEPTH], ifDone[MAX_IF_DEPTH];
+	int ifDepth = 0;
+
+	as->pc = 0;
+	for (int i = 0; i < as->lineCount; i++) {
+		as->cur = &as->lines[i];
+		if (!assembleLine(as, as->cur, &ifDepth, ifActive, ifDone)) return false;
+		if (as->error[0]) return false;
+	}
+	as->cur = NULL;
+	if (ifDepth) {
+		fail(as, "missing endif");
+		return false;
+	}
+	return true;
+}
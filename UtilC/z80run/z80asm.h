@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+#define ASM_MAX_ERROR	256
+
+// Two pass assembler for the sjasm syntax of the Util and BootMenu sources:
+// labels in column 0, #hex/%bin numbers, equ/org/db/dw/ds, if/else/endif
+// and the whole Z80 instruction set (with the IXH/IXL forms and the sjasm
+// "ld rr,rr" fake instructions), plus incbin. Macros and includes are not
+// expanded here: z80as does it before the lines are added.
+typedef struct Asm Asm;
+
+
+Asm    *asm_new(void);
+void    asm_free(Asm *as);
+bool    asm_define(Asm *as, const char *name, int32_t value, bool soft);
+bool    asm_defineExpr(Asm *as, const char *name, const char *expr, bool soft);
+void    asm_addLine(Asm *as, const char *text, const char *file, int line);
+void    asm_setAutoVars(Asm *as, uint16_t base, uint16_t size, uint16_t end);
+bool    asm_assemble(Asm *as, uint8_t *mem, uint16_t *start, uint16_t *size);
+bool    asm_lookup(const Asm *as, const char *name, int32_t *value);
+void    asm_setOutput(Asm *as, uint8_t *buf, uint32_t cap);
+uint32_t asm_outputSize(const Asm *as);
+const char *asm_error(const Asm *as);
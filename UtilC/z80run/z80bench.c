@@ -0,0 +1,854 @@
+/*
+ * z80bench: times the hot Z80 routines of the tools on the emulated MSX.
+ *
+ * Every kernel is cut out of its sjasm source (from one label up to the
+ * next routine), assembled at 0100h together with the equates of its
+ * source file, and called with representative data. Its variables are
+ * found as the symbols the kernel leaves undefined, and live at 1000h.
+ * A cartridge model in slot 1 stands for the Carnivore2.
+ *
+ * The T-states of a call are counted from the first instruction of the
+ * kernel to its return, the CALL itself excluded. BIOS slot switching
+ * (ENASLT) is served by the host and costs only its CALL and RET: the
+ * ENASLT column tells how many of them each kernel makes.
+ *
+ *   z80bench [-r repo] [kernel ...]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "msx.h"
+#include "z80asm.h"
+
+
+#define BENCH_ORG		0x0100		// Kernel code
+#define BENCH_VARS		0x1000		// Variables of the kernel, 64 bytes each
+#define BENCH_VARSIZE	64
+#define BENCH_BUF		0x2000		// 8KB data buffer
+#define BENCH_EXIT		0x0000		// Return address of the calls
+#define BENCH_SLOT		1			// Slot of the cartridge model
+#define BENCH_LIMIT		200000000ULL	// T-states per call
+
+#define CART_REGS		0x4f80		// Configuration registers (CardMDR)
+#define CART_EECS		0x23		// EEPROM port, CardMDR+#23
+#define CART_VERSION	0x2c		// Firmware version, 3 digits
+#define CART_XCTL		0x36		// Extended control, bit 1: EEPROM busy
+#define CART_XIDX		0x3e		// Extended register index
+#define CART_XDAT		0x3f		// Extended register data
+#define CART_IDE_BANK	0x4104		// Bit 0: IDE registers enabled
+#define CART_IDE_DATA	0x7c00		// IDE data register window, one sector
+#define CART_IDE_STATUS	0x7e07		// IDE status register
+#define IDE_READY		0x58		// DRDY, DSC and DRQ
+#define IDE_SECSIZE		512
+
+#define MAX_LINES		20000
+#define MAX_KERNELS		16
+#define MAX_FRAGMENTS	6
+
+#define NX_WORK			0xc000		// Work area of the Nextor driver
+#define NX_SECTORS		4			// Sectors of a read, CACHE_MAXRUN
+
+// Cartridge model: 64KB of RAM (the bank registers are not decoded), the
+// configuration registers at 4F80h-4FBFh, and the flash command sequence
+// AAh>xAAAh, 55h>x555h, A0h>xAAAh, after which the next write programs a
+// byte, clearing bits only. The first writes of a sequence that breaks off
+// go to the RAM, as they would with a RAM bank. The EEPROM data out is
+// always high (ready, erased). With shadow set the firmware is 2.60: XDat
+// reads and writes the EEPROM copy at XIdx 80h-FFh and XCtl is never busy.
+// While the IDE registers are enabled the status register always reads
+// ready, with the data of a sector.
+typedef struct {
+	uint8_t  mem[0x10000];
+	uint8_t  reg[0x40];
+	uint8_t  eeprom[0x80];
+	bool     shadow;
+	int      cycle;					// Position in the command sequence
+	uint16_t pending[2];			// Addresses of the held AAh and 55h
+	bool     program;
+} Cart;
+
+typedef struct {
+	char   **lines;
+	int      count;
+	char    *path;
+	const char *name;				// Path from the repository root
+} Source;
+
+typedef struct Bench Bench;
+
+typedef struct {
+	const char *name;
+	const char *file;				// Source, from the repository root
+	const char *fragments[MAX_FRAGMENTS];	// "First..Next": from label First up to label Next
+	const char *text;				// Lines assembled before the fragments
+	const char *entry;
+	int         calls;
+	uint32_t    bytes;				// Bytes processed by each call
+	void      (*setup)(Bench *b, int call);
+	const char *(*check)(Bench *b, int call);	// NULL if the call did its job
+} Kernel;
+
+struct Bench {
+	Msx      *msx;
+	Asm      *as;
+	Cart      cart;
+	const char *error;
+	char      errorBuf[64];
+	uint32_t  seed;
+	uint64_t  enaslt;
+};
+
+static const char usage[] =
+	"Usage: z80bench [-r repo] [kernel ...]\n"
+	"Times the Z80 kernels of the tools and prints the T-states per call and per byte.\n"
+	"\n"
+	"  -r repo    Root of the repository (default: ../..)\n"
+	"  -l         List the kernels\n";
+
+//###################################################################
+// Variables & Func.Definitions
+
+static bool    loadSource(Source *src, const char *root, const char *name);
+static void    freeSource(Source *src);
+static bool    runKernel(const char *root, const Kernel *k, uint64_t *cycles, uint64_t *enaslt, char *error, size_t errorSize);
+
+
+//###################################################################
+// Private Functions
+
+//-------------------------------------------------------------------
+// Cartridge model
+
+static void cartStore(Cart *c, uint16_t addr, uint8_t value)
+{
+	if (c->program) {
+		c->mem[addr] &= value;
+		c->program = false;
+	} else {
+		c->mem[addr] = value;
+	}
+}
+
+// A read or a write out of sequence ends it: the held writes go to the RAM
+static void cartFlush(Cart *c)
+{
+	if (c->cycle >= 1) c->mem[c->pending[0]] = 0xaa;
+	if (c->cycle >= 2) c->mem[c->pending[1]] = 0x55;
+	c->cycle = 0;
+}
+
+static uint8_t cartRead(void *ctx, uint16_t addr)
+{
+	Cart *c = ctx;
+
+	if (addr >= CART_REGS && addr < CART_REGS + sizeof(c->reg)) {
+		uint8_t r = addr - CART_REGS;
+		if (r == CART_EECS) return c->reg[CART_EECS] | 0x01;
+		if (c->shadow && r == CART_XCTL) return 0;
+		if (c->shadow && r == CART_XDAT) {
+			uint8_t i = c->reg[CART_XIDX]++;
+			return i & 0x80 ? c->eeprom[i & 0x7f] : 0xff;
+		}
+		return c->reg[r];
+	}
+	if (addr == CART_IDE_STATUS && (c->mem[CART_IDE_BANK] & 1)) return IDE_READY;
+	if (c->cycle) cartFlush(c);
+	return c->mem[addr];
+}
+
+static void cartWrite(void *ctx, uint16_t addr, uint8_t value)
+{
+	Cart *c = ctx;
+	uint16_t offset = addr & 0x0fff;
+
+	if (addr >= CART_REGS && addr < CART_REGS + sizeof(c->reg)) {
+		uint8_t r = addr - CART_REGS;
+		if (c->shadow && r == CART_XDAT) {
+			uint8_t i = c->reg[CART_XIDX]++;
+			if (i & 0x80) c->eeprom[i & 0x7f] = value;
+			return;
+		}
+		c->reg[r] = value;
+		return;
+	}
+	if (c->program) {
+		cartStore(c, addr, value);
+		return;
+	}
+	if (c->cycle == 1 && !(offset == 0x555 && value == 0x55)) cartFlush(c);
+	if (c->cycle == 2 && offset != 0xaaa) cartFlush(c);
+	switch (c->cycle) {
+		case 0:
+			if (offset == 0xaaa && value == 0xaa) {
+				c->pending[0] = addr;
+				c->cycle = 1;
+				return;
+			}
+			break;
+		case 1:
+			c->pending[1] = addr;
+			c->cycle = 2;
+			return;
+		case 2:
+			c->cycle = 0;
+			c->program = value == 0xa0;
+			return;
+	}
+	cartStore(c, addr, value);
+}
+
+//-------------------------------------------------------------------
+// Helpers for the kernels
+
+static uint16_t sym(Bench *b, const char *name)
+{
+	int32_t v = 0;
+
+	if (!asm_lookup(b->as, name, &v) && !b->error) {
+		snprintf(b->errorBuf, sizeof(b->errorBuf), "no symbol %s", name);
+		b->error = b->errorBuf;
+	}
+	return v;
+}
+
+static void poke(Bench *b, uint16_t addr, uint8_t value)
+{
+	msx_write(b->msx, addr, value);
+}
+
+static uint8_t peek(Bench *b, uint16_t addr)
+{
+	return msx_read(b->msx, addr);
+}
+
+static uint8_t rnd(Bench *b)
+{
+	b->seed = b->seed * 1103515245 + 12345;
+	return b->seed >> 16;
+}
+
+static bool carry(Bench *b)
+{
+	return b->msx->cpu.af.b.l & Z80_FLAG_C;
+}
+
+// Pages 1 and 2 in the cartridge, as seen by the boot menu
+static void cartPages(Bench *b)
+{
+	b->msx->slotReg = (b->msx->slotReg & 0xc3) | (BENCH_SLOT << 2) | (BENCH_SLOT << 4);
+}
+
+static void fillBuffer(Bench *b)
+{
+	for (int i = 0; i < 0x2000; i++) poke(b, BENCH_BUF + i, rnd(b));
+}
+
+static const char *checkCopy(Bench *b)
+{
+	if (carry(b)) return "returned a failure (CF=1)";
+	for (int i = 0; i < 0x2000; i++) {
+		if (b->cart.mem[0x8000 + i] != peek(b, BENCH_BUF + i)) return "data differs";
+	}
+	return NULL;
+}
+
+//-------------------------------------------------------------------
+// Kernels
+
+// Flash programming: 8KB from the buffer to the erased page 2
+static void setupFBProg2(Bench *b, int call)
+{
+	Z80 *cpu = &b->msx->cpu;
+
+	(void)call;
+	poke(b, sym(b, "ERMSlt"), BENCH_SLOT);
+	fillBuffer(b);
+	memset(b->cart.mem + 0x8000, 0xff, 0x2000);
+	cpu->hl.w = BENCH_BUF;
+	cpu->de.w = 0x8000;
+	cpu->bc.w = 0x2000;
+}
+
+static const char *checkFBProg2(Bench *b, int call)
+{
+	(void)call;
+	return checkCopy(b);
+}
+
+// Toggle bit polling after the byte was written
+static void setupCHECK(Bench *b, int call)
+{
+	Z80 *cpu = &b->msx->cpu;
+
+	poke(b, BENCH_BUF, call);
+	cpu->af.b.h = call;
+	cpu->de.w = BENCH_BUF;
+}
+
+static const char *checkCHECK(Bench *b, int call)
+{
+	(void)call;
+	return carry(b) ? "returned a failure (CF=1)" : NULL;
+}
+
+// BIOS to shadow RAM: 24 banks of 8KB, copied and checked
+static void setupShadow(Bench *b, int call)
+{
+	(void)call;
+	poke(b, sym(b, "ERMSlt"), BENCH_SLOT);
+	poke(b, sym(b, "F_A"), 0);
+	for (int i = 0; i < 0x2000; i++) b->cart.mem[0x8000 + i] = rnd(b);
+}
+
+static const char *checkShadow(Bench *b, int call)
+{
+	(void)call;
+	return peek(b, sym(b, "ShadowMDR")) != 0x23 ? "shadowing not enabled" : NULL;
+}
+
+// Boot menu directory sort: 100 entries of 64 bytes with random names
+#define SORT_ENTRIES	100
+
+static void setupDirSort(Bench *b, int call)
+{
+	(void)call;
+	cartPages(b);
+	poke(b, sym(b, "SORT"), 1);
+	poke(b, sym(b, "DIRCNT"), SORT_ENTRIES + 1);
+	poke(b, sym(b, "DIRCNT") + 1, 0);
+	memset(b->cart.mem + 0x8000, 0xff, 0x4000);
+	for (int e = 1; e <= SORT_ENTRIES; e++) {
+		uint8_t *p = b->cart.mem + 0x8000 + e * 64;
+		for (int i = 0; i < 64; i++) p[i] = rnd(b) & 0x7f;
+		p[0] = e;
+		for (int i = 5; i < 5 + 30; i++) p[i] = 'A' + rnd(b) % 26;
+	}
+}
+
+static const char *checkDirSort(Bench *b, int call)
+{
+	bool seen[SORT_ENTRIES + 1] = { false };
+
+	(void)call;
+	for (int e = 1; e <= SORT_ENTRIES; e++) {
+		const uint8_t *p = b->cart.mem + 0x8000 + e * 64;
+		if (p[0] < 1 || p[0] > SORT_ENTRIES || seen[p[0]]) return "entries lost";
+		seen[p[0]] = true;
+		if (e > 1 && memcmp(p - 64 + 5, p + 5, 5) > 0) return "not sorted";
+	}
+	return NULL;
+}
+
+// Direct VDP output: a 40x24 screen
+static void setupCHPUT_VDP(Bench *b, int call)
+{
+	if (!call) {
+		poke(b, sym(b, "CSRX"), 1);
+		poke(b, sym(b, "CSRY"), 1);
+	}
+	b->msx->cpu.af.b.h = 'A' + call % 26;
+}
+
+static const char *checkCHPUT_VDP(Bench *b, int call)
+{
+	return b->msx->vram[call] != 'A' + call % 26 ? "wrong VRAM contents" : NULL;
+}
+
+// Mapper detection scan: 32KB of a ROM writing the Konami SCC registers
+static void setupDetectMapper(Bench *b, int call)
+{
+	static const uint8_t banks[] = { 0x50, 0x70, 0x90, 0xb0 };
+
+	(void)call;
+	cartPages(b);
+	for (int i = 0x4000; i < 0xc000; i++) b->cart.mem[i] = rnd(b);
+	for (int i = 0; i < 64; i++) {
+		uint16_t a = 0x4010 + i * 0x1f0;
+		b->cart.mem[a] = 0x32;
+		b->cart.mem[a + 1] = 0x00;
+		b->cart.mem[a + 2] = banks[i & 3];
+	}
+	b->msx->cpu.de.w = 0;
+}
+
+static const char *checkDetectMapper(Bench *b, int call)
+{
+	static const uint8_t regs[] = { 0x50, 0x60, 0x68, 0x70, 0x78, 0x80, 0x90, 0xa0, 0xb0 };
+	uint16_t mask = 0;
+
+	(void)call;
+	for (uint32_t a = 0x4000; a < 0xc000; a++) {
+		uint8_t op = peek(b, a), lo = peek(b, a + 1), hi = peek(b, a + 2);
+		int first = 0;
+		if (op == 0x2a) {
+			if (lo != 0xff || peek(b, a + 3) != 0x77) continue;
+			first = 1;
+		} else if (op != 0x32 || lo != 0x00) {
+			continue;
+		}
+		for (int r = first; r < (first ? 5 : 9); r++) {
+			if (hi == regs[r]) mask |= 1 << r;
+		}
+	}
+	return b->msx->cpu.de.w != mask ? "wrong mapper bit mask" : NULL;
+}
+
+// Save to the SRAM: 8KB from the buffer to page 2
+static void setupRW_RAM(Bench *b, int call)
+{
+	Z80 *cpu = &b->msx->cpu;
+
+	(void)call;
+	poke(b, sym(b, "ERMSlt"), BENCH_SLOT);
+	fillBuffer(b);
+	cpu->hl.w = BENCH_BUF;
+	cpu->de.w = 0x8000;
+	cpu->bc.w = 0x2000;
+}
+
+static const char *checkRW_RAM(Bench *b, int call)
+{
+	(void)call;
+	return checkCopy(b);
+}
+
+// 93C46 EEPROM bit-bang on firmware 2.50, one byte per call
+static void setupEERD(Bench *b, int call)
+{
+	cartPages(b);
+	memcpy(b->cart.reg + CART_VERSION, "250", 3);
+	b->msx->cpu.af.b.h = call;
+}
+
+static const char *checkEERD(Bench *b, int call)
+{
+	(void)call;
+	return b->msx->cpu.af.b.h != 0xff ? "wrong data" : NULL;
+}
+
+// The same from the EEPROM shadow of firmware 2.60
+static void setupEERDsh(Bench *b, int call)
+{
+	cartPages(b);
+	memcpy(b->cart.reg + CART_VERSION, "260", 3);
+	b->cart.shadow = true;
+	b->cart.eeprom[call] = call ^ 0xa5;
+	b->msx->cpu.af.b.h = call;
+}
+
+static const char *checkEERDsh(Bench *b, int call)
+{
+	return b->msx->cpu.af.b.h != (call ^ 0xa5) ? "wrong data" : NULL;
+}
+
+static void setupEEWR(Bench *b, int call)
+{
+	cartPages(b);
+	memcpy(b->cart.reg + CART_VERSION, "250", 3);
+	b->msx->cpu.af.b.h = call;
+	b->msx->cpu.de.b.l = call ^ 0x5a;
+}
+
+static void setupEEWRsh(Bench *b, int call)
+{
+	setupEEWR(b, call);
+	memcpy(b->cart.reg + CART_VERSION, "260", 3);
+	b->cart.shadow = true;
+}
+
+static const char *checkEEWRsh(Bench *b, int call)
+{
+	return b->cart.eeprom[call] != (call ^ 0x5a) ? "not written" : NULL;
+}
+
+// IDE sector moves: 512 bytes between the data register window and the buffer
+static void setupIDE_RDSECT(Bench *b, int call)
+{
+	(void)call;
+	cartPages(b);
+	for (int i = 0; i < IDE_SECSIZE; i++) b->cart.mem[CART_IDE_DATA + i] = rnd(b);
+	b->msx->cpu.de.w = BENCH_BUF;
+}
+
+static const char *checkIDE_RDSECT(Bench *b, int call)
+{
+	(void)call;
+	if (b->msx->cpu.de.w != BENCH_BUF + IDE_SECSIZE) return "DE not advanced";
+	for (int i = 0; i < IDE_SECSIZE; i++) {
+		if (b->cart.mem[CART_IDE_DATA + i] != peek(b, BENCH_BUF + i)) return "data differs";
+	}
+	return NULL;
+}
+
+static void setupIDE_WRSECT(Bench *b, int call)
+{
+	(void)call;
+	cartPages(b);
+	for (int i = 0; i < IDE_SECSIZE; i++) poke(b, BENCH_BUF + i, rnd(b));
+	b->msx->cpu.hl.w = BENCH_BUF;
+}
+
+static const char *checkIDE_WRSECT(Bench *b, int call)
+{
+	(void)call;
+	if (b->msx->cpu.hl.w != BENCH_BUF + IDE_SECSIZE) return "HL not advanced";
+	for (int i = 0; i < IDE_SECSIZE; i++) {
+		if (b->cart.mem[CART_IDE_DATA + i] != peek(b, BENCH_BUF + i)) return "data differs";
+	}
+	return NULL;
+}
+
+// Nextor driver reads of 4 sectors: from the IDE with the cache off, and
+// through the cache when all of them are hits. The work area holds the
+// copy of XFER, the sectors are in consecutive sets, the cache window at
+// 6000h is not decoded by the cartridge model.
+static void setupNX(Bench *b, int call)
+{
+	Z80 *cpu = &b->msx->cpu;
+	uint32_t lba = (uint32_t)call * 61 + 0x12345;
+
+	cartPages(b);
+	poke(b, NX_WORK + sym(b, "W_HEAD"), 0xe0);
+	for (int i = 0; i < 4; i++) poke(b, NX_WORK + sym(b, "W_LBA") + i, lba >> (i * 8));
+	for (int i = 0; i < IDE_SECSIZE; i++) b->cart.mem[CART_IDE_DATA + i] = rnd(b);
+	cpu->ix.w = NX_WORK;
+	cpu->hl.w = BENCH_BUF;
+	cpu->bc.b.h = NX_SECTORS;
+	cpu->af.b.l &= ~Z80_FLAG_C;
+}
+
+static void setupNX_HIT(Bench *b, int call)
+{
+	uint16_t xfer = sym(b, "XFER"), size = sym(b, "XFER_END") - xfer;
+	uint32_t lba = (uint32_t)call * 61 + 0x12345;
+	int sets = sym(b, "CACHE_SETS"), way = call & 3;
+
+	setupNX(b, call);
+	memcpy(b->cart.reg + CART_VERSION, "250", 3);
+	for (int i = 0; i < size; i++) poke(b, NX_WORK + sym(b, "W_XFER") + i, peek(b, xfer + i));
+	poke(b, NX_WORK + sym(b, "W_CACHE"), 1);
+	poke(b, NX_WORK + sym(b, "W_OWNSLT"), BENCH_SLOT);
+	poke(b, NX_WORK + sym(b, "W_CARSLT"), BENCH_SLOT);
+	for (int s = 0; s < sets; s++) {
+		poke(b, NX_WORK + sym(b, "W_LRU") + s, 0xe4);
+		for (int i = 0; i < 16; i++) poke(b, NX_WORK + sym(b, "W_TAGS") + s * 16 + i, 0xff);
+	}
+	for (int n = 0; n < NX_SECTORS; n++) {
+		uint32_t tag = lba + n;
+		int set = tag & (sets - 1), line = (set * 4 + way) & 15;
+		for (int i = 0; i < 4; i++) poke(b, NX_WORK + sym(b, "W_TAGS") + set * 16 + way * 4 + i, tag >> (i * 8));
+		for (int i = 0; i < IDE_SECSIZE; i++) b->cart.mem[0x6000 + line * IDE_SECSIZE + i] = rnd(b);
+	}
+}
+
+static const char *checkNX_IDERD(Bench *b, int call)
+{
+	(void)call;
+	if (b->msx->cpu.af.b.h || b->msx->cpu.bc.b.h != NX_SECTORS) return "read failed";
+	for (int n = 0; n < NX_SECTORS; n++) {
+		for (int i = 0; i < IDE_SECSIZE; i++) {
+			if (b->cart.mem[CART_IDE_DATA + i] != peek(b, BENCH_BUF + n * IDE_SECSIZE + i)) return "data differs";
+		}
+	}
+	return NULL;
+}
+
+static const char *checkNX_HIT(Bench *b, int call)
+{
+	int sets = sym(b, "CACHE_SETS"), way = call & 3;
+
+	if (b->msx->cpu.af.b.h) return "read failed";
+	if (peek(b, NX_WORK + sym(b, "W_HITS")) != (uint8_t)((call + 1) * NX_SECTORS)) return "not a hit";
+	for (int n = 0; n < NX_SECTORS; n++) {
+		int line = (((call * 61 + 0x12345 + n) & (sets - 1)) * 4 + way) & 15;
+		for (int i = 0; i < IDE_SECSIZE; i++) {
+			if (b->cart.mem[0x6000 + line * IDE_SECSIZE + i] != peek(b, BENCH_BUF + n * IDE_SECSIZE + i)) return "data differs";
+		}
+	}
+	return NULL;
+}
+
+static const Kernel kernels[] = {
+	{ "FBProg2", "Util/c2man.asm", { "FBProg2..Shadow", "CHECK..FrDIR" }, NULL, "FBProg2",
+	  1, 0x2000, setupFBProg2, checkFBProg2 },
+	{ "CHECK", "Util/c2man.asm", { "CHECK..FrDIR" }, NULL, "CHECK",
+	  256, 1, setupCHECK, checkCHECK },
+	{ "Shadow", "Util/c2man.asm", { "Shadow..FBerase" }, NULL, "Shadow",
+	  1, 24 * 0x2000, setupShadow, checkShadow },
+	{ "DirSort", "BootMenu/BOOTCMFC.ASM", { "DirSort..CHFKEY" }, NULL, "DirSort",
+	  1, SORT_ENTRIES * 64, setupDirSort, checkDirSort },
+	{ "CHPUT_VDP", "BootMenu/BOOTCMFC.ASM", { "CHPUT_VDP..HookOn" }, NULL, "CHPUT_VDP",
+	  960, 1, setupCHPUT_VDP, checkCHPUT_VDP },
+	{ "DetectMapper", "Util/c2man.asm", { "DTME6..DTME" }, "BUFTOP\tequ\t#4000\nDTME:\tret", "DTME6",
+	  1, 0x8000, setupDetectMapper, checkDetectMapper },
+	{ "RW_RAM", "Util/c2sram.asm", { "RW_RAM..CHECK", "CHECK..FrErr" }, NULL, "RW_RAM",
+	  1, 0x2000, setupRW_RAM, checkRW_RAM },
+	{ "EERD", "BootMenu/BOOTCMFC.ASM", { "EESHD..EEWR" }, NULL, "EERD",
+	  128, 1, setupEERD, checkEERD },
+	{ "EERDsh", "BootMenu/BOOTCMFC.ASM", { "EESHD..EEWR" }, NULL, "EERD",
+	  128, 1, setupEERDsh, checkEERDsh },
+	{ "EEWR", "BootMenu/BOOTCMFC.ASM", { "EESHD..EERD", "EEWR..FadeOut" }, NULL, "EEWR",
+	  128, 1, setupEEWR, NULL },
+	{ "EEWRsh", "BootMenu/BOOTCMFC.ASM", { "EESHD..EERD", "EEWR..FadeOut" }, NULL, "EEWR",
+	  128, 1, setupEEWRsh, checkEEWRsh },
+	{ "IDE_RDSECT", "Util/lib/ide.inc", { "IDE_RDSECT..IDE_SETMULT" }, NULL, "IDE_RDSECT",
+	  16, IDE_SECSIZE, setupIDE_RDSECT, checkIDE_RDSECT },
+	{ "IDE_WRSECT", "Util/lib/ide.inc", { "IDE_RDSECT..IDE_SETMULT" }, NULL, "IDE_WRSECT",
+	  16, IDE_SECSIZE, setupIDE_WRSECT, checkIDE_WRSECT },
+	{ "NX_IDERD", "BIOSes/Sources/c2nxdrv.asm", { "IDE_RW..IDE_IDENT", "WAIT_RDY..RD_INIT" },
+	  NULL, "IDE_RW", 16, NX_SECTORS * IDE_SECSIZE, setupNX, checkNX_IDERD },
+	{ "NX_HIT", "BIOSes/Sources/c2nxdrv.asm", { "DEV_RD_CACHE..DEV_WR", "CA_FIND..GETWRK", "WRKADR..PRINT",
+	  "IDE_RW..IDE_IDENT", "WAIT_RDY..RD_INIT" }, "CACHE_SETS\tequ\t32", "DEV_RD_CACHE",
+	  16, NX_SECTORS * IDE_SECSIZE, setupNX_HIT, checkNX_HIT },
+};
+static const int kernelCount = sizeof(kernels) / sizeof(kernels[0]);
+
+//-------------------------------------------------------------------
+// Sources
+
+static bool loadSource(Source *src, const char *root, const char *name)
+{
+	FILE *f;
+	char line[1024];
+
+	memset(src, 0, sizeof(Source));
+	src->name = name;
+	src->path = malloc(strlen(root) + strlen(name) + 2);
+	src->lines = malloc(MAX_LINES * sizeof(char*));
+	if (!src->path || !src->lines) return false;
+	sprintf(src->path, "%s/%s", root, name);
+	f = fopen(src->path, "r");
+	if (!f) return false;
+	while (src->count < MAX_LINES && fgets(line, sizeof(line), f)) {
+		line[strcspn(line, "\r\n")] = '\0';
+		src->lines[src->count++] = strdup(line);
+	}
+	fclose(f);
+	return true;
+}
+
+static void freeSource(Source *src)
+{
+	for (int i = 0; i < src->count; i++) free(src->lines[i]);
+	free(src->lines);
+	free(src->path);
+}
+
+// Line where a label is defined (in column 0), -1 if not found
+static int findLabel(const Source *src, const char *label, int from)
+{
+	size_t len = strlen(label);
+
+	for (int i = from; i < src->count; i++) {
+		const char *l = src->lines[i];
+		if (!strncmp(l, label, len) && (l[len] == ':' || l[len] == ' ' || l[len] == '\t' || !l[len])) return i;
+	}
+	return -1;
+}
+
+// The equates of a source are soft symbols: the kernel can redefine them
+static void addEquates(Asm *as, const Source *src)
+{
+	bool progress = true;
+
+	while (progress) {
+		progress = false;
+		for (int i = 0; i < src->count; i++) {
+			char buf[1024], *p, *name, *expr;
+			size_t n;
+
+			snprintf(buf, sizeof(buf), "%s", src->lines[i]);
+			p = buf;
+			if (!*p || strchr(" \t;", *p)) continue;
+			name = p;
+			p += strcspn(p, ": \t");
+			if (!*p) continue;
+			*p++ = '\0';
+			p += strspn(p, ": \t");
+			if (strncasecmp(p, "equ", 3) || !strchr(" \t", p[3])) continue;
+			expr = p + 4;
+			expr[strcspn(expr, ";")] = '\0';
+			n = strlen(expr);
+			while (n && strchr(" \t", expr[n - 1])) expr[--n] = '\0';
+			if (asm_defineExpr(as, name, expr, true)) progress = true;
+		}
+	}
+}
+
+static bool addFragment(Asm *as, const Source *src, const char *fragment)
+{
+	char first[64], next[64];
+	const char *dots = strstr(fragment, "..");
+	int from, to;
+
+	snprintf(first, sizeof(first), "%.*s", (int)(dots - fragment), fragment);
+	snprintf(next, sizeof(next), "%s", dots + 2);
+	from = findLabel(src, first, 0);
+	to = from < 0 ? -1 : findLabel(src, next, from + 1);
+	if (to < 0) return false;
+	for (int i = from; i < to; i++) asm_addLine(as, src->lines[i], src->name, i + 1);
+	return true;
+}
+
+//-------------------------------------------------------------------
+// Runs
+
+static bool call(Bench *b, uint16_t entry, uint64_t *cycles)
+{
+	Z80 *cpu = &b->msx->cpu;
+	uint64_t start;
+
+	cpu->sp = MSX_DOS_TOP;
+	z80_push(cpu, BENCH_EXIT);
+	cpu->pc = entry;
+	cpu->halted = false;
+	start = cpu->cycles;
+	while (cpu->pc != BENCH_EXIT || cpu->sp != MSX_DOS_TOP) {
+		if (cpu->pc == 0x0024) b->enaslt++;
+		z80_step(cpu);
+		if (b->msx->finished || b->msx->error || cpu->halted) {
+			b->error = b->msx->error ? b->msx->error : "unexpected end";
+			return false;
+		}
+		if (cpu->cycles - start > BENCH_LIMIT) {
+			b->error = "T-state limit reached";
+			return false;
+		}
+	}
+	*cycles += cpu->cycles - start;
+	return true;
+}
+
+static bool runKernel(const char *root, const Kernel *k, uint64_t *cycles, uint64_t *enaslt, char *error, size_t errorSize)
+{
+	static uint8_t image[0x10000];
+	static MsxDevice cartDev;
+	Bench *b = calloc(1, sizeof(Bench));
+	Source src;
+	uint16_t start = 0, size = 0;
+	bool ok = false;
+	int32_t entry;
+
+	*cycles = *enaslt = 0;
+	if (!b || !loadSource(&src, root, k->file)) {
+		snprintf(error, errorSize, "can't read %s/%s", root, k->file);
+		if (b) freeSource(&src);
+		free(b);
+		return false;
+	}
+	b->msx = malloc(sizeof(Msx));
+	b->as = asm_new();
+	b->seed = 1;
+
+	// Kernel code
+	addEquates(b->as, &src);
+	asm_addLine(b->as, "\torg\t#0100", "z80bench", 0);
+	if (k->text) {
+		char text[256], *line, *save;
+		snprintf(text, sizeof(text), "%s", k->text);
+		for (line = strtok_r(text, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+			asm_addLine(b->as, line, "z80bench", 0);
+		}
+	}
+	for (int i = 0; i < MAX_FRAGMENTS && k->fragments[i]; i++) {
+		if (!addFragment(b->as, &src, k->fragments[i])) {
+			snprintf(error, errorSize, "%s not found in %s", k->fragments[i], k->file);
+			goto done;
+		}
+	}
+	asm_setAutoVars(b->as, BENCH_VARS, BENCH_VARSIZE, BENCH_BUF);
+	memset(image, 0, sizeof(image));
+	if (!asm_assemble(b->as, image, &start, &size)) {
+		snprintf(error, errorSize, "%s", asm_error(b->as));
+		goto done;
+	}
+	if (start < BENCH_ORG || start + size > BENCH_VARS || !asm_lookup(b->as, k->entry, &entry)) {
+		snprintf(error, errorSize, "kernel doesn't fit at %04Xh", BENCH_ORG);
+		goto done;
+	}
+
+	// Machine
+	if (!b->msx || !msx_init(b->msx, DOS_NEXTOR, 64)) {
+		snprintf(error, errorSize, "out of memory");
+		goto done;
+	}
+	cartDev.read = cartRead;
+	cartDev.write = cartWrite;
+	cartDev.ctx = &b->cart;
+	msx_insert(b->msx, BENCH_SLOT, 0, &cartDev);
+	msx_start(b->msx, image + BENCH_ORG, start + size - BENCH_ORG, "");
+	b->msx->vdpReg[1] &= ~0x20;		// No interrupts
+
+	for (int c = 0; c < k->calls; c++) {
+		const char *fail = NULL;
+		k->setup(b, c);
+		if (!b->error && call(b, entry, cycles) && k->check) fail = k->check(b, c);
+		if (b->error || fail) {
+			snprintf(error, errorSize, "call %d: %s", c + 1, b->error ? b->error : fail);
+			goto free;
+		}
+	}
+	*enaslt = b->enaslt;
+	ok = true;
+free:
+	msx_free(b->msx);
+done:
+	free(b->msx);
+	asm_free(b->as);
+	freeSource(&src);
+	free(b);
+	return ok;
+}
+
+
+//###################################################################
+// Main
+
+int main(int argc, char **argv)
+{
+	const char *root = "../..";
+	bool selected[MAX_KERNELS] = { false }, any = false;
+	int i, rc = 0;
+
+	for (i = 1; i < argc; i++) {
+		const char *opt = argv[i];
+		if (!strcmp(opt, "-r") && i + 1 < argc) {
+			root = argv[++i];
+		} else if (!strcmp(opt, "-l")) {
+			for (int k = 0; k < kernelCount; k++) printf("%-14s %s\n", kernels[k].name, kernels[k].file);
+			return 0;
+		} else if (opt[0] == '-') {
+			fputs(usage, stderr);
+			return 2;
+		} else {
+			int k;
+			for (k = 0; k < kernelCount && strcmp(kernels[k].name, opt); k++);
+			if (k == kernelCount) {
+				fprintf(stderr, "z80bench: unknown kernel %s\n", opt);
+				return 2;
+			}
+			selected[k] = any = true;
+		}
+	}
+
+	printf("%-14s %-26s %6s %8s %12s %12s %9s %6s\n",
+		   "Kernel", "Source", "Calls", "Bytes", "T-states", "T/call", "T/byte", "ENASLT");
+	for (int k = 0; k < kernelCount; k++) {
+		const Kernel *kn = &kernels[k];
+		uint64_t cycles, enaslt;
+		uint32_t bytes = kn->calls * kn->bytes;
+		char error[ASM_MAX_ERROR + 64];
+
+		if (any && !selected[k]) continue;
+		if (!runKernel(root, kn, &cycles, &enaslt, error, sizeof(error))) {
+			printf("%-14s %-26s FAIL: %s\n", kn->name, kn->file, error);
+			rc = 1;
+			continue;
+		}
+		printf("%-14s %-26s %6d %8u %12llu %12.1f %9.2f %6llu\n", kn->name, kn->file, kn->calls, bytes,
+			   (unsigned long long)cycles, (double)cycles / kn->calls, (double)cycles / bytes,
+			   (unsigned long long)enaslt);
+	}
+	return rc;
+}
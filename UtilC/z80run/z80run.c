@@ -0,0 +1,255 @@
+/*
+ * z80run: runs a MSX-DOS .COM program on the host, in an emulated MSX with
+ * a Z80 core and a BDOS served from a host directory.
+ *
+ * The console output of the program is scanned for the unittest_assert
+ * messages: every test reported as OK, failed or TODO is listed with the
+ * T-states it took (counted from the end of the previous test).
+ *
+ * With --c2 a Carnivore2 model is plugged in slot 1 (see c2cart.c), and its
+ * flash, EEPROM and IDE activity is reported at the end.
+ *
+ *   z80run [options] program.com [arguments]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "msx.h"
+#include "c2cart.h"
+
+
+#define LINE_SIZE	512
+
+typedef struct {
+	Msx      *msx;
+	bool      verbose;
+	bool      quiet;
+	char      line[LINE_SIZE];
+	int       lineLen;
+	bool      failing;				// Printing the details of a failed assert
+	uint64_t  mark;					// T-states at the end of the previous test
+	uint64_t  markDos;
+	int       passed, failed, todo;
+} Runner;
+
+static const char *const dosNames[] = { "", "MSX-DOS 1", "MSX-DOS 2", "Nextor" };
+
+static const char usage[] =
+	"Usage: z80run [options] program.com [arguments]\n"
+	"Runs a MSX-DOS program and reports the unittest_assert results.\n"
+	"\n"
+	"  -d dir     Host directory for the drive A: (default: current directory)\n"
+	"  -i image   Disk image for the sector level calls (default: built from -d)\n"
+	"  --dos1     Emulate MSX-DOS 1\n"
+	"  --dos2     Emulate MSX-DOS 2\n"
+	"  --nextor   Emulate Nextor (default)\n"
+	"  -m segs    RAM mapper size in 16KB segments (default: 64)\n"
+	"  -l limit   Stop after this many T-states (default: 4000000000)\n"
+	"  -c cost    T-states charged to every DOS/BIOS call (default: 0)\n"
+	"  --c2 flash Carnivore2 in slot 1 with this flash image (\"-\": erased flash)\n"
+	"  --cf image CF card of the Carnivore2 (raw device image)\n"
+	"  --c2-save file  Save the flash image at the end, if it was changed\n"
+	"  -v         Echo the console output of the program\n"
+	"  -q         Print only the summary\n";
+
+//###################################################################
+// Variables & Func.Definitions
+
+static void console(void *ctx, uint8_t ch);
+static void scanLine(Runner *r, const char *line);
+
+
+//###################################################################
+// Main
+
+int main(int argc, char **argv)
+{
+	const char *dir = ".", *image = NULL, *program = NULL;
+	const char *c2Flash = NULL, *c2Disk = NULL, *c2Save = NULL;
+	C2Cart *cart = NULL;
+	DosKind dos = DOS_NEXTOR;
+	unsigned segments = 64;
+	uint64_t limit = 4000000000ULL, cost = 0;
+	char args[128] = "";
+	Runner runner;
+	Msx *msx;
+	int i, rc;
+
+	memset(&runner, 0, sizeof(runner));
+	for (i = 1; i < argc && !program; i++) {
+		const char *opt = argv[i];
+		if (!strcmp(opt, "-d") && i + 1 < argc) dir = argv[++i];
+		else if (!strcmp(opt, "-i") && i + 1 < argc) image = argv[++i];
+		else if (!strcmp(opt, "--dos1")) dos = DOS_MSXDOS1;
+		else if (!strcmp(opt, "--dos2")) dos = DOS_MSXDOS2;
+		else if (!strcmp(opt, "--nextor")) dos = DOS_NEXTOR;
+		else if (!strcmp(opt, "-m") && i + 1 < argc) segments = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(opt, "-l") && i + 1 < argc) limit = strtoull(argv[++i], NULL, 0);
+		else if (!strcmp(opt, "-c") && i + 1 < argc) cost = strtoull(argv[++i], NULL, 0);
+		else if (!strcmp(opt, "--c2") && i + 1 < argc) c2Flash = argv[++i];
+		else if (!strcmp(opt, "--cf") && i + 1 < argc) c2Disk = argv[++i];
+		else if (!strcmp(opt, "--c2-save") && i + 1 < argc) c2Save = argv[++i];
+		else if (!strcmp(opt, "-v")) runner.verbose = true;
+		else if (!strcmp(opt, "-q")) runner.quiet = true;
+		else if (opt[0] == '-') {
+			fputs(usage, stderr);
+			return 2;
+		} else program = opt;
+	}
+	if (!program) {
+		fputs(usage, stderr);
+		return 2;
+	}
+	if ((c2Disk || c2Save) && !c2Flash) c2Flash = "-";
+	if (segments < 4 || segments > MSX_MAX_SEGMENTS || (segments & (segments - 1))) {
+		fprintf(stderr, "z80run: the mapper size must be a power of 2 between 4 and %d\n", MSX_MAX_SEGMENTS);
+		return 2;
+	}
+	for (; i < argc; i++) {
+		if (strlen(args) + strlen(argv[i]) + 2 > sizeof(args)) break;
+		if (args[0]) strcat(args, " ");
+		strcat(args, argv[i]);
+	}
+
+	msx = malloc(sizeof(Msx));
+	if (!msx || !msx_init(msx, dos, segments)) {
+		fprintf(stderr, "z80run: out of memory\n");
+		return 2;
+	}
+	msx->console = console;
+	msx->consoleCtx = &runner;
+	msx->trapCost = cost;
+	runner.msx = msx;
+
+	if (c2Flash) {
+		cart = malloc(sizeof(C2Cart));
+		if (!cart || !c2cart_init(cart, msx, 1)) {
+			fprintf(stderr, "z80run: out of memory\n");
+			return 2;
+		}
+		if (strcmp(c2Flash, "-") && !c2cart_loadFlash(cart, c2Flash)) {
+			fprintf(stderr, "z80run: can't read %s\n", c2Flash);
+			return 2;
+		}
+		if (c2Disk && !c2cart_openDisk(cart, c2Disk)) {
+			fprintf(stderr, "z80run: can't open %s\n", c2Disk);
+			return 2;
+		}
+	}
+
+	dos_init(msx, dir, image);
+	if (msx->error) {
+		fprintf(stderr, "z80run: %s\n", msx->error);
+		return 2;
+	}
+	if (!msx_load(msx, program, args)) {
+		fprintf(stderr, "z80run: can't load %s\n", program);
+		return 2;
+	}
+	dos_setProgram(msx, program, args);
+
+	runner.mark = msx->cpu.cycles;
+	msx_run(msx, limit);
+	if (runner.lineLen) scanLine(&runner, "");
+
+	printf("%s [%s]: %d passed, %d failed, %d todo, %llu T-states (%.3f s), %llu DOS calls, %llu BIOS calls\n",
+		   program, dosNames[dos], runner.passed, runner.failed, runner.todo,
+		   (unsigned long long)msx->cpu.cycles, (double)msx->cpu.cycles / MSX_CLOCK,
+		   (unsigned long long)msx->dosCalls, (unsigned long long)msx->biosCalls);
+	if (cart) {
+		c2cart_printStats(cart, stdout);
+		if (c2Save && cart->flashDirty && !c2cart_saveFlash(cart, c2Save)) {
+			fprintf(stderr, "z80run: can't write %s\n", c2Save);
+		}
+	}
+
+	if (msx->error) {
+		fprintf(stderr, "z80run: %s at PC=%04Xh\n", msx->error, msx->cpu.pc);
+		rc = 2;
+	} else if (runner.failed || msx->exitCode) {
+		if (msx->exitCode && !runner.failed) printf("%s: exit code %d\n", program, msx->exitCode);
+		rc = 1;
+	} else {
+		rc = 0;
+	}
+	if (cart) c2cart_free(cart);
+	free(cart);
+	dos_free(msx);
+	msx_free(msx);
+	free(msx);
+	return rc;
+}
+
+
+//###################################################################
+// Private Functions
+
+static void console(void *ctx, uint8_t ch)
+{
+	Runner *r = ctx;
+
+	if (r->verbose) {
+		if (ch != '\r' && ch != 0x07) putchar(ch);
+		if (ch == '\n') fflush(stdout);
+	}
+	if (ch == '\n') {
+		r->line[r->lineLen] = '\0';
+		scanLine(r, r->line);
+		r->lineLen = 0;
+		return;
+	}
+	if (ch < ' ' || r->lineLen >= LINE_SIZE - 1) return;
+	r->line[r->lineLen++] = ch;
+}
+
+static bool endsWith(const char *str, const char *end)
+{
+	size_t len = strlen(str), endLen = strlen(end);
+	return len >= endLen && !strcmp(str + len - endLen, end);
+}
+
+static void report(Runner *r, const char *status, const char *name, int nameLen)
+{
+	Msx *msx = r->msx;
+
+	if (!r->quiet) {
+		printf("  %-4s  %-60.*s %12llu T %6llu DOS\n", status, nameLen, name,
+			   (unsigned long long)(msx->cpu.cycles - r->mark),
+			   (unsigned long long)(msx->dosCalls - r->markDos));
+	}
+	r->mark = msx->cpu.cycles;
+	r->markDos = msx->dosCalls;
+}
+
+/**
+ * scanLine
+ * Looks for the unittest_assert messages in a line of console output.
+ */
+static void scanLine(Runner *r, const char *line)
+{
+	static const char failPrefix[] = "### Assert failed at: ";
+	static const char todoPrefix[] = "### TODO: ";
+	static const char failByPrefix[] = "Fail by ";
+
+	if (endsWith(line, " ... OK")) {
+		r->failing = false;
+		r->passed++;
+		report(r, "OK", line, strlen(line) - 7);
+	} else if (!strncmp(line, failPrefix, sizeof(failPrefix) - 1)) {
+		r->failing = true;
+		r->failed++;
+		report(r, "FAIL", line + sizeof(failPrefix) - 1, strlen(line) - (sizeof(failPrefix) - 1));
+	} else if (!strncmp(line, failByPrefix, sizeof(failByPrefix) - 1)) {
+		r->failing = true;
+		r->failed++;
+		report(r, "FAIL", line, strlen(line));
+	} else if (!strncmp(line, todoPrefix, sizeof(todoPrefix) - 1)) {
+		r->failing = false;
+		r->todo++;
+		report(r, "TODO", line + sizeof(todoPrefix) - 1, strlen(line) - (sizeof(todoPrefix) - 1));
+	} else if (r->failing && line[0] == ' ') {
+		if (!r->quiet) printf("        %s\n", line + strspn(line, " "));
+	} else {
+		r->failing = false;
+	}
+}